@@ -81,6 +81,14 @@ native port (devel packages)
 /usr/include/nopoll/nopoll_msg.h
 /usr/include/nopoll/nopoll_private.h
 /usr/include/nopoll/nopoll_win32.h
+/usr/include/nopoll/nopoll_metrics.h
+/usr/include/nopoll/nopoll_histogram.h
+/usr/include/nopoll/nopoll_worker.h
+/usr/include/nopoll/nopoll_writer.h
+/usr/include/nopoll/nopoll_utf8.h
+/usr/include/nopoll/nopoll_deflate.h
+/usr/include/nopoll/nopoll_timer.h
+/usr/include/nopoll/nopoll_conn_pool.h
 /usr/lib64/pkgconfig/nopoll.pc
 
 %changelog
@@ -51,11 +51,19 @@ BEGIN_C_DECLS
 #include <nopoll_io.h>
 #include <nopoll_conn_opts.h>
 #include <nopoll_conn.h>
+#include <nopoll_conn_pool.h>
 #include <nopoll_msg.h>
 #include <nopoll_log.h>
 #include <nopoll_listener.h>
 #include <nopoll_io.h>
 #include <nopoll_loop.h>
+#include <nopoll_timer.h>
+#include <nopoll_deflate.h>
+#include <nopoll_utf8.h>
+#include <nopoll_writer.h>
+#include <nopoll_worker.h>
+#include <nopoll_histogram.h>
+#include <nopoll_metrics.h>
 
 /** 
  * \addtogroup nopoll_module
@@ -50,6 +50,10 @@
 
 #if defined(NOPOLL_OS_UNIX)
 # include <netinet/tcp.h>
+# include <poll.h>
+#endif
+#if defined(NOPOLL_HAVE_SENDFILE)
+# include <sys/sendfile.h>
 #endif
 
 
@@ -230,6 +234,383 @@ nopoll_bool                 nopoll_conn_set_bind_interface (NOPOLL_SOCKET socket
 	return nopoll_true;
 } /* end */
 
+/**
+ * @internal Creates a socket for the address provided and starts a non
+ * blocking TCP connect to it.
+ *
+ * @return The socket created (the connect may still be in progress)
+ * or NOPOLL_INVALID_SOCKET if it fails.
+ */
+NOPOLL_SOCKET __nopoll_conn_sock_connect_start (noPollCtx       * ctx,
+						struct addrinfo * address,
+						const char      * host,
+						const char      * port,
+						noPollConnOpts  * options)
+{
+	NOPOLL_SOCKET        session;
+
+	/* create the socket */
+	session      = socket (address->ai_family, SOCK_STREAM, 0);
+	if (session == NOPOLL_INVALID_SOCKET) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "unable to create socket");
+		return NOPOLL_INVALID_SOCKET;
+	} /* end if */
+
+	/* disable nagle */
+	nopoll_conn_set_sock_tcp_nodelay (session, nopoll_true);
+
+	/* bind to specified interface */
+	if( nopoll_true != nopoll_conn_set_bind_interface (session, options) ) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "unable to bind to specified interface");
+		nopoll_close_socket (session);
+		return NOPOLL_INVALID_SOCKET;
+	} /* end if */
+
+	/* set non blocking status */
+	nopoll_conn_set_sock_block (session, nopoll_false);
+	
+	/* do a tcp connect */
+        if (connect (session, address->ai_addr, address->ai_addrlen) < 0) {
+		if(errno != NOPOLL_EINPROGRESS && errno != NOPOLL_EWOULDBLOCK && errno != NOPOLL_ENOTCONN) { 
+			nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "unable to connect to remote host %s:%s errno=%d",
+				    host, port, errno);
+
+		        shutdown (session, SHUT_RDWR);
+                        nopoll_close_socket (session);
+			return NOPOLL_INVALID_SOCKET;
+		} /* end if */
+	} /* end if */
+
+	return session;
+}
+
+/**
+ * @internal Resolves the family provided (0 for IPv6, 1 for IPv4) of
+ * a dual stack connect unless it is already being resolved.
+ */
+void __nopoll_conn_happy_eyeballs_resolve (noPollHappyEyeballs * he, int family)
+{
+	struct addrinfo * res;
+
+	nopoll_mutex_lock (he->ctx->ref_mutex);
+	if (he->state[family] != 0) {
+		nopoll_mutex_unlock (he->ctx->ref_mutex);
+		return;
+	} /* end if */
+	he->state[family] = 1;
+	nopoll_mutex_unlock (he->ctx->ref_mutex);
+
+	res = __nopoll_ctx_resolve (he->ctx, family == 0 ? NOPOLL_TRANSPORT_IPV6 : NOPOLL_TRANSPORT_IPV4, he->host, he->port);
+
+	nopoll_mutex_lock (he->ctx->ref_mutex);
+	he->res[family]   = res;
+	he->state[family] = 2;
+	nopoll_mutex_unlock (he->ctx->ref_mutex);
+	return;
+}
+
+/**
+ * @internal Releases a reference to the dual stack connect state.
+ */
+void __nopoll_conn_happy_eyeballs_unref (noPollHappyEyeballs * he)
+{
+	int refs;
+
+	nopoll_mutex_lock (he->ctx->ref_mutex);
+	he->refs--;
+	refs = he->refs;
+	nopoll_mutex_unlock (he->ctx->ref_mutex);
+	if (refs > 0)
+		return;
+
+	__nopoll_ctx_resolve_release (he->res[0]);
+	__nopoll_ctx_resolve_release (he->res[1]);
+	nopoll_free (he->host);
+	nopoll_free (he->port);
+	nopoll_free (he);
+	return;
+}
+
+/**
+ * @internal Worker task resolving IPv6 addresses of a dual stack connect.
+ */
+void __nopoll_conn_happy_eyeballs_resolve6 (noPollPtr data, nopoll_bool cancelled)
+{
+	if (! cancelled)
+		__nopoll_conn_happy_eyeballs_resolve ((noPollHappyEyeballs *) data, 0);
+	__nopoll_conn_happy_eyeballs_unref ((noPollHappyEyeballs *) data);
+	return;
+}
+
+/**
+ * @internal Worker task resolving IPv4 addresses of a dual stack connect.
+ */
+void __nopoll_conn_happy_eyeballs_resolve4 (noPollPtr data, nopoll_bool cancelled)
+{
+	if (! cancelled)
+		__nopoll_conn_happy_eyeballs_resolve ((noPollHappyEyeballs *) data, 1);
+	__nopoll_conn_happy_eyeballs_unref ((noPollHappyEyeballs *) data);
+	return;
+}
+
+/**
+ * @internal Waits up to the provided microseconds until any of the
+ * connects in progress finishes, flagging them at ready.
+ *
+ * Unlike select (2) on unix, poll (2) accepts descriptors above
+ * FD_SETSIZE (on windows, fd_set is bounded by count, and there are
+ * at most NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES sockets).
+ */
+void __nopoll_conn_happy_eyeballs_wait (NOPOLL_SOCKET * sockets, int count, long wait, nopoll_bool * ready)
+{
+#if defined(NOPOLL_OS_UNIX)
+	struct pollfd   fds[NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES];
+#else
+	fd_set          wset;
+	fd_set          eset;
+	struct timeval  tv;
+#endif
+	int             watched = 0;
+	int             iterator;
+
+#if defined(NOPOLL_OS_UNIX)
+	for (iterator = 0; iterator < count; iterator++) {
+		ready[iterator] = nopoll_false;
+		if (sockets[iterator] == NOPOLL_INVALID_SOCKET)
+			continue;
+		fds[watched].fd      = sockets[iterator];
+		fds[watched].events  = POLLOUT;
+		fds[watched].revents = 0;
+		watched++;
+	} /* end for */
+
+	/* round up so short waits still wait */
+	if (poll (fds, watched, (int) ((wait + 999) / 1000)) <= 0)
+		return;
+
+	watched = 0;
+	for (iterator = 0; iterator < count; iterator++) {
+		if (sockets[iterator] == NOPOLL_INVALID_SOCKET)
+			continue;
+		ready[iterator] = fds[watched].revents != 0;
+		watched++;
+	} /* end for */
+#else
+	FD_ZERO (&wset);
+	FD_ZERO (&eset);
+	for (iterator = 0; iterator < count; iterator++) {
+		ready[iterator] = nopoll_false;
+		if (sockets[iterator] == NOPOLL_INVALID_SOCKET)
+			continue;
+		FD_SET (sockets[iterator], &wset);
+		FD_SET (sockets[iterator], &eset);
+		watched++;
+	} /* end for */
+
+	if (watched == 0) {
+		nopoll_sleep (wait);
+		return;
+	} /* end if */
+
+	tv.tv_sec  = wait / 1000000;
+	tv.tv_usec = wait % 1000000;
+	if (select (0, NULL, &wset, &eset, &tv) <= 0)
+		return;
+
+	for (iterator = 0; iterator < count; iterator++) {
+		if (sockets[iterator] != NOPOLL_INVALID_SOCKET)
+			ready[iterator] = FD_ISSET (sockets[iterator], &wset) || FD_ISSET (sockets[iterator], &eset);
+	} /* end for */
+#endif
+	return;
+}
+
+/**
+ * @internal Dual stack connect (RFC 8305, "happy eyeballs"): resolves
+ * IPv6 and IPv4 addresses for the host at the same time (on workers,
+ * see __nopoll_worker_run_task) and races non blocking connects
+ * against them as they arrive, starting a new attempt every \ref
+ * NOPOLL_HAPPY_EYEBALLS_DELAY microseconds (interleaving families,
+ * IPv6 first) while previous ones are still in progress. IPv4
+ * addresses resolved first wait \ref
+ * NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY for IPv6 ones, so a slow
+ * or broken AAAA lookup does not delay the IPv4 fallback. The first
+ * attempt completing wins and the rest are closed.
+ *
+ * The race runs on the worker dialing the connection (see
+ * __nopoll_conn_dial_start), so nopoll_conn_new and friends do not
+ * wait for it. Unlike the single address connect, the socket returned
+ * is already connected. The whole race is limited by the context
+ * connect timeout (see \ref nopoll_conn_connect_timeout).
+ *
+ * @return A connected socket or -1 if it fails.
+ */
+NOPOLL_SOCKET __nopoll_conn_sock_connect_happy_eyeballs (noPollCtx       * ctx,
+							 const char      * host,
+							 const char      * port,
+							 noPollConnOpts  * options)
+{
+	noPollHappyEyeballs * he;
+	struct addrinfo     * next[2]  = {NULL, NULL};
+	nopoll_bool           taken[2] = {nopoll_false, nopoll_false};
+	nopoll_bool           queued[2];
+	int                   state[2];
+	struct addrinfo     * candidates[NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES];
+	NOPOLL_SOCKET         sockets[NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES];
+	nopoll_bool           ready[NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES];
+	NOPOLL_SOCKET         session     = NOPOLL_INVALID_SOCKET;
+	int                   started     = 0;
+	int                   family      = 0;
+	int                   chosen;
+	int                   pending;
+	int                   iterator;
+	int                   error;
+	socklen_t             error_len;
+	struct timeval        start;
+	long                  elapsed;
+	long                  last_attempt = 0;
+	long                  ipv4_first   = -1;
+	long                  wait;
+
+	he = nopoll_new (noPollHappyEyeballs, 1);
+	if (he == NULL)
+		return -1;
+	he->ctx  = ctx;
+	he->host = nopoll_strdup (host);
+	he->port = nopoll_strdup (port);
+
+	/* resolve both families at the same time (families whose
+	 * task can't be queued are resolved below by this thread):
+	 * references are held by this thread and both tasks */
+	he->refs  = 3;
+	queued[0] = __nopoll_worker_run_task (ctx, __nopoll_conn_happy_eyeballs_resolve6, he);
+	if (! queued[0])
+		__nopoll_conn_happy_eyeballs_unref (he);
+	queued[1] = __nopoll_worker_run_task (ctx, __nopoll_conn_happy_eyeballs_resolve4, he);
+	if (! queued[1])
+		__nopoll_conn_happy_eyeballs_unref (he);
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Starting dual stack connect to %s:%s", host, port);
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&start, NULL);
+#else
+	gettimeofday (&start, NULL);
+#endif
+	while (session == NOPOLL_INVALID_SOCKET) {
+		elapsed = __nopoll_conn_elapsed_since (&start);
+		if (elapsed >= ctx->conn_connect_std_timeout)
+			break;
+
+		/* take addresses resolved meanwhile */
+		nopoll_mutex_lock (ctx->ref_mutex);
+		for (iterator = 0; iterator < 2; iterator++) {
+			state[iterator] = he->state[iterator];
+			if (! taken[iterator] && state[iterator] == 2) {
+				next[iterator]  = he->res[iterator];
+				taken[iterator] = nopoll_true;
+			} /* end if */
+		} /* end for */
+		nopoll_mutex_unlock (ctx->ref_mutex);
+
+		pending = 0;
+		for (iterator = 0; iterator < started; iterator++) {
+			if (sockets[iterator] != NOPOLL_INVALID_SOCKET)
+				pending++;
+		} /* end for */
+		if (started == NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES)
+			next[0] = next[1] = NULL;
+
+		/* nothing in progress nor left to try */
+		if (pending == 0 && next[0] == NULL && next[1] == NULL) {
+			if (state[0] == 2 && state[1] == 2)
+				break;
+
+			/* families that couldn't be queued are
+			 * resolved here, and so are those no worker
+			 * took in time (every worker busy) */
+			if (state[0] == 0 && (! queued[0] || elapsed >= NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY))
+				__nopoll_conn_happy_eyeballs_resolve (he, 0);
+			else if (state[1] == 0 && (! queued[1] || elapsed >= NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY))
+				__nopoll_conn_happy_eyeballs_resolve (he, 1);
+			else
+				nopoll_sleep (NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY / 5);
+			continue;
+		} /* end if */
+
+		/* start next attempt (right away when every previous
+		 * one failed) */
+		if ((next[0] || next[1]) && (pending == 0 || elapsed - last_attempt >= NOPOLL_HAPPY_EYEBALLS_DELAY)) {
+			chosen = next[family] ? family : 1 - family;
+
+			/* IPv4 resolved first: wait a bit for IPv6 */
+			if (chosen == 1 && started == 0 && state[0] != 2) {
+				if (ipv4_first == -1)
+					ipv4_first = elapsed;
+				if (elapsed - ipv4_first < NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY) {
+					nopoll_sleep (NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY / 5);
+					continue;
+				} /* end if */
+			} /* end if */
+
+			candidates[started] = next[chosen];
+			next[chosen]        = next[chosen]->ai_next;
+			sockets[started]    = __nopoll_conn_sock_connect_start (ctx, candidates[started], host, port, options);
+			started++;
+			last_attempt        = elapsed;
+			family              = 1 - chosen;
+			continue;
+		} /* end if */
+
+		/* wait for the attempts in progress until the next one
+		 * is due (checking resolutions still running often) */
+		wait = ctx->conn_connect_std_timeout - elapsed;
+		if ((next[0] || next[1]) && NOPOLL_HAPPY_EYEBALLS_DELAY - (elapsed - last_attempt) < wait)
+			wait = NOPOLL_HAPPY_EYEBALLS_DELAY - (elapsed - last_attempt);
+		if ((state[0] != 2 || state[1] != 2) && wait > NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY / 5)
+			wait = NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY / 5;
+		if (wait < 0)
+			wait = 0;
+		__nopoll_conn_happy_eyeballs_wait (sockets, started, wait, ready);
+
+		for (iterator = 0; iterator < started; iterator++) {
+			if (sockets[iterator] == NOPOLL_INVALID_SOCKET || ! ready[iterator])
+				continue;
+
+			/* check connect result */
+			error     = 0;
+			error_len = sizeof (error);
+			if (getsockopt (sockets[iterator], SOL_SOCKET, SO_ERROR, (char *) &error, &error_len) == 0 && error == 0) {
+				nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Dual stack connect to %s:%s won by candidate %d (family %s)",
+					    host, port, iterator, candidates[iterator]->ai_family == AF_INET6 ? "IPv6" : "IPv4");
+				session           = sockets[iterator];
+				sockets[iterator] = NOPOLL_INVALID_SOCKET;
+				break;
+			} /* end if */
+
+			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Dual stack connect candidate %d to %s:%s failed, error=%d", iterator, host, port, error);
+			nopoll_close_socket (sockets[iterator]);
+			sockets[iterator] = NOPOLL_INVALID_SOCKET;
+		} /* end for */
+	} /* end while */
+
+	/* close attempts that lost the race */
+	for (iterator = 0; iterator < started; iterator++) {
+		if (sockets[iterator] != NOPOLL_INVALID_SOCKET)
+			nopoll_close_socket (sockets[iterator]);
+	} /* end for */
+
+	/* release addresses (once the workers finish) */
+	__nopoll_conn_happy_eyeballs_unref (he);
+
+	if (session == NOPOLL_INVALID_SOCKET) {
+		nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "unable to connect to remote host %s:%s, every dual stack candidate failed", host, port);
+		return -1;
+	} /* end if */
+
+	return session;
+}
+
 NOPOLL_SOCKET __nopoll_conn_sock_connect_opts_internal (noPollCtx       * ctx,
 							noPollTransport   transport,
 							const char      * host,
@@ -237,40 +618,12 @@ NOPOLL_SOCKET __nopoll_conn_sock_connect_opts_internal (noPollCtx       * ctx,
 							noPollConnOpts  * options)
 {
 
-	struct addrinfo      hints, *res = NULL;
+	struct addrinfo    * res         = NULL;
 	NOPOLL_SOCKET        session     = NOPOLL_INVALID_SOCKET;
 
-	/* clear hints structure */
-	memset (&hints, 0, sizeof(struct addrinfo));
-
 	switch (transport) {
 	case NOPOLL_TRANSPORT_IPV4:
-		/* configure hints */
-		hints.ai_family   = AF_INET;
-		hints.ai_socktype = SOCK_STREAM;
-		
-		/* resolve hosting name */
-		if (getaddrinfo (host, port, &hints, &res) != 0) {
-			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "unable to resolve host name %s, errno=%d", host, errno);
-			return -1;
-		} /* end if */
-
-		/* create the socket (it is checked right after the switch) */
-		session      = socket (AF_INET, SOCK_STREAM, 0);
-		break;
 	case NOPOLL_TRANSPORT_IPV6:
-		/* configure hints */
-		hints.ai_family   = AF_INET6;
-		hints.ai_socktype = SOCK_STREAM;
-		
-		/* resolve hosting name */
-		if (getaddrinfo (host, port, &hints, &res) != 0) {
-			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "unable to resolve host name %s, errno=%d", host, errno);
-			return -1;
-		} /* end if */
-
-		/* create the socket (it is checked right after the switch) */
-		session      = socket (AF_INET6, SOCK_STREAM, 0);
 		break;
 	default:
 		/* unsupported transport requested: nothing was resolved
@@ -279,52 +632,274 @@ NOPOLL_SOCKET __nopoll_conn_sock_connect_opts_internal (noPollCtx       * ctx,
 		return -1;
 	} /* end switch */
 
-	if (session == NOPOLL_INVALID_SOCKET) {
-		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "unable to create socket");
+	/* dual stack connect requested: the transport is ignored */
+	if (options && options->happy_eyeballs)
+		return __nopoll_conn_sock_connect_happy_eyeballs (ctx, host, port, options);
 
-		/* release address info */
-		freeaddrinfo (res);
+	/* resolve hosting name (through the resolver and the cache
+	 * configured at the context, see nopoll_ctx_set_resolver) */
+	res = __nopoll_ctx_resolve (ctx, transport, host, port);
+	if (res == NULL) {
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "unable to resolve host name %s, errno=%d", host, errno);
 		return -1;
 	} /* end if */
 
-	/* disable nagle */
-	nopoll_conn_set_sock_tcp_nodelay (session, nopoll_true);
+	/* create the socket and start connecting to the first address */
+	session = __nopoll_conn_sock_connect_start (ctx, res, host, port, options);
 
-	/* bind to specified interface */
-	if( nopoll_true != nopoll_conn_set_bind_interface (session, options) ) {
-		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "unable to bind to specified interface");
-		nopoll_close_socket (session);
+	/* release address info */
+	__nopoll_ctx_resolve_release (res);
 
-		/* release address info */
-		freeaddrinfo (res);
-		
+	if (session == NOPOLL_INVALID_SOCKET)
 		return -1;
+
+	/* return socket created */
+	return session;
+}
+
+/**
+ * @internal Releases a dial object (see __nopoll_conn_dial_start).
+ */
+void __nopoll_conn_dial_free (noPollConnDial * dial)
+{
+	if (dial->opts)
+		nopoll_conn_opts_unref (dial->opts);
+	nopoll_free (dial->host);
+	nopoll_free (dial->port);
+	nopoll_free (dial);
+	return;
+}
+
+/**
+ * @internal Worker task that resolves the dial endpoint and starts
+ * connecting to it (the happy eyeballs race, when configured, runs
+ * here too). The socket is taken by the owner of the dial (see
+ * __nopoll_conn_dial_check and __nopoll_conn_pool_collect).
+ */
+void __nopoll_conn_dial_run (noPollPtr data, nopoll_bool cancelled)
+{
+	noPollConnDial * dial    = (noPollConnDial *) data;
+	NOPOLL_SOCKET    session = NOPOLL_INVALID_SOCKET;
+	nopoll_bool      orphaned;
+
+	if (! cancelled)
+		session = __nopoll_conn_sock_connect_opts_internal (dial->ctx, dial->transport, dial->host, dial->port, dial->opts);
+	if (! nopoll_socket_is_valid (session))
+		session = NOPOLL_INVALID_SOCKET;
+
+	nopoll_mutex_lock (dial->ctx->ref_mutex);
+	orphaned      = dial->orphaned;
+	dial->session = session;
+	dial->done    = nopoll_true;
+	nopoll_mutex_unlock (dial->ctx->ref_mutex);
+
+	/* the owner was released meanwhile */
+	if (orphaned) {
+		if (session != NOPOLL_INVALID_SOCKET)
+			nopoll_close_socket (session);
+		__nopoll_conn_dial_free (dial);
 	} /* end if */
+	return;
+}
 
-	/* set non blocking status */
-	nopoll_conn_set_sock_block (session, nopoll_false);
-	
-	/* do a tcp connect */
-        if (connect (session, res->ai_addr, res->ai_addrlen) < 0) {
-		if(errno != NOPOLL_EINPROGRESS && errno != NOPOLL_EWOULDBLOCK && errno != NOPOLL_ENOTCONN) { 
-			nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "unable to connect to remote host %s:%s errno=%d",
-				    host, port, errno);
+/**
+ * @internal Starts resolving and connecting to the host and port
+ * provided on a worker (see __nopoll_worker_run_task) so the caller
+ * never waits for the resolver. On platforms without workers the dial
+ * is run by the caller when run_inline is set.
+ *
+ * @return The dial started (see __nopoll_conn_dial_release) or NULL
+ * if it fails or it was not started.
+ */
+noPollConnDial * __nopoll_conn_dial_start (noPollCtx       * ctx,
+					   noPollTransport   transport,
+					   const char      * host,
+					   const char      * port,
+					   noPollConnOpts  * options,
+					   nopoll_bool       run_inline)
+{
+	noPollConnDial * dial;
 
-		        shutdown (session, SHUT_RDWR);
-                        nopoll_close_socket (session);
+	dial = nopoll_new (noPollConnDial, 1);
+	if (dial == NULL)
+		return NULL;
+	dial->ctx       = ctx;
+	dial->transport = transport;
+	dial->host      = nopoll_strdup (host);
+	dial->port      = nopoll_strdup (port);
+	dial->session   = NOPOLL_INVALID_SOCKET;
+	if (options && nopoll_conn_opts_ref (options))
+		dial->opts = options;
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&dial->start, NULL);
+#else
+	gettimeofday (&dial->start, NULL);
+#endif
 
-			/* release address info */
-			freeaddrinfo (res);
-			
-			return -1;
-		} /* end if */
+	if (__nopoll_worker_run_task (ctx, __nopoll_conn_dial_run, dial))
+		return dial;
+
+	/* no workers */
+	if (! run_inline) {
+		__nopoll_conn_dial_free (dial);
+		return NULL;
 	} /* end if */
+	__nopoll_conn_dial_run (dial, nopoll_false);
+	return dial;
+}
 
-	/* release address info */
-	freeaddrinfo (res);
+/**
+ * @internal Releases a dial (closing its socket), leaving it to its
+ * worker if it is still running.
+ */
+void __nopoll_conn_dial_release (noPollConnDial * dial)
+{
+	nopoll_bool orphaned;
 
-	/* return socket created */
-	return session;
+	nopoll_mutex_lock (dial->ctx->ref_mutex);
+	orphaned       = ! dial->done;
+	dial->orphaned = orphaned;
+	nopoll_mutex_unlock (dial->ctx->ref_mutex);
+	if (orphaned)
+		return;
+
+	if (dial->session != NOPOLL_INVALID_SOCKET)
+		nopoll_close_socket (dial->session);
+	__nopoll_conn_dial_free (dial);
+	return;
+}
+
+/**
+ * @internal Stops dialing the provided connection (if it is).
+ */
+void __nopoll_conn_dial_stop (noPollConn * conn)
+{
+	noPollConnDial * dial;
+
+	if (! conn->dialing)
+		return;
+
+	nopoll_mutex_lock (conn->ctx->ref_mutex);
+	dial       = conn->dial;
+	conn->dial = NULL;
+	nopoll_mutex_unlock (conn->ctx->ref_mutex);
+
+	conn->dialing = nopoll_false;
+	if (dial)
+		__nopoll_conn_dial_release (dial);
+	return;
+}
+
+/**
+ * @internal Continues a client connection once its socket is
+ * connecting: starts its TLS handshake or sends its client init
+ * (queued by __nopoll_conn_new_common).
+ */
+void __nopoll_conn_connected (noPollConn * conn)
+{
+	if (conn->ssl) {
+		/* set socket */
+		SSL_set_fd (conn->ssl, conn->session);
+
+		/* start the TLS handshake: it is completed without
+		 * blocking (see __nopoll_conn_tls_handshake) by
+		 * nopoll_loop_wait, nopoll_conn_is_ready or
+		 * nopoll_conn_get_msg, sending the client init once
+		 * it finishes */
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "connecting to remote TLS site %s:%s", conn->host, conn->port);
+		__nopoll_conn_tls_handshake_start (conn, nopoll_true);
+		__nopoll_conn_tls_handshake (conn);
+		return;
+	} /* end if */
+
+	/* send client init */
+	__nopoll_conn_client_init_flush (conn);
+	return;
+}
+
+/**
+ * @internal Takes the socket dialed by a worker for the provided
+ * client connection (see __nopoll_conn_new_common), continuing its
+ * handshake. Connections whose name could not be resolved, or that
+ * were not connected before the connect timeout (see \ref
+ * nopoll_conn_connect_timeout), are left without socket (that is,
+ * \ref nopoll_conn_is_ok reports nopoll_false).
+ *
+ * Called by nopoll_loop_wait, nopoll_conn_is_ready and
+ * nopoll_conn_get_msg.
+ *
+ * @return nopoll_true if the connection is no longer dialing.
+ */
+nopoll_bool __nopoll_conn_dial_check (noPollConn * conn)
+{
+	noPollCtx      * ctx;
+	noPollConnDial * dial;
+	NOPOLL_SOCKET    session;
+	nopoll_bool      done    = nopoll_false;
+	nopoll_bool      expired = nopoll_false;
+
+	if (conn == NULL || ! conn->dialing)
+		return nopoll_true;
+	ctx = conn->ctx;
+
+	nopoll_mutex_lock (conn->handshake_mutex);
+	if (! conn->dialing) {
+		/* finished by another thread meanwhile */
+		nopoll_mutex_unlock (conn->handshake_mutex);
+		return nopoll_true;
+	} /* end if */
+
+	/* take the dial once it is finished or expired */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	dial = conn->dial;
+	if (dial) {
+		done    = dial->done;
+		expired = ! done && __nopoll_conn_elapsed_since (&dial->start) >= ctx->conn_connect_std_timeout;
+		if (done || expired)
+			conn->dial = NULL;
+	} /* end if */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	if (dial && ! done && ! expired) {
+		nopoll_mutex_unlock (conn->handshake_mutex);
+		return nopoll_false;
+	} /* end if */
+
+	session = NOPOLL_INVALID_SOCKET;
+	if (expired) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Timeout while connecting conn-id=%d to remote host %s:%s", conn->id, conn->host, conn->port);
+		__nopoll_conn_dial_release (dial);
+	} else if (dial) {
+		session = dial->session;
+		__nopoll_conn_dial_free (dial);
+		if (session == NOPOLL_INVALID_SOCKET)
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to connect conn-id=%d to remote host %s:%s", conn->id, conn->host, conn->port);
+	} /* end if */
+
+	/* publish the socket before clearing the flag so the
+	 * connection is never reported as failed meanwhile */
+	conn->session = session;
+	conn->dialing = nopoll_false;
+	if (session != NOPOLL_INVALID_SOCKET) {
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Connecting conn-id=%d to %s:%s (socket: %d)", conn->id, conn->host, conn->port, session);
+		__nopoll_conn_connected (conn);
+	} /* end if */
+
+	nopoll_mutex_unlock (conn->handshake_mutex);
+	return nopoll_true;
+}
+
+/**
+ * @internal Waits until the provided connection is no longer dialing
+ * (see __nopoll_conn_dial_check). Only used by operations requiring
+ * the socket right away, like sending content before the connection
+ * is ready (the wait is limited by the connect timeout).
+ */
+void __nopoll_conn_dial_wait (noPollConn * conn)
+{
+	while (! __nopoll_conn_dial_check (conn))
+		nopoll_sleep (500);
+	return;
 }
 
 /** 
@@ -378,9 +953,11 @@ NOPOLL_SOCKET nopoll_conn_sock_connect (noPollCtx       * ctx,
 char * __nopoll_conn_get_client_init (noPollConn * conn, noPollConnOpts * opts)
 {
 	/* build sec-websocket-key */
-	char key[50];
-	int  key_size = 50;
-	char nonce[17];
+	char   key[50];
+	int    key_size = 50;
+	char   nonce[17];
+	char * extensions;
+	char * result;
 
 	/* get the nonce */
 	if (! nopoll_nonce (nonce, 16)) {
@@ -400,35 +977,43 @@ char * __nopoll_conn_get_client_init (noPollConn * conn, noPollConnOpts * opts)
 	conn->handshake = nopoll_new (noPollHandShake, 1);
 	conn->handshake->expected_accept = nopoll_strdup (key);
 
+	/* extensions offered (permessage-deflate) */
+	extensions = __nopoll_deflate_client_offer (conn);
+
 	/* send initial handshake */
-	return nopoll_strdup_printf ("GET %s HTTP/1.1"
-				     "\r\nHost: %s"
-				     "\r\nUpgrade: websocket"
-				     "\r\nConnection: Upgrade"
-				     "\r\nSec-WebSocket-Key: %s"
-				     "\r\nSec-WebSocket-Version: %d"
-				     "%s%s"
-				     "%s%s"  /* Cookie */
-				     "%s%s"  /* protocol part */
-				     "%s"    /* extra arbitrary headers */
-				     "\r\n\r\n",
-				     conn->get_url,
-				     conn->host_name,
-				     /* sec-websocket-key */
-				     key,
-				     /* sec-websocket-version */
-				     conn->ctx->protocol_version,
-				     /* Origin (support not sending Origin: header in case it is not defined) */
-				     (conn->origin != NULL && (opts == NULL || opts->add_origin_header)) ? "\r\nOrigin: " : "",
-				     (conn->origin != NULL && (opts == NULL || opts->add_origin_header)) ? conn->origin : "",
-				     /* Cookie */
-				     (opts && opts->cookie) ? "\r\nCookie: " : "",
-				     (opts && opts->cookie) ? opts->cookie : "",
-				     /* protocol part */
-				     conn->protocols ? "\r\nSec-WebSocket-Protocol: " : "",
-				     conn->protocols ? conn->protocols : "",
-				     /* extra arbitrary headers */
-				     (opts && opts->extra_headers) ? opts->extra_headers : "");
+	result = nopoll_strdup_printf ("GET %s HTTP/1.1"
+				       "\r\nHost: %s"
+				       "\r\nUpgrade: websocket"
+				       "\r\nConnection: Upgrade"
+				       "\r\nSec-WebSocket-Key: %s"
+				       "\r\nSec-WebSocket-Version: %d"
+				       "%s%s"
+				       "%s%s"  /* Cookie */
+				       "%s%s"  /* protocol part */
+				       "%s"    /* extensions */
+				       "%s"    /* extra arbitrary headers */
+				       "\r\n\r\n",
+				       conn->get_url,
+				       conn->host_name,
+				       /* sec-websocket-key */
+				       key,
+				       /* sec-websocket-version */
+				       conn->ctx->protocol_version,
+				       /* Origin (support not sending Origin: header in case it is not defined) */
+				       (conn->origin != NULL && (opts == NULL || opts->add_origin_header)) ? "\r\nOrigin: " : "",
+				       (conn->origin != NULL && (opts == NULL || opts->add_origin_header)) ? conn->origin : "",
+				       /* Cookie */
+				       (opts && opts->cookie) ? "\r\nCookie: " : "",
+				       (opts && opts->cookie) ? opts->cookie : "",
+				       /* protocol part */
+				       conn->protocols ? "\r\nSec-WebSocket-Protocol: " : "",
+				       conn->protocols ? conn->protocols : "",
+				       /* extensions */
+				       extensions ? extensions : "",
+				       /* extra arbitrary headers */
+				       (opts && opts->extra_headers) ? opts->extra_headers : "");
+	nopoll_free (extensions);
+	return result;
 }
 
 
@@ -540,59 +1125,597 @@ int __nopoll_conn_tls_handle_error (noPollConn * conn, int res, const char * lab
 }
 
 /**
- * @internal Receive handler installed on connections running under
- * TLS: it is configured once the TLS session is established and it is
- * used for the rest of the connection life time.
+ * @internal Receive handler installed on connections running under
+ * TLS: it is configured once the TLS session is established and it is
+ * used for the rest of the connection life time.
+ */
+int nopoll_conn_tls_receive (noPollConn * conn, char * buffer, int buffer_size)
+{
+	int res;
+	nopoll_bool needs_retry;
+
+	/* call to read content */
+	res = SSL_read (conn->ssl, buffer, buffer_size);
+	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "SSL: received %d bytes..", res); */
+
+	/* call to handle error */
+	res = __nopoll_conn_tls_handle_error (conn, res, "SSL_read", &needs_retry);
+	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "  SSL: after procesing error %d bytes..", res); */
+	if (res == -2) {
+#if defined(NOPOLL_OS_UNIX)
+		errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+		WSASetLastError(NOPOLL_EWOULDBLOCK);
+#endif
+	}
+
+	return res;
+}
+
+/**
+ * @internal Send handler installed on connections running under TLS:
+ * it is configured once the TLS session is established and it is used
+ * for the rest of the connection life time.
+ */
+int nopoll_conn_tls_send (noPollConn * conn, char * buffer, int buffer_size)
+{
+	/* batched writes (see nopoll_conn_set_tls_batching) */
+	if (conn->tls_batching || conn->tls_batch_size > 0)
+		return __nopoll_conn_tls_batch_send (conn, buffer, buffer_size);
+
+	return __nopoll_conn_tls_write (conn, buffer, buffer_size);
+}
+
+/**
+ * @internal Writes the provided content with SSL_write (see
+ * nopoll_conn_tls_send).
+ */
+int __nopoll_conn_tls_write (noPollConn * conn, char * buffer, int buffer_size)
+{
+	int         res;
+	nopoll_bool needs_retry;
+
+	/* call to read content */
+	res = SSL_write (conn->ssl, buffer, buffer_size);
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "SSL: sent %d bytes (requested: %d)..", res, buffer_size); 
+
+	/* call to handle error */
+	res = __nopoll_conn_tls_handle_error (conn, res, "SSL_write", &needs_retry);
+	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "   SSL: after processing error, sent %d bytes (requested: %d)..",  res, buffer_size); */
+	if (res == -2) {
+#if defined(NOPOLL_OS_UNIX)
+		errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+		WSASetLastError(NOPOLL_EWOULDBLOCK);
+#endif
+	}
+
+	return res;
+}
+
+/**
+ * @internal Writes the content queued on the batch of the provided
+ * TLS connection.
+ *
+ * @return 1 when everything was written, 0 when the connection can't
+ * accept more content right now (the rest is kept) or -1 if it fails.
+ */
+int __nopoll_conn_tls_batch_flush (noPollConn * conn)
+{
+	int res;
+
+	while (conn->tls_batch_size > 0) {
+		res = __nopoll_conn_tls_write (conn, conn->tls_batch, conn->tls_batch_size);
+		if (res == -2)
+			return 0;
+		if (res <= 0)
+			return -1;
+
+		/* partial write (SSL_MODE_ENABLE_PARTIAL_WRITE) */
+		conn->tls_batch_size -= res;
+		if (conn->tls_batch_size > 0)
+			memmove (conn->tls_batch, conn->tls_batch + res, conn->tls_batch_size);
+	} /* end while */
+
+	return 1;
+}
+
+/**
+ * @internal Send handler used by TLS connections with batching
+ * enabled: content is queued until the batch is full (one TLS record)
+ * or it is flushed (nopoll_conn_flush_tls_batch, the loop before
+ * waiting, or when batching is disabled).
+ */
+int __nopoll_conn_tls_batch_send (noPollConn * conn, char * buffer, int buffer_size)
+{
+	int res;
+
+	/* flush queued content when the new one does not fit (or
+	 * batching was disabled) */
+	if (conn->tls_batch_size > 0 && (! conn->tls_batching || conn->tls_batch_size + buffer_size > NOPOLL_TLS_BATCH_SIZE)) {
+		res = __nopoll_conn_tls_batch_flush (conn);
+		if (res < 0)
+			return -1;
+		if (res == 0) {
+			/* keep ordering: nothing of the new content is
+			 * accepted until the batch is written */
+#if defined(NOPOLL_OS_UNIX)
+			errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+			WSASetLastError(NOPOLL_EWOULDBLOCK);
+#endif
+			return -2;
+		} /* end if */
+	} /* end if */
+
+	/* content that doesn't fit into a batch is written directly */
+	if (! conn->tls_batching || buffer_size > NOPOLL_TLS_BATCH_SIZE)
+		return __nopoll_conn_tls_write (conn, buffer, buffer_size);
+
+	if (conn->tls_batch == NULL) {
+		conn->tls_batch = nopoll_new (char, NOPOLL_TLS_BATCH_SIZE);
+		if (conn->tls_batch == NULL)
+			return __nopoll_conn_tls_write (conn, buffer, buffer_size);
+	} /* end if */
+
+	memcpy (conn->tls_batch + conn->tls_batch_size, buffer, buffer_size);
+	conn->tls_batch_size += buffer_size;
+	return buffer_size;
+}
+
+/**
+ * @brief Allows to enable write batching on the provided TLS
+ * connection: frames sent are queued and written together, packing
+ * several small messages into a single TLS record (a single
+ * SSL_write), instead of producing one record (with its header, MAC
+ * and system call) per frame.
+ *
+ * Content queued is written when it reaches \ref
+ * NOPOLL_TLS_BATCH_SIZE bytes (the maximum TLS record size), when
+ * \ref nopoll_conn_flush_tls_batch is called, when \ref
+ * nopoll_loop_wait iterates (before waiting for network activity),
+ * when batching is disabled or when the connection is closed. So,
+ * applications sending from loop handlers get batching without
+ * further changes.
+ *
+ * The connection must be used from the thread driving it (messages
+ * queued are written by that thread). Batching has no effect on
+ * connections without TLS (or with transmission offloaded to the
+ * kernel, see \ref nopoll_conn_opts_set_ktls).
+ *
+ * @param conn The connection to configure.
+ *
+ * @param enable nopoll_true to enable batching, nopoll_false to
+ * disable it (writing content queued).
+ */
+void          nopoll_conn_set_tls_batching (noPollConn * conn, nopoll_bool enable)
+{
+	if (conn == NULL)
+		return;
+
+	conn->tls_batching = enable;
+	if (! enable) {
+		nopoll_conn_flush_tls_batch (conn);
+		if (conn->tls_batch_size == 0) {
+			nopoll_free (conn->tls_batch);
+			conn->tls_batch = NULL;
+		} /* end if */
+	} /* end if */
+
+	return;
+}
+
+/**
+ * @brief Writes content queued on the provided connection by TLS
+ * write batching (see \ref nopoll_conn_set_tls_batching).
+ *
+ * @param conn The connection to flush.
+ *
+ * @return 1 when everything was written (or nothing was queued), 0
+ * when the connection can't accept more content right now (call
+ * again later) or -1 if it fails.
+ */
+int           nopoll_conn_flush_tls_batch (noPollConn * conn)
+{
+	if (conn == NULL || conn->ssl == NULL)
+		return 1;
+
+	return __nopoll_conn_tls_batch_flush (conn);
+}
+
+/**
+ * @internal Receive handler installed on TLS connections whose
+ * reception was offloaded to the kernel (kTLS): data records are
+ * read with recv, the rest (alerts, session tickets, key updates,
+ * reported by the kernel with EIO) are handled by OpenSSL.
+ */
+int __nopoll_conn_ktls_receive (noPollConn * conn, char * buffer, int buffer_size)
+{
+	int res;
+
+	/* content already decrypted by OpenSSL */
+	if (SSL_pending (conn->ssl) > 0)
+		return nopoll_conn_tls_receive (conn, buffer, buffer_size);
+
+	res = recv (conn->session, buffer, buffer_size, 0);
+	if (res < 0 && errno == EIO)
+		return nopoll_conn_tls_receive (conn, buffer, buffer_size);
+	return res;
+}
+
+/**
+ * @internal Configures the SSL object of the provided connection
+ * before the handshake: writes can be partial (and retried from a
+ * different buffer), read/write buffers are released while the
+ * connection is idle, and kernel TLS is enabled when requested.
+ */
+void __nopoll_conn_ssl_prepare (noPollConn * conn)
+{
+	if (conn->ssl == NULL)
+		return;
+
+	SSL_set_mode (conn->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER | SSL_MODE_RELEASE_BUFFERS);
+	if (! conn->ktls_requested)
+		return;
+
+#if defined(SSL_OP_ENABLE_KTLS) && ! defined(OPENSSL_NO_KTLS)
+	SSL_set_options (conn->ssl, SSL_OP_ENABLE_KTLS);
+#else
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "kTLS requested on conn-id=%d but OpenSSL was built without kTLS support", conn->id);
+#endif
+	return;
+}
+
+/**
+ * @internal Once the TLS handshake is finished, switches the I/O
+ * handlers of the provided connection to plain send/recv for each
+ * direction offloaded to the kernel.
+ */
+void __nopoll_conn_ktls_activate (noPollConn * conn)
+{
+	conn->ktls = NOPOLL_KTLS_NONE;
+	if (conn->ssl == NULL || ! conn->ktls_requested)
+		return;
+
+#if defined(SSL_OP_ENABLE_KTLS) && ! defined(OPENSSL_NO_KTLS)
+	if (BIO_get_ktls_send (SSL_get_wbio (conn->ssl))) {
+		conn->ktls |= NOPOLL_KTLS_TX;
+		conn->send  = nopoll_conn_default_send;
+	} /* end if */
+	if (BIO_get_ktls_recv (SSL_get_rbio (conn->ssl))) {
+		conn->ktls   |= NOPOLL_KTLS_RX;
+		conn->receive = __nopoll_conn_ktls_receive;
+	} /* end if */
+#endif
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "kTLS state for conn-id=%d: tx=%d rx=%d",
+		    conn->id, (conn->ktls & NOPOLL_KTLS_TX) != 0, (conn->ktls & NOPOLL_KTLS_RX) != 0);
+	return;
+}
+
+/**
+ * @internal I/O handler installed while the TLS handshake is in
+ * progress: nothing can be read or written until it finishes, so
+ * callers see a temporary failure (content sent is queued as
+ * pending).
+ */
+int __nopoll_conn_tls_handshake_io (noPollConn * conn, char * buffer, int buffer_size)
+{
+#if defined(NOPOLL_OS_UNIX)
+	errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+	WSASetLastError (NOPOLL_EWOULDBLOCK);
+#endif
+	return -1;
+}
+
+/**
+ * @internal Flags the provided connection (with conn->ssl already
+ * configured) to run its TLS handshake, which is completed without
+ * blocking by __nopoll_conn_tls_handshake.
+ */
+void __nopoll_conn_tls_handshake_start (noPollConn * conn, nopoll_bool is_client)
+{
+	if (is_client)
+		conn->pending_ssl_connect = nopoll_true;
+	else
+		conn->pending_ssl_accept  = nopoll_true;
+	conn->ssl_want_write = nopoll_false;
+	conn->receive        = __nopoll_conn_tls_handshake_io;
+	conn->send           = __nopoll_conn_tls_handshake_io;
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&conn->tls_handshake_start, NULL);
+#else
+	gettimeofday (&conn->tls_handshake_start, NULL);
+#endif
+
+	/* enforce the handshake timeout even if the peer never
+	 * sends anything (the timer holds a reference) */
+	if (conn->tls_handshake_timer > 0 || ! nopoll_conn_ref (conn))
+		return;
+	conn->tls_handshake_timer = nopoll_timer_add (conn->ctx, conn->ctx->tls_handshake_timeout,
+						      __nopoll_conn_tls_handshake_timeout, conn);
+	if (conn->tls_handshake_timer <= 0) {
+		conn->tls_handshake_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+	return;
+}
+
+/**
+ * @internal Timer handler installed by
+ * __nopoll_conn_tls_handshake_start that closes the connection
+ * received (which holds a reference for the timer) if its TLS
+ * handshake didn't finish on time.
+ */
+void __nopoll_conn_tls_handshake_timeout (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+{
+	noPollConn * conn = (noPollConn *) user_data;
+	long         next;
+
+	conn->tls_handshake_timer = 0;
+
+	/* a handshake step running on a worker is checked again
+	 * once it is returned to the loop */
+	if (nopoll_conn_is_ok (conn) && __nopoll_worker_is_busy (ctx, conn))
+		next = NOPOLL_TLS_HANDSHAKE_RECHECK;
+	else if (nopoll_conn_is_ok (conn) && (conn->pending_ssl_accept || conn->pending_ssl_connect) &&
+		 ! __nopoll_conn_tls_handshake_expired (conn))
+		next = ctx->tls_handshake_timeout - __nopoll_conn_elapsed_since (&conn->tls_handshake_start);
+	else {
+		/* finished, failed or expired (closed) */
+		nopoll_conn_unref (conn);
+		return;
+	} /* end if */
+
+	/* schedule next check (keeping the reference) */
+	conn->tls_handshake_timer = nopoll_timer_add (ctx, next, __nopoll_conn_tls_handshake_timeout, conn);
+	if (conn->tls_handshake_timer <= 0) {
+		conn->tls_handshake_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+	return;
+}
+
+/**
+ * @internal Cancels the handshake timer of the provided connection
+ * (see __nopoll_conn_tls_handshake_start), releasing the reference
+ * it holds.
+ */
+void __nopoll_conn_tls_handshake_timer_stop (noPollConn * conn)
+{
+	if (conn->tls_handshake_timer <= 0)
+		return;
+	if (nopoll_timer_cancel (conn->ctx, conn->tls_handshake_timer)) {
+		conn->tls_handshake_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+	return;
+}
+
+/**
+ * @internal Closes the provided connection because its TLS handshake
+ * failed. When the handshake step runs on a worker thread (see
+ * nopoll_ctx_set_tls_handshake_workers) the connection is only
+ * flagged: the loop closes it once the worker returns it, so the
+ * socket is closed and on close handlers are called by the thread
+ * running nopoll_loop_wait.
+ */
+void __nopoll_conn_tls_handshake_failed (noPollConn * conn)
+{
+	conn->stats.tls_handshakes_failed++;
+	__nopoll_ctx_thread_stats (conn->ctx)->tls_handshakes_failed++;
+	NOPOLL_PROBE3 (tls_handshake_complete, conn->id, conn->role, 0);
+
+	if (conn->tls_offloaded) {
+		conn->tls_failed = nopoll_true;
+		return;
+	} /* end if */
+	nopoll_conn_shutdown (conn);
+	return;
+}
+
+/**
+ * @internal Closes the provided connection if its TLS handshake is
+ * still in progress after the timeout configured (see
+ * nopoll_ctx_set_tls_handshake_timeout).
+ *
+ * @return nopoll_true if the handshake deadline expired.
+ */
+nopoll_bool __nopoll_conn_tls_handshake_expired (noPollConn * conn)
+{
+	if (! conn->pending_ssl_accept && ! conn->pending_ssl_connect)
+		return nopoll_false;
+	if (__nopoll_conn_elapsed_since (&conn->tls_handshake_start) < conn->ctx->tls_handshake_timeout)
+		return nopoll_false;
+
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "TLS handshake timeout (%ld us) reached, closing conn-id=%d (session: %d)",
+		    conn->ctx->tls_handshake_timeout, conn->id, conn->session);
+	__nopoll_conn_tls_handshake_failed (conn);
+	return nopoll_true;
+}
+
+/**
+ * @internal Writes as much of the websocket client init held at
+ * pending_write (see __nopoll_conn_send_client_init) as the socket
+ * takes without blocking. It is called once the socket is writable
+ * by nopoll_loop_wait, nopoll_conn_is_ready and nopoll_conn_get_msg.
+ *
+ * @return nopoll_true when the client init is completely sent.
+ */
+nopoll_bool __nopoll_conn_client_init_flush (noPollConn * conn)
+{
+	int bytes_written;
+
+	if (! conn->client_init_pending)
+		return nopoll_true;
+	if (conn->dialing)
+		return nopoll_false;
+	if (conn->pending_write == NULL) {
+		/* flushed through nopoll_conn_complete_pending_write */
+		conn->client_init_pending = nopoll_false;
+		return nopoll_true;
+	} /* end if */
+
+	bytes_written = conn->send (conn, conn->pending_write + conn->pending_write_desp, conn->pending_write_bytes);
+	if (bytes_written > 0) {
+		conn->pending_write_bytes -= bytes_written;
+		conn->pending_write_desp  += bytes_written;
+		__nopoll_conn_pending_sync (conn);
+	} /* end if */
+
+	if (conn->pending_write_bytes > 0) {
+		/* for some reason, under FreeBSD, a ENOTCONN is reported when they should be returning EINPROGRESS and/or EWOULDBLOCK */
+		if (bytes_written > 0 || errno == NOPOLL_EWOULDBLOCK || errno == NOPOLL_EINPROGRESS || errno == NOPOLL_ENOTCONN)
+			return nopoll_false;
+
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Failed to send websocket init message, error code was: %d (2), closing session", errno);
+		nopoll_conn_shutdown (conn);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_free (conn->pending_write);
+	conn->pending_write       = NULL;
+	conn->client_init_pending = nopoll_false;
+	__nopoll_conn_pending_sync (conn);
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Web socket initial client handshake sent");
+	return nopoll_true;
+}
+
+/**
+ * @internal Sends the websocket client init to the server (taking
+ * ownership of the content provided). What the socket can't take yet
+ * (the connect is still in progress) is kept as pending write and
+ * flushed once the socket is writable (see
+ * __nopoll_conn_client_init_flush).
  */
-int nopoll_conn_tls_receive (noPollConn * conn, char * buffer, int buffer_size)
+void __nopoll_conn_send_client_init (noPollConn * conn, char * content)
 {
-	int res;
-	nopoll_bool needs_retry;
-
-	/* call to read content */
-	res = SSL_read (conn->ssl, buffer, buffer_size);
-	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "SSL: received %d bytes..", res); */
-
-	/* call to handle error */
-	res = __nopoll_conn_tls_handle_error (conn, res, "SSL_read", &needs_retry);
-	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "  SSL: after procesing error %d bytes..", res); */
-	if (res == -2) {
-#if defined(NOPOLL_OS_UNIX)
-		errno = NOPOLL_EWOULDBLOCK;
-#elif defined(NOPOLL_OS_WIN32)
-		WSASetLastError(NOPOLL_EWOULDBLOCK);
-#endif
-	}
-
-	return res;
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Sending websocket client init: %s", content);
+
+	conn->pending_write       = content;
+	conn->pending_write_bytes = strlen (content);
+	conn->pending_write_desp  = 0;
+	conn->client_init_pending = nopoll_true;
+	__nopoll_conn_pending_sync (conn);
+	__nopoll_conn_client_init_flush (conn);
+	return;
 }
 
 /**
- * @internal Send handler installed on connections running under TLS:
- * it is configured once the TLS session is established and it is used
- * for the rest of the connection life time.
+ * @internal Runs the TLS handshake of the provided connection (client
+ * or listener side) as far as possible without blocking. It is called
+ * each time the socket is ready (nopoll_loop_wait watches the socket
+ * for writing while conn->ssl_want_write is set) and from
+ * nopoll_conn_is_ready, so a slow peer never holds the caller.
+ *
+ * Once finished, TLS I/O handlers are installed and, on the client
+ * side, the websocket client init is sent.
+ *
+ * @return 1 when the handshake is finished, 0 when it is still in
+ * progress and -1 when it failed (the connection is closed).
  */
-int nopoll_conn_tls_send (noPollConn * conn, char * buffer, int buffer_size)
+int __nopoll_conn_tls_handshake (noPollConn * conn)
 {
-	int         res;
-	nopoll_bool needs_retry;
+	noPollCtx * ctx = conn->ctx;
+	int         result;
+	int         ssl_error;
+	X509      * server_cert;
+	char      * content;
 
-	/* call to read content */
-	res = SSL_write (conn->ssl, buffer, buffer_size);
-	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "SSL: sent %d bytes (requested: %d)..", res, buffer_size); 
+	if (! conn->pending_ssl_accept && ! conn->pending_ssl_connect)
+		return nopoll_conn_is_ok (conn) ? 1 : -1;
+	if (! nopoll_conn_is_ok (conn) || conn->tls_failed || __nopoll_conn_tls_handshake_expired (conn))
+		return -1;
 
-	/* call to handle error */
-	res = __nopoll_conn_tls_handle_error (conn, res, "SSL_write", &needs_retry);
-	/* nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "   SSL: after processing error, sent %d bytes (requested: %d)..",  res, buffer_size); */
-	if (res == -2) {
-#if defined(NOPOLL_OS_UNIX)
-		errno = NOPOLL_EWOULDBLOCK;
-#elif defined(NOPOLL_OS_WIN32)
-		WSASetLastError(NOPOLL_EWOULDBLOCK);
-#endif
-	}
+	/* next handshake step */
+	if (conn->pending_ssl_accept)
+		result = SSL_accept (conn->ssl);
+	else
+		result = SSL_connect (conn->ssl);
+	if (result <= 0) {
+		ssl_error = SSL_get_error (conn->ssl, result);
+		switch (ssl_error) {
+		case SSL_ERROR_WANT_READ:
+			conn->ssl_want_write = nopoll_false;
+			return 0;
+		case SSL_ERROR_WANT_WRITE:
+			conn->ssl_want_write = nopoll_true;
+			return 0;
+		case SSL_ERROR_SYSCALL:
+			/* Check ENOTCONN on SSL_connect error (only happening on windows). See:
+			 * https://github.com/ASPLes/nopoll/pull/19
+			 * The socket is still connecting: wait until it
+			 * is writable */
+			if (errno == NOPOLL_ENOTCONN || errno == NOPOLL_EWOULDBLOCK || errno == NOPOLL_EINPROGRESS) {
+				conn->ssl_want_write = nopoll_true;
+				return 0;
+			} /* end if */
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "syscall error while doing TLS handshake, ssl error (code:%d), conn-id: %d (%p), errno: %d, session: %d",
+				    ssl_error, conn->id, conn, errno, conn->session);
+			break;
+		default:
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "there was an error with the TLS negotiation, ssl error (code:%d) : %s",
+				    ssl_error, ERR_error_string (ssl_error, NULL));
+			break;
+		} /* end switch */
 
-	return res;
+		/* show log stack */
+		nopoll_conn_log_ssl (conn);
+		__nopoll_conn_tls_handshake_failed (conn);
+		return -1;
+	} /* end if */
+
+	conn->ssl_want_write = nopoll_false;
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "TLS handshake finished (conn-id=%d, %s:%s), configuring I/O handlers",
+		    conn->id, conn->host, conn->port);
+
+	/* check remote certificate (if it is present) */
+	if (conn->pending_ssl_connect) {
+		server_cert = SSL_get_peer_certificate (conn->ssl);
+		if (server_cert == NULL) {
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "server side didn't set a certificate for this session, these are bad news");
+			__nopoll_conn_tls_handshake_failed (conn);
+			return -1;
+		} /* end if */
+		X509_free (server_cert);
+	} /* end if */
+
+	/* configure default handlers */
+	conn->pending_ssl_accept  = nopoll_false;
+	conn->pending_ssl_connect = nopoll_false;
+	conn->receive             = nopoll_conn_tls_receive;
+	conn->send                = nopoll_conn_tls_send;
+	__nopoll_conn_ktls_activate (conn);
+
+	/* call to check post ssl checks after SSL finalization */
+	if (ctx->post_ssl_check) {
+		if (! ctx->post_ssl_check (ctx, conn, conn->ssl_ctx, conn->ssl, ctx->post_ssl_check_data)) {
+			/* TLS post check failed */
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "TLS/SSL post check function failed, dropping connection");
+			__nopoll_conn_tls_handshake_failed (conn);
+			return -1;
+		} /* end if */
+	} /* end if */
+
+	/* set this connection has TLS ok */
+	conn->tls_on = nopoll_true;
+	conn->stats.tls_handshakes_ok++;
+	__nopoll_ctx_thread_stats (conn->ctx)->tls_handshakes_ok++;
+	NOPOLL_PROBE3 (tls_handshake_complete, conn->id, conn->role, 1);
+
+	/* release the handshake timer (a step run by a worker leaves
+	 * it to the loop, see __nopoll_conn_tls_handshake_timeout) */
+	if (! conn->tls_offloaded)
+		__nopoll_conn_tls_handshake_timer_stop (conn);
+
+	/* client side: start websocket handshake */
+	if (conn->client_init) {
+		content           = conn->client_init;
+		conn->client_init = NULL;
+		__nopoll_conn_send_client_init (conn, content);
+	} /* end if */
+
+	return nopoll_conn_is_ok (conn) ? 1 : -1;
 }
 
 
@@ -807,13 +1930,9 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 				       const char      * origin)
 {
 	noPollConn     * conn;
+	noPollConnDial * dial = NULL;
 	NOPOLL_SOCKET    session;
 	char           * content;
-	int              size;
-	int              ssl_error;
-	X509           * server_cert;
-	int              iterator;
-	long             remaining_timeout;
 
 	if (! ctx || ! host_ip) {
 		/* release connection options */
@@ -826,10 +1945,18 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 		host_port = "80";
 
 	session = socket;
+
+	/* names are resolved (and dual stack races are run) by a
+	 * worker: the connection is reported while it is dialing (see
+	 * __nopoll_conn_dial_check) */
+	if (! nopoll_socket_is_valid (session) &&
+	    ((options && options->happy_eyeballs) || __nopoll_ctx_resolve_may_block (ctx, transport, host_ip, host_port)))
+		dial = __nopoll_conn_dial_start (ctx, transport, host_ip, host_port, options, nopoll_false);
+
 	/* create socket connection in a non block manner */
-	if (! nopoll_socket_is_valid (session))
+	if (dial == NULL && ! nopoll_socket_is_valid (session))
 		session = __nopoll_conn_sock_connect_opts_internal (ctx, transport, host_ip, host_port, options);
-	if (! nopoll_socket_is_valid (session)) {
+	if (dial == NULL && ! nopoll_socket_is_valid (session)) {
 		/* release connection options */
 		__nopoll_conn_opts_release_if_needed (options);
 		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to connect to remote host %s:%s", host_ip, host_port);
@@ -839,6 +1966,8 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 	/* create the connection */
 	conn = nopoll_new (noPollConn, 1);
 	if (conn == NULL) {
+		if (dial)
+			__nopoll_conn_dial_release (dial);
 		/* release connection options */
 		__nopoll_conn_opts_release_if_needed (options);
 		return NULL;
@@ -853,6 +1982,8 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 	/* register connection into context */
 	if (! nopoll_ctx_register_conn (ctx, conn)) {
 		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to register connection into the context, unable to create connection");
+		if (dial)
+			__nopoll_conn_dial_release (dial);
 		nopoll_free (conn);
 		/* release connection options */
 		__nopoll_conn_opts_release_if_needed (options);
@@ -865,12 +1996,19 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 	
 	/* configure context */
 	conn->ctx     = ctx;
-	conn->session = session;
+	conn->session = dial ? NOPOLL_INVALID_SOCKET : session;
+	conn->dial    = dial;
+	conn->dialing = dial != NULL;
 	conn->role    = NOPOLL_ROLE_CLIENT;
 
 	/* record max frame size accepted for this connection (if
 	 * configured through connection options) */
 	__nopoll_conn_set_max_frame_size (conn, options);
+	__nopoll_conn_set_keepalive (conn, options);
+	__nopoll_conn_set_deflate (conn, options);
+	conn->ktls_requested = options && options->ktls;
+	__nopoll_conn_set_utf8 (conn, options);
+	__nopoll_conn_set_reassemble (conn, options);
 
 	/* record host and port */
 	conn->host    = nopoll_strdup (host_ip);
@@ -953,149 +2091,24 @@ noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
 		
 		/* set server name indication (SNI) */
 		SSL_set_tlsext_host_name(conn->ssl, conn->host_name);
+		__nopoll_conn_ssl_prepare (conn);
 
-		/* set socket */
-		SSL_set_fd (conn->ssl, conn->session);
-
-		/* do the initial connect connect */
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "connecting to remote TLS site %s:%s", conn->host, conn->port);
-		iterator = 0;
-                conn->pending_ssl_connect = nopoll_true;
-		while (SSL_connect (conn->ssl) <= 0) {
-		
-			/* get ssl error */
-			ssl_error = SSL_get_error (conn->ssl, -1);
- 
-			switch (ssl_error) {
-			case SSL_ERROR_WANT_READ:
-			        nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "still not prepared to continue because read wanted, conn-id=%d (%p, session: %d), errno=%d",
-					    conn->id, conn, conn->session, errno);
-				break;
-			case SSL_ERROR_WANT_WRITE:
-			        nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "still not prepared to continue because write wanted, conn-id=%d (%p)",
-					    conn->id, conn);
-				break;
-			case SSL_ERROR_SYSCALL:
-				/* Check ENOTCONN on SSL_connect error (only happening on windows). See:
-				 * https://github.com/ASPLes/nopoll/pull/19
-				 */
-				if (errno == NOPOLL_ENOTCONN) {
-					nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "the socket is not yet connected, retrying, conn-id=%d (%p)",
-					            conn->id, conn);
-					break;
-				}
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "syscall error while doing TLS handshake, ssl error (code:%d), conn-id: %d (%p), errno: %d, session: %d",
-					    ssl_error, conn->id, conn, errno, conn->session);
-				nopoll_conn_log_ssl (conn);
-				nopoll_conn_shutdown (conn);
-				nopoll_free (content);
-
-				/* release connection options */
-				__nopoll_conn_opts_release_if_needed (options);
-
-				return conn;
-			default:
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "there was an error with the TLS negotiation, ssl error (code:%d) : %s",
-					    ssl_error, ERR_error_string (ssl_error, NULL));
-				/* show log stack */
-				nopoll_conn_log_ssl (conn);
-					
-				/* call to release connection */
-				nopoll_conn_shutdown (conn);
-				nopoll_free (content);
-
-				/* release connection options */
-				__nopoll_conn_opts_release_if_needed (options);
-
-				return conn;
-			} /* end switch */
-			
-			/* try and limit max reconnect allowed */
-			iterator++;
-
-			if (iterator > 1000) {
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Max retry calls=%d to SSL_connect reached, shutting down connection id=%d, errno=%d",
-					    iterator, conn->id, errno);
-				nopoll_free (content);
-
-				/* release connection options */
-				__nopoll_conn_opts_release_if_needed (options);
-
-				return conn;
-			} /* end if */
-
-			/* wait a bit before retry */
-			nopoll_sleep (10000);
-
-		} /* end while */
-
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Client TLS handshake finished, configuring I/O handlers");
-
-		/* check remote certificate (if it is present) */
-		server_cert = SSL_get_peer_certificate (conn->ssl);
-		if (server_cert == NULL) {
-			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "server side didn't set a certificate for this session, these are bad news");
-
-			/* release connection options */
-			nopoll_free (content);
-			__nopoll_conn_opts_release_if_needed (options);
-
-			return conn;
-		}
-		X509_free (server_cert);
-
-		/* call to check post ssl checks after SSL finalization */
-		if (conn->ctx && conn->ctx->post_ssl_check) {
-			if (! conn->ctx->post_ssl_check (conn->ctx, conn, conn->ssl_ctx, conn->ssl, conn->ctx->post_ssl_check_data)) {
-				/* TLS post check failed */
-				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "TLS/SSL post check function failed, dropping connection");
-				nopoll_conn_shutdown (conn);
-
-				/* release content and connection options
-				 * (like the rest of failure paths in this
-				 * function do) */
-				nopoll_free (content);
-				__nopoll_conn_opts_release_if_needed (options);
-
-				return conn;
-			} /* end if */
-		} /* end if */
+		/* the client init is sent once the TLS handshake
+		 * finishes, which starts when the socket is
+		 * connecting (see __nopoll_conn_connected) */
+		conn->client_init = content;
+		if (! conn->dialing)
+			__nopoll_conn_connected (conn);
 
-		/* configure default handlers */
-		conn->receive = nopoll_conn_tls_receive;
-		conn->send    = nopoll_conn_tls_send;
+		/* release connection options */
+		__nopoll_conn_opts_release_if_needed (options);
 
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "TLS I/O handlers configured");
-                conn->pending_ssl_connect = nopoll_false;
-		conn->tls_on = nopoll_true;
+		return conn;
 	} /* end if */
 
-	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Sending websocket client init: %s", content);
-	size = strlen (content);
-
-	/* call to send content */
-	remaining_timeout = ctx->conn_connect_std_timeout;
-	while (remaining_timeout > 0) {
-		if (size != conn->send (conn, content, size)) {
-		        /* for some reason, under FreeBSD, a ENOTCONN is reported when they should be returning EINPROGRESS and/or EWOULDBLOCK */
-			if (errno == NOPOLL_EWOULDBLOCK || errno == NOPOLL_EINPROGRESS || errno == NOPOLL_ENOTCONN) {
-				/* nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Connection in progress (errno=%d), session: %d", errno, session); */
-				nopoll_sleep (10000);
-				remaining_timeout -= 10000;
-				continue;
-			} /* end if */
-
-			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to send websocket init message, error code was: %d (2), closing session", errno);
-			nopoll_conn_shutdown (conn);
-		} /* end if */
-
-		break;
-	}
-
-	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Web socket initial client handshake sent");
-
-	/* release content */
-	nopoll_free (content);
+	/* send client init (content is released once sent, and it is
+	 * kept as pending write while dialing) */
+	__nopoll_conn_send_client_init (conn, content);
 
 	/* release connection options */
 	__nopoll_conn_opts_release_if_needed (options);
@@ -1683,8 +2696,9 @@ nopoll_bool    nopoll_conn_is_ok (noPollConn * conn)
 	if (conn == NULL)
 		return nopoll_false;
 
-	/* return current socket status */
-	return conn->session != NOPOLL_INVALID_SOCKET;
+	/* return current socket status (a connection being dialed
+	 * is ok until its dial fails) */
+	return conn->session != NOPOLL_INVALID_SOCKET || conn->dialing;
 }
 
 /** 
@@ -1704,14 +2718,18 @@ nopoll_bool    nopoll_conn_is_ready (noPollConn * conn)
 {
 	if (conn == NULL)
 		return nopoll_false;
+	if (! __nopoll_conn_dial_check (conn))
+		return nopoll_false;
 	if (conn->session == NOPOLL_INVALID_SOCKET)
 		return nopoll_false;
 	if (! conn->handshake_ok) {
 		/* acquire here handshake mutex */
 		nopoll_mutex_lock (conn->handshake_mutex);
 
-		/* complete handshake */
-		nopoll_conn_complete_handshake (conn);
+		/* complete TLS and websocket handshakes (once the
+		 * client init is sent) */
+		if (__nopoll_conn_tls_handshake (conn) == 1 && __nopoll_conn_client_init_flush (conn))
+			nopoll_conn_complete_handshake (conn);
 
 		/* release here handshake mutex */
 		nopoll_mutex_unlock (conn->handshake_mutex);
@@ -1737,10 +2755,34 @@ nopoll_bool    nopoll_conn_is_tls_on (noPollConn * conn)
 	return conn->tls_on;
 }
 
+/**
+ * @brief Allows to check if the TLS session of the provided
+ * connection was offloaded to the kernel (see \ref
+ * nopoll_conn_opts_set_ktls).
+ *
+ * @param conn The connection to check.
+ *
+ * @return A mask of \ref noPollKtlsFlags with the directions
+ * offloaded (\ref NOPOLL_KTLS_NONE when kTLS is not active or conn
+ * is NULL).
+ */
+int            nopoll_conn_get_ktls (noPollConn * conn)
+{
+	if (conn == NULL)
+		return NOPOLL_KTLS_NONE;
+
+	return conn->ktls;
+}
+
 /** 
  * @brief Allows to get the socket associated to this nopoll
  * connection.
  *
+ * Client connections whose host name is resolved by a worker (see
+ * \ref nopoll_ctx_set_resolver) have no socket until it finishes, so
+ * this function waits for it (limited by the connect timeout, see
+ * \ref nopoll_conn_connect_timeout).
+ *
  * @param conn The connection from where the socket will be returned.
  *
  * @return The socket reference or -1 if it fails.
@@ -1749,6 +2791,7 @@ NOPOLL_SOCKET nopoll_conn_socket (noPollConn * conn)
 {
 	if (conn == NULL)
 		return -1;
+	__nopoll_conn_dial_wait (conn);
 	return conn->session;
 }
 
@@ -2061,12 +3104,16 @@ void          nopoll_conn_shutdown (noPollConn * conn)
 		    conn->id, conn->session, role);
 #endif
 
+	/* stop dialing (if it is) */
+	__nopoll_conn_dial_stop (conn);
+
 	/* call to on close handler if defined */
 	if (conn->session != NOPOLL_INVALID_SOCKET && conn->on_close)
 	        conn->on_close (conn->ctx, conn, conn->on_close_data);
 
 	/* shutdown connection here */
 	if (conn->session != NOPOLL_INVALID_SOCKET) {
+		NOPOLL_PROBE3 (conn_closed, conn->id, conn->role, conn->peer_close_status);
 	        shutdown (conn->session, SHUT_RDWR);
 		nopoll_close_socket (conn->session);
 	}
@@ -2075,6 +3122,32 @@ void          nopoll_conn_shutdown (noPollConn * conn)
 	return;
 }
 
+/**
+ * @internal Fails the connection provided because of a protocol
+ * violation detected by noPoll: a close frame with the status and
+ * reason provided is sent (RFC 6455 section 7.4.1) and the connection
+ * is shut down. Unlike nopoll_conn_close_ext, no reference is
+ * released.
+ */
+void          __nopoll_conn_fail (noPollConn * conn, int status, const char * reason)
+{
+	char content[125];
+	int  reason_size = strlen (reason);
+
+	if (conn == NULL || conn->session == NOPOLL_INVALID_SOCKET)
+		return;
+
+	if (reason_size > 123)
+		reason_size = 123;
+	nopoll_set_16bit (status, content);
+	memcpy (content + 2, reason, reason_size);
+	nopoll_conn_send_frame (conn, nopoll_true, conn->role == NOPOLL_ROLE_CLIENT, NOPOLL_CLOSE_FRAME,
+				reason_size + 2, content, 0);
+
+	nopoll_conn_shutdown (conn);
+	return;
+}
+
 /** 
  * @brief Allows to close an opened \ref noPollConn no matter its role
  * (\ref noPollRole).
@@ -2101,6 +3174,11 @@ void          nopoll_conn_close_ext  (noPollConn  * conn, int status, const char
 	if (conn == NULL)
 		return;
 
+	/* stop keepalive and handshake checks (releasing the
+	 * references they hold) before references are counted below */
+	__nopoll_conn_keepalive_stop (conn);
+	__nopoll_conn_tls_handshake_timer_stop (conn);
+
 #if defined(SHOW_DEBUG_LOG)
 	if (conn->role == NOPOLL_ROLE_LISTENER)
 		role = "listener";
@@ -2117,6 +3195,10 @@ void          nopoll_conn_close_ext  (noPollConn  * conn, int status, const char
 	if (conn->session != NOPOLL_INVALID_SOCKET) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "requested proper connection close id=%d (session %d)", conn->id, conn->session);
 
+		/* write content batched before the close frame */
+		if (conn->tls_batching)
+			nopoll_conn_set_tls_batching (conn, nopoll_false);
+
 		/* build reason indication */
 		content = NULL;
 		if (reason && reason_size > 0) {
@@ -2258,6 +3340,17 @@ void nopoll_conn_unref (noPollConn * conn)
 	if (conn->pending_msg)
 		nopoll_msg_unref (conn->pending_msg);
 
+	/* return compression streams to the context pool and drop
+	 * pending bytes from the context counters (before releasing
+	 * our context reference) */
+	__nopoll_deflate_release (conn);
+	if (conn->ctx)
+		__nopoll_conn_dial_stop (conn);
+	if (conn->ctx && conn->pending_write) {
+		conn->pending_write_bytes = 0;
+		__nopoll_conn_pending_sync (conn);
+	} /* end if */
+
 	/* release ctx */
 	if (conn->ctx) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Releasing context reference, count before unref: %d", conn->ctx->refs);
@@ -2280,12 +3373,20 @@ void nopoll_conn_unref (noPollConn * conn)
 
 	/* release TLS certificates */
 	nopoll_free (conn->certificate);
+	nopoll_free (conn->tls_batch);
+	nopoll_free (conn->client_init);
+	nopoll_free (conn->latency);
 	nopoll_free (conn->private_key);
 	nopoll_free (conn->chain_certificate);
+	if (conn->cert_ctx)
+		SSL_CTX_free (conn->cert_ctx);
+	if (conn->accept_ctx)
+		SSL_CTX_free (conn->accept_ctx);
 
 	/* release incomplete message */
 	if (conn->previous_msg) 
 		nopoll_msg_unref (conn->previous_msg);
+	nopoll_free (conn->reassembly);
 
 	if (conn->ssl)
 		SSL_free (conn->ssl);
@@ -2299,6 +3400,7 @@ void nopoll_conn_unref (noPollConn * conn)
 		nopoll_free (conn->handshake->websocket_accept);
 		nopoll_free (conn->handshake->expected_accept);
 		nopoll_free (conn->handshake->cookie);
+		nopoll_free (conn->handshake->extensions);
 		nopoll_free (conn->handshake);
 	} /* end if */
 
@@ -2343,26 +3445,185 @@ long int nopoll_conn_get_max_frame_size (noPollConn * conn)
 	if (conn->max_frame_size > 0)
 		return conn->max_frame_size;
 
-	/* value configured at the listener that accepted us (in the
-	 * case the connection wasn't configured directly) */
-	if (conn->listener && conn->listener->max_frame_size > 0)
-		return conn->listener->max_frame_size;
+	/* value configured at the listener that accepted us (in the
+	 * case the connection wasn't configured directly) */
+	if (conn->listener && conn->listener->max_frame_size > 0)
+		return conn->listener->max_frame_size;
+
+	/* fall back into the context configuration */
+	return nopoll_ctx_get_max_frame_size (conn->ctx);
+}
+
+/**
+ * @internal Allows to configure into the connection the max frame
+ * size received through the provided connection options (if any).
+ */
+void __nopoll_conn_set_max_frame_size (noPollConn * conn, noPollConnOpts * options)
+{
+	if (conn == NULL || options == NULL || options->max_frame_size <= 0)
+		return;
+
+	conn->max_frame_size = options->max_frame_size;
+
+	return;
+}
+
+/**
+ * @internal Allows to configure into the connection the keepalive
+ * settings received through the provided connection options (if any).
+ */
+void __nopoll_conn_set_keepalive (noPollConn * conn, noPollConnOpts * options)
+{
+	if (conn == NULL || options == NULL || ! options->keepalive_set)
+		return;
+
+	conn->keepalive_set          = nopoll_true;
+	conn->keepalive_interval     = options->keepalive_interval;
+	conn->keepalive_pong_timeout = options->keepalive_pong_timeout;
+	conn->keepalive_idle         = options->keepalive_idle;
+
+	return;
+}
+
+/**
+ * @internal Allows to configure into the connection the UTF-8
+ * validation settings received through the provided connection
+ * options, taking them from the context otherwise.
+ */
+void __nopoll_conn_set_utf8 (noPollConn * conn, noPollConnOpts * options)
+{
+	if (conn == NULL)
+		return;
+
+	if (options && options->utf8_set) {
+		conn->utf8_rx = options->utf8_rx;
+		conn->utf8_tx = options->utf8_tx;
+		return;
+	} /* end if */
+
+	conn->utf8_rx = conn->ctx->utf8_rx;
+	conn->utf8_tx = conn->ctx->utf8_tx;
+	return;
+}
+
+/**
+ * @internal Allows to configure into the connection the message
+ * reassembly setting received through the provided connection
+ * options, taking it from the context otherwise.
+ */
+void __nopoll_conn_set_reassemble (noPollConn * conn, noPollConnOpts * options)
+{
+	if (conn == NULL)
+		return;
+
+	if (options && options->reassemble_set) {
+		conn->reassemble = options->reassemble;
+		return;
+	} /* end if */
+
+	conn->reassemble = conn->ctx->reassemble;
+	return;
+}
+
+/**
+ * @internal Accumulates the data message received into the
+ * connection reassembly buffer (see
+ * nopoll_ctx_set_reassemble_messages).
+ *
+ * @return The message to deliver (the one received when it is not
+ * part of a bigger message, or a new message holding the complete
+ * content) or NULL if the message isn't complete yet (or the
+ * connection was closed because it is too big). The reference
+ * received is always consumed.
+ */
+noPollMsg * __nopoll_conn_reassemble (noPollConn * conn, noPollMsg * msg, long max_frame_size)
+{
+	nopoll_bool   complete = msg->has_fin && msg->remain_bytes == 0;
+	char        * buffer;
+	long          capacity;
+
+	/* complete message that wasn't split: deliver it as is */
+	if (complete && conn->reassembly == NULL)
+		return msg;
+
+	if (msg->payload_size > max_frame_size - conn->reassembly_size) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL,
+			    "Message being reassembled is bigger than the maximum accepted (%ld), closing session id: %d",
+			    max_frame_size, conn->id);
+		nopoll_msg_unref (msg);
+		__nopoll_conn_fail (conn, 1009, "Message too big");
+		return NULL;
+	} /* end if */
+
+	/* first piece: record message type */
+	if (conn->reassembly_size == 0 && conn->reassembly == NULL)
+		conn->reassembly_op_code = msg->op_code;
+
+	/* grow buffer (doubling its size) */
+	if (conn->reassembly_size + msg->payload_size + 1 > conn->reassembly_capacity) {
+		capacity = conn->reassembly_capacity > 0 ? conn->reassembly_capacity : 4096;
+		while (capacity < conn->reassembly_size + msg->payload_size + 1)
+			capacity = capacity > max_frame_size ? conn->reassembly_size + msg->payload_size + 1 : capacity * 2;
+
+		buffer = nopoll_realloc (conn->reassembly, capacity);
+		if (buffer == NULL) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to reassemble the incoming message, dropping connection id=%d", conn->id);
+			nopoll_msg_unref (msg);
+			nopoll_conn_shutdown (conn);
+			return NULL;
+		} /* end if */
+		conn->reassembly          = buffer;
+		conn->reassembly_capacity = capacity;
+	} /* end if */
+
+	if (msg->payload_size > 0)
+		memcpy (conn->reassembly + conn->reassembly_size, msg->payload, msg->payload_size);
+	conn->reassembly_size += msg->payload_size;
+	nopoll_msg_unref (msg);
+
+	if (! complete)
+		return NULL;
+
+	/* deliver complete message (it takes the buffer) */
+	msg = nopoll_msg_new ();
+	if (msg == NULL) {
+		nopoll_conn_shutdown (conn);
+		return NULL;
+	} /* end if */
+	conn->reassembly[conn->reassembly_size] = 0;
+	msg->payload      = conn->reassembly;
+	msg->payload_size = conn->reassembly_size;
+	msg->op_code      = conn->reassembly_op_code;
+	msg->has_fin      = nopoll_true;
+
+	conn->reassembly          = NULL;
+	conn->reassembly_size     = 0;
+	conn->reassembly_capacity = 0;
 
-	/* fall back into the context configuration */
-	return nopoll_ctx_get_max_frame_size (conn->ctx);
+	return msg;
 }
 
 /**
- * @internal Allows to configure into the connection the max frame
- * size received through the provided connection options (if any).
+ * @internal Allows to configure into the connection the
+ * permessage-deflate settings received through the provided
+ * connection options (if any). Nothing is configured when noPoll was
+ * built without zlib, so the extension is never offered nor accepted.
  */
-void __nopoll_conn_set_max_frame_size (noPollConn * conn, noPollConnOpts * options)
+void __nopoll_conn_set_deflate (noPollConn * conn, noPollConnOpts * options)
 {
-	if (conn == NULL || options == NULL || options->max_frame_size <= 0)
+#if defined(NOPOLL_HAVE_ZLIB)
+	if (conn == NULL || options == NULL || ! options->deflate_enabled || conn->deflate)
 		return;
 
-	conn->max_frame_size = options->max_frame_size;
-
+	conn->deflate = nopoll_new (noPollDeflate, 1);
+	if (conn->deflate == NULL)
+		return;
+	conn->deflate->server_no_context_takeover = options->deflate_server_no_context_takeover;
+	conn->deflate->client_no_context_takeover = options->deflate_client_no_context_takeover;
+	conn->deflate->server_max_window_bits     = options->deflate_server_max_window_bits;
+	conn->deflate->client_max_window_bits     = options->deflate_client_max_window_bits;
+	conn->deflate->threshold                  = options->deflate_threshold_set ? options->deflate_threshold : conn->ctx->deflate_threshold;
+#endif
 	return;
 }
 
@@ -2373,6 +3634,15 @@ void __nopoll_conn_set_max_frame_size (noPollConn * conn, noPollConnOpts * optio
  */
 int nopoll_conn_default_receive (noPollConn * conn, char * buffer, int buffer_size)
 {
+	/* still dialing (see __nopoll_conn_dial_check) */
+	if (conn->dialing) {
+#if defined(NOPOLL_OS_UNIX)
+		errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+		WSASetLastError(NOPOLL_EWOULDBLOCK);
+#endif
+		return -1;
+	} /* end if */
 	return recv (conn->session, buffer, buffer_size, 0);
 }
 
@@ -2383,6 +3653,15 @@ int nopoll_conn_default_receive (noPollConn * conn, char * buffer, int buffer_si
  */
 int nopoll_conn_default_send (noPollConn * conn, char * buffer, int buffer_size)
 {
+	/* still dialing (see __nopoll_conn_dial_check) */
+	if (conn->dialing) {
+#if defined(NOPOLL_OS_UNIX)
+		errno = NOPOLL_EWOULDBLOCK;
+#elif defined(NOPOLL_OS_WIN32)
+		WSASetLastError(NOPOLL_EWOULDBLOCK);
+#endif
+		return -1;
+	} /* end if */
 	return send (conn->session, buffer, buffer_size, 0);
 }
 
@@ -2858,6 +4137,7 @@ nopoll_bool nopoll_conn_complete_handshake_check_listener (noPollCtx * ctx, noPo
 	char                 * accept_key;
 	const char           * protocol;
 	nopoll_bool            origin_check;
+	char                 * extensions;
 
 	/* call to check listener handshake */
 	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Checking client handshake data..");
@@ -2918,6 +4198,9 @@ nopoll_bool nopoll_conn_complete_handshake_check_listener (noPollCtx * ctx, noPo
 		return nopoll_false;
 	} /* end if */
 
+	/* accept extensions offered (permessage-deflate) */
+	extensions = __nopoll_deflate_server_accept (conn);
+
 	/* ok, send handshake reply */
 	if (conn->protocols || conn->accepted_protocol) {
 		/* set protocol in the reply taking preference by the
@@ -2927,15 +4210,16 @@ nopoll_bool nopoll_conn_complete_handshake_check_listener (noPollCtx * ctx, noPo
 			protocol = conn->protocols;
 
 		/* send accept header accepting protocol requested by the user */
-		reply = nopoll_strdup_printf ("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\nSec-WebSocket-Protocol: %s\r\n\r\n", 
-					      accept_key, protocol);
+		reply = nopoll_strdup_printf ("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\nSec-WebSocket-Protocol: %s%s\r\n\r\n", 
+					      accept_key, protocol, extensions ? extensions : "");
 	} else {
 		/* send accept header without telling anything about protocols */
-		reply = nopoll_strdup_printf ("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", 
-					      accept_key);
+		reply = nopoll_strdup_printf ("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s%s\r\n\r\n", 
+					      accept_key, extensions ? extensions : "");
 	}
 		
 	nopoll_free (accept_key);
+	nopoll_free (extensions);
 	if (reply == NULL) {
 		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to build reply, closing session");
 		return nopoll_false;
@@ -2996,6 +4280,12 @@ nopoll_bool nopoll_conn_complete_handshake_check_client (noPollCtx * ctx, noPoll
 	}
 	nopoll_free (accept);
 
+	/* check extensions accepted by the server (permessage-deflate) */
+	if (result && ! __nopoll_deflate_client_check (conn)) {
+		result = nopoll_false;
+		nopoll_conn_shutdown (conn);
+	} /* end if */
+
 	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Finished Sec-Websocket-Accept check, nopoll_conn_complete_handshake_check_client (%p, %p)=%d",
 		    ctx, conn, result);
 
@@ -3020,22 +4310,58 @@ void nopoll_conn_complete_handshake_check (noPollConn * conn)
 	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "calling to check handshake received on connection id %d role %d..",
 		    conn->id, conn->role);
 
+	/* reply metrics requests before the upgrade check */
+	if (conn->role == NOPOLL_ROLE_LISTENER && conn->handshake->metrics_request) {
+		__nopoll_metrics_serve (conn);
+		return;
+	} /* end if */
+
 	if (conn->role == NOPOLL_ROLE_LISTENER) {
 		result = nopoll_conn_complete_handshake_check_listener (ctx, conn);
 	} else if (conn->role == NOPOLL_ROLE_CLIENT) {
 		result = nopoll_conn_complete_handshake_check_client (ctx, conn);
 	} /* end if */
 
+	NOPOLL_PROBE3 (handshake_complete, conn->id, conn->role, result);
+
 	/* flag connection as ready: now we can get messages */
 	if (result) {
 		conn->handshake_ok = nopoll_true;
+		conn->stats.handshakes_ok++;
+		__nopoll_ctx_thread_stats (conn->ctx)->handshakes_ok++;
+
+		/* start keepalive checks (if configured) */
+		__nopoll_conn_keepalive_start (conn);
 	} else {
+		conn->stats.handshakes_failed++;
+		__nopoll_ctx_thread_stats (conn->ctx)->handshakes_failed++;
 		nopoll_conn_shutdown (conn);
 	} /* end if */
 
 	return;
 }
 
+/**
+ * @internal Records the Sec-WebSocket-Extensions value received,
+ * joining it to previous ones (the header can be repeated). The value
+ * is owned by the handshake after this call.
+ */
+void __nopoll_conn_add_extensions (noPollConn * conn, char * value)
+{
+	char * joined;
+
+	if (conn->handshake->extensions == NULL) {
+		conn->handshake->extensions = value;
+		return;
+	} /* end if */
+
+	joined = nopoll_strdup_printf ("%s, %s", conn->handshake->extensions, value);
+	nopoll_free (conn->handshake->extensions);
+	nopoll_free (value);
+	conn->handshake->extensions = joined;
+	return;
+}
+
 /** 
  * @internal Handler that implements one step of the websocket
  * listener handshake received from client, until it is completed.
@@ -3056,6 +4382,11 @@ int nopoll_conn_complete_handshake_listener (noPollCtx * ctx, noPollConn * conn,
 		 * instead of continuing to read lines over it */
 		if (! nopoll_conn_get_http_url (conn, buffer, buffer_size, "GET", &conn->get_url))
 			return 0;
+
+		/* metrics requests are replied once the rest of the
+		 * headers are read, skipping the upgrade check (see
+		 * nopoll_ctx_set_metrics_path) */
+		conn->handshake->metrics_request = __nopoll_metrics_is_path (ctx, conn->get_url);
 		return 1;
 	} /* end if */
 
@@ -3108,6 +4439,9 @@ int nopoll_conn_complete_handshake_listener (noPollCtx * ctx, noPollConn * conn,
 		conn->handshake->cookie = value;
 	} else if (strcasecmp (header, "X-Real-IP") == 0) {
 		conn->x_real_ip_address = value;
+	} else if (strcasecmp (header, "Sec-WebSocket-Extensions") == 0) {
+		/* header can be repeated (RFC 6455, section 9.1) */
+		__nopoll_conn_add_extensions (conn, value);
 	} else {
 		/* release value, nobody claimed it */
 		nopoll_free (value);
@@ -3177,6 +4511,8 @@ int nopoll_conn_complete_handshake_client (noPollCtx * ctx, noPollConn * conn, c
 	} else if (strcasecmp (header, "Connection") == 0) {
 		conn->handshake->connection_upgrade = 1;
 		nopoll_free (value);
+	} else if (strcasecmp (header, "Sec-WebSocket-Extensions") == 0) {
+		__nopoll_conn_add_extensions (conn, value);
 	} else {
 		/* release value, nobody claimed it */
 		nopoll_free (value);
@@ -3305,21 +4641,17 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 	char        buffer[20];
 	int         bytes;
 	noPollMsg * msg;
-	int         ssl_error;
 	int         header_size = 2;
-#if defined(SHOW_DEBUG_LOG)
-	long        result;
-#endif
 	unsigned char *len;
 	unsigned long int  payload_size_aux;
 	long int           max_frame_size;
+	int                result_inflate;
+	long               read_size;
+	noPollStats      * ctx_stats;
 
 	if (conn == NULL)
 		return NULL;
 
-        if (conn->pending_ssl_connect)
-            return NULL;  /* Let the loop in conn_new_common handle this */
-
 	/* get maximum frame size accepted for this connection: it is
 	 * used to reject frames declaring a payload size bigger than
 	 * what this connection is willing to handle */
@@ -3329,65 +4661,15 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 		    "=== START: conn-id=%d (errno=%d, session: %d, conn->handshake_ok: %d, conn->pending_ssl_accept: %d) ===", 
 		    conn->id, errno, conn->session, conn->handshake_ok, conn->pending_ssl_accept);
 	
-	/* check for accept SSL connection */
-	if (conn->pending_ssl_accept) {
-		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Received connect over a connection (id %d) with TLS handshake pending to be finished, processing..",
-			    conn->id);
-
-		/* get ssl error */
-		ssl_error = SSL_accept (conn->ssl);
-		if (ssl_error == -1) {
-			/* get error */
-			ssl_error = SSL_get_error (conn->ssl, -1);
- 
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "accept function have failed (for listener side) ssl_error=%d : dumping error stack..", ssl_error);
- 
-			switch (ssl_error) {
-			case SSL_ERROR_WANT_READ:
-			        nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "still not prepared to continue because read wanted conn-id=%d (%p, session %d)",
-					    conn->id, conn, conn->session);
-				return NULL;
-			case SSL_ERROR_WANT_WRITE:
-			        nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "still not prepared to continue because write wanted conn-id=%d (%p)",
-					    conn->id, conn);
-				return NULL;
-			default:
-				break;
-			} /* end switch */
-
-			/* TLS-fication process have failed */
-			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "there was an error while accepting TLS connection");
-			nopoll_conn_log_ssl (conn);
-			nopoll_conn_shutdown (conn);
-			return NULL;
-		} /* end if */
-
-		/* ssl accept */
-		conn->pending_ssl_accept = nopoll_false;
-		nopoll_conn_set_sock_block (conn->session, nopoll_false);
-
-#if defined(SHOW_DEBUG_LOG)
-		result = SSL_get_verify_result (conn->ssl);
-		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Completed TLS operation from %s:%s (conn id %d, ssl veriry result: %d)",
-			    conn->host, conn->port, conn->id, (int) result);
-#endif
-
-		/* configure default handlers */
-		conn->receive = nopoll_conn_tls_receive;
-		conn->send    = nopoll_conn_tls_send;
-
-		/* call to check post ssl checks after SSL finalization */
-		if (conn->ctx && conn->ctx->post_ssl_check) {
-			if (! conn->ctx->post_ssl_check (conn->ctx, conn, conn->ssl_ctx, conn->ssl, conn->ctx->post_ssl_check_data)) {
-				/* TLS post check failed */
-				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "TLS/SSL post check function failed, dropping connection");
-				nopoll_conn_shutdown (conn);
-				return NULL;
-			} /* end if */
-		} /* end if */
+	/* nothing to read until the connection is dialed */
+	if (! __nopoll_conn_dial_check (conn) || conn->session == NOPOLL_INVALID_SOCKET)
+		return NULL;
 
-		/* set this connection has TLS ok */
-		conn->tls_on  = nopoll_true;
+	/* continue the TLS handshake (accepted or created) */
+	if (conn->pending_ssl_accept || conn->pending_ssl_connect) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Received data over a connection (id %d) with TLS handshake pending to be finished, processing..",
+			    conn->id);
+		__nopoll_conn_tls_handshake (conn);
 
 #if defined(NOPOLL_OS_UNIX)
 		/* report NULL because this was a call to complete TLS */
@@ -3404,6 +4686,10 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 	/* check connection status */
 	if (! conn->handshake_ok) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Connection id %d handshake is not complete, running..", conn->id);
+		/* the server replies once the client init is sent */
+		if (! __nopoll_conn_client_init_flush (conn))
+			return NULL;
+
 		/* acquire here handshake mutex */
 		nopoll_mutex_lock (conn->handshake_mutex);
 
@@ -3442,8 +4728,9 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 			/* flag this message as a fragment */
 			msg->is_fragment = nopoll_true;
 
-			/* get fin bytes */
-			msg->has_fin      = 1; /* for now final message */
+			/* get fin bytes: the rest of the frame keeps the
+			 * FIN bit announced by the peer */
+			msg->has_fin      = conn->previous_msg->has_fin;
 			msg->op_code      = 0; /* continuation frame */
 
 			/* copy initial mask indication */
@@ -3567,6 +4854,16 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 		return NULL;
 	} /* end if */
 
+	/* check RSV1, used by permessage-deflate to flag compressed
+	 * messages (RFC 7692, section 6) */
+	if (! __nopoll_deflate_rx_frame (conn, nopoll_get_bit (buffer[0], 6), msg->op_code)) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received websocket frame (op code %d) with RSV1 bit set but it is not allowed, closing session id: %d",
+			    msg->op_code, conn->id);
+		nopoll_msg_unref (msg);
+		nopoll_conn_shutdown (conn);
+		return NULL;
+	} /* end if */
+
 	/* check payload size value */
 	if (msg->payload_size < 0) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong payload size at first 7 bits, closing session id: %d", 
@@ -3663,6 +4960,8 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL,
 				    "Received websocket frame announcing a payload size (%lu) bigger than the maximum frame size accepted (%ld), closing session id: %d",
 				    payload_size_aux, max_frame_size, conn->id);
+			conn->stats.frame_size_rejections++;
+			__nopoll_ctx_thread_stats (conn->ctx)->frame_size_rejections++;
 			nopoll_msg_unref (msg);
 			nopoll_conn_shutdown (conn);
 			return NULL;
@@ -3679,12 +4978,27 @@ noPollMsg   * nopoll_conn_get_msg (noPollConn * conn)
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL,
 			    "Received websocket frame with a wrong payload size (%ld): it is negative or bigger than the maximum frame size accepted (%ld), closing session id: %d",
 			    msg->payload_size, max_frame_size, conn->id);
+		conn->stats.frame_size_rejections++;
+		__nopoll_ctx_thread_stats (conn->ctx)->frame_size_rejections++;
 		nopoll_msg_unref (msg);
 		nopoll_conn_shutdown (conn);
 		return NULL;
 	} /* end if */
 
-	if (msg->op_code == NOPOLL_PONG_FRAME) {
+	/* account the frame received */
+	conn->stats.frames_in[msg->op_code & 0x0f]++;
+	conn->stats.bytes_in[msg->op_code & 0x0f] += msg->payload_size;
+	ctx_stats = __nopoll_ctx_thread_stats (conn->ctx);
+	ctx_stats->frames_in[msg->op_code & 0x0f]++;
+	ctx_stats->bytes_in[msg->op_code & 0x0f] += msg->payload_size;
+	NOPOLL_PROBE4 (frame_header, conn->id, msg->op_code, msg->payload_size, msg->has_fin);
+
+	/* record peer activity (used by keepalive) */
+	if (conn->keepalive_timer > 0)
+		__nopoll_conn_keepalive_activity (conn, msg->op_code == NOPOLL_PONG_FRAME);
+
+	/* PONG frames with payload are read (and discarded) below */
+	if (msg->op_code == NOPOLL_PONG_FRAME && msg->payload_size == 0) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "PONG received over connection id=%d", conn->id);
 		nopoll_msg_unref (msg);
 		return NULL;
@@ -3786,8 +5100,14 @@ read_payload:
 		return NULL;
 	} /* end if */
 
+	/* streaming connections read big payloads in pieces, the
+	 * rest is handled as a partial read (see previous_msg) */
+	read_size = msg->payload_size;
+	if ((conn->on_msg_chunk || conn->ctx->on_msg_chunk) && read_size > NOPOLL_MSG_CHUNK_SIZE)
+		read_size = NOPOLL_MSG_CHUNK_SIZE;
+
 	/* copy payload received */
-	msg->payload = nopoll_new (char, msg->payload_size + 1);	/* allow extra byte for string terminator */
+	msg->payload = nopoll_new (char, read_size + 1);	/* allow extra byte for string terminator */
 	if (msg->payload == NULL) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to read the incoming frame, dropping connection id=%d", conn->id);
 		nopoll_msg_unref (msg);
@@ -3795,7 +5115,7 @@ read_payload:
 		return NULL;		
 	} /* end if */
 
-	bytes = __nopoll_conn_receive (conn, (char *) msg->payload, msg->payload_size);
+	bytes = __nopoll_conn_receive (conn, (char *) msg->payload, read_size);
 	if (bytes < 0) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Connection lost during message reception, dropping connection id=%d, bytes=%d, errno=%d : %s", 
 			    conn->id, bytes, errno, strerror (errno));
@@ -3856,6 +5176,28 @@ read_payload:
 		msg->unmask_desp += msg->payload_size;
 	} /* end if */
 
+	/* inflate content of compressed messages (permessage-deflate) */
+	result_inflate = __nopoll_deflate_inflate_msg (conn, msg, max_frame_size);
+	if (result_inflate < 0) {
+		nopoll_msg_unref (msg);
+		nopoll_conn_shutdown (conn);
+		return NULL;
+	} /* end if */
+	if (result_inflate > 0 && msg->payload_size == 0 && ! (msg->has_fin && msg->remain_bytes == 0)) {
+		/* content received didn't produce output yet (if the
+		 * message is held at conn->previous_msg it is reused
+		 * on the next call) */
+		nopoll_msg_unref (msg);
+		return NULL;
+	} /* end if */
+
+	/* validate content of text messages (UTF-8) */
+	if (conn->utf8_rx && ! __nopoll_utf8_rx_msg (conn, msg)) {
+		nopoll_msg_unref (msg);
+		__nopoll_conn_fail (conn, 1007, "Invalid UTF-8 content");
+		return NULL;
+	} /* end if */
+
 	/* check here close frame with reason */
 	if (msg->op_code == NOPOLL_CLOSE_FRAME) {
 
@@ -3872,6 +5214,14 @@ read_payload:
 			conn->peer_close_reason = nopoll_strdup ((const char *) msg->payload + 2);
 		} /* end if */
 
+		if (conn->peer_close_status >= 1000 && conn->peer_close_status <= 1015) {
+			conn->stats.close_codes[conn->peer_close_status - 1000]++;
+			__nopoll_ctx_thread_stats (conn->ctx)->close_codes[conn->peer_close_status - 1000]++;
+		} else {
+			conn->stats.close_other++;
+			__nopoll_ctx_thread_stats (conn->ctx)->close_other++;
+		} /* end if */
+
 		/* release message, close the connection and return
 		   NULL to notify caller nothing to read for the
 		   application */
@@ -3889,6 +5239,18 @@ read_payload:
 		return NULL;
 	} /* end if */
 
+	/* Received pong frame with payload */
+	if (msg->op_code == NOPOLL_PONG_FRAME) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "PONG received over connection id=%d and payload_size=%ld",
+			    conn->id, msg->payload_size);
+		nopoll_msg_unref (msg);
+		return NULL;
+	} /* end if */
+
+	/* join fragments when complete messages are requested */
+	if (conn->reassemble && ! (conn->on_msg_chunk || conn->ctx->on_msg_chunk) && msg->op_code <= NOPOLL_BINARY_FRAME)
+		return __nopoll_conn_reassemble (conn, msg, max_frame_size);
+
 	return msg;
 }
 
@@ -3915,6 +5277,19 @@ read_payload:
  */
 int           __nopoll_conn_send_common (noPollConn * conn, const char * content, long length, nopoll_bool has_fin, long sleep_in_header, noPollOpCode frame_type)
 {
+	return __nopoll_conn_send_common_flags (conn, content, length, has_fin, sleep_in_header, frame_type, NOPOLL_SEND_DEFAULT);
+}
+
+/**
+ * @internal Same as __nopoll_conn_send_common but allowing to
+ * provide send flags (see \ref noPollSendFlags).
+ */
+int           __nopoll_conn_send_common_flags (noPollConn * conn, const char * content, long length, nopoll_bool has_fin,
+					       long sleep_in_header, noPollOpCode frame_type, int flags)
+{
+	int result;
+	int utf8_state = 0;
+
 	if (conn == NULL || content == NULL || length == 0 || length < -1)
 		return -1;
 
@@ -3933,15 +5308,18 @@ int           __nopoll_conn_send_common (noPollConn * conn, const char * content
 	}
 	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "__nopoll_conn_send_common: attempting to send %d bytes", (int) length);
 
-	/* sending content as client */
-	if (conn->role == NOPOLL_ROLE_CLIENT) {
-		return nopoll_conn_send_frame (conn, /* fin */ has_fin, /* masked */ nopoll_true, 
-					       frame_type, length, (noPollPtr) content, sleep_in_header);
-	} /* end if */
+	/* validate text content (UTF-8), the validator state is only
+	 * recorded once the frame is sent */
+	if (conn->utf8_tx && frame_type == NOPOLL_TEXT_FRAME && ! __nopoll_utf8_tx_check (conn, content, length, has_fin, &utf8_state))
+		return -1;
 
-	/* sending content as listener */
-	return nopoll_conn_send_frame (conn, /* fin */ has_fin, /* masked */ nopoll_false, 
-				       frame_type, length, (noPollPtr) content, sleep_in_header);	
+	/* sending content (masked as client) */
+	result = __nopoll_conn_send_frame_flags (conn, /* fin */ has_fin, /* masked */ conn->role == NOPOLL_ROLE_CLIENT, 
+						 frame_type, length, (noPollPtr) content, sleep_in_header, flags);
+	if (conn->utf8_tx && frame_type == NOPOLL_TEXT_FRAME && result >= 0)
+		conn->utf8_tx_state = utf8_state;
+
+	return result;
 }
 
 /** 
@@ -3951,7 +5329,8 @@ int           __nopoll_conn_send_common (noPollConn * conn, const char * content
  * @param conn The connection where the message will be sent.
  *
  * @param content The content to be sent (it should be utf-8 content
- * or the function will fail).
+ * or the function will fail when UTF-8 validation is enabled, see
+ * \ref nopoll_ctx_set_utf8_validation).
  *
  * @param length Amount of bytes to take from the content to be
  * sent. If provided -1, it is assumed you are passing in a C-like
@@ -3988,7 +5367,8 @@ int           nopoll_conn_send_text (noPollConn * conn, const char * content, lo
  * @param conn The connection where the message will be sent.
  *
  * @param content The content to be sent (it should be utf-8 content
- * or the function will fail).
+ * or the function will fail when UTF-8 validation is enabled, see
+ * \ref nopoll_ctx_set_utf8_validation).
  *
  * @param length Amount of bytes to take from the content to be
  * sent. If provided -1, it is assumed you are passing in a C-like
@@ -4091,6 +5471,339 @@ int           nopoll_conn_send_binary_fragment (noPollConn * conn, const char *
 	return __nopoll_conn_send_common (conn, content, length, nopoll_false, 0, NOPOLL_BINARY_FRAME);
 }
 
+/**
+ * @brief Allows to send a text or binary message (or a fragment of
+ * it) over the provided connection, providing flags that control
+ * how it is sent.
+ *
+ * For example, use \ref NOPOLL_SEND_NO_COMPRESS to skip
+ * permessage-deflate for content that is already compressed (images,
+ * archives..), where compressing again only burns CPU:
+ *
+ * \code
+ * nopoll_conn_send_ext (conn, NOPOLL_BINARY_FRAME, image, image_size, nopoll_true, NOPOLL_SEND_NO_COMPRESS);
+ * \endcode
+ *
+ * @param conn The connection where the message will be sent.
+ *
+ * @param op_code The message type (\ref NOPOLL_TEXT_FRAME or \ref NOPOLL_BINARY_FRAME).
+ *
+ * @param content The content to be sent.
+ *
+ * @param length Amount of bytes to take from the content to be
+ * sent. -1 is only accepted for text messages (see \ref
+ * nopoll_conn_send_text).
+ *
+ * @param has_fin nopoll_true to send the last frame of the message,
+ * nopoll_false to send a fragment (more frames to come, that is, FIN
+ * = 0).
+ *
+ * @param flags Send flags (see \ref noPollSendFlags).
+ *
+ * @return The number of bytes written otherwise < 0 is returned in
+ * case of failure (see \ref nopoll_conn_send_text to know about
+ * values reported).
+ */
+int           nopoll_conn_send_ext (noPollConn * conn, noPollOpCode op_code, const char * content, long length,
+				    nopoll_bool has_fin, int flags)
+{
+	if (op_code != NOPOLL_TEXT_FRAME && op_code != NOPOLL_BINARY_FRAME)
+		return -1;
+
+	return __nopoll_conn_send_common_flags (conn, content, length, has_fin, 0, op_code, flags);
+}
+
+/**
+ * @internal Producer used by nopoll_conn_send_file when the content
+ * can't be sent with sendfile (it reads the file range requested).
+ */
+long __nopoll_conn_file_producer (noPollWriter * writer, char * buffer, long size, noPollPtr user_data)
+{
+	noPollFileRange * range = (noPollFileRange *) user_data;
+	int               result;
+
+	if (range->remaining == 0)
+		return 0;
+	if (size > range->remaining)
+		size = range->remaining;
+
+#if defined(NOPOLL_OS_WIN32)
+	if (_lseek (range->fd, range->offset, SEEK_SET) != range->offset)
+		return -1;
+	result = _read (range->fd, buffer, (unsigned int) size);
+#else
+	if (lseek (range->fd, (off_t) range->offset, SEEK_SET) != (off_t) range->offset)
+		return -1;
+	do {
+		result = read (range->fd, buffer, (size_t) size);
+	} while (result < 0 && errno == NOPOLL_EINTR);
+#endif
+	/* file shorter than the range requested */
+	if (result <= 0)
+		return -1;
+
+	range->offset    += result;
+	range->remaining -= result;
+	return result;
+}
+
+/**
+ * @internal Waits (up to the provided timeout, in microseconds) until
+ * the connection socket accepts more data. poll is used where
+ * available so sockets above FD_SETSIZE are supported.
+ */
+void __nopoll_conn_wait_writable (noPollConn * conn, long timeout)
+{
+#if defined(NOPOLL_OS_UNIX)
+	struct pollfd    pfd;
+#else
+	struct timeval   tv;
+	fd_set           wset;
+#endif
+
+	if (conn->session == NOPOLL_INVALID_SOCKET)
+		return;
+
+#if defined(NOPOLL_OS_UNIX)
+	pfd.fd      = conn->session;
+	pfd.events  = POLLOUT;
+	pfd.revents = 0;
+	/* round up so short waits still wait */
+	poll (&pfd, 1, (int) ((timeout + 999) / 1000));
+#else
+	/* on windows, fd_set is a list of sockets (bounded by count
+	 * and not by value) */
+	FD_ZERO (&wset);
+	FD_SET (conn->session, &wset);
+	tv.tv_sec  = timeout / 1000000;
+	tv.tv_usec = timeout % 1000000;
+	select (conn->session + 1, NULL, &wset, NULL, &tv);
+#endif
+	return;
+}
+
+/**
+ * @internal Allows to check if the provided connection can send file
+ * content with sendfile: plain (or kTLS) connections that do not mask
+ * (server side) using the default send handler.
+ */
+nopoll_bool __nopoll_conn_can_sendfile (noPollConn * conn)
+{
+#if defined(NOPOLL_HAVE_SENDFILE)
+	return (conn->ssl == NULL || (conn->ktls & NOPOLL_KTLS_TX)) && conn->role != NOPOLL_ROLE_CLIENT &&
+		conn->send == nopoll_conn_default_send;
+#else
+	return nopoll_false;
+#endif
+}
+
+/**
+ * @internal Sends the provided file range as a single binary frame
+ * using sendfile, so the content never goes through user space. The
+ * caller must check __nopoll_conn_can_sendfile.
+ *
+ * @return Bytes sent (length) or -1 if it fails (the connection is
+ * closed if the frame was partially sent).
+ */
+long __nopoll_conn_sendfile (noPollConn * conn, int fd, long offset, long length)
+{
+#if defined(NOPOLL_HAVE_SENDFILE)
+	unsigned char   header[10];
+	int             header_size = 2;
+	int             desp        = 0;
+	long            sent        = 0;
+	long            stall       = 0;
+	ssize_t         written;
+	off_t           file_offset;
+	size_t          chunk;
+
+	/* frame header: final binary frame, not masked */
+	header[0] = 0x80 | NOPOLL_BINARY_FRAME;
+	if (length < 126) {
+		header[1] = (unsigned char) length;
+	} else if (length <= 65535) {
+		header[1] = 126;
+		nopoll_set_16bit (length, (char *) header + 2);
+		header_size += 2;
+	} else {
+		header[1] = 127;
+		header[2] = header[3] = header[4] = header[5] = 0;
+#if defined(NOPOLL_64BIT_PLATFORM)
+		header[2] = (unsigned char) ((length >> 56) & 0x7F);
+		header[3] = (unsigned char) ((length >> 48) & 0xFF);
+		header[4] = (unsigned char) ((length >> 40) & 0xFF);
+		header[5] = (unsigned char) ((length >> 32) & 0xFF);
+#endif
+		header[6] = (unsigned char) ((length >> 24) & 0xFF);
+		header[7] = (unsigned char) ((length >> 16) & 0xFF);
+		header[8] = (unsigned char) ((length >> 8) & 0xFF);
+		header[9] = (unsigned char) (length & 0xFF);
+		header_size += 8;
+	} /* end if */
+
+	/* write header and then the file content */
+	while (sent < length) {
+		if (desp < header_size) {
+			written = conn->send (conn, (char *) header + desp, header_size - desp);
+			if (written > 0)
+				desp += written;
+		} else {
+			file_offset = (off_t) (offset + sent);
+			chunk       = (size_t) (length - sent > 0x40000000 ? 0x40000000 : length - sent);
+			written     = sendfile (conn->session, fd, &file_offset, chunk);
+			if (written > 0)
+				sent += written;
+			else if (written == 0) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "File content ended before the range requested (%ld bytes sent out of %ld), closing conn-id=%d",
+					    sent, length, conn->id);
+				nopoll_conn_shutdown (conn);
+				return -1;
+			} /* end if */
+		} /* end if */
+
+		if (written > 0) {
+			stall = 0;
+			continue;
+		} /* end if */
+
+		if (errno != NOPOLL_EWOULDBLOCK && errno != NOPOLL_EINTR && errno != EAGAIN) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Failed to send file content, errno=%d : %s, conn-id=%d", errno, strerror (errno), conn->id);
+			if (desp > 0)
+				nopoll_conn_shutdown (conn);
+			return -1;
+		} /* end if */
+
+		/* wait for the connection to accept more content */
+		if (stall >= NOPOLL_SEND_FILE_STALL_TIMEOUT * 1000000L) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Connection didn't accept file content during %d seconds, closing conn-id=%d",
+				    NOPOLL_SEND_FILE_STALL_TIMEOUT, conn->id);
+			if (desp > 0)
+				nopoll_conn_shutdown (conn);
+			return -1;
+		} /* end if */
+		__nopoll_conn_wait_writable (conn, 100000);
+		stall += 100000;
+	} /* end while */
+
+	return sent;
+#else
+	return -1;
+#endif
+}
+
+/**
+ * @brief Allows to send the content of a file (or part of it) as a
+ * binary message over the provided connection.
+ *
+ * On plain (no TLS) server side connections (which do not mask
+ * content), the payload is sent with sendfile(2) after writing the
+ * frame header, so file content never goes through user space
+ * buffers. This also applies to TLS connections where encryption was
+ * offloaded to the kernel (see \ref nopoll_conn_opts_set_ktls).
+ * Otherwise (TLS, client connections, or platforms without
+ * sendfile) the content is read and sent in pieces (see \ref
+ * nopoll_writer_new), so memory used stays bounded no matter the file
+ * size.
+ *
+ * The function blocks the caller until the content is sent. It fails
+ * if the connection doesn't accept more content during \ref
+ * NOPOLL_SEND_FILE_STALL_TIMEOUT seconds.
+ *
+ * \code
+ * fd = open ("image.png", O_RDONLY);
+ * if (nopoll_conn_send_file (conn, fd, 0, -1) < 0)
+ *       printf ("Failed to send file\n");
+ * close (fd);
+ * \endcode
+ *
+ * @param conn The connection where the file content is sent.
+ *
+ * @param fd The file descriptor to read (it is not closed).
+ *
+ * @param offset Position of the file where content starts.
+ *
+ * @param length Bytes to send. Use -1 to send until the end of the file.
+ *
+ * @return Bytes sent or -1 if it fails. When a failure is found after
+ * part of the message was sent, the connection is closed because the
+ * message cannot be completed.
+ */
+long          nopoll_conn_send_file (noPollConn * conn, int fd, long offset, long length)
+{
+	struct stat       st;
+	noPollFileRange   range;
+	noPollWriter    * writer;
+	long              sent;
+	long              stall = 0;
+	int               result;
+
+	if (conn == NULL || fd < 0 || offset < 0 || ! nopoll_conn_is_ok (conn))
+		return -1;
+
+	if (conn->role == NOPOLL_ROLE_MAIN_LISTENER) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Trying to send content over a master listener connection");
+		return -1;
+	} /* end if */
+
+	/* the file is sent over the socket being dialed (if it is) */
+	__nopoll_conn_dial_wait (conn);
+	if (conn->session == NOPOLL_INVALID_SOCKET)
+		return -1;
+
+	/* send until the end of the file */
+	if (length < 0) {
+		if (fstat (fd, &st) != 0 || (long) st.st_size < offset)
+			return -1;
+		length = (long) st.st_size - offset;
+	} /* end if */
+	if (length == 0)
+		return -1;
+
+	/* complete previous frames */
+	while (nopoll_conn_pending_write_bytes (conn) > 0) {
+		if (nopoll_conn_complete_pending_write (conn) < 0 && errno != NOPOLL_EWOULDBLOCK)
+			return -1;
+		if (nopoll_conn_pending_write_bytes (conn) == 0)
+			break;
+		if (stall >= NOPOLL_SEND_FILE_STALL_TIMEOUT * 1000000L)
+			return -1;
+		__nopoll_conn_wait_writable (conn, 100000);
+		stall += 100000;
+	} /* end while */
+
+	if (__nopoll_conn_can_sendfile (conn))
+		return __nopoll_conn_sendfile (conn, fd, offset, length);
+
+	/* read and send in pieces */
+	range.fd        = fd;
+	range.offset    = offset;
+	range.remaining = length;
+	writer = nopoll_writer_new (conn, NOPOLL_BINARY_FRAME, 0, __nopoll_conn_file_producer, &range);
+	if (writer == NULL)
+		return -1;
+
+	sent = 0;
+	while (nopoll_true) {
+		result = nopoll_writer_send (writer, NOPOLL_SEND_FILE_STALL_TIMEOUT * 1000000L);
+		if (result != 0 || nopoll_writer_get_sent (writer) == sent)
+			break;
+		/* progress was made: keep waiting */
+		sent = nopoll_writer_get_sent (writer);
+	} /* end while */
+
+	if (result != 1) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Failed to send file content (%ld bytes sent out of %ld), conn-id=%d",
+			    nopoll_writer_get_sent (writer), length, conn->id);
+		if (writer->frames > 0 && ! nopoll_writer_is_done (writer))
+			nopoll_conn_shutdown (conn);
+		nopoll_writer_free (writer);
+		return -1;
+	} /* end if */
+
+	nopoll_writer_free (writer);
+	return length;
+}
+
 
 /** 
  * @brief Allows to read the provided amount of bytes from the
@@ -4414,6 +6127,282 @@ nopoll_bool      nopoll_conn_send_ping (noPollConn * conn)
 	return nopoll_conn_send_frame (conn, nopoll_true, conn->role == NOPOLL_ROLE_CLIENT, NOPOLL_PING_FRAME, 0, NULL, 0) >= 0;
 }
 
+/**
+ * @internal Returns microseconds elapsed since the provided time.
+ */
+long __nopoll_conn_elapsed_since (struct timeval * since)
+{
+	struct timeval now;
+	struct timeval diff;
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&now, NULL);
+#else
+	gettimeofday (&now, NULL);
+#endif
+	nopoll_timeval_substract (&now, since, &diff);
+	return (diff.tv_sec * 1000000) + diff.tv_usec;
+}
+
+/**
+ * @internal Timer handler that implements keepalive checks on the
+ * connection received (which holds a reference for the timer).
+ */
+void __nopoll_conn_keepalive_check (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+{
+	noPollConn * conn = (noPollConn *) user_data;
+	long         elapsed;
+	long         next;
+
+	conn->keepalive_timer = 0;
+
+	/* connection no longer working: stop checks */
+	if (! nopoll_conn_is_ok (conn)) {
+		nopoll_conn_unref (conn);
+		return;
+	} /* end if */
+
+	if (conn->pong_pending) {
+		/* check PONG deadline */
+		elapsed = __nopoll_conn_elapsed_since (&conn->ping_sent);
+		if (elapsed >= conn->keepalive_pong_timeout) {
+			nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "No PONG received over conn-id=%d after %ld microseconds, closing connection",
+				    conn->id, elapsed);
+			nopoll_conn_shutdown (conn);
+			nopoll_conn_unref (conn);
+			return;
+		} /* end if */
+		next = conn->keepalive_pong_timeout - elapsed;
+	} else if (__nopoll_conn_elapsed_since (&conn->last_activity) >= conn->keepalive_idle) {
+		/* connection idle: ping the peer */
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Sending keepalive PING over idle conn-id=%d", conn->id);
+#if defined(NOPOLL_OS_WIN32)
+		nopoll_win32_gettimeofday (&conn->ping_sent, NULL);
+#else
+		gettimeofday (&conn->ping_sent, NULL);
+#endif
+		conn->pong_pending = nopoll_true;
+		if (! nopoll_conn_send_ping (conn))
+			nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "Failed to send keepalive PING over conn-id=%d", conn->id);
+		next = conn->keepalive_pong_timeout;
+	} else {
+		/* connection busy */
+		next = conn->keepalive_interval;
+	} /* end if */
+
+	/* schedule next check (keeping the reference) */
+	conn->keepalive_timer = nopoll_timer_add (ctx, next, __nopoll_conn_keepalive_check, conn);
+	if (conn->keepalive_timer <= 0) {
+		conn->keepalive_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+
+	return;
+}
+
+/**
+ * @internal Starts keepalive checks on the connection provided (if
+ * they are configured for it or at the context).
+ */
+void __nopoll_conn_keepalive_start (noPollConn * conn)
+{
+	noPollCtx * ctx = conn->ctx;
+
+	/* use context configuration if the connection was not
+	 * configured through options */
+	if (! conn->keepalive_set) {
+		conn->keepalive_interval     = ctx->keepalive_interval;
+		conn->keepalive_pong_timeout = ctx->keepalive_pong_timeout;
+		conn->keepalive_idle         = ctx->keepalive_idle;
+	} /* end if */
+
+	if (conn->keepalive_interval <= 0 || conn->keepalive_timer > 0)
+		return;
+	if (conn->keepalive_pong_timeout <= 0)
+		conn->keepalive_pong_timeout = conn->keepalive_interval;
+	if (conn->keepalive_idle <= 0)
+		conn->keepalive_idle = conn->keepalive_interval;
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&conn->last_activity, NULL);
+#else
+	gettimeofday (&conn->last_activity, NULL);
+#endif
+
+	/* the timer holds a reference to the connection */
+	if (! nopoll_conn_ref (conn))
+		return;
+	conn->keepalive_timer = nopoll_timer_add (ctx, conn->keepalive_interval, __nopoll_conn_keepalive_check, conn);
+	if (conn->keepalive_timer <= 0) {
+		conn->keepalive_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+
+	return;
+}
+
+/**
+ * @internal Stops keepalive checks on the connection provided.
+ */
+void __nopoll_conn_keepalive_stop (noPollConn * conn)
+{
+	if (conn->keepalive_timer <= 0)
+		return;
+
+	/* release the reference held by the timer if it was still
+	 * pending */
+	if (nopoll_timer_cancel (conn->ctx, conn->keepalive_timer)) {
+		conn->keepalive_timer = 0;
+		nopoll_conn_unref (conn);
+	} /* end if */
+
+	return;
+}
+
+/**
+ * @internal Records that a frame was received over the connection
+ * (and the PONG reply to a keepalive PING, measuring the round trip
+ * time).
+ */
+void __nopoll_conn_keepalive_activity (noPollConn * conn, nopoll_bool is_pong)
+{
+	noPollStats * ctx_stats;
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&conn->last_activity, NULL);
+#else
+	gettimeofday (&conn->last_activity, NULL);
+#endif
+
+	if (is_pong && conn->pong_pending) {
+		conn->pong_pending = nopoll_false;
+		conn->rtt          = __nopoll_conn_elapsed_since (&conn->ping_sent);
+		/* report at least 1 (0 means not measured) */
+		if (conn->rtt <= 0)
+			conn->rtt = 1;
+		conn->stats.pongs++;
+		conn->stats.rtt_last   = conn->rtt;
+		conn->stats.rtt_total += conn->rtt;
+		ctx_stats = __nopoll_ctx_thread_stats (conn->ctx);
+		ctx_stats->pongs++;
+		ctx_stats->rtt_last   = conn->rtt;
+		ctx_stats->rtt_total += conn->rtt;
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Keepalive PONG received over conn-id=%d, rtt=%ld microseconds", conn->id, conn->rtt);
+	} /* end if */
+
+	return;
+}
+
+/**
+ * @brief Returns the round trip time measured with the last keepalive
+ * PING answered by the peer (see \ref nopoll_ctx_set_keepalive).
+ *
+ * @param conn The connection to check.
+ *
+ * @return Round trip time in microseconds or -1 if it was not
+ * measured (keepalive not enabled or no PONG received yet).
+ */
+long               nopoll_conn_get_rtt (noPollConn * conn)
+{
+	if (conn == NULL || conn->rtt <= 0)
+		return -1;
+
+	return conn->rtt;
+}
+
+/**
+ * @brief Gets the counters collected by the provided connection
+ * since it was created (frames and bytes by opcode, handshakes,
+ * partial writes, keepalive round trip times, close codes
+ * received...). See \ref noPollStats.
+ *
+ * Counters are updated by the thread doing I/O on the connection
+ * without any locking, so values read from another thread may be
+ * slightly behind.
+ *
+ * @param conn The connection to check.
+ *
+ * @param stats Reference where the counters are copied.
+ *
+ * @return nopoll_true if the counters were copied, otherwise
+ * nopoll_false is returned (NULL parameters).
+ */
+nopoll_bool        nopoll_conn_get_stats (noPollConn * conn, noPollStats * stats)
+{
+	if (conn == NULL || stats == NULL)
+		return nopoll_false;
+
+	memcpy (stats, &conn->stats, sizeof (noPollStats));
+	stats->pending_write_bytes = conn->pending_write ? conn->pending_write_bytes : 0;
+
+	return nopoll_true;
+}
+
+/**
+ * @brief Enables or disables recording the latencies of the provided
+ * connection into its own histograms (see \ref
+ * nopoll_conn_get_latency), which take about 4KB per connection.
+ * Latencies are only recorded while tracking is enabled on the
+ * context too (see \ref nopoll_ctx_set_latency_tracking), which
+ * aggregates all connections without this option.
+ *
+ * Values recorded so far are released when tracking is disabled.
+ * Configure it from the thread doing I/O on the connection (for
+ * example, from the on ready handler).
+ *
+ * @param conn The connection to configure.
+ *
+ * @param enable nopoll_true to record the connection latencies.
+ *
+ * @return nopoll_true if the configuration was applied, otherwise
+ * nopoll_false is returned (NULL connection or memory allocation
+ * failure).
+ */
+nopoll_bool        nopoll_conn_set_latency_tracking (noPollConn * conn, nopoll_bool enable)
+{
+	if (conn == NULL)
+		return nopoll_false;
+
+	if (! enable) {
+		nopoll_free (conn->latency);
+		conn->latency = NULL;
+		return nopoll_true;
+	} /* end if */
+
+	if (conn->latency == NULL)
+		conn->latency = nopoll_new (noPollHistogram, NOPOLL_LATENCY_MAX);
+	return conn->latency != NULL;
+}
+
+/**
+ * @brief Gets the histogram of the latency requested recorded by the
+ * provided connection (see \ref nopoll_conn_set_latency_tracking).
+ * \ref NOPOLL_LATENCY_LOOP is only reported by \ref
+ * nopoll_ctx_get_latency.
+ *
+ * @param conn The connection to check.
+ *
+ * @param which The latency requested.
+ *
+ * @param hist Reference where the histogram is copied (empty if
+ * nothing was recorded or the connection doesn't track its
+ * latencies).
+ *
+ * @return nopoll_true if the histogram was copied, otherwise
+ * nopoll_false is returned (wrong parameters).
+ */
+nopoll_bool        nopoll_conn_get_latency (noPollConn * conn, noPollLatency which, noPollHistogram * hist)
+{
+	if (conn == NULL || hist == NULL || which < 0 || which >= NOPOLL_LATENCY_MAX)
+		return nopoll_false;
+
+	nopoll_histogram_reset (hist);
+	if (conn->latency)
+		nopoll_histogram_merge (hist, &conn->latency[which]);
+
+	return nopoll_true;
+}
+
 /** 
  * @brief Allows to configure an on message handler on the provided
  * connection that overrides the one configured at \ref noPollCtx.
@@ -4439,6 +6428,44 @@ void          nopoll_conn_set_on_msg (noPollConn              * conn,
 	return;
 }
 
+/**
+ * @brief Allows to stream messages received on the provided
+ * connection: instead of reading each frame completely (which
+ * requires allocating its full payload) the content is read in
+ * pieces no bigger than \ref NOPOLL_MSG_CHUNK_SIZE that are notified
+ * to the handler as they arrive, so messages of any size are
+ * received with bounded memory.
+ *
+ * The handler is called by \ref nopoll_loop_wait (instead of the
+ * handler configured with \ref nopoll_conn_set_on_msg) for text and
+ * binary messages. Applications calling \ref nopoll_conn_get_msg
+ * directly on a streaming connection receive those pieces as
+ * messages (check \ref nopoll_msg_is_final).
+ *
+ * Keep in mind the frame size limit (see \ref
+ * nopoll_ctx_set_max_frame_size) is still checked.
+ *
+ * @param conn The connection to configure.
+ *
+ * @param on_msg_chunk The handler called with each piece of message
+ * received (it overrides the one configured with \ref
+ * nopoll_ctx_set_on_msg_chunk). Use NULL to disable streaming.
+ *
+ * @param user_data User defined pointer to be passed in into the handler when it is called.
+ */
+void          nopoll_conn_set_on_msg_chunk (noPollConn                  * conn,
+					    noPollOnMessageChunkHandler   on_msg_chunk,
+					    noPollPtr                     user_data)
+{
+	if (conn == NULL)
+		return;
+
+	conn->on_msg_chunk      = on_msg_chunk;
+	conn->on_msg_chunk_data = user_data;
+
+	return;
+}
+
 /** 
  * @brief Allows to configure a handler that is called when the
  * connection provided is ready to send and receive because all
@@ -4542,6 +6569,23 @@ int __nopoll_conn_complete_pending_write_reduce_header (noPollConn * conn, int b
 	return bytes_written;
 }
 
+/**
+ * @internal Accounts at the context counters (see
+ * nopoll_ctx_get_stats) the change of the bytes kept as pending
+ * write since the last call. Called each time pending_write or
+ * pending_write_bytes are updated.
+ */
+void __nopoll_conn_pending_sync (noPollConn * conn)
+{
+	int pending = conn->pending_write ? conn->pending_write_bytes : 0;
+
+	if (pending == conn->pending_write_counted)
+		return;
+	__nopoll_ctx_thread_stats (conn->ctx)->pending_write_bytes += pending - conn->pending_write_counted;
+	conn->pending_write_counted = pending;
+	return;
+}
+
 /** 
  * @brief Allows to call to complete last pending write process that may be
  * pending from a previous uncompleted write operation. The function
@@ -4571,6 +6615,9 @@ int nopoll_conn_complete_pending_write (noPollConn * conn)
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Completed pending write operation with bytes=%d", bytes_written);
 		nopoll_free (conn->pending_write);
 		conn->pending_write = NULL;
+		__nopoll_conn_pending_sync (conn);
+		if (conn->ctx->latency_tracking)
+			__nopoll_latency_record (conn, NOPOLL_LATENCY_WRITE_FLUSH, &conn->pending_write_start);
 
 		/* reduce/remove bytes written due to header */
 		return __nopoll_conn_complete_pending_write_reduce_header (conn, bytes_written);
@@ -4578,8 +6625,12 @@ int nopoll_conn_complete_pending_write (noPollConn * conn)
 
 	if (bytes_written > 0) {
 		/* bytes written but not everything */
+		conn->stats.partial_writes++;
+		__nopoll_ctx_thread_stats (conn->ctx)->partial_writes++;
 		conn->pending_write_bytes -= bytes_written;
 		conn->pending_write_desp += bytes_written;
+		__nopoll_conn_pending_sync (conn);
+		NOPOLL_PROBE3 (partial_write, conn->id, bytes_written, conn->pending_write_bytes);
 
 		/* reduce/remove bytes written due to header */
 		return __nopoll_conn_complete_pending_write_reduce_header (conn, bytes_written);
@@ -4703,6 +6754,8 @@ int nopoll_conn_flush_writes (noPollConn * conn, long timeout, int previous_resu
  * include a pause (in microseconds) between sending the header and
  * the rest of the content. Use 0 to disable it.
  *
+ * @param flags Send flags (see \ref noPollSendFlags).
+ *
  * @return The function returns the number of bytes sent, being \p length the
  * max amount of bytes that can be reported as sent by
  * this function. This means value reported by this function do not
@@ -4714,9 +6767,9 @@ int nopoll_conn_flush_writes (noPollConn * conn, long timeout, int previous_resu
  *  -2 : retry operation needed (NOPOLL_EWOULDBLOCK)
  *
  */
-int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool masked,
-			    noPollOpCode op_code, long length, noPollPtr content, long sleep_in_header)
-
+int __nopoll_conn_send_frame_flags (noPollConn * conn, nopoll_bool fin, nopoll_bool masked,
+				    noPollOpCode op_code, long length, noPollPtr content, long sleep_in_header,
+				    int flags)
 {
 	char               header[14];
 	int                header_size;
@@ -4727,10 +6780,19 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	unsigned int       mask_value = 0;
 	int                desp = 0;
 	int                tries;
+	int                compressed;
+	char             * deflated;
+	long               deflated_size;
+	long               user_length = length;
+	struct timeval     send_start;
+	noPollStats      * ctx_stats;
 #if defined(SHOW_DEBUG_LOG)
 	noPollDebugLevel   level;
 #endif
 
+	/* content sent before the connection is dialed waits for it */
+	__nopoll_conn_dial_wait (conn);
+
 	/* check for pending send operation */
 	bytes_written = nopoll_conn_complete_pending_write (conn);
 	if (bytes_written < 0)
@@ -4742,6 +6804,19 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	/* set header codes */
 	if (fin) 
 		nopoll_set_bit (header, 7);
+
+	/* compress data frames when permessage-deflate was
+	 * negotiated: from here, length and content refer to the
+	 * compressed content (RSV1 is only set on the first frame) */
+	compressed = __nopoll_deflate_compress (conn, fin, op_code, (const char *) content, length, flags, &deflated, &deflated_size);
+	if (compressed < 0)
+		return -1;
+	if (compressed) {
+		if (op_code != NOPOLL_CONTINUATION_FRAME)
+			nopoll_set_bit (header, 6);
+		content = deflated;
+		length  = deflated_size;
+	} /* end if */
 	
 	if (masked) {
 		nopoll_set_bit (header + 1, 7);
@@ -4791,6 +6866,8 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 		header[9] = (length & 0x00000000000000FF);
 	} else {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to send the requested message, this requested is bigger than the value that can be supported by this platform");
+		if (compressed)
+			__nopoll_deflate_scratch_release (conn);
 		return -1;
 	}
 
@@ -4804,6 +6881,8 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	send_buffer = nopoll_new (char, length + header_size + 2);
 	if (send_buffer == NULL) {
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to allocate memory to implement send operation");
+		if (compressed)
+			__nopoll_deflate_scratch_release (conn);
 		return -1;
 	} /* end if */
 	
@@ -4820,6 +6899,10 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 		}
 	} /* end if */
 
+	/* compressed content was already copied */
+	if (compressed)
+		__nopoll_deflate_scratch_release (conn);
+
 	
 	/* send content */
 	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Mask used for this delivery: %u (masked? %d, about to send %d bytes)",
@@ -4829,6 +6912,10 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	desp  = 0;
 	tries = 0;
 
+	/* time the write when latency tracking is enabled */
+	if (conn->ctx->latency_tracking)
+		__nopoll_latency_now (&send_start);
+
 	/***** BEGIN INTERNAL debug code for test_30, test_31, test_32, test_33, test_34, test_35 : nopoll-regression-client.c ******/
 	if ((conn->__force_stop_after_header > 0) && (conn->__force_stop_after_header < (length + header_size))) {
 		
@@ -4911,6 +6998,14 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 			break;
 		} /* end if */
 
+		/* a short write that made progress (errno untouched,
+		 * which is what SSL_MODE_ENABLE_PARTIAL_WRITE and the
+		 * kernel report) is retried right away: the next call
+		 * either completes or reports NOPOLL_EWOULDBLOCK and
+		 * the rest is kept as pending write */
+		if (bytes_written > 0)
+			continue;
+
 		/* wait a bit */
 		nopoll_sleep (100000);
 
@@ -4919,6 +7014,21 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	/* record pending write bytes */
 	conn->pending_write_bytes = length + header_size - desp;
 
+	/* account the frame: whatever was not written is kept as
+	 * pending write and flushed later */
+	conn->stats.frames_out[op_code & 0x0f]++;
+	conn->stats.bytes_out[op_code & 0x0f] += length;
+	ctx_stats = __nopoll_ctx_thread_stats (conn->ctx);
+	ctx_stats->frames_out[op_code & 0x0f]++;
+	ctx_stats->bytes_out[op_code & 0x0f] += length;
+	NOPOLL_PROBE4 (frame_sent, conn->id, op_code, length, desp);
+	if (conn->ctx->latency_tracking) {
+		if (conn->pending_write_bytes > 0)
+			conn->pending_write_start = send_start;
+		else
+			__nopoll_latency_record (conn, NOPOLL_LATENCY_WRITE_FLUSH, &send_start);
+	} /* end if */
+
 	/* record the header to be accurate when reporting the amount
 	   of bytes written: we have to avoid confusing two things:
 
@@ -4961,8 +7071,12 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 
 	/* check pending bytes for the next operation */
 	if (conn->pending_write_bytes > 0) {
+		conn->stats.partial_writes++;
+		ctx_stats->partial_writes++;
+		NOPOLL_PROBE3 (partial_write, conn->id, desp, conn->pending_write_bytes);
 		conn->pending_write = send_buffer;
 		conn->pending_write_desp = desp;
+		__nopoll_conn_pending_sync (conn);
 		nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Stored %d bytes starting from %d out of %ld bytes (header size: %d)", 
 			    conn->pending_write_bytes, desp, length + header_size, header_size);
 	} else {
@@ -4970,9 +7084,21 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 		nopoll_free (send_buffer);
 	} /* end if */
 
+	/* compressed frames can't be sent again by the caller (the
+	 * content was already fed to the compression stream): the
+	 * whole content is reported as taken while the compressed
+	 * remainder is kept as pending write (0 on write errors) */
+	if (compressed) {
+		if (bytes_sent > 0 || conn->pending_write_bytes == 0 || errno == NOPOLL_EWOULDBLOCK)
+			return user_length;
+		return 0;
+	} /* end if */
+
 	/* if no byte was sent and errno is set to non-blocking error
-	   operation that indicates a retry, report -2 */
-	if (bytes_sent == 0 && errno == NOPOLL_EWOULDBLOCK) 
+	   operation that indicates a retry, report -2 (frames without
+	   payload completely written report 0 whatever errno was
+	   left by previous operations) */
+	if (bytes_sent == 0 && conn->pending_write_bytes > 0 && errno == NOPOLL_EWOULDBLOCK) 
 	        return -2;
 
 	/* report what was written (which can be everything, part,
@@ -4980,6 +7106,34 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 	return bytes_sent;
 }
 
+/**
+ * @internal Function used to send a frame over the provided
+ * connection (see __nopoll_conn_send_frame_flags).
+ *
+ * @param conn The connection where the send operation will happen.
+ *
+ * @param fin If the frame to be sent must be flagged as a fin frame.
+ *
+ * @param masked The frame to be sent is masked or not.
+ *
+ * @param op_code The frame op code to be configured.
+ *
+ * @param length The frame payload length.
+ *
+ * @param content Pointer to the data to be sent in the frame.
+ *
+ * @param sleep_in_header Optional hacking option that allows to
+ * include a pause (in microseconds) between sending the header and
+ * the rest of the content. Use 0 to disable it.
+ *
+ * @return See __nopoll_conn_send_frame_flags.
+ */
+int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool masked,
+			    noPollOpCode op_code, long length, noPollPtr content, long sleep_in_header)
+{
+	return __nopoll_conn_send_frame_flags (conn, fin, masked, op_code, length, content, sleep_in_header, NOPOLL_SEND_DEFAULT);
+}
+
 /** 
  * @brief Allows to accept a new incoming WebSocket connection on the
  * provided listener.
@@ -5055,6 +7209,54 @@ noPollConn * nopoll_conn_accept_socket (noPollCtx * ctx, noPollConn * listener,
 	return conn;
 }
 
+/**
+ * @internal Loads the certificate, private key and optional chain
+ * files provided on the SSL_CTX of an incoming TLS connection.
+ *
+ * @return nopoll_true if the key material was configured, otherwise
+ * nopoll_false (failure is logged).
+ */
+nopoll_bool __nopoll_conn_load_certificate (noPollCtx  * ctx,
+					    noPollConn * conn,
+					    const char * certificateFile,
+					    const char * privateKey,
+					    const char * chainCertificate)
+{
+	/* configure chain certificate */
+	if (chainCertificate) {
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Setting up chain certificate: %s", chainCertificate);
+		if (SSL_CTX_use_certificate_chain_file (conn->ssl_ctx, chainCertificate) != 1) {
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to configure chain certificate (%s), SSL_CTX_use_certificate_chain_file () failed", chainCertificate);
+			return nopoll_false;
+		} /* end if */
+	} /* end if */
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Using certificate file: %s (with ssl context ref: %p)", certificateFile, conn->ssl_ctx);
+	if (SSL_CTX_use_certificate_chain_file (conn->ssl_ctx, certificateFile) != 1) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "there was an error while setting certificate file into the SSL context, unable to start TLS profile. Failure found at SSL_CTX_use_certificate_chain_file function. Tried certificate file: %s", 
+			    certificateFile);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Using certificate key: %s", privateKey);
+	if (SSL_CTX_use_PrivateKey_file (conn->ssl_ctx, privateKey, SSL_FILETYPE_PEM) != 1) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, 
+			    "there was an error while setting private file into the SSL context, unable to start TLS profile. Failure found at SSL_CTX_use_PrivateKey_file function. Tried private file: %s", 
+			    privateKey);
+		return nopoll_false;
+	} /* end if */
+
+	/* check for private key and certificate file to match. */
+	if (! SSL_CTX_check_private_key (conn->ssl_ctx)) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, 
+			    "seems that certificate file and private key doesn't match!, unable to start TLS profile. Failure found at SSL_CTX_check_private_key function. Used certificate %s, and key: %s",
+			    certificateFile, privateKey);
+		return nopoll_false;
+	} /* end if */
+
+	return nopoll_true;
+}
+
 /**
  * @internal Function to support accept listener operations.
  *
@@ -5075,6 +7277,9 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 	const char          * privateKey       = NULL;
 	const char          * chainCertificate = NULL;
 	const char          * serverName       = NULL;
+	int                   source           = 1;
+	int                   generation       = 0;
+	nopoll_bool           preloaded        = nopoll_false;
 
 	/* check input parameters */
 	if (! (ctx && listener && conn && session != NOPOLL_INVALID_SOCKET)) {
@@ -5094,6 +7299,11 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 	/* record max frame size accepted for this connection (taken
 	 * from the options configured at the listener) */
 	__nopoll_conn_set_max_frame_size (conn, options);
+	__nopoll_conn_set_keepalive (conn, options);
+	__nopoll_conn_set_deflate (conn, options);
+	conn->ktls_requested = options && options->ktls;
+	__nopoll_conn_set_utf8 (conn, options);
+	__nopoll_conn_set_reassemble (conn, options);
 
 	/* now check for accept handler */
 	if (ctx->on_accept) {
@@ -5119,10 +7329,26 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 		 * session */
 		conn->tls_on = nopoll_true;
 
+		/* reuse the SSL_CTX prepared for previous connections
+		 * accepted by this listener while it is still valid
+		 * (the certificates it was built with were not
+		 * reloaded). It is not shared when the application
+		 * creates SSL contexts (see
+		 * nopoll_ctx_set_ssl_context_creator) */
+		generation = __nopoll_ctx_cert_generation (ctx);
+		if (ctx->context_creator == NULL && options == listener->opts)
+			conn->ssl_ctx = __nopoll_listener_get_accept_ctx (listener, generation);
+		if (conn->ssl_ctx) {
+			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Reusing listener SSL context (ssl context ref: %p)", conn->ssl_ctx);
+			goto accept_tls_session;
+		} /* end if */
+
 		/* NOTE: serverName is left NULL here: SNI is not yet
 		 * queried at this point, so the lookup done below
 		 * through nopoll_ctx_find_certificate () always asks
-		 * for the default certificate */
+		 * for the default certificate. Certificates installed
+		 * for a server name are selected later, during the
+		 * handshake (see __nopoll_ctx_sni_install) */
 
 		/* 1) GET FROM OPTIONS: detect here if we have
 		 * certificates provided through options */
@@ -5137,10 +7363,12 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 			/* 2) GET FROM LISTENER: get references to currently configured certificate file */
 			certificateFile = listener->certificate;
 			privateKey      = listener->private_key;
+			source          = 2;
 			if (certificateFile == NULL || privateKey == NULL) {
 				/* 3) GET FROM STORE: check if the
 				 * certificate is already installed */
 				nopoll_ctx_find_certificate (ctx, serverName, &certificateFile, &privateKey, &chainCertificate);
+				source = 3;
 			}
 		} /* end if */
 
@@ -5201,73 +7429,20 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 			goto fail_accept_tls;
 		} /* end if */
 
-		/* configure chain certificate */
-		if (chainCertificate) {
-			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Setting up chain certificate: %s", chainCertificate);
-			if (SSL_CTX_use_certificate_chain_file (conn->ssl_ctx, chainCertificate) != 1) {
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to configure chain certificate (%s), SSL_CTX_use_certificate_chain_file () failed", chainCertificate);
-
-			fail_accept_tls:
-				/* common cleanup for TLS setup failures:
-				 * shutdown, unregister and release options
-				 * like the rest of failure paths do */
-				nopoll_conn_shutdown (conn);
-				nopoll_ctx_unregister_conn (ctx, conn);
-
-				/* release connection options */
-				nopoll_conn_opts_unref (options);
-
-				return nopoll_false;
-			} /* end if */
-		} /* end if */
-
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Using certificate file: %s (with ssl context ref: %p)", certificateFile, conn->ssl_ctx);
-		if (conn->ssl_ctx == NULL || SSL_CTX_use_certificate_chain_file (conn->ssl_ctx, certificateFile) != 1) {
-			/* drop an error log */
-			if (conn->ssl_ctx == NULL)
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to accept incoming connection, failed to create SSL context. Context creator returned NULL pointer");
-			else 
-				nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "there was an error while setting certificate file into the SSL context, unable to start TLS profile. Failure found at SSL_CTX_use_certificate_chain_file function. Tried certificate file: %s", 
-					    certificateFile);
-
-			/* dump error stack */
-			nopoll_conn_shutdown (conn);
-			nopoll_ctx_unregister_conn (ctx, conn);
-
-			/* release connection options */
-			nopoll_conn_opts_unref (options);
-
-			return nopoll_false;
-		} /* end if */
-
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Using certificate key: %s", privateKey);
-		if (SSL_CTX_use_PrivateKey_file (conn->ssl_ctx, privateKey, SSL_FILETYPE_PEM) != 1) {
-			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, 
-				    "there was an error while setting private file into the SSL context, unable to start TLS profile. Failure found at SSL_CTX_use_PrivateKey_file function. Tried private file: %s", 
-				    privateKey);
-			/* dump error stack */
-			nopoll_conn_shutdown (conn);
-			nopoll_ctx_unregister_conn (ctx, conn);
-
-			/* release connection options */
-			nopoll_conn_opts_unref (options);
-
-			return nopoll_false;
-		}
-
-		/* check for private key and certificate file to match. */
-		if (! SSL_CTX_check_private_key (conn->ssl_ctx)) {
-			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, 
-				    "seems that certificate file and private key doesn't match!, unable to start TLS profile. Failure found at SSL_CTX_check_private_key function. Used certificate %s, and key: %s",
-				    certificateFile, privateKey);
-			/* dump error stack */
-			nopoll_conn_shutdown (conn);
-			nopoll_ctx_unregister_conn (ctx, conn);
-
-			/* release connection options */
-			nopoll_conn_opts_unref (options);
-
-			return nopoll_false;
+		/* use the key material preloaded for the listener or the
+		 * context certificate (no file I/O), as long as the chain
+		 * to be used is the one loaded with it. Reloads (see
+		 * nopoll_listener_reload_certificate) swap it, so
+		 * connections accepted from now on get the new one */
+		if (source == 2 && (listener->chain_certificate || ! (options && options->chain_certificate)))
+			preloaded = __nopoll_listener_use_certificate (listener, conn->ssl_ctx);
+		else if (source == 3 && listener->chain_certificate == NULL && ! (options && options->chain_certificate))
+			preloaded = __nopoll_ctx_use_certificate (ctx, conn->ssl_ctx);
+
+		if (preloaded) {
+			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Using preloaded certificate (with ssl context ref: %p)", conn->ssl_ctx);
+		} else if (! __nopoll_conn_load_certificate (ctx, conn, certificateFile, privateKey, chainCertificate)) {
+			goto fail_accept_tls;
 		} /* end if */
 
 		if (options != NULL && ! options->disable_ssl_verify) {
@@ -5281,6 +7456,16 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 		} /* end if */
 
 
+		/* route by SNI to the certificates preloaded */
+		__nopoll_ctx_sni_install (ctx, conn->ssl_ctx);
+
+		/* share it with next connections accepted, as long as
+		 * the key material is preloaded (otherwise files are
+		 * read for each connection, as before) */
+		if (preloaded && ctx->context_creator == NULL && options == listener->opts)
+			__nopoll_listener_set_accept_ctx (listener, conn->ssl_ctx, generation);
+
+	accept_tls_session:
 		/* create SSL context */
 		conn->ssl = SSL_new (conn->ssl_ctx);       
 		if (conn->ssl == NULL) {
@@ -5296,10 +7481,11 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 
 		/* set the file descriptor */
 		SSL_set_fd (conn->ssl, conn->session);
+		__nopoll_conn_ssl_prepare (conn);
 
 		/* don't complete here the operation but flag it as
 		 * pending */
-		conn->pending_ssl_accept = nopoll_true;
+		__nopoll_conn_tls_handshake_start (conn, nopoll_false);
 		nopoll_conn_set_sock_block (conn->session, nopoll_false);
 
 		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Prepared TLS session to be activated on next reads (conn id %d)", conn->id);
@@ -5310,6 +7496,17 @@ nopoll_bool __nopoll_conn_accept_complete_common (noPollCtx * ctx, noPollConnOpt
 	nopoll_conn_opts_unref (options);
 
 	return nopoll_true;
+
+ fail_accept_tls:
+	/* common cleanup for TLS setup failures: shutdown, unregister
+	 * and release options like the rest of failure paths do */
+	nopoll_conn_shutdown (conn);
+	nopoll_ctx_unregister_conn (ctx, conn);
+
+	/* release connection options */
+	nopoll_conn_opts_unref (options);
+
+	return nopoll_false;
 }
 
 /** 
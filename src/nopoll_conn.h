@@ -136,6 +136,8 @@ nopoll_bool    nopoll_conn_is_ready (noPollConn * conn);
 
 nopoll_bool    nopoll_conn_is_tls_on (noPollConn * conn);
 
+int            nopoll_conn_get_ktls (noPollConn * conn);
+
 NOPOLL_SOCKET nopoll_conn_socket (noPollConn * conn);
 
 void           nopoll_conn_set_socket (noPollConn * conn, NOPOLL_SOCKET _socket);
@@ -191,6 +193,15 @@ int           nopoll_conn_send_binary (noPollConn * conn, const char * content,
 
 int           nopoll_conn_send_binary_fragment (noPollConn * conn, const char * content, long length);
 
+int           nopoll_conn_send_ext (noPollConn * conn, noPollOpCode op_code, const char * content, long length,
+				    nopoll_bool has_fin, int flags);
+
+long          nopoll_conn_send_file (noPollConn * conn, int fd, long offset, long length);
+
+void          nopoll_conn_set_tls_batching (noPollConn * conn, nopoll_bool enable);
+
+int           nopoll_conn_flush_tls_batch (noPollConn * conn);
+
 int           nopoll_conn_complete_pending_write (noPollConn * conn);
 
 int           nopoll_conn_pending_write_bytes    (noPollConn * conn);
@@ -211,6 +222,10 @@ void          nopoll_conn_set_on_msg (noPollConn              * conn,
 				      noPollOnMessageHandler    on_msg,
 				      noPollPtr                 user_data);
 
+void          nopoll_conn_set_on_msg_chunk (noPollConn                  * conn,
+					    noPollOnMessageChunkHandler   on_msg_chunk,
+					    noPollPtr                     user_data);
+
 void          nopoll_conn_set_on_ready (noPollConn            * conn,
 					noPollActionHandler     on_ready,
 					noPollPtr               user_data);
@@ -223,6 +238,10 @@ int nopoll_conn_send_frame (noPollConn * conn, nopoll_bool fin, nopoll_bool mask
 			    noPollOpCode op_code, long length, noPollPtr content,
 			    long sleep_in_header);
 
+int __nopoll_conn_send_frame_flags (noPollConn * conn, nopoll_bool fin, nopoll_bool masked,
+				    noPollOpCode op_code, long length, noPollPtr content,
+				    long sleep_in_header, int flags);
+
 int           __nopoll_conn_send_common (noPollConn * conn, 
 					 const char * content, 
 					 long         length, 
@@ -230,6 +249,14 @@ int           __nopoll_conn_send_common (noPollConn * conn,
 					 long         sleep_in_header,
 					 noPollOpCode frame_type);
 
+int           __nopoll_conn_send_common_flags (noPollConn * conn, 
+					       const char * content, 
+					       long         length, 
+					       nopoll_bool  has_fin, 
+					       long         sleep_in_header,
+					       noPollOpCode frame_type,
+					       int          flags);
+
 nopoll_bool      nopoll_conn_wait_until_connection_ready (noPollConn * conn,
 							  int          timeout);
 
@@ -242,12 +269,127 @@ const char *       nopoll_conn_get_x_real_ip_header (noPollConn * conn);
 
 long int           nopoll_conn_get_max_frame_size (noPollConn * conn);
 
+long               nopoll_conn_get_rtt (noPollConn * conn);
+
+nopoll_bool        nopoll_conn_get_stats (noPollConn * conn, noPollStats * stats);
+
+nopoll_bool        nopoll_conn_set_latency_tracking (noPollConn * conn, nopoll_bool enable);
+
+nopoll_bool        nopoll_conn_get_latency (noPollConn * conn, noPollLatency which, noPollHistogram * hist);
+
 
 /** internal api **/
 void nopoll_conn_complete_handshake (noPollConn * conn);
 
 void __nopoll_conn_set_max_frame_size (noPollConn * conn, noPollConnOpts * options);
 
+void __nopoll_conn_set_keepalive (noPollConn * conn, noPollConnOpts * options);
+
+void __nopoll_conn_set_deflate (noPollConn * conn, noPollConnOpts * options);
+
+void __nopoll_conn_set_utf8 (noPollConn * conn, noPollConnOpts * options);
+
+void __nopoll_conn_set_reassemble (noPollConn * conn, noPollConnOpts * options);
+
+noPollMsg * __nopoll_conn_reassemble (noPollConn * conn, noPollMsg * msg, long max_frame_size);
+
+long __nopoll_conn_file_producer (noPollWriter * writer, char * buffer, long size, noPollPtr user_data);
+
+void __nopoll_conn_wait_writable (noPollConn * conn, long timeout);
+
+nopoll_bool __nopoll_conn_can_sendfile (noPollConn * conn);
+
+long __nopoll_conn_sendfile (noPollConn * conn, int fd, long offset, long length);
+
+int  __nopoll_conn_ktls_receive (noPollConn * conn, char * buffer, int buffer_size);
+
+void __nopoll_conn_ssl_prepare (noPollConn * conn);
+
+nopoll_bool __nopoll_conn_load_certificate (noPollCtx  * ctx,
+					    noPollConn * conn,
+					    const char * certificateFile,
+					    const char * privateKey,
+					    const char * chainCertificate);
+
+int  __nopoll_conn_tls_write (noPollConn * conn, char * buffer, int buffer_size);
+
+int  __nopoll_conn_tls_batch_flush (noPollConn * conn);
+
+int  __nopoll_conn_tls_batch_send (noPollConn * conn, char * buffer, int buffer_size);
+
+void __nopoll_conn_ktls_activate (noPollConn * conn);
+
+int  __nopoll_conn_tls_handshake_io (noPollConn * conn, char * buffer, int buffer_size);
+
+void __nopoll_conn_tls_handshake_start (noPollConn * conn, nopoll_bool is_client);
+
+void __nopoll_conn_tls_handshake_failed (noPollConn * conn);
+
+nopoll_bool __nopoll_conn_tls_handshake_expired (noPollConn * conn);
+
+void __nopoll_conn_tls_handshake_timeout (noPollCtx * ctx, int timer_id, noPollPtr user_data);
+
+void __nopoll_conn_tls_handshake_timer_stop (noPollConn * conn);
+
+nopoll_bool __nopoll_conn_client_init_flush (noPollConn * conn);
+
+void __nopoll_conn_send_client_init (noPollConn * conn, char * content);
+
+void __nopoll_conn_pending_sync (noPollConn * conn);
+
+int  __nopoll_conn_tls_handshake (noPollConn * conn);
+
+long __nopoll_conn_elapsed_since (struct timeval * since);
+
+void __nopoll_conn_fail (noPollConn * conn, int status, const char * reason);
+
+void __nopoll_conn_add_extensions (noPollConn * conn, char * value);
+
+void __nopoll_conn_keepalive_start (noPollConn * conn);
+
+void __nopoll_conn_keepalive_stop (noPollConn * conn);
+
+void __nopoll_conn_keepalive_activity (noPollConn * conn, nopoll_bool is_pong);
+
+NOPOLL_SOCKET __nopoll_conn_sock_connect_opts_internal (noPollCtx       * ctx,
+							noPollTransport   transport,
+							const char      * host,
+							const char      * port,
+							noPollConnOpts  * options);
+
+void __nopoll_conn_dial_free (noPollConnDial * dial);
+
+void __nopoll_conn_dial_run (noPollPtr data, nopoll_bool cancelled);
+
+noPollConnDial * __nopoll_conn_dial_start (noPollCtx       * ctx,
+					   noPollTransport   transport,
+					   const char      * host,
+					   const char      * port,
+					   noPollConnOpts  * options,
+					   nopoll_bool       run_inline);
+
+void __nopoll_conn_dial_release (noPollConnDial * dial);
+
+void __nopoll_conn_dial_stop (noPollConn * conn);
+
+void __nopoll_conn_connected (noPollConn * conn);
+
+nopoll_bool __nopoll_conn_dial_check (noPollConn * conn);
+
+void __nopoll_conn_dial_wait (noPollConn * conn);
+
+noPollConn * __nopoll_conn_new_common (noPollCtx       * ctx,
+				       noPollConnOpts  * options,
+				       noPollTransport   transport,
+				       nopoll_bool       enable_tls,
+				       int               socket,
+				       const char      * host_ip,
+				       const char      * host_port,
+				       const char      * host_name,
+				       const char      * get_url,
+				       const char      * protocols,
+				       const char      * origin);
+
 int nopoll_conn_default_receive (noPollConn * conn, char * buffer, int buffer_size);
 
 int nopoll_conn_default_send (noPollConn * conn, char * buffer, int buffer_size);
@@ -206,6 +206,34 @@ void nopoll_conn_opts_ssl_peer_verify (noPollConnOpts * opts, nopoll_bool verify
 	return;
 }
 
+/**
+ * @brief Allows to request kernel TLS (kTLS) offload for TLS
+ * connections created (or accepted, when used with \ref
+ * nopoll_listener_tls_new_opts) with these options.
+ *
+ * Once the TLS handshake finishes, if OpenSSL managed to move the
+ * symmetric crypto into the kernel, the connection sends (and/or
+ * receives) with plain send/recv over the socket, avoiding the
+ * user space copy and encryption done by SSL_write/SSL_read. This
+ * also enables the sendfile path of \ref nopoll_conn_send_file.
+ *
+ * It requires OpenSSL 3 built with kTLS support and a kernel with
+ * the tls module loaded; otherwise the connection keeps working
+ * through OpenSSL as usual. Use \ref nopoll_conn_get_ktls to check
+ * the result.
+ *
+ * @param opts The connection option to configure.
+ *
+ * @param enable nopoll_true to request kTLS (disabled by default).
+ */
+void nopoll_conn_opts_set_ktls (noPollConnOpts * opts, nopoll_bool enable)
+{
+	if (opts == NULL)
+		return;
+	opts->ktls = enable;
+	return;
+}
+
 /** 
  * @brief Allows to set Cookie header content to be sent during the
  * connection handshake. If configured and the remote side server is a
@@ -459,6 +487,216 @@ void nopoll_conn_opts_set_max_frame_size (noPollConnOpts * opts, long int max_fr
 	return;
 }
 
+/**
+ * @brief Allows to enable dual stack connect (RFC 8305, "happy
+ * eyeballs") for client connections created with these options.
+ *
+ * When enabled, every IPv6 and IPv4 address found for the host is
+ * considered (ignoring the transport implied by the function used,
+ * for example \ref nopoll_conn_new or \ref nopoll_conn_new6) and
+ * connection attempts are started against them, alternating
+ * families and starting with IPv6, every \ref
+ * NOPOLL_HAPPY_EYEBALLS_DELAY microseconds while previous ones are
+ * still in progress. The first attempt that completes is used and
+ * the rest are discarded, so a broken family (or address) does not
+ * delay the connection more than that delay.
+ *
+ * Both families are resolved at the same time and attempts start as
+ * soon as addresses arrive (IPv4 ones wait \ref
+ * NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY for IPv6 ones), so a slow
+ * AAAA lookup does not delay the IPv4 fallback either. The race runs
+ * on a worker thread: the connection is reported right away, while
+ * it is still dialing (see \ref nopoll_conn_is_ready).
+ *
+ * @param opts The connection options object.
+ *
+ * @param enable nopoll_true to enable dual stack connect, nopoll_false to disable it (default).
+ */
+void nopoll_conn_opts_set_happy_eyeballs (noPollConnOpts * opts, nopoll_bool enable)
+{
+	if (opts == NULL)
+		return;
+
+	opts->happy_eyeballs = enable;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure keepalive pings for connections created
+ * (or accepted, when used on a listener) with these options,
+ * overriding the context configuration (see \ref
+ * nopoll_ctx_set_keepalive, where parameters are explained).
+ *
+ * @param opts The connection options object.
+ *
+ * @param ping_interval Time (microseconds) between keepalive checks. Use 0 to disable keepalive for these connections.
+ *
+ * @param pong_timeout Time (microseconds) to wait for the PONG reply.
+ *
+ * @param idle_threshold Time (microseconds) without receiving anything before a PING is sent.
+ */
+void nopoll_conn_opts_set_keepalive (noPollConnOpts * opts, long ping_interval, long pong_timeout, long idle_threshold)
+{
+	if (opts == NULL)
+		return;
+
+	opts->keepalive_set          = nopoll_true;
+	opts->keepalive_interval     = ping_interval;
+	opts->keepalive_pong_timeout = pong_timeout;
+	opts->keepalive_idle         = idle_threshold;
+
+	return;
+}
+
+/**
+ * @brief Allows to enable permessage-deflate (RFC 7692) on connections
+ * created (or accepted, when used on a listener) with these options.
+ *
+ * Clients include the offer in the handshake and servers accept the
+ * first valid offer received. Once negotiated, text and binary
+ * messages are compressed when sent and inflated when received
+ * (check it with \ref nopoll_conn_is_permessage_deflate). Compression
+ * streams are taken from a pool kept by the context, so they are
+ * reused across connections instead of being allocated for each one.
+ * Compressed output goes to scratch buffers kept by the context too:
+ * up to \ref NOPOLL_DEFLATE_SCRATCH_BUFFERS threads can send at the
+ * same time without allocating, beyond that each send allocates a
+ * buffer big enough for the whole compressed message.
+ *
+ * Compressed messages can't be sent again once handed to the
+ * compression stream, so send operations report the whole content as
+ * written even when the socket only took part of it: the rest is kept
+ * as pending write (see \ref nopoll_conn_pending_write_bytes), and
+ * completing it (see \ref nopoll_conn_complete_pending_write) reports
+ * bytes of compressed content.
+ *
+ * The function does nothing if noPoll was built without zlib (see
+ * NOPOLL_HAVE_ZLIB at nopoll_config.h).
+ *
+ * @param opts The connection options object.
+ *
+ * @param enable nopoll_true to enable permessage-deflate, nopoll_false to disable it (default).
+ */
+void nopoll_conn_opts_set_permessage_deflate (noPollConnOpts * opts, nopoll_bool enable)
+{
+	if (opts == NULL)
+		return;
+
+	opts->deflate_enabled = enable;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure permessage-deflate parameters (RFC 7692,
+ * section 7.1) requested by connections created (or accepted) with
+ * these options. It also enables permessage-deflate (see \ref
+ * nopoll_conn_opts_set_permessage_deflate).
+ *
+ * Clients include these parameters in their offer. Servers apply
+ * them on top of what each client offers (a parameter requested by
+ * either side is used).
+ *
+ * @param opts The connection options object.
+ *
+ * @param server_no_context_takeover The server compressor resets its state after each message.
+ *
+ * @param client_no_context_takeover The client compressor resets its state after each message.
+ *
+ * @param server_max_window_bits Window size (9..15) used by the server compressor. Use 0 for the default (15).
+ *
+ * @param client_max_window_bits Window size (9..15) used by the client compressor. Use 0 for the default (15).
+ */
+void nopoll_conn_opts_set_permessage_deflate_params (noPollConnOpts * opts,
+						     nopoll_bool      server_no_context_takeover,
+						     nopoll_bool      client_no_context_takeover,
+						     int              server_max_window_bits,
+						     int              client_max_window_bits)
+{
+	if (opts == NULL)
+		return;
+
+	/* window sizes outside the range supported are ignored */
+	if (server_max_window_bits < 9 || server_max_window_bits > 15)
+		server_max_window_bits = 0;
+	if (client_max_window_bits < 9 || client_max_window_bits > 15)
+		client_max_window_bits = 0;
+
+	opts->deflate_enabled                    = nopoll_true;
+	opts->deflate_server_no_context_takeover = server_no_context_takeover;
+	opts->deflate_client_no_context_takeover = client_no_context_takeover;
+	opts->deflate_server_max_window_bits     = server_max_window_bits;
+	opts->deflate_client_max_window_bits     = client_max_window_bits;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the minimum size of the messages
+ * compressed by permessage-deflate connections created (or accepted)
+ * with these options, overriding the context configuration (see \ref
+ * nopoll_ctx_set_deflate_threshold).
+ *
+ * @param opts The connection options object.
+ *
+ * @param min_size Minimum size (bytes) to compress. Use 0 to compress every message.
+ */
+void nopoll_conn_opts_set_permessage_deflate_threshold (noPollConnOpts * opts, long min_size)
+{
+	if (opts == NULL)
+		return;
+
+	opts->deflate_threshold_set = nopoll_true;
+	opts->deflate_threshold     = min_size > 0 ? min_size : 0;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure UTF-8 validation of text messages on
+ * connections created (or accepted) with these options, overriding
+ * the context configuration (see \ref nopoll_ctx_set_utf8_validation).
+ *
+ * @param opts The connection options object.
+ *
+ * @param on_receive nopoll_true to validate text messages received.
+ *
+ * @param on_send nopoll_true to validate text messages sent.
+ */
+void nopoll_conn_opts_set_utf8_validation (noPollConnOpts * opts, nopoll_bool on_receive, nopoll_bool on_send)
+{
+	if (opts == NULL)
+		return;
+
+	opts->utf8_set = nopoll_true;
+	opts->utf8_rx  = on_receive;
+	opts->utf8_tx  = on_send;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure whether connections created (or
+ * accepted) with these options deliver only complete messages,
+ * overriding the context configuration (see \ref
+ * nopoll_ctx_set_reassemble_messages).
+ *
+ * @param opts The connection options object.
+ *
+ * @param enable nopoll_true to deliver complete messages only.
+ */
+void nopoll_conn_opts_set_reassemble_messages (noPollConnOpts * opts, nopoll_bool enable)
+{
+	if (opts == NULL)
+		return;
+
+	opts->reassemble_set = nopoll_true;
+	opts->reassemble     = enable;
+
+	return;
+}
+
 /**
  * @internal Drops one reference from the options object provided,
  * releasing it (and everything it holds) when the last reference is
@@ -54,6 +54,8 @@ nopoll_bool  nopoll_conn_opts_set_ssl_certs    (noPollConnOpts * opts,
 
 void        nopoll_conn_opts_ssl_peer_verify (noPollConnOpts * opts, nopoll_bool verify);
 
+void        nopoll_conn_opts_set_ktls (noPollConnOpts * opts, nopoll_bool enable);
+
 void        nopoll_conn_opts_set_cookie (noPollConnOpts * opts, const char * cookie_content);
 
 void        nopoll_conn_opts_skip_origin_check (noPollConnOpts * opts, nopoll_bool skip_check);
@@ -72,6 +74,24 @@ void nopoll_conn_opts_set_extra_headers (noPollConnOpts * opts, const char * ext
 
 void nopoll_conn_opts_set_max_frame_size (noPollConnOpts * opts, long int max_frame_size);
 
+void nopoll_conn_opts_set_happy_eyeballs (noPollConnOpts * opts, nopoll_bool enable);
+
+void nopoll_conn_opts_set_keepalive (noPollConnOpts * opts, long ping_interval, long pong_timeout, long idle_threshold);
+
+void nopoll_conn_opts_set_permessage_deflate (noPollConnOpts * opts, nopoll_bool enable);
+
+void nopoll_conn_opts_set_permessage_deflate_params (noPollConnOpts * opts,
+						     nopoll_bool      server_no_context_takeover,
+						     nopoll_bool      client_no_context_takeover,
+						     int              server_max_window_bits,
+						     int              client_max_window_bits);
+
+void nopoll_conn_opts_set_permessage_deflate_threshold (noPollConnOpts * opts, long min_size);
+
+void nopoll_conn_opts_set_utf8_validation (noPollConnOpts * opts, nopoll_bool on_receive, nopoll_bool on_send);
+
+void nopoll_conn_opts_set_reassemble_messages (noPollConnOpts * opts, nopoll_bool enable);
+
 void nopoll_conn_opts_free (noPollConnOpts * opts);
 
 /** internal API **/
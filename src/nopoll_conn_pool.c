@@ -0,0 +1,712 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_conn_pool.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_conn_pool noPoll Connection Pool: keep warm client connections ready to be used
+ */
+
+/** 
+ * \addtogroup nopoll_conn_pool
+ * @{
+ */
+
+/**
+ * @internal Starts dialing a new connection for the pool provided.
+ * Name resolution and the connect are done by a worker (see
+ * __nopoll_conn_dial_start) so the loop never waits for them, or by
+ * the caller on platforms without workers. The caller must hold
+ * pool->mutex.
+ */
+void __nopoll_conn_pool_dial (noPollConnPool * pool)
+{
+	noPollConnDial * dial;
+
+	dial = __nopoll_conn_dial_start (pool->ctx, pool->transport, pool->host_ip, pool->host_port, pool->opts, nopoll_true);
+	if (dial == NULL)
+		return;
+
+	dial->next  = pool->dials;
+	pool->dials = dial;
+	return;
+}
+
+/**
+ * @internal Creates a client connection for the pool provided over
+ * the socket received (or connecting right away when
+ * NOPOLL_INVALID_SOCKET is received). The connection may not be ready
+ * when returned.
+ */
+noPollConn * __nopoll_conn_pool_connect (noPollConnPool * pool, NOPOLL_SOCKET session)
+{
+	noPollConn * conn;
+
+	/* acquire a reference for the connection being created: the
+	 * options are consumed by __nopoll_conn_new_common () unless
+	 * they are flagged for reuse */
+	if (pool->opts && ! pool->opts->reuse)
+		nopoll_conn_opts_ref (pool->opts);
+
+	conn = __nopoll_conn_new_common (pool->ctx, pool->opts, pool->transport, pool->enable_tls,
+					 session,
+					 pool->host_ip, pool->host_port, pool->host_name,
+					 pool->get_url, pool->protocols, pool->origin);
+	if (conn == NULL) {
+		nopoll_log (pool->ctx, NOPOLL_LEVEL_WARNING, "Connection pool failed to connect to %s:%s, retrying in %d seconds",
+			    pool->host_ip, pool->host_port, NOPOLL_CONN_POOL_RETRY_PERIOD);
+		pool->next_retry = (long) time (NULL) + NOPOLL_CONN_POOL_RETRY_PERIOD;
+		return NULL;
+	} /* end if */
+
+	nopoll_log (pool->ctx, NOPOLL_LEVEL_DEBUG, "Connection pool dialed conn-id=%d to %s:%s", conn->id, pool->host_ip, pool->host_port);
+	return conn;
+}
+
+/**
+ * @internal Returns an empty slot of the pool (dropping connections
+ * that are no longer working) or -1 if the pool is full. The caller
+ * must hold pool->mutex.
+ */
+int __nopoll_conn_pool_slot (noPollConnPool * pool)
+{
+	int iterator;
+
+	for (iterator = 0; iterator < pool->size; iterator++) {
+		if (pool->conns[iterator] && ! nopoll_conn_is_ok (pool->conns[iterator])) {
+			nopoll_log (pool->ctx, NOPOLL_LEVEL_DEBUG, "Connection pool dropping closed conn-id=%d", pool->conns[iterator]->id);
+			nopoll_conn_close (pool->conns[iterator]);
+			pool->conns[iterator] = NULL;
+		} /* end if */
+
+		if (pool->conns[iterator] == NULL)
+			return iterator;
+	} /* end for */
+
+	return -1;
+}
+
+/**
+ * @internal Takes the sockets dialed by workers, creating the pool
+ * connections over them (their TLS and WebSocket handshakes are then
+ * driven by the loop). The caller must hold pool->mutex.
+ *
+ * @return Number of dials still in progress.
+ */
+int __nopoll_conn_pool_collect (noPollConnPool * pool)
+{
+	noPollConnDial    ** previous = &(pool->dials);
+	noPollConnDial     * dial;
+	NOPOLL_SOCKET        session;
+	nopoll_bool          done;
+	int                  pending  = 0;
+	int                  slot;
+
+	while (*previous) {
+		dial = *previous;
+		nopoll_mutex_lock (pool->ctx->ref_mutex);
+		done = dial->done;
+		nopoll_mutex_unlock (pool->ctx->ref_mutex);
+		if (! done) {
+			pending++;
+			previous = &(dial->next);
+			continue;
+		} /* end if */
+
+		*previous = dial->next;
+		session   = dial->session;
+		__nopoll_conn_dial_free (dial);
+
+		if (session == NOPOLL_INVALID_SOCKET) {
+			nopoll_log (pool->ctx, NOPOLL_LEVEL_WARNING, "Connection pool failed to connect to %s:%s, retrying in %d seconds",
+				    pool->host_ip, pool->host_port, NOPOLL_CONN_POOL_RETRY_PERIOD);
+			pool->next_retry = (long) time (NULL) + NOPOLL_CONN_POOL_RETRY_PERIOD;
+			continue;
+		} /* end if */
+
+		/* no room (connections given back meanwhile) */
+		slot = __nopoll_conn_pool_slot (pool);
+		if (slot == -1) {
+			nopoll_close_socket (session);
+			continue;
+		} /* end if */
+		pool->conns[slot] = __nopoll_conn_pool_connect (pool, session);
+	} /* end while */
+
+	return pending;
+}
+
+/**
+ * @internal Refills the pool provided, keeping at most
+ * pool->max_dials connections dialing or doing their handshakes. The
+ * caller must hold pool->mutex.
+ */
+void __nopoll_conn_pool_refill_common (noPollConnPool * pool)
+{
+	int iterator;
+	int pending;
+	int in_flight;
+	int empty = 0;
+
+	pending   = __nopoll_conn_pool_collect (pool);
+	in_flight = pending;
+
+	for (iterator = 0; iterator < pool->size; iterator++) {
+		/* drop connections that are no longer working */
+		if (pool->conns[iterator] && ! nopoll_conn_is_ok (pool->conns[iterator])) {
+			nopoll_log (pool->ctx, NOPOLL_LEVEL_DEBUG, "Connection pool dropping closed conn-id=%d", pool->conns[iterator]->id);
+			nopoll_conn_close (pool->conns[iterator]);
+			pool->conns[iterator] = NULL;
+		} /* end if */
+
+		if (pool->conns[iterator] == NULL)
+			empty++;
+		else if (! nopoll_conn_is_ready (pool->conns[iterator]))
+			in_flight++;
+	} /* end for */
+
+	/* empty slots already being dialed */
+	empty -= pending;
+
+	while (empty > 0 && in_flight < pool->max_dials) {
+		/* do not insist with an endpoint that is failing */
+		if (pool->next_retry > (long) time (NULL))
+			return;
+
+		__nopoll_conn_pool_dial (pool);
+		empty--;
+		in_flight++;
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @brief Creates a pool of client connections that keeps \p size
+ * connections to the provided endpoint established and ready to be
+ * used (see \ref nopoll_conn_pool_get).
+ *
+ * Connections are created like \ref nopoll_conn_new_opts (or \ref
+ * nopoll_conn_tls_new when \p enable_tls is nopoll_true) does and
+ * are registered into the context, so they are watched by \ref
+ * nopoll_loop_wait. Every loop iteration replaces (dials again)
+ * connections that were closed or handed out, so a ready connection
+ * is available without paying the TCP, TLS and WebSocket handshakes
+ * when it is needed. When the loop is not used, call \ref
+ * nopoll_conn_pool_refill to do that.
+ *
+ * Name resolution and connects run on a worker thread (see \ref
+ * nopoll_ctx_set_tls_handshake_workers; a single worker is started
+ * for it when none is configured) and the handshakes are then driven
+ * by the loop, so refilling a pool never blocks it. At most \ref
+ * NOPOLL_CONN_POOL_MAX_DIALS connections are dialing at the same
+ * time (see \ref nopoll_conn_pool_set_max_dials). On platforms
+ * without worker support the resolution and connect are done by the
+ * thread refilling the pool.
+ *
+ * Connections are created over IPv4 (see \ref nopoll_conn_pool_new6).
+ *
+ * Pools are kept by the context and identified by all parameters
+ * received (options object included): asking for a pool that already
+ * exists returns it with an additional reference (keeping its
+ * current size), so every part of the application using an endpoint
+ * shares the same connections. Each reference must be released with
+ * \ref nopoll_conn_pool_unref.
+ *
+ * @param ctx The context where the pool is created.
+ *
+ * @param opts Optional connection options applied to every
+ * connection. As with the rest of the API, the object is owned (and
+ * released) by the pool unless it is flagged with \ref
+ * nopoll_conn_opts_set_reuse. Note that only options flagged for
+ * reuse (or NULL) can identify an existing pool.
+ *
+ * @param enable_tls nopoll_true to create TLS (wss://) connections.
+ *
+ * @param size Number of connections kept ready (bigger than 0).
+ *
+ * @param host_ip See \ref nopoll_conn_new
+ *
+ * @param host_port See \ref nopoll_conn_new
+ *
+ * @param host_name See \ref nopoll_conn_new
+ *
+ * @param get_url See \ref nopoll_conn_new
+ *
+ * @param protocols See \ref nopoll_conn_new
+ *
+ * @param origin See \ref nopoll_conn_new
+ *
+ * @return A reference to the pool or NULL if it fails.
+ */
+noPollConnPool * nopoll_conn_pool_new (noPollCtx       * ctx,
+				       noPollConnOpts  * opts,
+				       nopoll_bool       enable_tls,
+				       int               size,
+				       const char      * host_ip,
+				       const char      * host_port,
+				       const char      * host_name,
+				       const char      * get_url,
+				       const char      * protocols,
+				       const char      * origin)
+{
+	return __nopoll_conn_pool_new_common (ctx, opts, NOPOLL_TRANSPORT_IPV4, enable_tls, size,
+					      host_ip, host_port, host_name, get_url, protocols, origin);
+}
+
+/**
+ * @brief Creates a pool of client connections like \ref
+ * nopoll_conn_pool_new does, but connecting over IPv6.
+ *
+ * @param ctx See \ref nopoll_conn_pool_new
+ *
+ * @param opts See \ref nopoll_conn_pool_new
+ *
+ * @param enable_tls See \ref nopoll_conn_pool_new
+ *
+ * @param size See \ref nopoll_conn_pool_new
+ *
+ * @param host_ip See \ref nopoll_conn_new6
+ *
+ * @param host_port See \ref nopoll_conn_new6
+ *
+ * @param host_name See \ref nopoll_conn_new6
+ *
+ * @param get_url See \ref nopoll_conn_new6
+ *
+ * @param protocols See \ref nopoll_conn_new6
+ *
+ * @param origin See \ref nopoll_conn_new6
+ *
+ * @return A reference to the pool or NULL if it fails.
+ */
+noPollConnPool * nopoll_conn_pool_new6 (noPollCtx       * ctx,
+					noPollConnOpts  * opts,
+					nopoll_bool       enable_tls,
+					int               size,
+					const char      * host_ip,
+					const char      * host_port,
+					const char      * host_name,
+					const char      * get_url,
+					const char      * protocols,
+					const char      * origin)
+{
+	return __nopoll_conn_pool_new_common (ctx, opts, NOPOLL_TRANSPORT_IPV6, enable_tls, size,
+					      host_ip, host_port, host_name, get_url, protocols, origin);
+}
+
+/**
+ * @internal Implementation used by nopoll_conn_pool_new and
+ * nopoll_conn_pool_new6.
+ */
+noPollConnPool * __nopoll_conn_pool_new_common (noPollCtx       * ctx,
+						noPollConnOpts  * opts,
+						noPollTransport   transport,
+						nopoll_bool       enable_tls,
+						int               size,
+						const char      * host_ip,
+						const char      * host_port,
+						const char      * host_name,
+						const char      * get_url,
+						const char      * protocols,
+						const char      * origin)
+{
+	noPollConnPool * pool;
+
+	if (ctx == NULL || host_ip == NULL || size <= 0) {
+		/* release connection options */
+		__nopoll_conn_opts_release_if_needed (opts);
+		return NULL;
+	} /* end if */
+
+	/* set default connection port */
+	if (host_port == NULL)
+		host_port = "80";
+
+	/* find a pool already created for this endpoint */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	pool = ctx->conn_pools;
+	while (pool) {
+		if (pool->opts == opts && pool->transport == transport && pool->enable_tls == enable_tls &&
+		    nopoll_cmp (pool->host_ip, host_ip) && nopoll_cmp (pool->host_port, host_port) &&
+		    nopoll_cmp (pool->host_name, host_name) && nopoll_cmp (pool->get_url, get_url) &&
+		    nopoll_cmp (pool->protocols, protocols) && nopoll_cmp (pool->origin, origin)) {
+			pool->refs++;
+			nopoll_mutex_unlock (ctx->ref_mutex);
+			return pool;
+		} /* end if */
+		pool = pool->next;
+	} /* end while */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	pool = nopoll_new (noPollConnPool, 1);
+	if (pool == NULL) {
+		/* release connection options */
+		__nopoll_conn_opts_release_if_needed (opts);
+		return NULL;
+	} /* end if */
+
+	pool->conns = nopoll_new (noPollConn *, size);
+	if (pool->conns == NULL) {
+		nopoll_free (pool);
+		/* release connection options */
+		__nopoll_conn_opts_release_if_needed (opts);
+		return NULL;
+	} /* end if */
+
+	pool->ctx        = ctx;
+	pool->refs       = 1;
+	pool->size       = size;
+	pool->opts       = opts;
+	pool->transport  = transport;
+	pool->enable_tls = enable_tls;
+	pool->max_dials  = NOPOLL_CONN_POOL_MAX_DIALS;
+	pool->mutex      = nopoll_mutex_create ();
+	pool->host_ip    = nopoll_strdup (host_ip);
+	pool->host_port  = nopoll_strdup (host_port);
+	pool->host_name  = host_name ? nopoll_strdup (host_name) : NULL;
+	pool->get_url    = get_url   ? nopoll_strdup (get_url)   : NULL;
+	pool->protocols  = protocols ? nopoll_strdup (protocols) : NULL;
+	pool->origin     = origin    ? nopoll_strdup (origin)    : NULL;
+
+	/* the pool holds a reference to the context */
+	nopoll_ctx_ref (ctx);
+
+	/* register the pool */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	pool->next       = ctx->conn_pools;
+	ctx->conn_pools  = pool;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	/* dial initial connections */
+	nopoll_conn_pool_refill (pool);
+
+	return pool;
+}
+
+/**
+ * @brief Gets a connection from the pool, preferring connections that
+ * already finished their handshake.
+ *
+ * The connection returned is no longer part of the pool: it is owned
+ * by the caller, who must close it (\ref nopoll_conn_close) or give it
+ * back to the pool (\ref nopoll_conn_pool_release) once done. A
+ * replacement is dialed right away so the pool is kept full.
+ *
+ * When no connection is ready yet, a connection still doing its
+ * handshake is returned (or a new one is created if the pool is
+ * empty), so the caller must check it with \ref nopoll_conn_is_ready
+ * (or \ref nopoll_conn_wait_until_connection_ready) as it would do
+ * with \ref nopoll_conn_new.
+ *
+ * @param pool The pool where the connection is requested.
+ *
+ * @return A connection or NULL if it fails.
+ */
+noPollConn     * nopoll_conn_pool_get (noPollConnPool * pool)
+{
+	noPollConn * conn = NULL;
+	int          iterator;
+	int          candidate = -1;
+
+	if (pool == NULL)
+		return NULL;
+
+	nopoll_mutex_lock (pool->mutex);
+
+	/* take connections dialed meanwhile */
+	__nopoll_conn_pool_collect (pool);
+
+	for (iterator = 0; iterator < pool->size; iterator++) {
+		if (pool->conns[iterator] == NULL || ! nopoll_conn_is_ok (pool->conns[iterator]))
+			continue;
+
+		/* connection ready: use it */
+		if (nopoll_conn_is_ready (pool->conns[iterator])) {
+			candidate = iterator;
+			break;
+		} /* end if */
+
+		/* remember first connection in progress */
+		if (candidate == -1)
+			candidate = iterator;
+	} /* end for */
+
+	if (candidate != -1) {
+		conn                   = pool->conns[candidate];
+		pool->conns[candidate] = NULL;
+	} /* end if */
+
+	/* dial replacements */
+	__nopoll_conn_pool_refill_common (pool);
+
+	/* nothing available: create a connection (on the caller
+	 * thread, as nopoll_conn_new does) */
+	if (conn == NULL && pool->next_retry <= (long) time (NULL))
+		conn = __nopoll_conn_pool_connect (pool, NOPOLL_INVALID_SOCKET);
+
+	nopoll_mutex_unlock (pool->mutex);
+
+	return conn;
+}
+
+/**
+ * @brief Gives back to the pool a connection obtained through \ref
+ * nopoll_conn_pool_get.
+ *
+ * The connection is kept if it is still working, ready and the pool
+ * has room for it (for example, when the replacement dialed could not
+ * be created). Otherwise the connection is closed.
+ *
+ * @param pool The pool where the connection is returned.
+ *
+ * @param conn The connection to return. The caller must not use it
+ * after this call.
+ *
+ * @return nopoll_true if the connection was kept by the pool,
+ * nopoll_false if it was closed.
+ */
+nopoll_bool      nopoll_conn_pool_release (noPollConnPool * pool, noPollConn * conn)
+{
+	int slot;
+
+	if (conn == NULL)
+		return nopoll_false;
+	if (pool == NULL) {
+		nopoll_conn_close (conn);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_mutex_lock (pool->mutex);
+	if (nopoll_conn_is_ok (conn) && nopoll_conn_is_ready (conn)) {
+		/* replace closed connections too */
+		slot = __nopoll_conn_pool_slot (pool);
+		if (slot != -1) {
+			pool->conns[slot] = conn;
+			nopoll_mutex_unlock (pool->mutex);
+			return nopoll_true;
+		} /* end if */
+	} /* end if */
+	nopoll_mutex_unlock (pool->mutex);
+
+	/* no room (or not working) */
+	nopoll_conn_close (conn);
+	return nopoll_false;
+}
+
+/**
+ * @brief Returns how many connections of the pool are ready to be
+ * used (handshake completed), taking the connections dialed
+ * meanwhile.
+ *
+ * @param pool The pool to check.
+ *
+ * @return Number of ready connections (0 when NULL is received).
+ */
+int              nopoll_conn_pool_ready (noPollConnPool * pool)
+{
+	int iterator;
+	int ready = 0;
+
+	if (pool == NULL)
+		return 0;
+
+	nopoll_mutex_lock (pool->mutex);
+	__nopoll_conn_pool_collect (pool);
+	for (iterator = 0; iterator < pool->size; iterator++) {
+		if (pool->conns[iterator] && nopoll_conn_is_ok (pool->conns[iterator]) && nopoll_conn_is_ready (pool->conns[iterator]))
+			ready++;
+	} /* end for */
+	nopoll_mutex_unlock (pool->mutex);
+
+	return ready;
+}
+
+/**
+ * @brief Replaces connections of the pool that were closed or handed
+ * out, dialing new ones.
+ *
+ * This is done automatically on every \ref nopoll_loop_wait
+ * iteration, so it is only required when the loop is not used. When
+ * an endpoint fails to connect, new attempts are delayed \ref
+ * NOPOLL_CONN_POOL_RETRY_PERIOD seconds.
+ *
+ * @param pool The pool to refill.
+ */
+void             nopoll_conn_pool_refill (noPollConnPool * pool)
+{
+	if (pool == NULL)
+		return;
+
+	nopoll_mutex_lock (pool->mutex);
+	__nopoll_conn_pool_refill_common (pool);
+	nopoll_mutex_unlock (pool->mutex);
+
+	return;
+}
+
+/**
+ * @brief Configures how many connections the pool dials (or keeps
+ * doing their handshakes) at the same time, so refilling a big pool
+ * (or one whose connections were all closed at once) doesn't flood
+ * the endpoint.
+ *
+ * @param pool The pool to configure.
+ *
+ * @param max_dials Connections dialing at the same time (bigger than
+ * 0). Default value is \ref NOPOLL_CONN_POOL_MAX_DIALS.
+ */
+void             nopoll_conn_pool_set_max_dials (noPollConnPool * pool, int max_dials)
+{
+	if (pool == NULL || max_dials <= 0)
+		return;
+
+	nopoll_mutex_lock (pool->mutex);
+	pool->max_dials = max_dials;
+	nopoll_mutex_unlock (pool->mutex);
+
+	return;
+}
+
+/**
+ * @brief Releases a reference to the pool. When the last reference is
+ * released, every connection kept by the pool is closed (connections
+ * handed out are not affected).
+ *
+ * @param pool The pool to release.
+ */
+void             nopoll_conn_pool_unref (noPollConnPool * pool)
+{
+	noPollCtx          * ctx;
+	noPollConnPool    ** previous;
+	noPollConnDial     * dial;
+	int                  iterator;
+
+	if (pool == NULL)
+		return;
+	ctx = pool->ctx;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	pool->refs--;
+	if (pool->refs > 0) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return;
+	} /* end if */
+
+	/* unregister the pool */
+	previous = &(ctx->conn_pools);
+	while (*previous) {
+		if (*previous == pool) {
+			*previous = pool->next;
+			break;
+		} /* end if */
+		previous = &((*previous)->next);
+	} /* end while */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	/* close connections kept */
+	for (iterator = 0; iterator < pool->size; iterator++) {
+		if (pool->conns[iterator])
+			nopoll_conn_close (pool->conns[iterator]);
+	} /* end for */
+	nopoll_free (pool->conns);
+
+	/* dials still running are released by their worker */
+	while (pool->dials) {
+		dial        = pool->dials;
+		pool->dials = dial->next;
+		__nopoll_conn_dial_release (dial);
+	} /* end while */
+
+	nopoll_free (pool->host_ip);
+	nopoll_free (pool->host_port);
+	nopoll_free (pool->host_name);
+	nopoll_free (pool->get_url);
+	nopoll_free (pool->protocols);
+	nopoll_free (pool->origin);
+
+	/* release connection options */
+	__nopoll_conn_opts_release_if_needed (pool->opts);
+
+	nopoll_mutex_destroy (pool->mutex);
+	nopoll_free (pool);
+
+	/* release the reference to the context */
+	nopoll_ctx_unref (ctx);
+
+	return;
+}
+
+/**
+ * @internal Refills every pool registered on the provided context
+ * (called by \ref nopoll_loop_wait on every iteration).
+ */
+void             __nopoll_conn_pool_refill_all (noPollCtx * ctx)
+{
+	noPollConnPool * pool;
+	noPollConnPool * next;
+
+	/* each pool is refilled holding a reference (which keeps it
+	 * registered, so its next pointer stays valid) and without
+	 * ctx->ref_mutex because creating connections requires it */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	pool = ctx->conn_pools;
+	if (pool)
+		pool->refs++;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	while (pool) {
+		nopoll_conn_pool_refill (pool);
+
+		/* get next pool */
+		nopoll_mutex_lock (ctx->ref_mutex);
+		next = pool->next;
+		if (next)
+			next->refs++;
+		nopoll_mutex_unlock (ctx->ref_mutex);
+
+		nopoll_conn_pool_unref (pool);
+		pool = next;
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @}
+ */
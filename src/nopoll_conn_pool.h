@@ -0,0 +1,96 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#ifndef __NOPOLL_CONN_POOL_H__
+#define __NOPOLL_CONN_POOL_H__
+
+#include <nopoll.h>
+
+BEGIN_C_DECLS
+
+noPollConnPool * nopoll_conn_pool_new (noPollCtx       * ctx,
+				       noPollConnOpts  * opts,
+				       nopoll_bool       enable_tls,
+				       int               size,
+				       const char      * host_ip,
+				       const char      * host_port,
+				       const char      * host_name,
+				       const char      * get_url,
+				       const char      * protocols,
+				       const char      * origin);
+
+noPollConnPool * nopoll_conn_pool_new6 (noPollCtx       * ctx,
+					noPollConnOpts  * opts,
+					nopoll_bool       enable_tls,
+					int               size,
+					const char      * host_ip,
+					const char      * host_port,
+					const char      * host_name,
+					const char      * get_url,
+					const char      * protocols,
+					const char      * origin);
+
+noPollConn     * nopoll_conn_pool_get (noPollConnPool * pool);
+
+nopoll_bool      nopoll_conn_pool_release (noPollConnPool * pool, noPollConn * conn);
+
+int              nopoll_conn_pool_ready (noPollConnPool * pool);
+
+void             nopoll_conn_pool_refill (noPollConnPool * pool);
+
+void             nopoll_conn_pool_set_max_dials (noPollConnPool * pool, int max_dials);
+
+void             nopoll_conn_pool_unref (noPollConnPool * pool);
+
+/** internal API **/
+noPollConnPool * __nopoll_conn_pool_new_common (noPollCtx       * ctx,
+						noPollConnOpts  * opts,
+						noPollTransport   transport,
+						nopoll_bool       enable_tls,
+						int               size,
+						const char      * host_ip,
+						const char      * host_port,
+						const char      * host_name,
+						const char      * get_url,
+						const char      * protocols,
+						const char      * origin);
+
+void             __nopoll_conn_pool_refill_all (noPollCtx * ctx);
+
+END_C_DECLS
+
+#endif
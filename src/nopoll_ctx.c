@@ -39,6 +39,19 @@
 #include <nopoll_private.h>
 #include <signal.h>
 
+#if defined(NOPOLL_HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
+/* the certificate watcher uses inotify where available */
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define NOPOLL_HAVE_INOTIFY (1)
+#endif
+
+/* initial number of buckets of the SNI index (power of two) */
+#define NOPOLL_SNI_HASH_SIZE (64)
+
 /** 
  * \defgroup nopoll_ctx noPoll Context: context handling functions used by the library
  */
@@ -94,10 +107,12 @@ noPollCtx * nopoll_ctx_new (void) {
 
 	/* 20 seconds for connection timeout */
 	result->conn_connect_std_timeout = 20000000;
+	result->tls_handshake_timeout    = NOPOLL_TLS_HANDSHAKE_TIMEOUT;
 
 	/* default log initialization */
 	result->not_executed  = nopoll_true;
 	result->debug_enabled = nopoll_false;
+	__nopoll_log_update (result);
 	
 	/* colored log */
 	result->not_executed_color  = nopoll_true;
@@ -115,8 +130,19 @@ noPollCtx * nopoll_ctx_new (void) {
 	/* setup default maximum frame size accepted */
 	result->max_frame_size = NOPOLL_MAX_FRAME_SIZE_DEFAULT;
 
+	/* system resolver without cache by default */
+	result->resolver_mode  = NOPOLL_RESOLVER_SYSTEM;
+	result->resolver_cache_max = NOPOLL_RESOLVER_CACHE_MAX_ENTRIES;
+	result->io_wait_timeout = NOPOLL_IO_WAIT_TIMEOUT;
+	result->cert_watch_fd   = -1;
+
 	/* create mutexes */
-	result->ref_mutex = nopoll_mutex_create ();
+	result->ref_mutex     = nopoll_mutex_create ();
+	result->deflate_mutex = nopoll_mutex_create ();
+
+	/* prepare per thread counters and compression buffers */
+	__nopoll_ctx_counters_start (result);
+	__nopoll_deflate_scratch_start (result);
 
 #if !defined(NOPOLL_OS_WIN32)
 	/* install sigpipe handler */
@@ -184,6 +210,12 @@ void           nopoll_ctx_unref (noPollCtx * ctx)
 	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Releasing noPoll context %p (refs: %d, conns registered: %d, list size: %d)",
 		    ctx, ctx->refs, ctx->conn_num, ctx->conn_length);
 
+	/* stop workers first: handshake steps and tasks still running
+	 * use certificates, the resolver cache and the mutex */
+	__nopoll_worker_release (ctx);
+	if (ctx->cert_watch_fd >= 0)
+		close (ctx->cert_watch_fd);
+
 	iterator = 0;
 	while (iterator < ctx->certificates_length) {
 		/* get reference */
@@ -194,6 +226,8 @@ void           nopoll_ctx_unref (noPollCtx * ctx)
 		nopoll_free (cert->certificateFile);
 		nopoll_free (cert->privateKey);
 		nopoll_free (cert->optionalChainFile);
+		if (cert->ssl_ctx)
+			SSL_CTX_free (cert->ssl_ctx);
 
 		/* next position */
 		iterator++;
@@ -208,8 +242,28 @@ void           nopoll_ctx_unref (noPollCtx * ctx)
 		ctx->io_engine = NULL;
 	} /* end if */
 
-	/* release mutex */
+	/* release resolver cache and hosts file entries */
+	__nopoll_ctx_resolver_cache_purge (ctx, nopoll_true);
+	__nopoll_ctx_hosts_release (ctx);
+
+	/* release timers */
+	__nopoll_timer_release_all (ctx);
+
+	/* release idle compression streams */
+	__nopoll_deflate_pool_release (ctx);
+
+	/* release SNI index */
+	__nopoll_ctx_sni_release (ctx);
+
+	/* flush and stop the asynchronous logger */
+	__nopoll_log_async_release (ctx);
+
+	/* release counters of threads */
+	__nopoll_ctx_counters_release (ctx);
+
+	/* release mutexes */
 	nopoll_mutex_destroy (ctx->ref_mutex);
+	nopoll_mutex_destroy (ctx->deflate_mutex);
 
 	/* release all certificates buckets */
 	nopoll_free (ctx->certificates);
@@ -217,6 +271,7 @@ void           nopoll_ctx_unref (noPollCtx * ctx)
 	/* release connection */
 	nopoll_free (ctx->conn_list);
 	ctx->conn_length = 0;
+	nopoll_free (ctx->metrics_path);
 	nopoll_free (ctx);
 	return;
 }
@@ -453,608 +508,2857 @@ int            nopoll_ctx_conns (noPollCtx * ctx)
 	return result;
 }
 
-/** 
- * @brief Allows to find the certificate associated to the provided serverName. 
- *
- * @param ctx The context where the operation will take place.
- *
- * @param serverName the servername to use as pattern to find the
- * right certificate. If NULL is provided the function first looks for
- * a certificate that isn't associated to any serverName and, when
- * there is none, it falls back to reporting the first certificate
- * stored, whatever serverName it is associated to.
- *
- * @param certificateFile If provided a reference and the function
- * returns nopoll_true, it will contain the certificateFile found.
- *
- * @param privateKey If provided a reference and the function
- * returns nopoll_true, it will contain the privateKey found.
- *
- * @param optionalChainFile If provided a reference and the function
- * returns nopoll_true, it will contain the optionalChainFile found.
- *
- * NOTE: the values reported are references owned by the context, not
- * copies: they must not be released by the caller and they are only
- * valid while the context is alive and the certificate is not
- * replaced.
- *
- * @return nopoll_true in the case the certificate was found,
- * otherwise nopoll_false is returned.
+/**
+ * @internal Adds the counters in source into dest. rtt_last is
+ * replaced (if measured) and pending_write_bytes is left untouched
+ * because it is not a counter.
  */
-nopoll_bool    nopoll_ctx_find_certificate (noPollCtx   * ctx, 
-					    const char  * serverName, 
-					    const char ** certificateFile, 
-					    const char ** privateKey, 
-					    const char ** optionalChainFile)
+void           __nopoll_ctx_stats_add (noPollStats * dest, noPollStats * source)
 {
-	noPollCertificate * cert;
+	int iterator;
 
-	int iterator = 0;
-	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+	for (iterator = 0; iterator < 16; iterator++) {
+		dest->frames_in[iterator]   += source->frames_in[iterator];
+		dest->bytes_in[iterator]    += source->bytes_in[iterator];
+		dest->frames_out[iterator]  += source->frames_out[iterator];
+		dest->bytes_out[iterator]   += source->bytes_out[iterator];
+		dest->close_codes[iterator] += source->close_codes[iterator];
+	} /* end for */
+
+	dest->handshakes_ok         += source->handshakes_ok;
+	dest->handshakes_failed     += source->handshakes_failed;
+	dest->tls_handshakes_ok     += source->tls_handshakes_ok;
+	dest->tls_handshakes_failed += source->tls_handshakes_failed;
+	dest->partial_writes        += source->partial_writes;
+	dest->pongs                 += source->pongs;
+	dest->rtt_total             += source->rtt_total;
+	dest->close_other           += source->close_other;
+	dest->frame_size_rejections += source->frame_size_rejections;
+	if (source->rtt_last > 0)
+		dest->rtt_last = source->rtt_last;
 
-	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Finding a certificate for serverName=%s", serverName ? serverName : "<not defined>");
+	return;
+}
+
+#if defined(NOPOLL_HAVE_PTHREAD)
+/**
+ * @internal Called when a thread that updated context counters
+ * finishes.
+ */
+static void __nopoll_ctx_counters_thread_end (void * data)
+{
+	noPollCtxCounters * counters = (noPollCtxCounters *) data;
+
+	__sync_synchronize ();
+	counters->closed = 1;
+	return;
+}
+#endif
+
+/**
+ * @internal Prepares the context so each thread updates its own
+ * counters (see __nopoll_ctx_counters).
+ */
+void                __nopoll_ctx_counters_start (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	pthread_key_t * key;
+
+	key = nopoll_new (pthread_key_t, 1);
+	if (key == NULL)
+		return;
+	if (pthread_key_create (key, __nopoll_ctx_counters_thread_end) != 0) {
+		nopoll_free (key);
+		return;
+	} /* end if */
+	ctx->counters_key = key;
+#endif
+	return;
+}
 
-	/* acquire the mutex to walk the certificate store while it may
-	 * be updated by nopoll_ctx_set_certificate () */
+/**
+ * @internal Returns the counters the calling thread updates for the
+ * provided context, created on first use. Only the calling thread
+ * writes them, so no lock is needed. Without thread support (or if
+ * memory is exhausted) the counters of the context are returned,
+ * updated without locking as connection counters are.
+ */
+static noPollCtxCounters * __nopoll_ctx_counters (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	pthread_key_t     * key = (pthread_key_t *) ctx->counters_key;
+	noPollCtxCounters * counters;
+
+	if (key == NULL)
+		return &ctx->counters;
+	counters = (noPollCtxCounters *) pthread_getspecific (*key);
+	if (counters)
+		return counters;
+
+	counters = nopoll_new (noPollCtxCounters, 1);
+	if (counters == NULL)
+		return &ctx->counters;
 	nopoll_mutex_lock (ctx->ref_mutex);
+	counters->next         = ctx->counters_threads;
+	ctx->counters_threads  = counters;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+	pthread_setspecific (*key, counters);
+	return counters;
+#else
+	return &ctx->counters;
+#endif
+}
 
-	while (iterator < ctx->certificates_length) {
-		/* get cert */
-		cert = &(ctx->certificates[iterator]);
+/**
+ * @internal Returns the context counters the calling thread updates
+ * (see __nopoll_ctx_counters).
+ */
+noPollStats       * __nopoll_ctx_thread_stats (noPollCtx * ctx)
+{
+	return &__nopoll_ctx_counters (ctx)->stats;
+}
 
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "   certificate stored associated to serverName=%s", cert->serverName ? cert->serverName : "<not defined>");
-		if ((serverName == NULL && cert->serverName == NULL)  ||
-		    (nopoll_cmp (serverName, cert->serverName))) {
-			if (certificateFile)
-				(*certificateFile)   = cert->certificateFile;
-			if (privateKey)
-				(*privateKey)        = cert->privateKey;
-			if (optionalChainFile)
-				(*optionalChainFile) = cert->optionalChainFile;
+/**
+ * @internal Returns the context latency histograms
+ * (NOPOLL_LATENCY_MAX) the calling thread records into (see
+ * __nopoll_ctx_counters).
+ */
+noPollHistogram   * __nopoll_ctx_thread_latency (noPollCtx * ctx)
+{
+	return __nopoll_ctx_counters (ctx)->latency;
+}
 
-			nopoll_mutex_unlock (ctx->ref_mutex);
-			return nopoll_true;
+/**
+ * @internal Adds into stats (if defined) the context counters and
+ * merges into hist (if defined) the context histogram selected with
+ * which: values of threads already finished plus those of every
+ * thread still running. Blocks of threads finished are folded into
+ * ctx->counters. The caller must hold ctx->ref_mutex.
+ */
+void                __nopoll_ctx_counters_collect (noPollCtx       * ctx,
+						   noPollStats     * stats,
+						   noPollLatency     which,
+						   noPollHistogram * hist)
+{
+	noPollCtxCounters ** counters = &ctx->counters_threads;
+	noPollCtxCounters  * closed;
+
+	while (*counters) {
+		if ((*counters)->closed) {
+			closed    = *counters;
+			*counters = closed->next;
+#if defined(NOPOLL_HAVE_PTHREAD)
+			__sync_synchronize ();
+#endif
+			__nopoll_ctx_stats_add (&ctx->counters.stats, &closed->stats);
+			ctx->counters.stats.pending_write_bytes += closed->stats.pending_write_bytes;
+			__nopoll_ctx_latency_add (ctx->counters.latency, closed->latency);
+			nopoll_free (closed);
+			continue;
 		} /* end if */
 
-		/* next position */
-		iterator++;
+		if (stats) {
+			__nopoll_ctx_stats_add (stats, &(*counters)->stats);
+			stats->pending_write_bytes += (*counters)->stats.pending_write_bytes;
+		} /* end if */
+		if (hist)
+			nopoll_histogram_merge (hist, &(*counters)->latency[which]);
+		counters = &(*counters)->next;
 	} /* end while */
 
-	/* check for default certificate when serverName isn't defined:
-	 * report the first certificate stored, whatever serverName it
-	 * is associated to.
-	 *
-	 * NOTE: this loop used to have the iterator++ placed outside
-	 * the while body (a misplaced brace). It did not spin because
-	 * cert is the address of an array position, so it is never
-	 * NULL and the first iteration always returned */
-	if (serverName == NULL && ctx->certificates_length > 0) {
-		cert = &(ctx->certificates[0]);
-
-		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "   serverName not defined, selecting first certificate from the list");
-		if (certificateFile)
-			(*certificateFile)   = cert->certificateFile;
-		if (privateKey)
-			(*privateKey)        = cert->privateKey;
-		if (optionalChainFile)
-			(*optionalChainFile) = cert->optionalChainFile;
-
-		nopoll_mutex_unlock (ctx->ref_mutex);
-		return nopoll_true;
+	if (stats) {
+		__nopoll_ctx_stats_add (stats, &ctx->counters.stats);
+		stats->pending_write_bytes += ctx->counters.stats.pending_write_bytes;
 	} /* end if */
+	if (hist)
+		nopoll_histogram_merge (hist, &ctx->counters.latency[which]);
+	return;
+}
 
-	nopoll_mutex_unlock (ctx->ref_mutex);
+/**
+ * @internal Releases the counters of threads (see
+ * __nopoll_ctx_counters) when the context is released.
+ */
+void                __nopoll_ctx_counters_release (noPollCtx * ctx)
+{
+	noPollCtxCounters * counters;
 
-	return nopoll_false;
+#if defined(NOPOLL_HAVE_PTHREAD)
+	if (ctx->counters_key) {
+		pthread_key_delete (*((pthread_key_t *) ctx->counters_key));
+		nopoll_free (ctx->counters_key);
+		ctx->counters_key = NULL;
+	} /* end if */
+#endif
+	while (ctx->counters_threads) {
+		counters              = ctx->counters_threads;
+		ctx->counters_threads = counters->next;
+		nopoll_free (counters);
+	} /* end while */
+	return;
 }
 
 /**
- * @internal Looks for a certificate stored under exactly the
- * serverName provided, without the fallback to the default
- * certificate implemented by \ref nopoll_ctx_find_certificate.
+ * @brief Gets the counters collected by all connections created on
+ * the provided context: the ones currently registered plus those
+ * already closed and unregistered (see \ref noPollStats and \ref
+ * nopoll_conn_get_stats).
  *
- * NOTE: the caller must hold ctx->ref_mutex.
+ * pending_write_bytes reports the bytes waiting to be written on
+ * all connections currently registered and rtt_last the value
+ * measured by one of the last connections reporting it.
  *
- * @param ctx The context whose certificate store is checked.
+ * Counters are kept per thread as they are updated, so the cost
+ * does not depend on the number of connections.
  *
- * @param serverName The serverName to look for (NULL matches the
- * certificate stored without serverName).
+ * @param ctx The context to check.
+ *
+ * @param stats Reference where the counters are copied.
  *
- * @return nopoll_true when a certificate with that exact serverName
- * is stored, otherwise nopoll_false.
+ * @return nopoll_true if the counters were copied, otherwise
+ * nopoll_false is returned (NULL parameters).
  */
-static nopoll_bool __nopoll_ctx_find_certificate_exact (noPollCtx * ctx, const char * serverName)
+nopoll_bool    nopoll_ctx_get_stats (noPollCtx * ctx, noPollStats * stats)
 {
-	int iterator = 0;
+	nopoll_return_val_if_fail (ctx, ctx && stats, nopoll_false);
 
-	while (iterator < ctx->certificates_length) {
-		if (nopoll_cmp (serverName, ctx->certificates[iterator].serverName))
-			return nopoll_true;
+	memset (stats, 0, sizeof (noPollStats));
 
-		/* next position */
-		iterator++;
-	} /* end while */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	__nopoll_ctx_counters_collect (ctx, stats, 0, NULL);
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	return nopoll_false;
+	return nopoll_true;
 }
 
 /**
- * @brief Allows to install a certificate to be used in general by all
- * listener connections working under the provided context.
+ * @internal Adds the NOPOLL_LATENCY_MAX histograms in source (if any)
+ * into dest (if latency tracking was enabled).
+ */
+void           __nopoll_ctx_latency_add (noPollHistogram * dest, noPollHistogram * source)
+{
+	int iterator;
+
+	if (dest == NULL || source == NULL)
+		return;
+
+	for (iterator = 0; iterator < NOPOLL_LATENCY_MAX; iterator++)
+		nopoll_histogram_merge (&dest[iterator], &source[iterator]);
+	return;
+}
+
+/**
+ * @brief Enables or disables latency tracking on the provided
+ * context (disabled by default). When enabled, the latencies
+ * defined by \ref noPollLatency are recorded into the context
+ * histograms (see \ref nopoll_ctx_get_latency), kept per thread so
+ * recording takes no lock, and into the histograms of connections
+ * that track their own latencies (see \ref
+ * nopoll_conn_set_latency_tracking).
  *
- * @param ctx The context where the certificate will be installed.
+ * Each value recorded requires a gettimeofday call, so keep it
+ * disabled unless it is needed. Values recorded so far are kept when
+ * tracking is disabled.
  *
- * @param serverName The optional server name to limit the use of
- * this certificate to the value provided here. Provide a NULL value
- * to make the certificate work under any server notified
- * (Host: header) or via SNI (server name identification associated to
- * the TLS transport).
+ * @param ctx The context to configure.
  *
- * @param certificateFile The certificate file to be installed. 
+ * @param enable nopoll_true to record latencies.
  *
- * @param privateKey The private key file to be used.
+ * @return nopoll_true if the configuration was applied, otherwise
+ * nopoll_false is returned (NULL context).
+ */
+nopoll_bool    nopoll_ctx_set_latency_tracking (noPollCtx * ctx, nopoll_bool enable)
+{
+	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	ctx->latency_tracking = enable;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return nopoll_true;
+}
+
+/**
+ * @brief Gets the histogram of the latency requested recorded on the
+ * provided context, for every connection created on it (see \ref
+ * nopoll_ctx_set_latency_tracking). The histograms of the threads
+ * recording are merged, so the cost does not depend on the number of
+ * connections.
  *
- * @param optionalChainFile Optional chain file with additional
- * material to complete the certificate definition.
+ * @param ctx The context to check.
  *
- * @return nopoll_true if the certificate was installed otherwise
- * nopoll_false. The function returns nopoll_false when ctx, certificateFile or privateKey are NULL.
- */ 
-nopoll_bool           nopoll_ctx_set_certificate (noPollCtx  * ctx, 
-						  const char * serverName, 
-						  const char * certificateFile, 
-						  const char * privateKey, 
-						  const char * optionalChainFile)
+ * @param which The latency requested.
+ *
+ * @param hist Reference where the histogram is copied.
+ *
+ * @return nopoll_true if the histogram was copied, otherwise
+ * nopoll_false is returned (wrong parameters).
+ */
+nopoll_bool    nopoll_ctx_get_latency (noPollCtx * ctx, noPollLatency which, noPollHistogram * hist)
 {
-	int length;
-	noPollCertificate * cert;
-	noPollCertificate * certificates;
+	nopoll_return_val_if_fail (ctx, ctx && hist && which >= 0 && which < NOPOLL_LATENCY_MAX, nopoll_false);
 
-	/* check values before proceed */
-	nopoll_return_val_if_fail (ctx, ctx && certificateFile && privateKey, nopoll_false);
+	nopoll_histogram_reset (hist);
 
-	/* acquire the mutex to protect the certificate store while it
-	 * is checked and updated */
 	nopoll_mutex_lock (ctx->ref_mutex);
+	__nopoll_ctx_counters_collect (ctx, NULL, which, hist);
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	/* check if the certificate is already installed
-	 *
-	 * NOTE: this check used to call nopoll_ctx_find_certificate (),
-	 * which falls back to reporting the first certificate stored
-	 * when serverName is NULL. That made installing a certificate
-	 * without serverName a silent no-op as soon as any other
-	 * certificate was present. An exact match is what is needed
-	 * here (and doing it inside the critical section also removes
-	 * the check/update race) */
-	if (__nopoll_ctx_find_certificate_exact (ctx, serverName)) {
-		nopoll_mutex_unlock (ctx->ref_mutex);
-		return nopoll_true;
-	} /* end if */
+	return nopoll_true;
+}
 
-	/* update certificate storage to hold all values */
-	length = ctx->certificates_length + 1;
-	if (length == 1)
-		certificates = nopoll_new (noPollCertificate, 1);
-	else
-		certificates = (noPollCertificate *) nopoll_realloc (ctx->certificates, sizeof (noPollCertificate) * (length));
+/**
+ * @brief Configures the path where listeners created on the provided
+ * context serve the context metrics (see \ref nopoll_metrics_render)
+ * in OpenMetrics text format, for example "/metrics".
+ *
+ * A plain HTTP GET received for that path (no upgrade headers are
+ * required) is replied with the metrics and the connection is closed
+ * instead of being upgraded to websocket. The reply is written as the
+ * socket accepts it, so a slow scraper never blocks the loop. Metric
+ * requests are not notified to on open/on ready handlers.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param path The path to serve (including the leading /) or NULL to
+ * disable the exporter (default).
+ *
+ * @return nopoll_true if the configuration was applied, otherwise
+ * nopoll_false is returned.
+ */
+nopoll_bool    nopoll_ctx_set_metrics_path (noPollCtx * ctx, const char * path)
+{
+	char * copy = NULL;
 
-	/* check the allocation before using it: storing the result
-	 * directly into ctx->certificates and then indexing it
-	 * dereferenced NULL when the allocation failed, and left
-	 * certificates_length already increased */
-	if (certificates == NULL) {
-		nopoll_mutex_unlock (ctx->ref_mutex);
-		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to store the certificate provided");
-		return nopoll_false;
-	} /* end if */
+	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+	nopoll_return_val_if_fail (ctx, path == NULL || path[0] == '/', nopoll_false);
 
-	ctx->certificates        = certificates;
-	ctx->certificates_length = length;
+	if (path) {
+		copy = nopoll_strdup (path);
+		if (copy == NULL)
+			return nopoll_false;
+	} /* end if */
 
-	/* hold certificate */
-	cert = &(ctx->certificates[length - 1]);
+	nopoll_mutex_lock (ctx->ref_mutex);
+	nopoll_free (ctx->metrics_path);
+	ctx->metrics_path = copy;
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	cert->serverName = NULL;
-	if (serverName)
-		cert->serverName         = nopoll_strdup (serverName);
+	return nopoll_true;
+}
 
-	cert->certificateFile = NULL;
-	if (certificateFile)
-		cert->certificateFile    = nopoll_strdup (certificateFile);
+/**
+ * @internal Hashes the server name provided ignoring case (host names
+ * are case insensitive) using FNV-1a.
+ */
+unsigned int   __nopoll_ctx_sni_hash (const char * serverName)
+{
+	unsigned int hash = 2166136261u;
 
-	cert->privateKey = NULL;
-	if (privateKey)
-		cert->privateKey         = nopoll_strdup (privateKey);
+	while (*serverName) {
+		hash ^= (unsigned int) tolower ((unsigned char) *serverName);
+		hash *= 16777619u;
+		serverName++;
+	} /* end while */
 
-	cert->optionalChainFile = NULL;
-	if (optionalChainFile)
-		cert->optionalChainFile  = nopoll_strdup (optionalChainFile);
+	return hash;
+}
 
-	/* release the mutex */
-	nopoll_mutex_unlock (ctx->ref_mutex);
+/**
+ * @internal Compares both server names ignoring case.
+ */
+nopoll_bool    __nopoll_ctx_sni_equal (const char * name1, const char * name2)
+{
+	while (*name1 && *name2) {
+		if (tolower ((unsigned char) *name1) != tolower ((unsigned char) *name2))
+			return nopoll_false;
+		name1++;
+		name2++;
+	} /* end while */
 
-	return nopoll_true;
+	return *name1 == *name2;
 }
 
-/** 
- * @brief Allows to configure the on open handler, the handler that is
- * called when an incoming websocket connection is received and all
+/**
+ * @internal Looks for the SNI index entry stored under exactly the
+ * server name provided (ignoring case) at the hash provided (the
+ * context index, with ctx->ref_mutex held, or a snapshot).
+ *
+ * @return The entry found or NULL.
+ */
+noPollSniEntry * __nopoll_ctx_sni_lookup (noPollSniEntry ** hash, int hash_size, const char * serverName)
+{
+	noPollSniEntry * entry;
+
+	if (hash == NULL || serverName == NULL)
+		return NULL;
+
+	entry = hash[__nopoll_ctx_sni_hash (serverName) & (hash_size - 1)];
+	while (entry) {
+		if (__nopoll_ctx_sni_equal (entry->serverName, serverName))
+			return entry;
+		entry = entry->next;
+	} /* end while */
+
+	return NULL;
+}
+
+/**
+ * @internal Finds the SNI index entry to be used for the server name
+ * requested by a TLS client: an exact match is preferred and, when
+ * there is none, a wildcard entry (*.example.com) covering the first
+ * label of the name is looked up (see __nopoll_ctx_sni_lookup).
+ *
+ * @return The entry found or NULL.
+ */
+noPollSniEntry * __nopoll_ctx_sni_match (noPollSniEntry ** hash, int hash_size, const char * serverName)
+{
+	noPollSniEntry * entry;
+	const char     * domain;
+	char             wildcard[256];
+
+	entry = __nopoll_ctx_sni_lookup (hash, hash_size, serverName);
+	if (entry)
+		return entry;
+
+	/* wildcards only cover one label: a.example.com is covered
+	 * by *.example.com while a.b.example.com is not */
+	domain = strchr (serverName, '.');
+	if (domain == NULL || domain == serverName || domain[1] == 0 || strlen (domain) > (sizeof (wildcard) - 2))
+		return NULL;
+
+	wildcard[0] = '*';
+	memcpy (wildcard + 1, domain, strlen (domain) + 1);
+
+	return __nopoll_ctx_sni_lookup (hash, hash_size, wildcard);
+}
+
+/**
+ * @internal Doubles the SNI index size so buckets are kept short. The
+ * caller must hold ctx->ref_mutex.
+ */
+void __nopoll_ctx_sni_grow (noPollCtx * ctx)
+{
+	noPollSniEntry ** hash;
+	noPollSniEntry  * entry;
+	noPollSniEntry  * next;
+	unsigned int      bucket;
+	int               size = ctx->sni_hash_size * 2;
+	int               iterator;
+
+	hash = nopoll_new (noPollSniEntry *, size);
+	if (hash == NULL)
+		return;
+
+	for (iterator = 0; iterator < ctx->sni_hash_size; iterator++) {
+		entry = ctx->sni_hash[iterator];
+		while (entry) {
+			next          = entry->next;
+			bucket        = __nopoll_ctx_sni_hash (entry->serverName) & (size - 1);
+			entry->next   = hash[bucket];
+			hash[bucket]  = entry;
+			entry         = next;
+		} /* end while */
+	} /* end for */
+
+	nopoll_free (ctx->sni_hash);
+	ctx->sni_hash      = hash;
+	ctx->sni_hash_size = size;
+	return;
+}
+
+/**
+ * @internal Adds an entry to the SNI index. The caller must hold
+ * ctx->ref_mutex.
+ *
+ * @return nopoll_true if the entry was added, otherwise nopoll_false
+ * (memory allocation failure).
+ */
+nopoll_bool __nopoll_ctx_sni_add (noPollCtx * ctx, const char * serverName, int cert_index)
+{
+	noPollSniEntry * entry;
+	unsigned int     bucket;
+
+	if (ctx->sni_hash == NULL) {
+		ctx->sni_hash = nopoll_new (noPollSniEntry *, NOPOLL_SNI_HASH_SIZE);
+		if (ctx->sni_hash == NULL)
+			return nopoll_false;
+		ctx->sni_hash_size = NOPOLL_SNI_HASH_SIZE;
+	} /* end if */
+
+	entry = nopoll_new (noPollSniEntry, 1);
+	if (entry == NULL)
+		return nopoll_false;
+	entry->serverName = nopoll_strdup (serverName);
+	if (entry->serverName == NULL) {
+		nopoll_free (entry);
+		return nopoll_false;
+	} /* end if */
+	entry->cert_index = cert_index;
+
+	if (ctx->sni_count >= ctx->sni_hash_size)
+		__nopoll_ctx_sni_grow (ctx);
+
+	bucket                = __nopoll_ctx_sni_hash (serverName) & (ctx->sni_hash_size - 1);
+	entry->next           = ctx->sni_hash[bucket];
+	ctx->sni_hash[bucket] = entry;
+
+	ctx->sni_count++;
+	return nopoll_true;
+}
+
+/**
+ * @internal Creates a server SSL_CTX loaded with the certificate,
+ * private key and optional chain provided, so TLS handshakes can use
+ * it without touching the disk.
+ *
+ * @return A new SSL_CTX (SSL_CTX *) or NULL if the key material could
+ * not be loaded.
+ */
+noPollPtr __nopoll_ctx_load_certificate (noPollCtx  * ctx,
+					 const char * certificateFile,
+					 const char * privateKey,
+					 const char * optionalChainFile)
+{
+	SSL_CTX * ssl_ctx;
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	SSL_library_init ();
+	ssl_ctx = SSL_CTX_new (SSLv23_server_method ());
+#else
+	ssl_ctx = SSL_CTX_new (TLS_server_method ());
+#endif
+	if (ssl_ctx == NULL)
+		return NULL;
+
+	if (optionalChainFile && SSL_CTX_use_certificate_chain_file (ssl_ctx, optionalChainFile) != 1) {
+		nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "Unable to load chain certificate %s", optionalChainFile);
+		SSL_CTX_free (ssl_ctx);
+		return NULL;
+	} /* end if */
+
+	if (SSL_CTX_use_certificate_chain_file (ssl_ctx, certificateFile) != 1 ||
+	    SSL_CTX_use_PrivateKey_file (ssl_ctx, privateKey, SSL_FILETYPE_PEM) != 1 ||
+	    ! SSL_CTX_check_private_key (ssl_ctx)) {
+		nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "Unable to load certificate %s with key %s", certificateFile, privateKey);
+		SSL_CTX_free (ssl_ctx);
+		return NULL;
+	} /* end if */
+
+	return ssl_ctx;
+}
+
+/**
+ * @internal Copies the certificate, chain and private key preloaded
+ * on source into ssl_ctx (both SSL_CTX *). The objects are shared
+ * (reference counted), so no file is read.
+ *
+ * @return nopoll_true if the key material was configured.
+ */
+nopoll_bool __nopoll_ctx_apply_certificate (noPollPtr ssl_ctx, noPollPtr source)
+{
+	X509            * cert;
+	EVP_PKEY        * key;
+	STACK_OF(X509)  * chain = NULL;
+
+	cert = SSL_CTX_get0_certificate ((SSL_CTX *) source);
+	key  = SSL_CTX_get0_privatekey ((SSL_CTX *) source);
+	if (cert == NULL || key == NULL)
+		return nopoll_false;
+
+	if (SSL_CTX_use_certificate ((SSL_CTX *) ssl_ctx, cert) != 1 ||
+	    SSL_CTX_use_PrivateKey ((SSL_CTX *) ssl_ctx, key) != 1)
+		return nopoll_false;
+
+	SSL_CTX_get0_chain_certs ((SSL_CTX *) source, &chain);
+	if (chain && SSL_CTX_set1_chain ((SSL_CTX *) ssl_ctx, chain) != 1)
+		return nopoll_false;
+
+	return nopoll_true;
+}
+
+/**
+ * @internal Returns a value that changes when any of the files
+ * provided is replaced or modified (used to detect certificate
+ * rotations), or -1 if some of them can't be checked.
+ */
+long __nopoll_ctx_certificate_stamp (const char * certificateFile,
+				     const char * privateKey,
+				     const char * optionalChainFile)
+{
+	struct stat   info;
+	const char  * files[3];
+	long          stamp = 0;
+	int           iterator;
+
+	files[0] = certificateFile;
+	files[1] = privateKey;
+	files[2] = optionalChainFile;
+
+	for (iterator = 0; iterator < 3; iterator++) {
+		if (files[iterator] == NULL)
+			continue;
+		if (stat (files[iterator], &info) != 0)
+			return -1;
+		stamp = (stamp * 31) + (long) info.st_mtime + (long) info.st_size + (long) info.st_ino;
+	} /* end for */
+
+	/* -1 is reserved */
+	return stamp == -1 ? 0 : stamp;
+}
+
+/**
+ * @internal Acquires a reference to the SSL_CTX provided (SSL_CTX *).
+ */
+void __nopoll_ctx_ssl_ctx_ref (noPollPtr ssl_ctx)
+{
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+	CRYPTO_add (&((SSL_CTX *) ssl_ctx)->references, 1, CRYPTO_LOCK_SSL_CTX);
+#else
+	SSL_CTX_up_ref ((SSL_CTX *) ssl_ctx);
+#endif
+	return;
+}
+
+/**
+ * @internal Returns the current generation of the certificates stored
+ * on the context (see __nopoll_ctx_sni_publish).
+ */
+int __nopoll_ctx_cert_generation (noPollCtx * ctx)
+{
+	int generation;
+
+#if defined(__GNUC__)
+	generation = __sync_fetch_and_add (&ctx->cert_generation, 0);
+#else
+	nopoll_mutex_lock (ctx->ref_mutex);
+	generation = ctx->cert_generation;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+#endif
+	return generation;
+}
+
+/**
+ * @internal Starts reading the SNI snapshot published at
+ * ctx->sni_index (see __nopoll_ctx_sni_publish). Without atomic
+ * operations available, readers and writers are serialized with
+ * ctx->ref_mutex.
+ */
+static void __nopoll_ctx_sni_enter (noPollCtx * ctx)
+{
+#if defined(__GNUC__)
+	/* full barrier: ctx->sni_index is read after the increment */
+	__sync_fetch_and_add (&ctx->sni_readers, 1);
+#else
+	nopoll_mutex_lock (ctx->ref_mutex);
+#endif
+	return;
+}
+
+/**
+ * @internal Finishes reading the SNI snapshot (see
+ * __nopoll_ctx_sni_enter).
+ */
+static void __nopoll_ctx_sni_leave (noPollCtx * ctx)
+{
+#if defined(__GNUC__)
+	__sync_fetch_and_sub (&ctx->sni_readers, 1);
+#else
+	nopoll_mutex_unlock (ctx->ref_mutex);
+#endif
+	return;
+}
+
+/**
+ * @internal Releases a SNI snapshot, including the references it
+ * holds to preloaded SSL_CTX.
+ */
+static void __nopoll_ctx_sni_index_free (noPollSniIndex * index)
+{
+	noPollSniEntry * entry;
+	noPollSniEntry * next;
+	int              iterator;
+
+	for (iterator = 0; iterator < index->hash_size; iterator++) {
+		entry = index->hash[iterator];
+		while (entry) {
+			next = entry->next;
+			nopoll_free (entry->serverName);
+			SSL_CTX_free (entry->ssl_ctx);
+			nopoll_free (entry);
+			entry = next;
+		} /* end while */
+	} /* end for */
+
+	nopoll_free (index->hash);
+	nopoll_free (index);
+	return;
+}
+
+/**
+ * @internal Releases the SNI snapshots replaced. Unless all is
+ * requested (the context is being released), nothing is done while a
+ * handshake is reading a snapshot: they are released by a later call.
+ * The caller must hold ctx->ref_mutex.
+ */
+static void __nopoll_ctx_sni_collect (noPollCtx * ctx, nopoll_bool all)
+{
+	noPollSniIndex * retired;
+	noPollSniIndex * next;
+
+#if defined(__GNUC__)
+	/* full barrier: the snapshot swap is visible before readers
+	 * are checked, so readers entering from now on get the new
+	 * one */
+	if (! all && __sync_fetch_and_add (&ctx->sni_readers, 0) != 0)
+		return;
+#endif
+
+	retired          = ctx->sni_retired;
+	ctx->sni_retired = NULL;
+	while (retired) {
+		next = retired->next;
+		__nopoll_ctx_sni_index_free (retired);
+		retired = next;
+	} /* end while */
+	return;
+}
+
+/**
+ * @internal Called each time certificates stored on the context
+ * change: rebuilds the SNI snapshot read by handshakes (named
+ * certificates with key material preloaded) and publishes it,
+ * retiring the previous one. The caller must hold ctx->ref_mutex.
+ */
+void __nopoll_ctx_sni_publish (noPollCtx * ctx)
+{
+	noPollSniIndex    * index = NULL;
+	noPollSniIndex    * previous;
+	noPollSniEntry    * entry;
+	noPollSniEntry    * copy;
+	noPollCertificate * cert;
+	int                 iterator;
+
+	/* listeners rebuild the SSL_CTX they reuse */
+	ctx->cert_generation++;
+
+	if (ctx->sni_loaded > 0) {
+		index = nopoll_new (noPollSniIndex, 1);
+		if (index)
+			index->hash = nopoll_new (noPollSniEntry *, ctx->sni_hash_size);
+		if (index == NULL || index->hash == NULL) {
+			nopoll_free (index);
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to update the SNI index, keeping current one");
+			return;
+		} /* end if */
+		index->hash_size = ctx->sni_hash_size;
+
+		for (iterator = 0; iterator < ctx->sni_hash_size; iterator++) {
+			for (entry = ctx->sni_hash[iterator]; entry; entry = entry->next) {
+				cert = &(ctx->certificates[entry->cert_index]);
+				if (cert->ssl_ctx == NULL)
+					continue;
+				copy = nopoll_new (noPollSniEntry, 1);
+				if (copy == NULL)
+					continue;
+				copy->serverName = nopoll_strdup (entry->serverName);
+				if (copy->serverName == NULL) {
+					nopoll_free (copy);
+					continue;
+				} /* end if */
+				copy->cert_index = entry->cert_index;
+				copy->ssl_ctx    = cert->ssl_ctx;
+				__nopoll_ctx_ssl_ctx_ref (copy->ssl_ctx);
+
+				copy->next             = index->hash[iterator];
+				index->hash[iterator]  = copy;
+			} /* end for */
+		} /* end for */
+	} /* end if */
+
+	/* publish (the snapshot is complete before it is visible)
+	 * and retire the previous one */
+	previous = ctx->sni_index;
+#if defined(__GNUC__)
+	__sync_synchronize ();
+#endif
+	ctx->sni_index = index;
+	if (previous) {
+		previous->next   = ctx->sni_retired;
+		ctx->sni_retired = previous;
+	} /* end if */
+	__nopoll_ctx_sni_collect (ctx, nopoll_false);
+	return;
+}
+
+/**
+ * @internal SSL servername callback installed on listener
+ * connections: switches the TLS session to the SSL_CTX preloaded for
+ * the server name requested by the client (if any). Sessions without
+ * SNI or asking for an unknown name keep the default certificate.
+ *
+ * The lookup is done on the snapshot published (see
+ * __nopoll_ctx_sni_publish), without taking ctx->ref_mutex.
+ */
+int __nopoll_ctx_sni_select (SSL * ssl, int * alert, void * user_data)
+{
+	noPollCtx         * ctx        = (noPollCtx *) user_data;
+	const char        * serverName = SSL_get_servername (ssl, TLSEXT_NAMETYPE_host_name);
+	noPollSniIndex    * index;
+	noPollSniEntry    * entry;
+
+	if (serverName == NULL || ctx == NULL)
+		return SSL_TLSEXT_ERR_OK;
+
+	/* the session takes its own reference to the SSL_CTX, so a
+	 * reload (see nopoll_ctx_reload_certificate) does not affect
+	 * handshakes already running */
+	__nopoll_ctx_sni_enter (ctx);
+	index = ctx->sni_index;
+	entry = index ? __nopoll_ctx_sni_match (index->hash, index->hash_size, serverName) : NULL;
+	if (entry) {
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Selected certificate for serverName=%s (entry %s)", serverName, entry->serverName);
+		SSL_set_SSL_CTX (ssl, entry->ssl_ctx);
+	} /* end if */
+	__nopoll_ctx_sni_leave (ctx);
+
+	return SSL_TLSEXT_ERR_OK;
+}
+
+/**
+ * @internal Installs the SNI selection callback on the SSL_CTX
+ * provided (an SSL_CTX * used by a listener connection) when the
+ * context has named certificates preloaded.
+ */
+void __nopoll_ctx_sni_install (noPollCtx * ctx, noPollPtr ssl_ctx)
+{
+	nopoll_bool loaded;
+
+	if (ctx == NULL || ssl_ctx == NULL)
+		return;
+
+	__nopoll_ctx_sni_enter (ctx);
+	loaded = (ctx->sni_index != NULL);
+	__nopoll_ctx_sni_leave (ctx);
+
+	if (! loaded)
+		return;
+
+	SSL_CTX_set_tlsext_servername_callback ((SSL_CTX *) ssl_ctx, __nopoll_ctx_sni_select);
+	SSL_CTX_set_tlsext_servername_arg ((SSL_CTX *) ssl_ctx, ctx);
+	return;
+}
+
+/**
+ * @internal Releases the SNI index.
+ */
+void __nopoll_ctx_sni_release (noPollCtx * ctx)
+{
+	noPollSniEntry * entry;
+	noPollSniEntry * next;
+	int              iterator;
+
+	for (iterator = 0; iterator < ctx->sni_hash_size; iterator++) {
+		entry = ctx->sni_hash[iterator];
+		while (entry) {
+			next = entry->next;
+			nopoll_free (entry->serverName);
+			nopoll_free (entry);
+			entry = next;
+		} /* end while */
+	} /* end for */
+
+	nopoll_free (ctx->sni_hash);
+	ctx->sni_hash      = NULL;
+	ctx->sni_hash_size = 0;
+	ctx->sni_count     = 0;
+	ctx->sni_loaded    = 0;
+
+	/* and the snapshots published */
+	if (ctx->sni_index) {
+		ctx->sni_index->next = ctx->sni_retired;
+		ctx->sni_retired     = ctx->sni_index;
+		ctx->sni_index       = NULL;
+	} /* end if */
+	__nopoll_ctx_sni_collect (ctx, nopoll_true);
+	return;
+}
+
+/** 
+ * @brief Allows to find the certificate associated to the provided serverName. 
+ *
+ * @param ctx The context where the operation will take place.
+ *
+ * @param serverName the servername to use as pattern to find the
+ * right certificate (compared ignoring case, through a hash index).
+ * If NULL is provided the function first looks for
+ * a certificate that isn't associated to any serverName and, when
+ * there is none, it falls back to reporting the first certificate
+ * stored, whatever serverName it is associated to.
+ *
+ * @param certificateFile If provided a reference and the function
+ * returns nopoll_true, it will contain the certificateFile found.
+ *
+ * @param privateKey If provided a reference and the function
+ * returns nopoll_true, it will contain the privateKey found.
+ *
+ * @param optionalChainFile If provided a reference and the function
+ * returns nopoll_true, it will contain the optionalChainFile found.
+ *
+ * NOTE: the values reported are references owned by the context, not
+ * copies: they must not be released by the caller and they are only
+ * valid while the context is alive and the certificate is not
+ * replaced.
+ *
+ * @return nopoll_true in the case the certificate was found,
+ * otherwise nopoll_false is returned.
+ */
+nopoll_bool    nopoll_ctx_find_certificate (noPollCtx   * ctx, 
+					    const char  * serverName, 
+					    const char ** certificateFile, 
+					    const char ** privateKey, 
+					    const char ** optionalChainFile)
+{
+	noPollCertificate * cert = NULL;
+	noPollSniEntry    * entry;
+
+	int iterator = 0;
+	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Finding a certificate for serverName=%s", serverName ? serverName : "<not defined>");
+
+	/* acquire the mutex to check the certificate store while it
+	 * may be updated by nopoll_ctx_set_certificate () */
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	if (serverName) {
+		/* named certificates are indexed by serverName */
+		entry = __nopoll_ctx_sni_lookup (ctx->sni_hash, ctx->sni_hash_size, serverName);
+		if (entry)
+			cert = &(ctx->certificates[entry->cert_index]);
+	} else {
+		/* look for the certificate without serverName */
+		while (iterator < ctx->certificates_length) {
+			if (ctx->certificates[iterator].serverName == NULL) {
+				cert = &(ctx->certificates[iterator]);
+				break;
+			} /* end if */
+
+			/* next position */
+			iterator++;
+		} /* end while */
+
+		/* check for default certificate when serverName isn't
+		 * defined: report the first certificate stored,
+		 * whatever serverName it is associated to.
+		 *
+		 * NOTE: this loop used to have the iterator++ placed
+		 * outside the while body (a misplaced brace). It did
+		 * not spin because cert is the address of an array
+		 * position, so it is never NULL and the first
+		 * iteration always returned */
+		if (cert == NULL && ctx->certificates_length > 0) {
+			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "   serverName not defined, selecting first certificate from the list");
+			cert = &(ctx->certificates[0]);
+		} /* end if */
+	} /* end if */
+
+	if (cert == NULL) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return nopoll_false;
+	} /* end if */
+
+	if (certificateFile)
+		(*certificateFile)   = cert->certificateFile;
+	if (privateKey)
+		(*privateKey)        = cert->privateKey;
+	if (optionalChainFile)
+		(*optionalChainFile) = cert->optionalChainFile;
+
+	nopoll_mutex_unlock (ctx->ref_mutex);
+	return nopoll_true;
+}
+
+/**
+ * @internal Looks for a certificate stored under exactly the
+ * serverName provided, without the fallback to the default
+ * certificate implemented by \ref nopoll_ctx_find_certificate.
+ *
+ * NOTE: the caller must hold ctx->ref_mutex.
+ *
+ * @param ctx The context whose certificate store is checked.
+ *
+ * @param serverName The serverName to look for (NULL matches the
+ * certificate stored without serverName).
+ *
+ * @return The position of the certificate in ctx->certificates or -1
+ * when no certificate with that exact serverName is stored.
+ */
+static int __nopoll_ctx_find_certificate_exact (noPollCtx * ctx, const char * serverName)
+{
+	noPollSniEntry * entry;
+	int              iterator = 0;
+
+	/* named certificates are indexed */
+	if (serverName) {
+		entry = __nopoll_ctx_sni_lookup (ctx->sni_hash, ctx->sni_hash_size, serverName);
+		return entry ? entry->cert_index : -1;
+	} /* end if */
+
+	while (iterator < ctx->certificates_length) {
+		if (ctx->certificates[iterator].serverName == NULL)
+			return iterator;
+
+		/* next position */
+		iterator++;
+	} /* end while */
+
+	return -1;
+}
+
+/**
+ * @brief Allows to install a certificate to be used in general by all
+ * listener connections working under the provided context.
+ *
+ * @param ctx The context where the certificate will be installed.
+ *
+ * @param serverName The optional server name to limit the use of
+ * this certificate to the value provided here. Provide a NULL value
+ * to make the certificate work under any server notified
+ * (Host: header) or via SNI (server name identification associated to
+ * the TLS transport).
+ *
+ * Certificates installed with a serverName are loaded when this
+ * function is called and selected during the TLS handshake of
+ * incoming connections requesting that name through SNI (the
+ * certificate configured on the listener, or the default one, is used
+ * otherwise). The serverName can be a wildcard covering one label, for
+ * example *.example.com, and it is compared ignoring case.
+ *
+ * @param certificateFile The certificate file to be installed. 
+ *
+ * @param privateKey The private key file to be used.
+ *
+ * @param optionalChainFile Optional chain file with additional
+ * material to complete the certificate definition.
+ *
+ * @return nopoll_true if the certificate was installed otherwise
+ * nopoll_false. The function returns nopoll_false when ctx, certificateFile or privateKey are NULL.
+ */ 
+nopoll_bool           nopoll_ctx_set_certificate (noPollCtx  * ctx, 
+						  const char * serverName, 
+						  const char * certificateFile, 
+						  const char * privateKey, 
+						  const char * optionalChainFile)
+{
+	int length;
+	noPollCertificate * cert;
+	noPollCertificate * certificates;
+	SSL_CTX           * ssl_ctx;
+	long                stamp;
+
+	/* check values before proceed */
+	nopoll_return_val_if_fail (ctx, ctx && certificateFile && privateKey, nopoll_false);
+
+	/* acquire the mutex to protect the certificate store while it
+	 * is checked and updated */
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	/* check if the certificate is already installed
+	 *
+	 * NOTE: this check used to call nopoll_ctx_find_certificate (),
+	 * which falls back to reporting the first certificate stored
+	 * when serverName is NULL. That made installing a certificate
+	 * without serverName a silent no-op as soon as any other
+	 * certificate was present. An exact match is what is needed
+	 * here (and doing it inside the critical section also removes
+	 * the check/update race) */
+	if (__nopoll_ctx_find_certificate_exact (ctx, serverName) != -1) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return nopoll_true;
+	} /* end if */
+
+	/* preload key material (outside the critical section) so
+	 * TLS handshakes can use it without file I/O. A certificate
+	 * that can't be loaded is still stored, and reported by
+	 * nopoll_ctx_find_certificate, but handshakes read its files
+	 * (and it is not used for SNI) */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+	stamp   = __nopoll_ctx_certificate_stamp (certificateFile, privateKey, optionalChainFile);
+	ssl_ctx = __nopoll_ctx_load_certificate (ctx, certificateFile, privateKey, optionalChainFile);
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	/* check again: it may have been installed meanwhile */
+	if (__nopoll_ctx_find_certificate_exact (ctx, serverName) != -1) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		if (ssl_ctx)
+			SSL_CTX_free (ssl_ctx);
+		return nopoll_true;
+	} /* end if */
+
+	/* update certificate storage to hold all values */
+	length = ctx->certificates_length + 1;
+	if (length == 1)
+		certificates = nopoll_new (noPollCertificate, 1);
+	else
+		certificates = (noPollCertificate *) nopoll_realloc (ctx->certificates, sizeof (noPollCertificate) * (length));
+
+	/* check the allocation before using it: storing the result
+	 * directly into ctx->certificates and then indexing it
+	 * dereferenced NULL when the allocation failed, and left
+	 * certificates_length already increased */
+	if (certificates == NULL) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to store the certificate provided");
+		if (ssl_ctx)
+			SSL_CTX_free (ssl_ctx);
+		return nopoll_false;
+	} /* end if */
+	ctx->certificates        = certificates;
+
+	/* index named certificates */
+	if (serverName && ! __nopoll_ctx_sni_add (ctx, serverName, length - 1)) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to acquire memory to index the certificate provided");
+		if (ssl_ctx)
+			SSL_CTX_free (ssl_ctx);
+		return nopoll_false;
+	} /* end if */
+	ctx->certificates_length = length;
+
+	/* hold certificate */
+	cert = &(ctx->certificates[length - 1]);
+
+	cert->serverName = NULL;
+	if (serverName)
+		cert->serverName         = nopoll_strdup (serverName);
+
+	cert->certificateFile = NULL;
+	if (certificateFile)
+		cert->certificateFile    = nopoll_strdup (certificateFile);
+
+	cert->privateKey = NULL;
+	if (privateKey)
+		cert->privateKey         = nopoll_strdup (privateKey);
+
+	cert->optionalChainFile = NULL;
+	if (optionalChainFile)
+		cert->optionalChainFile  = nopoll_strdup (optionalChainFile);
+
+	cert->ssl_ctx = ssl_ctx;
+	cert->stamp   = stamp;
+	if (serverName && ssl_ctx)
+		ctx->sni_loaded++;
+	__nopoll_ctx_sni_publish (ctx);
+
+	/* release the mutex */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return nopoll_true;
+}
+
+/**
+ * @brief Replaces the certificate installed for the provided
+ * serverName (see \ref nopoll_ctx_set_certificate) with the key
+ * material found at the files provided, for example after renewing
+ * it.
+ *
+ * The new certificate is loaded first and then swapped in
+ * atomically: handshakes already running keep using the previous
+ * one, while connections accepted after this call get the new
+ * one. When the files can't be loaded the current certificate is
+ * kept and the function fails. The function can be called from any
+ * thread. When no certificate is installed for the serverName, it is
+ * installed.
+ *
+ * NOTE: references reported by \ref nopoll_ctx_find_certificate for
+ * this certificate are no longer valid after this call.
+ *
+ * @param ctx The context where the certificate is installed.
+ *
+ * @param serverName The server name of the certificate to replace
+ * (NULL for the certificate installed without server name).
+ *
+ * @param certificateFile The certificate file to be installed.
+ *
+ * @param privateKey The private key file to be used.
+ *
+ * @param optionalChainFile Optional chain file with additional
+ * material to complete the certificate definition.
+ *
+ * @return nopoll_true if the certificate was replaced (or installed),
+ * otherwise nopoll_false.
+ */
+nopoll_bool           nopoll_ctx_reload_certificate (noPollCtx  * ctx,
+						     const char * serverName,
+						     const char * certificateFile,
+						     const char * privateKey,
+						     const char * optionalChainFile)
+{
+	noPollCertificate * cert;
+	SSL_CTX           * ssl_ctx;
+	SSL_CTX           * previous;
+	long                stamp;
+	int                 position;
+	char              * files[3];
+
+	nopoll_return_val_if_fail (ctx, ctx && certificateFile && privateKey, nopoll_false);
+
+	/* load new key material without holding any lock */
+	stamp   = __nopoll_ctx_certificate_stamp (certificateFile, privateKey, optionalChainFile);
+	ssl_ctx = __nopoll_ctx_load_certificate (ctx, certificateFile, privateKey, optionalChainFile);
+	if (ssl_ctx == NULL) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to reload certificate for serverName=%s, keeping current one",
+			    serverName ? serverName : "<not defined>");
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	position = __nopoll_ctx_find_certificate_exact (ctx, serverName);
+	if (position == -1) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		SSL_CTX_free (ssl_ctx);
+		return nopoll_ctx_set_certificate (ctx, serverName, certificateFile, privateKey, optionalChainFile);
+	} /* end if */
+
+	/* swap */
+	cert     = &(ctx->certificates[position]);
+	previous = cert->ssl_ctx;
+	files[0] = cert->certificateFile;
+	files[1] = cert->privateKey;
+	files[2] = cert->optionalChainFile;
+
+	cert->ssl_ctx           = ssl_ctx;
+	cert->stamp             = stamp;
+	cert->certificateFile   = nopoll_strdup (certificateFile);
+	cert->privateKey        = nopoll_strdup (privateKey);
+	cert->optionalChainFile = optionalChainFile ? nopoll_strdup (optionalChainFile) : NULL;
+	if (serverName && previous == NULL)
+		ctx->sni_loaded++;
+	__nopoll_ctx_sni_publish (ctx);
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Reloaded certificate for serverName=%s from %s",
+		    serverName ? serverName : "<not defined>", certificateFile);
+
+	/* sessions using the previous SSL_CTX hold their own
+	 * references */
+	if (previous)
+		SSL_CTX_free (previous);
+	nopoll_free (files[0]);
+	nopoll_free (files[1]);
+	nopoll_free (files[2]);
+
+	return nopoll_true;
+}
+
+/**
+ * @internal Configures on the ssl_ctx provided (an SSL_CTX * being
+ * prepared for an incoming connection) the key material preloaded for
+ * the certificate reported by nopoll_ctx_find_certificate (ctx, NULL,
+ * ...).
+ *
+ * @return nopoll_true if the key material was configured, nopoll_false
+ * when there is no certificate or it is not preloaded.
+ */
+nopoll_bool           __nopoll_ctx_use_certificate (noPollCtx * ctx, noPollPtr ssl_ctx)
+{
+	noPollCertificate * cert;
+	nopoll_bool         result = nopoll_false;
+	int                 position;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	position = __nopoll_ctx_find_certificate_exact (ctx, NULL);
+	if (position == -1 && ctx->certificates_length > 0)
+		position = 0;
+	if (position != -1) {
+		cert = &(ctx->certificates[position]);
+		if (cert->ssl_ctx)
+			result = __nopoll_ctx_apply_certificate (ssl_ctx, cert->ssl_ctx);
+	} /* end if */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Checks the files of a certificate stored on the context,
+ * reloading it when they changed. Returns nopoll_false when there is
+ * no certificate at that position.
+ */
+nopoll_bool __nopoll_ctx_watch_certificate (noPollCtx * ctx, int position)
+{
+	noPollCertificate * cert;
+	char              * files[4];
+	long                stamp;
+	long                current;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	if (position >= ctx->certificates_length) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return nopoll_false;
+	} /* end if */
+	cert     = &(ctx->certificates[position]);
+	files[0] = cert->serverName ? nopoll_strdup (cert->serverName) : NULL;
+	files[1] = nopoll_strdup (cert->certificateFile);
+	files[2] = nopoll_strdup (cert->privateKey);
+	files[3] = cert->optionalChainFile ? nopoll_strdup (cert->optionalChainFile) : NULL;
+	stamp    = cert->stamp;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	__nopoll_ctx_watch_file (ctx, files[1]);
+	__nopoll_ctx_watch_file (ctx, files[2]);
+	__nopoll_ctx_watch_file (ctx, files[3]);
+
+	/* reload on changes (a failure is retried on next check, for
+	 * example, when files are still being written) */
+	current = __nopoll_ctx_certificate_stamp (files[1], files[2], files[3]);
+	if (current != -1 && current != stamp)
+		nopoll_ctx_reload_certificate (ctx, files[0], files[1], files[2], files[3]);
+
+	nopoll_free (files[0]);
+	nopoll_free (files[1]);
+	nopoll_free (files[2]);
+	nopoll_free (files[3]);
+	return nopoll_true;
+}
+
+/**
+ * @internal Foreach handler used by the certificate watcher to check
+ * listeners.
+ */
+nopoll_bool __nopoll_ctx_watch_listener (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	if (nopoll_conn_role (conn) == NOPOLL_ROLE_MAIN_LISTENER)
+		__nopoll_listener_watch_certificate (conn);
+	return nopoll_false;
+}
+
+/**
+ * @internal Watches (through inotify, when available) the directory
+ * holding the file provided, so the certificate watcher only checks
+ * files once they change. Directories are watched instead of files
+ * because renewals usually replace them.
+ */
+void __nopoll_ctx_watch_file (noPollCtx * ctx, const char * file)
+{
+#if defined(NOPOLL_HAVE_INOTIFY)
+	char         directory[4096];
+	const char * slash;
+	size_t       length;
+
+	if (ctx->cert_watch_fd < 0 || file == NULL)
+		return;
+
+	slash = strrchr (file, '/');
+	if (slash == NULL) {
+		strcpy (directory, ".");
+	} else {
+		length = (slash == file) ? 1 : (size_t) (slash - file);
+		if (length >= sizeof (directory))
+			return;
+		memcpy (directory, file, length);
+		directory[length] = 0;
+	} /* end if */
+
+	/* watching a directory already watched does nothing */
+	inotify_add_watch (ctx->cert_watch_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB);
+#endif
+	return;
+}
+
+/**
+ * @internal Worker task that checks the files of the certificates
+ * installed on the context and on listeners, reloading those that
+ * changed (see nopoll_ctx_watch_certificates). Checks requested while
+ * it runs are done before finishing.
+ */
+void __nopoll_ctx_watch_run (noPollPtr data, nopoll_bool cancelled)
+{
+	noPollCtx   * ctx   = (noPollCtx *) data;
+	nopoll_bool   again = ! cancelled;
+	int           position;
+
+	while (again) {
+		/* check certificates installed on the context */
+		position = 0;
+		while (__nopoll_ctx_watch_certificate (ctx, position))
+			position++;
+
+		/* and on listeners */
+		nopoll_ctx_foreach_conn (ctx, __nopoll_ctx_watch_listener, NULL);
+
+		nopoll_mutex_lock (ctx->ref_mutex);
+		again                   = ctx->cert_watch_pending;
+		ctx->cert_watch_pending = nopoll_false;
+		nopoll_mutex_unlock (ctx->ref_mutex);
+	} /* end while */
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	ctx->cert_watch_running = nopoll_false;
+	ctx->cert_watch_pending = nopoll_false;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+	return;
+}
+
+/**
+ * @internal Timer handler that implements the certificate watcher:
+ * files are checked (stat and PEM parsing) on the worker pool, so the
+ * loop is not blocked. With inotify available, they are only checked
+ * when their directories report changes or certificates were updated
+ * (new files to watch).
+ */
+void __nopoll_ctx_watch_certificates (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+{
+	long         interval;
+	nopoll_bool  current;
+	nopoll_bool  check;
+	nopoll_bool  queue = nopoll_false;
+#if defined(NOPOLL_HAVE_INOTIFY)
+	char         events[4096];
+#endif
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	check = ctx->cert_watch_fd < 0 || ctx->cert_watch_generation != ctx->cert_generation;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+#if defined(NOPOLL_HAVE_INOTIFY)
+	/* drain events (non blocking descriptor) */
+	while (ctx->cert_watch_fd >= 0 && read (ctx->cert_watch_fd, events, sizeof (events)) > 0)
+		check = nopoll_true;
+#endif
+
+	if (check) {
+		nopoll_mutex_lock (ctx->ref_mutex);
+		ctx->cert_watch_generation = ctx->cert_generation;
+		if (ctx->cert_watch_running) {
+			ctx->cert_watch_pending = nopoll_true;
+		} else {
+			ctx->cert_watch_running = nopoll_true;
+			queue                   = nopoll_true;
+		} /* end if */
+		nopoll_mutex_unlock (ctx->ref_mutex);
+
+		/* without worker support, the check runs here */
+		if (queue && ! __nopoll_worker_run_task (ctx, __nopoll_ctx_watch_run, ctx))
+			__nopoll_ctx_watch_run (ctx, nopoll_false);
+	} /* end if */
+
+	/* schedule next check unless the watcher was reconfigured */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	current  = (ctx->cert_watch_timer == timer_id);
+	interval = ctx->cert_watch_interval;
+	if (current)
+		ctx->cert_watch_timer = 0;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	if (current)
+		nopoll_ctx_watch_certificates (ctx, interval);
+	return;
+}
+
+/**
+ * @brief Enables a watcher that reloads certificates when their files
+ * change, so they can be renewed without restarting listeners.
+ *
+ * Every interval, the files of the certificates installed on the
+ * context (\ref nopoll_ctx_set_certificate) and on listeners (\ref
+ * nopoll_listener_set_certificate) are checked and, when they were
+ * modified or replaced, the certificate is reloaded (see \ref
+ * nopoll_ctx_reload_certificate). Files that can't be loaded (for
+ * example, while they are being written) are checked again on the
+ * next interval.
+ *
+ * The watcher is driven from \ref nopoll_loop_wait by a timer (see
+ * \ref nopoll_timer_add), so the loop must be running, but files are
+ * checked and loaded on the worker pool. Where inotify is available
+ * (Linux), files are only checked after their directories report
+ * changes.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param interval Check interval in microseconds. Use 0 to disable
+ * the watcher.
+ */
+void                  nopoll_ctx_watch_certificates (noPollCtx * ctx, long interval)
+{
+	int timer_id;
+
+	nopoll_return_if_fail (ctx, ctx && interval >= 0);
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	timer_id                 = ctx->cert_watch_timer;
+	ctx->cert_watch_timer    = 0;
+	ctx->cert_watch_interval = interval;
+#if defined(NOPOLL_HAVE_INOTIFY)
+	/* kept until the context is released: a check may be
+	 * running on the worker pool */
+	if (interval > 0 && ctx->cert_watch_fd < 0) {
+		ctx->cert_watch_fd         = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+		ctx->cert_watch_generation = ctx->cert_generation - 1;
+	} /* end if */
+#endif
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	/* replace the current timer (if any) */
+	if (timer_id > 0)
+		nopoll_timer_cancel (ctx, timer_id);
+	if (interval == 0)
+		return;
+
+	timer_id = nopoll_timer_add (ctx, interval, __nopoll_ctx_watch_certificates, NULL);
+	nopoll_mutex_lock (ctx->ref_mutex);
+	ctx->cert_watch_timer = timer_id;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+	return;
+}
+
+/**
+ * @brief Allows to configure how long TLS handshakes may take before
+ * the connection is closed.
+ *
+ * TLS handshakes (on accepted connections and on connections created
+ * with \ref nopoll_conn_tls_new) don't block: they progress from \ref
+ * nopoll_loop_wait, \ref nopoll_conn_is_ready and \ref
+ * nopoll_conn_get_msg as the peer sends (or accepts) data. A peer
+ * that doesn't complete the handshake in this time is disconnected.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param microseconds Handshake timeout. Use 0 to restore the
+ * default value (\ref NOPOLL_TLS_HANDSHAKE_TIMEOUT).
+ */
+void                  nopoll_ctx_set_tls_handshake_timeout (noPollCtx * ctx, long microseconds)
+{
+	nopoll_return_if_fail (ctx, ctx && microseconds >= 0);
+
+	if (microseconds == 0)
+		microseconds = NOPOLL_TLS_HANDSHAKE_TIMEOUT;
+	ctx->tls_handshake_timeout = microseconds;
+	return;
+}
+
+/**
+ * @brief Allows to run the TLS handshake of accepted connections on a
+ * pool of worker threads instead of the thread running \ref
+ * nopoll_loop_wait.
+ *
+ * Private key operations done while accepting TLS connections are
+ * expensive: under reconnection storms they take most of the loop
+ * time, delaying messages of connections already established. With
+ * workers configured, each handshake step of an accepted connection
+ * runs on the pool and the connection is watched by the loop again
+ * once the step finishes.
+ *
+ * Configure the pool before running \ref nopoll_loop_wait. Thread
+ * handlers must be installed (see \ref nopoll_thread_handlers) and
+ * the TLS post check (see \ref nopoll_ctx_set_post_ssl_check) is
+ * called from a worker thread. Connections whose handshake fails
+ * on a worker are returned to the loop, which closes them, so on
+ * close handlers are always called by the thread running \ref
+ * nopoll_loop_wait.
+ *
+ * Workers are only available on POSIX platforms built with threads
+ * support.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param workers Number of worker threads. Use 0 to stop the pool and
+ * run handshakes on the loop again.
+ *
+ * @return nopoll_true if the pool was configured, otherwise
+ * nopoll_false (for example, when noPoll was built without POSIX
+ * threads support).
+ */
+nopoll_bool           nopoll_ctx_set_tls_handshake_workers (noPollCtx * ctx, int workers)
+{
+	nopoll_return_val_if_fail (ctx, ctx && workers >= 0, nopoll_false);
+
+	/* replace the current pool (if any) */
+	__nopoll_worker_release (ctx);
+	if (workers == 0)
+		return nopoll_true;
+	return __nopoll_worker_start (ctx, workers, nopoll_true);
+}
+
+/** 
+ * @brief Allows to configure the on open handler, the handler that is
+ * called when an incoming websocket connection is received and all
  * websocket client handshake data was received (but not yet replied).
  *
- * This handler differs from \ref nopoll_ctx_set_on_accept in that this
- * one is called after all client handshake data was received.
+ * This handler differs from \ref nopoll_ctx_set_on_accept in that this
+ * one is called after all client handshake data was received.
+ *
+ * Note the connection is still not fully working at this point
+ * because the handshake hasn't been sent to the remote peer yet. This
+ * means that attempting to send any content inside this handler (for
+ * example by using \ref nopoll_conn_send_text) will cause a protocol
+ * violation (because remote side is expecting a handshake reply but
+ * received something different). 
+ *
+ * In the case you want to sent content right away after receiving a
+ * connection (on a listener), you can use \ref
+ * nopoll_ctx_set_on_ready "On Ready" handler which is called just
+ * after the connection has been fully accepted and handshake reply is
+ * fully written.
+ *
+ * @param ctx The context that will be configured.
+ *
+ * @param on_open The handler to be configured on this context.
+ *
+ * @param user_data User defined pointer to be passed to the on open
+ * handler
+ */
+void           nopoll_ctx_set_on_open (noPollCtx            * ctx,
+				       noPollActionHandler    on_open,
+				       noPollPtr              user_data)
+{
+	/* NOTE: a NULL handler is rejected by the check above, so the
+	 * handler cannot be uninstalled through this function (unlike
+	 * \ref nopoll_ctx_set_on_msg, which does accept NULL) */
+	nopoll_return_if_fail (ctx, ctx && on_open);
+
+	/* set the handler */
+	ctx->on_open      = on_open;
+	ctx->on_open_data = user_data;
+	return;
+}
+
+/** 
+ * @brief Allows to configure a handler that is called when a
+ * connection is received and it is ready to send and receive because
+ * all WebSocket handshake protocol finished OK.
+ *
+ * Unlike handlers configured at \ref nopoll_ctx_set_on_open and \ref
+ * nopoll_ctx_set_on_accept which get notified when the connection
+ * isn't still working (because WebSocket handshake wasn't finished
+ * yet), on ready handlers configured here will get called just after
+ * the WebSocket handshake has taken place.
+ *
+ * @param ctx The context that will be configured.
+ *
+ * @param on_ready The handler to be called when a connection is fully
+ * ready to send and receive content because WebSocket handshake has
+ * finished. The function must return nopoll_true to accept the
+ * connection. By returning nopoll_false the handler is signalling to
+ * terminate the connection.
+ *
+ * @param user_data Optional user data pointer passed to the on ready
+ * handler.
+ * 
+ */
+void           nopoll_ctx_set_on_ready (noPollCtx          * ctx,
+					noPollActionHandler  on_ready,
+					noPollPtr            user_data)
+{
+	/* see note at nopoll_ctx_set_on_open () about NULL handlers */
+	nopoll_return_if_fail (ctx, ctx && on_ready);
+
+	/* set the handler */
+	ctx->on_ready      = on_ready;
+	ctx->on_ready_data = user_data;
+	return;
+}
+
+/** 
+ * @brief Allows to configure the accept handler that will be called
+ * when a connection is received but before any handshake takes place.
+ *
+ * @param ctx The context that will be configured.
+ *
+ * @param on_accept The handler to be called when a connection is
+ * received. Here the handler must return nopoll_true to accept the
+ * connection, otherwise nopoll_false should be returned.
+ *
+ * @param user_data Optional user data pointer passed to the on accept
+ * handler.
+ *
+ */
+void              nopoll_ctx_set_on_accept (noPollCtx            * ctx,
+					    noPollActionHandler    on_accept,
+					    noPollPtr              user_data)
+{
+	/* see note at nopoll_ctx_set_on_open () about NULL handlers */
+	nopoll_return_if_fail (ctx, ctx && on_accept);
+
+	/* set the handler */
+	ctx->on_accept      = on_accept;
+	ctx->on_accept_data = user_data;
+	return;
+}
+
+/** 
+ * @brief Allows to set a general handler to get notifications about a
+ * message received over any connection that is running under the
+ * provided context (noPollCtx).
+ *
+ * @param ctx The context where the notification will happen
+ *
+ * @param on_msg The handler to be called when an incoming message is
+ * received.
+ *
+ * @param user_data User defined pointer that is passed in into the
+ * handler when called.
+ *
+ * Note that the handler configured here will be overridden by the handler configured by \ref nopoll_conn_set_on_msg
+ *
+ */
+void           nopoll_ctx_set_on_msg    (noPollCtx              * ctx,
+					 noPollOnMessageHandler   on_msg,
+					 noPollPtr                user_data)
+{
+	nopoll_return_if_fail (ctx, ctx);
+	
+	/* set new handler */
+	ctx->on_msg      = on_msg;
+	ctx->on_msg_data = user_data;
+
+	return;
+}
+
+/**
+ * @brief Allows to set a general handler to stream messages received
+ * over any connection running under the provided context (see \ref
+ * nopoll_conn_set_on_msg_chunk).
+ *
+ * @param ctx The context where the notification will happen.
+ *
+ * @param on_msg_chunk The handler to be called with each piece of
+ * message received. Use NULL to disable streaming.
+ *
+ * @param user_data User defined pointer that is passed in into the
+ * handler when called.
+ *
+ * Note that the handler configured here will be overridden by the
+ * handler configured by \ref nopoll_conn_set_on_msg_chunk.
+ */
+void           nopoll_ctx_set_on_msg_chunk (noPollCtx                   * ctx,
+					    noPollOnMessageChunkHandler   on_msg_chunk,
+					    noPollPtr                     user_data)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->on_msg_chunk      = on_msg_chunk;
+	ctx->on_msg_chunk_data = user_data;
+
+	return;
+}
+
+/** 
+ * @brief Allows to configure the handler that will be used to let
+ * user land code to define OpenSSL SSL_CTX object.
+ *
+ * By default, SSL_CTX (SSL Context) object is created by default
+ * settings that works for most of the cases. In the case you want to
+ * configure particular configurations that should be enabled on the
+ * provided SSL_CTX that is going to be used by the client ---while
+ * connecting--- or server ---while receiving a connection--- then use
+ * this function to setup your creator handler.
+ *
+ * See \ref noPollSslContextCreator for more information about this
+ * handler.
+ *
+ * @param ctx The context that will be configured.
+ *
+ * @param context_creator The handler to be called to create the
+ * SSL_CTX object. Passing NULL restores the default creation done by
+ * the library.
+ *
+ * @param user_data User defined pointer to be passed to the handler
+ * when it is called.
+ */
+void           nopoll_ctx_set_ssl_context_creator (noPollCtx                * ctx,
+						   noPollSslContextCreator    context_creator,
+						   noPollPtr                  user_data)
+{
+	if (ctx == NULL)
+		return;
+
+	/* set handlers as indicated by the caller */
+	ctx->context_creator      = context_creator;
+	ctx->context_creator_data = user_data;
+	return;
+}
+
+/** 
+ * @brief Allows to configure a function that will implement a post SSL/TLS check.
+ *
+ * See the following function to get more information: \ref noPollSslPostCheck
+ *
+ * @param ctx The context where the operation is taking place.
+ *
+ * @param post_ssl_check The handler that is going to be called
+ * everything a new connection with SSL is established by a client or
+ * received by a server. The handler is executed right after the SSL
+ * handshake finishes without error.
+ *
+ * @param user_data A reference to user defined pointer that will be
+ * passed in to the handler.
+ */
+void           nopoll_ctx_set_post_ssl_check (noPollCtx          * ctx,
+					      noPollSslPostCheck   post_ssl_check,
+					      noPollPtr            user_data)
+{
+	if (ctx == NULL)
+		return;
+
+	/* set handlers as indicated by the caller */
+	ctx->post_ssl_check      = post_ssl_check;
+	ctx->post_ssl_check_data = user_data;
+	return;
+}
+
+/** 
+ * @brief Allows to iterate over all connections currently registered
+ * on the provided context, optionally stopping the foreach process,
+ * returning the connection reference selected if the foreach handler
+ * returns nopoll_true.
+ *
+ * @param ctx The nopoll context where the foreach operation will take
+ * place.
+ *
+ * @param foreach The foreach handler to be called for each connection
+ * registered.
+ *
+ * @param user_data An optional reference to a pointer that will be
+ * passed to the handler.
+ *
+ * @return Returns the connection selected (that is, the one for which
+ * the foreach handler returned nopoll_true) or NULL in the case all
+ * foreach executions returned nopoll_false. Keep in mind the function
+ * also returns NULL if ctx or foreach parameter is NULL.
+ *
+ * See \ref noPollForeachConn for a signature example.
+ */
+noPollConn   * nopoll_ctx_foreach_conn (noPollCtx          * ctx, 
+					noPollForeachConn    foreach, 
+					noPollPtr            user_data)
+{
+	noPollConn * result;
+	int          iterator;
+	nopoll_return_val_if_fail (ctx, ctx && foreach, NULL);
+
+	/* acquire here the mutex to protect connection list */
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	/* nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Doing foreach over conn_length array (%p): %d", ctx, ctx->conn_length); */
+	
+	/* find the connection and remove it from the array */
+	iterator = 0;
+	while (iterator < ctx->conn_length) {
+
+		/* check the connection reference */
+		if (ctx->conn_list[iterator]) {
+
+			result = ctx->conn_list[iterator];
+
+			/* acquire a reference before releasing the
+			 * mutex: otherwise another thread may
+			 * unregister and destroy this connection while
+			 * the handler below is using it
+			 *
+			 * NOTE: it must be a transient reference. The
+			 * handler is allowed to close the connection it
+			 * is notified about and nopoll_conn_close ()
+			 * uses the reference counting to decide whether
+			 * the caller holds a reference to release: a
+			 * plain nopoll_conn_ref () here makes it release
+			 * this one, destroying the connection before the
+			 * unref below */
+			__nopoll_conn_transient_ref (result);
+
+			/* release the mutex before calling user code:
+			 * the handler may call back into the API */
+			nopoll_mutex_unlock (ctx->ref_mutex);
+
+			/* call to notify connection */
+			if (foreach (ctx, result, user_data)) {
+
+				/* selected: drop our own reference and
+				 * report it to the caller (the mutex is
+				 * already released here) */
+				__nopoll_conn_transient_unref (result);
+				return result;
+			} /* end if */
+
+			/* not selected: drop our own reference */
+			__nopoll_conn_transient_unref (result);
+
+			/* acquire the mutex again to continue walking
+			 * the connection list */
+			nopoll_mutex_lock (ctx->ref_mutex);
+
+		} /* end if */
+		
+		iterator++;
+	} /* end while */
+
+	/* release here the mutex to protect connection list */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return NULL;
+}
+
+
+/** 
+ * @brief Allows to change the protocol version that is sent in all
+ * client connections created under the provided context and the
+ * protocol version accepted by listeners created under this context
+ * too.
+ *
+ * This is a really basic (mostly fake) protocol version support
+ * because it only allows to change the version string sent (but
+ * nothing more for now). It is useful for testing purposes.
+ *
+ * @param ctx The noPoll context where the protocol version change
+ * will be applied.
+ *
+ * @param version The value representing the protocol version. By
+ * default this function isn't required to be called because it
+ * already has the right protocol value configured (13). 
+ */ 
+void           nopoll_ctx_set_protocol_version (noPollCtx * ctx, int version)
+{
+	/* check input data
+	 *
+	 * NOTE: this used to check (ctx || version), which lets a NULL
+	 * ctx through whenever version is not 0, dereferencing it
+	 * right below */
+	nopoll_return_if_fail (ctx, ctx);
+
+	/* setup the new protocol version */
+	ctx->protocol_version = version;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the maximum websocket frame size
+ * (payload) that will be accepted by connections created under the
+ * provided context.
+ *
+ * Any incoming frame declaring a payload size bigger than this value
+ * causes the connection to be closed without allocating memory for
+ * it. This limit protects the application from remote peers declaring
+ * huge (or crafted) frame sizes.
+ *
+ * By default, every context is configured with \ref
+ * NOPOLL_MAX_FRAME_SIZE_DEFAULT (16MB). The value can be also
+ * configured for a particular connection or listener, which takes
+ * precedence over this one, by using \ref
+ * nopoll_conn_opts_set_max_frame_size.
+ *
+ * @param ctx The context where the limit will be configured.
+ *
+ * @param max_frame_size The maximum frame size to accept. It must be
+ * a value bigger than 0 and equal or lower than \ref
+ * NOPOLL_MAX_FRAME_SIZE_LIMIT. Any other value is discarded, keeping
+ * the current configuration.
+ */
+void           nopoll_ctx_set_max_frame_size (noPollCtx * ctx, long int max_frame_size)
+{
+	/* check input data */
+	nopoll_return_if_fail (ctx, ctx);
+
+	if (max_frame_size <= 0 || max_frame_size > NOPOLL_MAX_FRAME_SIZE_LIMIT) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong max frame size value (%ld), it must be inside the range 1..%ld, discarding configuration",
+			    max_frame_size, (long int) NOPOLL_MAX_FRAME_SIZE_LIMIT);
+		return;
+	} /* end if */
+
+	/* setup the new limit */
+	ctx->max_frame_size = max_frame_size;
+
+	return;
+}
+
+/**
+ * @brief Allows to get current maximum websocket frame size (payload)
+ * accepted by connections created under the provided context.
+ *
+ * @param ctx The context that is being checked.
+ *
+ * @return Current limit configured or \ref
+ * NOPOLL_MAX_FRAME_SIZE_DEFAULT in the case of wrong reference
+ * received or no limit was configured.
+ */
+long int       nopoll_ctx_get_max_frame_size (noPollCtx * ctx)
+{
+	if (ctx == NULL || ctx->max_frame_size <= 0)
+		return NOPOLL_MAX_FRAME_SIZE_DEFAULT;
+
+	return ctx->max_frame_size;
+}
+
+/**
+ * @brief Allows to configure a user defined resolver used to
+ * translate host names into addresses for every client connection
+ * created under the provided context (\ref nopoll_conn_new and
+ * friends).
+ *
+ * This allows applications to plug their own name resolution (for
+ * example, a service discovery lookup or the answers kept by the
+ * application's own asynchronous DNS client) without changing the
+ * connection API. Results reported by the handler are also stored in
+ * the resolver cache when enabled (see \ref
+ * nopoll_ctx_set_resolver_cache_ttl).
+ *
+ * Note the handler (like the built-in resolver when a DNS query is
+ * required) is called by a worker thread: \ref nopoll_conn_new (and
+ * friends) do not wait for it and report a connection that is
+ * connected once the handler finishes (the connection is driven by
+ * \ref nopoll_loop_wait or \ref nopoll_conn_is_ready), so the handler
+ * may block and it must be thread safe. Numeric addresses, names
+ * kept by the resolver cache and, under \ref
+ * NOPOLL_RESOLVER_HOSTS_ONLY, names declared at the hosts file (kept
+ * in memory and loaded again when the file changes) are resolved
+ * without workers. On platforms without workers, the handler is
+ * called by the thread creating the connection.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param resolver The resolver handler or NULL to restore the
+ * built-in one (see \ref nopoll_ctx_set_resolver_mode).
+ *
+ * @param user_data User defined pointer passed to the handler.
+ */
+void           nopoll_ctx_set_resolver (noPollCtx      * ctx,
+					noPollResolver   resolver,
+					noPollPtr        user_data)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->resolver      = resolver;
+	ctx->resolver_data = resolver ? user_data : NULL;
+
+	/* entries resolved with the previous resolver are no longer valid */
+	nopoll_ctx_flush_resolver_cache (ctx);
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the strategy used by the built-in
+ * resolver (the one used when no resolver is configured with \ref
+ * nopoll_ctx_set_resolver).
+ *
+ * Use \ref NOPOLL_RESOLVER_HOSTS_ONLY to only accept numeric
+ * addresses and names declared at /etc/hosts: this avoids any DNS
+ * round trip (and the latency it has) for deployments where every
+ * peer is known in advance.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param mode The resolver strategy to use (by default \ref NOPOLL_RESOLVER_SYSTEM).
+ */
+void           nopoll_ctx_set_resolver_mode (noPollCtx * ctx, noPollResolverMode mode)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	if (mode != NOPOLL_RESOLVER_SYSTEM && mode != NOPOLL_RESOLVER_HOSTS_ONLY) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong resolver mode value (%d), discarding configuration", mode);
+		return;
+	} /* end if */
+
+	ctx->resolver_mode = mode;
+
+	/* entries resolved with the previous mode are no longer valid */
+	nopoll_ctx_flush_resolver_cache (ctx);
+
+	return;
+}
+
+/**
+ * @brief Allows to enable (and configure) the resolver cache used by
+ * client connections created under the provided context.
+ *
+ * When enabled, addresses resolved for a host, port and transport
+ * are kept for \p ttl seconds, so reconnecting to the same peer does
+ * not pay the resolution latency again. At most \ref
+ * NOPOLL_RESOLVER_CACHE_MAX_ENTRIES entries are kept by default
+ * (see \ref nopoll_ctx_set_resolver_cache_max_entries), dropping the
+ * oldest ones first. The cache is disabled by default.
  *
- * Note the connection is still not fully working at this point
- * because the handshake hasn't been sent to the remote peer yet. This
- * means that attempting to send any content inside this handler (for
- * example by using \ref nopoll_conn_send_text) will cause a protocol
- * violation (because remote side is expecting a handshake reply but
- * received something different). 
+ * @param ctx The context to configure.
  *
- * In the case you want to sent content right away after receiving a
- * connection (on a listener), you can use \ref
- * nopoll_ctx_set_on_ready "On Ready" handler which is called just
- * after the connection has been fully accepted and handshake reply is
- * fully written.
+ * @param ttl Seconds that resolved addresses are kept. Use 0 to
+ * disable the cache (releasing every entry stored). Negative values
+ * are discarded, keeping the current configuration.
+ */
+void           nopoll_ctx_set_resolver_cache_ttl (noPollCtx * ctx, int ttl)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	if (ttl < 0) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong resolver cache ttl value (%d), discarding configuration", ttl);
+		return;
+	} /* end if */
+
+	ctx->resolver_cache_ttl = ttl;
+	if (ttl == 0)
+		nopoll_ctx_flush_resolver_cache (ctx);
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the maximum number of entries kept by
+ * the resolver cache of the provided context (see \ref
+ * nopoll_ctx_set_resolver_cache_ttl). When the cache is full, the
+ * oldest entries are dropped first.
  *
- * @param ctx The context that will be configured.
+ * @param ctx The context to configure.
  *
- * @param on_open The handler to be configured on this context.
+ * @param max_entries Maximum number of entries (bigger than 0, by
+ * default \ref NOPOLL_RESOLVER_CACHE_MAX_ENTRIES). Entries above the
+ * new limit are released right away. Other values are discarded,
+ * keeping the current configuration.
+ */
+void           nopoll_ctx_set_resolver_cache_max_entries (noPollCtx * ctx, int max_entries)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	if (max_entries <= 0) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong resolver cache max entries value (%d), discarding configuration", max_entries);
+		return;
+	} /* end if */
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	ctx->resolver_cache_max = max_entries;
+	__nopoll_ctx_resolver_cache_trim (ctx);
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return;
+}
+
+/**
+ * @brief Removes all entries stored in the resolver cache of the
+ * provided context, forcing the next connections to resolve again
+ * (names declared at the hosts file are read again as well).
  *
- * @param user_data User defined pointer to be passed to the on open
- * handler
+ * @param ctx The context whose resolver cache is flushed.
  */
-void           nopoll_ctx_set_on_open (noPollCtx            * ctx,
-				       noPollActionHandler    on_open,
-				       noPollPtr              user_data)
+void           nopoll_ctx_flush_resolver_cache (noPollCtx * ctx)
 {
-	/* NOTE: a NULL handler is rejected by the check above, so the
-	 * handler cannot be uninstalled through this function (unlike
-	 * \ref nopoll_ctx_set_on_msg, which does accept NULL) */
-	nopoll_return_if_fail (ctx, ctx && on_open);
+	nopoll_return_if_fail (ctx, ctx);
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	__nopoll_ctx_resolver_cache_purge (ctx, nopoll_true);
+	__nopoll_ctx_hosts_release (ctx);
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	/* set the handler */
-	ctx->on_open      = on_open;
-	ctx->on_open_data = user_data;
 	return;
 }
 
-/** 
- * @brief Allows to configure a handler that is called when a
- * connection is received and it is ready to send and receive because
- * all WebSocket handshake protocol finished OK.
+/**
+ * @brief Allows to enable keepalive pings (and dead peer detection)
+ * on connections created or accepted on this context.
  *
- * Unlike handlers configured at \ref nopoll_ctx_set_on_open and \ref
- * nopoll_ctx_set_on_accept which get notified when the connection
- * isn't still working (because WebSocket handshake wasn't finished
- * yet), on ready handlers configured here will get called just after
- * the WebSocket handshake has taken place.
+ * Once enabled, every connection completing its handshake is checked
+ * every \p ping_interval by \ref nopoll_loop_wait (using a timer, see
+ * \ref nopoll_timer_add). When nothing was received from the peer for
+ * \p idle_threshold, a PING is sent (busy connections are not pinged)
+ * and, if the PONG reply does not arrive in \p pong_timeout, the
+ * connection is closed (\ref nopoll_conn_set_on_close handler is
+ * called). The round trip time measured with the last PING is
+ * reported by \ref nopoll_conn_get_rtt.
  *
- * @param ctx The context that will be configured.
+ * Connections can override this configuration using \ref
+ * nopoll_conn_opts_set_keepalive. The configuration applies to
+ * connections completing their handshake after this call.
  *
- * @param on_ready The handler to be called when a connection is fully
- * ready to send and receive content because WebSocket handshake has
- * finished. The function must return nopoll_true to accept the
- * connection. By returning nopoll_false the handler is signalling to
- * terminate the connection.
+ * @param ctx The context to configure.
  *
- * @param user_data Optional user data pointer passed to the on ready
- * handler.
- * 
+ * @param ping_interval Time (microseconds) between keepalive checks. Use 0 to disable keepalive (default).
+ *
+ * @param pong_timeout Time (microseconds) to wait for the PONG reply. Use 0 to wait \p ping_interval.
+ *
+ * @param idle_threshold Time (microseconds) without receiving anything before a PING is sent. Use 0 to use \p ping_interval.
  */
-void           nopoll_ctx_set_on_ready (noPollCtx          * ctx,
-					noPollActionHandler  on_ready,
-					noPollPtr            user_data)
+void           nopoll_ctx_set_keepalive (noPollCtx * ctx, long ping_interval, long pong_timeout, long idle_threshold)
 {
-	/* see note at nopoll_ctx_set_on_open () about NULL handlers */
-	nopoll_return_if_fail (ctx, ctx && on_ready);
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->keepalive_interval     = ping_interval;
+	ctx->keepalive_pong_timeout = pong_timeout;
+	ctx->keepalive_idle         = idle_threshold;
 
-	/* set the handler */
-	ctx->on_ready      = on_ready;
-	ctx->on_ready_data = user_data;
 	return;
 }
 
-/** 
- * @brief Allows to configure the accept handler that will be called
- * when a connection is received but before any handshake takes place.
+/**
+ * @brief Allows to configure the minimum size of the messages
+ * compressed by permessage-deflate connections created or accepted
+ * on this context (see \ref nopoll_conn_opts_set_permessage_deflate).
  *
- * @param ctx The context that will be configured.
+ * Smaller messages are sent uncompressed: compressing a few bytes
+ * costs CPU, and the deflate overhead usually makes them bigger. For
+ * fragmented messages, the size of the first frame is checked.
  *
- * @param on_accept The handler to be called when a connection is
- * received. Here the handler must return nopoll_true to accept the
- * connection, otherwise nopoll_false should be returned.
+ * Connections can override this configuration using \ref
+ * nopoll_conn_opts_set_permessage_deflate_threshold. The
+ * configuration applies to connections created after this call.
  *
- * @param user_data Optional user data pointer passed to the on accept
- * handler.
+ * @param ctx The context to configure.
  *
+ * @param min_size Minimum size (bytes) to compress. Use 0 to compress every message (default).
  */
-void              nopoll_ctx_set_on_accept (noPollCtx            * ctx,
-					    noPollActionHandler    on_accept,
-					    noPollPtr              user_data)
+void           nopoll_ctx_set_deflate_threshold (noPollCtx * ctx, long min_size)
 {
-	/* see note at nopoll_ctx_set_on_open () about NULL handlers */
-	nopoll_return_if_fail (ctx, ctx && on_accept);
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->deflate_threshold = min_size > 0 ? min_size : 0;
 
-	/* set the handler */
-	ctx->on_accept      = on_accept;
-	ctx->on_accept_data = user_data;
 	return;
 }
 
-/** 
- * @brief Allows to set a general handler to get notifications about a
- * message received over any connection that is running under the
- * provided context (noPollCtx).
+/**
+ * @brief Allows to limit the number of compression windows kept by
+ * permessage-deflate connections of this context.
  *
- * @param ctx The context where the notification will happen
+ * A connection negotiating context takeover keeps its compression
+ * streams (and their sliding windows, up to ~300KB) for its whole
+ * life, which does not scale to many connections. Once the limit
+ * provided is reached:
  *
- * @param on_msg The handler to be called when an incoming message is
- * received.
+ * - The compressor of the least recently used connection is released
+ * and that connection switches to no context takeover (for the
+ * messages it sends). Connections in the middle of a message are
+ * never evicted.
  *
- * @param user_data User defined pointer that is passed in into the
- * handler when called.
+ * - New connections negotiate no context takeover in both directions
+ * (as the windows used by the peer to compress cannot be released
+ * once agreed).
  *
- * Note that the handler configured here will be overridden by the handler configured by \ref nopoll_conn_set_on_msg
+ * @param ctx The context to configure.
  *
+ * @param max_windows Maximum number of windows kept. Use 0 for no limit (default).
  */
-void           nopoll_ctx_set_on_msg    (noPollCtx              * ctx,
-					 noPollOnMessageHandler   on_msg,
-					 noPollPtr                user_data)
+void           nopoll_ctx_set_deflate_max_windows (noPollCtx * ctx, int max_windows)
 {
 	nopoll_return_if_fail (ctx, ctx);
-	
-	/* set new handler */
-	ctx->on_msg      = on_msg;
-	ctx->on_msg_data = user_data;
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	ctx->deflate_max_windows = max_windows > 0 ? max_windows : 0;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	return;
+}
+
+/**
+ * @brief Allows to enable UTF-8 validation of text messages on
+ * connections created or accepted on this context (RFC 6455 section
+ * 8.1).
+ *
+ * When enabled on receive, a text message with invalid UTF-8 content
+ * fails the connection (a close frame with status 1007 is sent and
+ * the connection is shut down). Validation state is kept across
+ * fragments and partial reads, so a code point can be split anywhere.
+ * When enabled on send, \ref nopoll_conn_send_text (and the rest of
+ * text send functions) fail with -1 without sending anything when
+ * the content is not valid UTF-8.
+ *
+ * Connections can override this configuration using \ref
+ * nopoll_conn_opts_set_utf8_validation. The configuration applies to
+ * connections created after this call.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param on_receive nopoll_true to validate text messages received (disabled by default).
+ *
+ * @param on_send nopoll_true to validate text messages sent (disabled by default).
+ */
+void           nopoll_ctx_set_utf8_validation (noPollCtx * ctx, nopoll_bool on_receive, nopoll_bool on_send)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->utf8_rx = on_receive;
+	ctx->utf8_tx = on_send;
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the context so connections deliver only
+ * complete messages: fragments (and pieces of frames partially read)
+ * are joined by the library, so each message notified (or returned
+ * by \ref nopoll_conn_get_msg) is a complete message.
+ *
+ * Content is accumulated into a buffer that grows geometrically, so
+ * reassembling a message of N bytes copies each byte once (amortized).
+ * A message bigger than the maximum frame size accepted (see \ref
+ * nopoll_ctx_set_max_frame_size) closes the connection with status
+ * 1009.
+ *
+ * Reassembly is not done on connections with a streaming handler
+ * (see \ref nopoll_ctx_set_on_msg_chunk). Connections can override
+ * this configuration using \ref
+ * nopoll_conn_opts_set_reassemble_messages. The configuration applies
+ * to connections created after this call.
+ *
+ * @param ctx The context to configure.
+ *
+ * @param enable nopoll_true to deliver complete messages only (disabled by default).
+ */
+void           nopoll_ctx_set_reassemble_messages (noPollCtx * ctx, nopoll_bool enable)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->reassemble = enable;
+
+	return;
+}
+
+/**
+ * @brief Allows to get the number of compression windows currently
+ * kept by permessage-deflate connections of this context (see \ref
+ * nopoll_ctx_set_deflate_max_windows).
+ *
+ * @param ctx The context to check.
+ *
+ * @return Number of windows kept or -1 if ctx is NULL.
+ */
+int            nopoll_ctx_get_deflate_windows (noPollCtx * ctx)
+{
+	int result;
+
+	nopoll_return_val_if_fail (ctx, ctx, -1);
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	result = ctx->deflate_windows;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Releases an address list reported by \ref
+ * __nopoll_ctx_resolve.
+ *
+ * @param list The address list to release.
+ */
+void           __nopoll_ctx_resolve_release (struct addrinfo * list)
+{
+	struct addrinfo * next;
+
+	while (list) {
+		next = list->ai_next;
+		nopoll_free (list->ai_addr);
+		nopoll_free (list);
+		list = next;
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @internal Creates a copy of the provided address list owned by the
+ * library (canonical names are not copied).
+ *
+ * @param list The address list to copy.
+ *
+ * @return A newly allocated list to be released with \ref
+ * __nopoll_ctx_resolve_release or NULL if it fails.
+ */
+struct addrinfo * __nopoll_ctx_resolve_copy (struct addrinfo * list)
+{
+	struct addrinfo * result = NULL;
+	struct addrinfo * last   = NULL;
+	struct addrinfo * node;
+
+	while (list) {
+		node = nopoll_new (struct addrinfo, 1);
+		if (node == NULL) {
+			__nopoll_ctx_resolve_release (result);
+			return NULL;
+		} /* end if */
+
+		node->ai_flags    = list->ai_flags;
+		node->ai_family   = list->ai_family;
+		node->ai_socktype = list->ai_socktype;
+		node->ai_protocol = list->ai_protocol;
+		node->ai_addrlen  = list->ai_addrlen;
+		node->ai_addr     = nopoll_calloc (1, list->ai_addrlen);
+		if (node->ai_addr == NULL) {
+			nopoll_free (node);
+			__nopoll_ctx_resolve_release (result);
+			return NULL;
+		} /* end if */
+		memcpy (node->ai_addr, list->ai_addr, list->ai_addrlen);
+
+		/* link node */
+		if (last)
+			last->ai_next = node;
+		else
+			result = node;
+		last = node;
+
+		/* next position */
+		list = list->ai_next;
+	} /* end while */
+
+	return result;
+}
+
+/**
+ * @internal Releases resolver cache entries: expired ones or all of
+ * them when all is nopoll_true. The caller must hold ctx->ref_mutex
+ * (or be the last owner of the context).
+ */
+void           __nopoll_ctx_resolver_cache_purge (noPollCtx * ctx, nopoll_bool all)
+{
+	noPollResolverEntry  * entry;
+	noPollResolverEntry ** previous;
+	long                   now = (long) time (NULL);
+
+	previous = &(ctx->resolver_cache);
+	while (*previous) {
+		entry = *previous;
+		if (! all && entry->expires > now) {
+			previous = &(entry->next);
+			continue;
+		} /* end if */
+
+		/* unlink and release */
+		*previous = entry->next;
+		ctx->resolver_cache_length--;
+
+		nopoll_free (entry->host);
+		nopoll_free (entry->port);
+		__nopoll_ctx_resolve_release (entry->addresses);
+		nopoll_free (entry);
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @internal Drops the oldest resolver cache entries until the cache
+ * holds at most ctx->resolver_cache_max entries. The caller must hold
+ * ctx->ref_mutex.
+ */
+void           __nopoll_ctx_resolver_cache_trim (noPollCtx * ctx)
+{
+	noPollResolverEntry  * entry;
+	noPollResolverEntry ** previous;
+	int                    position = 0;
+
+	/* newer entries are placed first: keep the head and drop the
+	 * tail */
+	previous = &(ctx->resolver_cache);
+	while (*previous && position < ctx->resolver_cache_max) {
+		previous = &((*previous)->next);
+		position++;
+	} /* end while */
+
+	while (*previous) {
+		entry     = *previous;
+		*previous = entry->next;
+		ctx->resolver_cache_length--;
+
+		nopoll_free (entry->host);
+		nopoll_free (entry->port);
+		__nopoll_ctx_resolve_release (entry->addresses);
+		nopoll_free (entry);
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @internal Stores a copy of the address list provided into the
+ * resolver cache.
+ */
+void           __nopoll_ctx_resolver_cache_store (noPollCtx        * ctx,
+						  noPollTransport    transport,
+						  const char       * host,
+						  const char       * port,
+						  struct addrinfo  * addresses)
+{
+	noPollResolverEntry  * entry;
+
+	entry = nopoll_new (noPollResolverEntry, 1);
+	if (entry == NULL)
+		return;
+	entry->host      = nopoll_strdup (host);
+	entry->port      = nopoll_strdup (port);
+	entry->transport = transport;
+	entry->addresses = __nopoll_ctx_resolve_copy (addresses);
+	if (entry->host == NULL || entry->port == NULL || entry->addresses == NULL) {
+		nopoll_free (entry->host);
+		nopoll_free (entry->port);
+		__nopoll_ctx_resolve_release (entry->addresses);
+		nopoll_free (entry);
+		return;
+	} /* end if */
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	/* drop expired entries before adding */
+	__nopoll_ctx_resolver_cache_purge (ctx, nopoll_false);
+
+	entry->expires       = (long) time (NULL) + ctx->resolver_cache_ttl;
+	entry->next          = ctx->resolver_cache;
+	ctx->resolver_cache  = entry;
+	ctx->resolver_cache_length++;
+
+	/* keep the cache bounded */
+	__nopoll_ctx_resolver_cache_trim (ctx);
+
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return;
+}
+
+/**
+ * @internal Gets next blank separated token from the line provided,
+ * updating the cursor.
+ */
+char         * __nopoll_ctx_hosts_next_token (char ** cursor)
+{
+	char * token;
+
+	/* skip blanks */
+	while (**cursor == ' ' || **cursor == '\t' || **cursor == '\r' || **cursor == '\n')
+		(*cursor)++;
+	if (**cursor == 0)
+		return NULL;
+
+	/* find token end */
+	token = *cursor;
+	while (**cursor && **cursor != ' ' && **cursor != '\t' && **cursor != '\r' && **cursor != '\n')
+		(*cursor)++;
+	if (**cursor) {
+		**cursor = 0;
+		(*cursor)++;
+	} /* end if */
+
+	return token;
+}
+
+/**
+ * @internal Compares the host names provided ignoring case (host
+ * names are ASCII, see RFC 4343).
+ */
+nopoll_bool    __nopoll_ctx_hosts_name_equal (const char * name1, const char * name2)
+{
+	while (*name1 && *name2) {
+		if (tolower ((unsigned char) *name1) != tolower ((unsigned char) *name2))
+			return nopoll_false;
+		name1++;
+		name2++;
+	} /* end while */
+
+	return *name1 == *name2;
+}
+
+/**
+ * @internal Releases the hosts file entries provided.
+ */
+void           __nopoll_ctx_hosts_free (noPollHostsEntry * hosts)
+{
+	noPollHostsEntry * next;
+
+	while (hosts) {
+		next = hosts->next;
+		nopoll_free (hosts->name);
+		nopoll_free (hosts->address);
+		nopoll_free (hosts);
+		hosts = next;
+	} /* end while */
 
 	return;
 }
 
-/** 
- * @brief Allows to configure the handler that will be used to let
- * user land code to define OpenSSL SSL_CTX object.
- *
- * By default, SSL_CTX (SSL Context) object is created by default
- * settings that works for most of the cases. In the case you want to
- * configure particular configurations that should be enabled on the
- * provided SSL_CTX that is going to be used by the client ---while
- * connecting--- or server ---while receiving a connection--- then use
- * this function to setup your creator handler.
- *
- * See \ref noPollSslContextCreator for more information about this
- * handler.
- *
- * @param ctx The context that will be configured.
- *
- * @param context_creator The handler to be called to create the
- * SSL_CTX object. Passing NULL restores the default creation done by
- * the library.
- *
- * @param user_data User defined pointer to be passed to the handler
- * when it is called.
+/**
+ * @internal Parses the hosts file provided, reporting one entry for
+ * each name declared (in the order found) or NULL if it fails.
  */
-void           nopoll_ctx_set_ssl_context_creator (noPollCtx                * ctx,
-						   noPollSslContextCreator    context_creator,
-						   noPollPtr                  user_data)
+noPollHostsEntry * __nopoll_ctx_hosts_parse (noPollCtx * ctx, const char * path)
 {
-	if (ctx == NULL)
-		return;
+	FILE             * file;
+	char               line[512];
+	char             * cursor;
+	char             * address;
+	char             * name;
+	char             * comment;
+	noPollHostsEntry * result = NULL;
+	noPollHostsEntry * last   = NULL;
+	noPollHostsEntry * entry;
+
+	file = fopen (path, "r");
+	if (file == NULL) {
+		nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "Unable to open hosts file %s, errno=%d", path, errno);
+		return NULL;
+	} /* end if */
 
-	/* set handlers as indicated by the caller */
-	ctx->context_creator      = context_creator;
-	ctx->context_creator_data = user_data;
-	return;
+	while (fgets (line, sizeof (line), file)) {
+		/* skip comments */
+		comment = strchr (line, '#');
+		if (comment)
+			*comment = 0;
+
+		/* line format: address name [aliases...] */
+		cursor  = line;
+		address = __nopoll_ctx_hosts_next_token (&cursor);
+		if (address == NULL)
+			continue;
+
+		while ((name = __nopoll_ctx_hosts_next_token (&cursor)) != NULL) {
+			entry = nopoll_new (noPollHostsEntry, 1);
+			if (entry == NULL)
+				break;
+			entry->name    = nopoll_strdup (name);
+			entry->address = nopoll_strdup (address);
+			if (last)
+				last->next = entry;
+			else
+				result = entry;
+			last = entry;
+		} /* end while */
+	} /* end while */
+
+	fclose (file);
+
+	return result;
 }
 
-/** 
- * @brief Allows to configure a function that will implement a post SSL/TLS check.
- *
- * See the following function to get more information: \ref noPollSslPostCheck
- *
- * @param ctx The context where the operation is taking place.
- *
- * @param post_ssl_check The handler that is going to be called
- * everything a new connection with SSL is established by a client or
- * received by a server. The handler is executed right after the SSL
- * handshake finishes without error.
- *
- * @param user_data A reference to user defined pointer that will be
- * passed in to the handler.
+/**
+ * @internal Drops the hosts file entries loaded, forcing the next
+ * lookup to read the file again. The caller must hold ctx->ref_mutex.
  */
-void           nopoll_ctx_set_post_ssl_check (noPollCtx          * ctx,
-					      noPollSslPostCheck   post_ssl_check,
-					      noPollPtr            user_data)
+void           __nopoll_ctx_hosts_release (noPollCtx * ctx)
 {
-	if (ctx == NULL)
-		return;
+	__nopoll_ctx_hosts_free (ctx->hosts);
+	ctx->hosts         = NULL;
+	ctx->hosts_mtime   = 0;
+	ctx->hosts_checked = 0;
 
-	/* set handlers as indicated by the caller */
-	ctx->post_ssl_check      = post_ssl_check;
-	ctx->post_ssl_check_data = user_data;
 	return;
 }
 
-/** 
- * @brief Allows to iterate over all connections currently registered
- * on the provided context, optionally stopping the foreach process,
- * returning the connection reference selected if the foreach handler
- * returns nopoll_true.
- *
- * @param ctx The nopoll context where the foreach operation will take
- * place.
- *
- * @param foreach The foreach handler to be called for each connection
- * registered.
- *
- * @param user_data An optional reference to a pointer that will be
- * passed to the handler.
- *
- * @return Returns the connection selected (that is, the one for which
- * the foreach handler returned nopoll_true) or NULL in the case all
- * foreach executions returned nopoll_false. Keep in mind the function
- * also returns NULL if ctx or foreach parameter is NULL.
- *
- * See \ref noPollForeachConn for a signature example.
+/**
+ * @internal Loads the hosts file the first time and reloads it when
+ * its modification time changes (checked at most once per second),
+ * so lookups are answered from memory.
  */
-noPollConn   * nopoll_ctx_foreach_conn (noPollCtx          * ctx, 
-					noPollForeachConn    foreach, 
-					noPollPtr            user_data)
+void           __nopoll_ctx_hosts_refresh (noPollCtx * ctx)
 {
-	noPollConn * result;
-	int          iterator;
-	nopoll_return_val_if_fail (ctx, ctx && foreach, NULL);
+#if defined(NOPOLL_OS_WIN32)
+	const char       * path = "C:\\Windows\\System32\\drivers\\etc\\hosts";
+#else
+	const char       * path = "/etc/hosts";
+#endif
+	struct stat        info;
+	noPollHostsEntry * hosts = NULL;
+	long               now   = (long) time (NULL);
+	long               mtime;
 
-	/* acquire here the mutex to protect connection list */
 	nopoll_mutex_lock (ctx->ref_mutex);
+	if (ctx->hosts_checked == now) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return;
+	} /* end if */
+	ctx->hosts_checked = now;
+	mtime              = ctx->hosts_mtime;
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	/* nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Doing foreach over conn_length array (%p): %d", ctx, ctx->conn_length); */
-	
-	/* find the connection and remove it from the array */
-	iterator = 0;
-	while (iterator < ctx->conn_length) {
-
-		/* check the connection reference */
-		if (ctx->conn_list[iterator]) {
-
-			result = ctx->conn_list[iterator];
+	/* parse without holding the lock (-1 flags a missing file) */
+	if (stat (path, &info) != 0)
+		info.st_mtime = -1;
+	if ((long) info.st_mtime == mtime)
+		return;
+	if ((long) info.st_mtime != -1)
+		hosts = __nopoll_ctx_hosts_parse (ctx, path);
 
-			/* acquire a reference before releasing the
-			 * mutex: otherwise another thread may
-			 * unregister and destroy this connection while
-			 * the handler below is using it
-			 *
-			 * NOTE: it must be a transient reference. The
-			 * handler is allowed to close the connection it
-			 * is notified about and nopoll_conn_close ()
-			 * uses the reference counting to decide whether
-			 * the caller holds a reference to release: a
-			 * plain nopoll_conn_ref () here makes it release
-			 * this one, destroying the connection before the
-			 * unref below */
-			__nopoll_conn_transient_ref (result);
+	nopoll_mutex_lock (ctx->ref_mutex);
+	ctx->hosts_mtime = (long) info.st_mtime;
+	__nopoll_ctx_hosts_free (ctx->hosts);
+	ctx->hosts       = hosts;
+	nopoll_mutex_unlock (ctx->ref_mutex);
 
-			/* release the mutex before calling user code:
-			 * the handler may call back into the API */
-			nopoll_mutex_unlock (ctx->ref_mutex);
+	return;
+}
 
-			/* call to notify connection */
-			if (foreach (ctx, result, user_data)) {
+/**
+ * @internal Built-in resolver used under \ref
+ * NOPOLL_RESOLVER_HOSTS_ONLY (and before querying DNS servers
+ * otherwise): accepts numeric addresses and names declared at the
+ * hosts file (see __nopoll_ctx_hosts_refresh), reporting the first
+ * address found with the family requested.
+ */
+int            __nopoll_ctx_resolve_hosts_file (noPollCtx        * ctx,
+						noPollTransport    transport,
+						const char       * host,
+						const char       * port,
+						struct addrinfo ** result)
+{
+	struct addrinfo    hints;
+	noPollHostsEntry * entry;
+	char             * address = NULL;
+	nopoll_bool        is_ipv6;
+	int                rc;
 
-				/* selected: drop our own reference and
-				 * report it to the caller (the mutex is
-				 * already released here) */
-				__nopoll_conn_transient_unref (result);
-				return result;
-			} /* end if */
+	memset (&hints, 0, sizeof (struct addrinfo));
+	hints.ai_family   = (transport == NOPOLL_TRANSPORT_IPV6) ? AF_INET6 : AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags    = AI_NUMERICHOST;
 
-			/* not selected: drop our own reference */
-			__nopoll_conn_transient_unref (result);
+	/* numeric addresses do not require any lookup */
+	if (getaddrinfo (host, port, &hints, result) == 0)
+		return 0;
 
-			/* acquire the mutex again to continue walking
-			 * the connection list */
-			nopoll_mutex_lock (ctx->ref_mutex);
+	__nopoll_ctx_hosts_refresh (ctx);
 
+	/* only addresses with the family requested are accepted */
+	nopoll_mutex_lock (ctx->ref_mutex);
+	entry = ctx->hosts;
+	while (entry) {
+		is_ipv6 = strchr (entry->address, ':') != NULL;
+		if (is_ipv6 == (transport == NOPOLL_TRANSPORT_IPV6) && __nopoll_ctx_hosts_name_equal (entry->name, host)) {
+			address = nopoll_strdup (entry->address);
+			break;
 		} /* end if */
-		
-		iterator++;
+		entry = entry->next;
 	} /* end while */
-
-	/* release here the mutex to protect connection list */
 	nopoll_mutex_unlock (ctx->ref_mutex);
 
-	return NULL;
-}
+	if (address == NULL)
+		return -1;
+	rc = getaddrinfo (address, port, &hints, result);
+	nopoll_free (address);
 
+	return rc;
+}
 
-/** 
- * @brief Allows to change the protocol version that is sent in all
- * client connections created under the provided context and the
- * protocol version accepted by listeners created under this context
- * too.
- *
- * This is a really basic (mostly fake) protocol version support
- * because it only allows to change the version string sent (but
- * nothing more for now). It is useful for testing purposes.
- *
- * @param ctx The noPoll context where the protocol version change
- * will be applied.
- *
- * @param version The value representing the protocol version. By
- * default this function isn't required to be called because it
- * already has the right protocol value configured (13). 
- */ 
-void           nopoll_ctx_set_protocol_version (noPollCtx * ctx, int version)
+/**
+ * @internal Finds the resolver cache entry (not expired) for the host,
+ * port and transport provided. The caller must hold ctx->ref_mutex.
+ */
+noPollResolverEntry * __nopoll_ctx_resolver_cache_find (noPollCtx        * ctx,
+							noPollTransport    transport,
+							const char       * host,
+							const char       * port)
 {
-	/* check input data
-	 *
-	 * NOTE: this used to check (ctx || version), which lets a NULL
-	 * ctx through whenever version is not 0, dereferencing it
-	 * right below */
-	nopoll_return_if_fail (ctx, ctx);
-
-	/* setup the new protocol version */
-	ctx->protocol_version = version;
+	noPollResolverEntry * entry = ctx->resolver_cache;
+	long                  now   = (long) time (NULL);
+
+	while (entry) {
+		if (entry->transport == transport && entry->expires > now &&
+		    nopoll_cmp (entry->host, host) && nopoll_cmp (entry->port, port))
+			return entry;
+		entry = entry->next;
+	} /* end while */
 
-	return;
+	return NULL;
 }
 
 /**
- * @brief Allows to configure the maximum websocket frame size
- * (payload) that will be accepted by connections created under the
- * provided context.
- *
- * Any incoming frame declaring a payload size bigger than this value
- * causes the connection to be closed without allocating memory for
- * it. This limit protects the application from remote peers declaring
- * huge (or crafted) frame sizes.
- *
- * By default, every context is configured with \ref
- * NOPOLL_MAX_FRAME_SIZE_DEFAULT (16MB). The value can be also
- * configured for a particular connection or listener, which takes
- * precedence over this one, by using \ref
- * nopoll_conn_opts_set_max_frame_size.
- *
- * @param ctx The context where the limit will be configured.
- *
- * @param max_frame_size The maximum frame size to accept. It must be
- * a value bigger than 0 and equal or lower than \ref
- * NOPOLL_MAX_FRAME_SIZE_LIMIT. Any other value is discarded, keeping
- * the current configuration.
+ * @internal Allows to check if resolving the host provided may block
+ * the caller (a DNS query or a user defined resolver), that is, it is
+ * not a numeric address, a name declared at the hosts file or an
+ * entry kept by the resolver cache.
  */
-void           nopoll_ctx_set_max_frame_size (noPollCtx * ctx, long int max_frame_size)
+nopoll_bool    __nopoll_ctx_resolve_may_block (noPollCtx        * ctx,
+					       noPollTransport    transport,
+					       const char       * host,
+					       const char       * port)
 {
-	/* check input data */
-	nopoll_return_if_fail (ctx, ctx);
+	struct addrinfo * res = NULL;
+	nopoll_bool       cached;
 
-	if (max_frame_size <= 0 || max_frame_size > NOPOLL_MAX_FRAME_SIZE_LIMIT) {
-		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Received wrong max frame size value (%ld), it must be inside the range 1..%ld, discarding configuration",
-			    max_frame_size, (long int) NOPOLL_MAX_FRAME_SIZE_LIMIT);
-		return;
+	if (ctx->resolver_cache_ttl > 0) {
+		nopoll_mutex_lock (ctx->ref_mutex);
+		cached = __nopoll_ctx_resolver_cache_find (ctx, transport, host, port) != NULL;
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		if (cached)
+			return nopoll_false;
 	} /* end if */
 
-	/* setup the new limit */
-	ctx->max_frame_size = max_frame_size;
+	/* user defined resolvers may take any time */
+	if (ctx->resolver)
+		return nopoll_true;
+	if (ctx->resolver_mode == NOPOLL_RESOLVER_HOSTS_ONLY)
+		return nopoll_false;
 
-	return;
+	/* names not declared at the hosts file require a query */
+	if (__nopoll_ctx_resolve_hosts_file (ctx, transport, host, port, &res) != 0)
+		return nopoll_true;
+	freeaddrinfo (res);
+
+	return nopoll_false;
 }
 
 /**
- * @brief Allows to get current maximum websocket frame size (payload)
- * accepted by connections created under the provided context.
- *
- * @param ctx The context that is being checked.
- *
- * @return Current limit configured or \ref
- * NOPOLL_MAX_FRAME_SIZE_DEFAULT in the case of wrong reference
- * received or no limit was configured.
+ * @internal Resolves the host and port provided for the transport
+ * requested, using the resolver cache and the resolver configured on
+ * the context (see \ref nopoll_ctx_set_resolver, \ref
+ * nopoll_ctx_set_resolver_mode and \ref
+ * nopoll_ctx_set_resolver_cache_ttl).
+ *
+ * @return An address list to be released with \ref
+ * __nopoll_ctx_resolve_release or NULL if it fails.
  */
-long int       nopoll_ctx_get_max_frame_size (noPollCtx * ctx)
+struct addrinfo * __nopoll_ctx_resolve (noPollCtx        * ctx,
+					noPollTransport    transport,
+					const char       * host,
+					const char       * port)
 {
-	if (ctx == NULL || ctx->max_frame_size <= 0)
-		return NOPOLL_MAX_FRAME_SIZE_DEFAULT;
+	noPollResolverEntry * entry;
+	struct addrinfo       hints;
+	struct addrinfo     * res    = NULL;
+	struct addrinfo     * result = NULL;
+	int                   rc;
 
-	return ctx->max_frame_size;
+	if (ctx == NULL || host == NULL || port == NULL)
+		return NULL;
+
+	/* check the cache first */
+	if (ctx->resolver_cache_ttl > 0) {
+		nopoll_mutex_lock (ctx->ref_mutex);
+		entry = __nopoll_ctx_resolver_cache_find (ctx, transport, host, port);
+		if (entry)
+			result = __nopoll_ctx_resolve_copy (entry->addresses);
+		nopoll_mutex_unlock (ctx->ref_mutex);
+
+		if (result) {
+			nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Resolved %s:%s from resolver cache", host, port);
+			return result;
+		} /* end if */
+	} /* end if */
+
+	/* resolve (without holding any lock) */
+	if (ctx->resolver) {
+		rc = ctx->resolver (ctx, transport, host, port, &res, ctx->resolver_data);
+	} else if (ctx->resolver_mode == NOPOLL_RESOLVER_HOSTS_ONLY) {
+		rc = __nopoll_ctx_resolve_hosts_file (ctx, transport, host, port, &res);
+	} else if (__nopoll_ctx_resolve_hosts_file (ctx, transport, host, port, &res) == 0) {
+		/* numeric address or name declared at the hosts file
+		 * (answered from memory) */
+		rc = 0;
+	} else {
+		memset (&hints, 0, sizeof (struct addrinfo));
+		hints.ai_family   = (transport == NOPOLL_TRANSPORT_IPV6) ? AF_INET6 : AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		rc = getaddrinfo (host, port, &hints, &res);
+	} /* end if */
+
+	if (rc != 0 || res == NULL) {
+		nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "unable to resolve host name %s:%s (transport %d), rc=%d", host, port, transport, rc);
+		return NULL;
+	} /* end if */
+
+	/* get a library owned copy */
+	result = __nopoll_ctx_resolve_copy (res);
+	freeaddrinfo (res);
+	if (result == NULL)
+		return NULL;
+
+	/* store into the cache */
+	if (ctx->resolver_cache_ttl > 0)
+		__nopoll_ctx_resolver_cache_store (ctx, transport, host, port, result);
+
+	return result;
 }
 
 /**
@@ -61,12 +61,32 @@ nopoll_bool    __nopoll_ctx_conn_is_registered (noPollCtx  * ctx,
 
 int            nopoll_ctx_conns (noPollCtx * ctx);
 
+nopoll_bool    nopoll_ctx_get_stats (noPollCtx * ctx, noPollStats * stats);
+
+nopoll_bool    nopoll_ctx_set_latency_tracking (noPollCtx * ctx, nopoll_bool enable);
+
+nopoll_bool    nopoll_ctx_get_latency (noPollCtx * ctx, noPollLatency which, noPollHistogram * hist);
+
+nopoll_bool    nopoll_ctx_set_metrics_path (noPollCtx * ctx, const char * path);
+
 nopoll_bool    nopoll_ctx_set_certificate (noPollCtx  * ctx, 
 					   const char * serverName, 
 					   const char * certificateFile, 
 					   const char * privateKey, 
 					   const char * optionalChainFile);
 
+nopoll_bool    nopoll_ctx_reload_certificate (noPollCtx  * ctx, 
+					      const char * serverName, 
+					      const char * certificateFile, 
+					      const char * privateKey, 
+					      const char * optionalChainFile);
+
+void           nopoll_ctx_watch_certificates (noPollCtx * ctx, long interval);
+
+void           nopoll_ctx_set_tls_handshake_timeout (noPollCtx * ctx, long microseconds);
+
+nopoll_bool    nopoll_ctx_set_tls_handshake_workers (noPollCtx * ctx, int workers);
+
 nopoll_bool    nopoll_ctx_find_certificate (noPollCtx   * ctx, 
 					    const char  * serverName, 
 					    const char ** certificateFile, 
@@ -89,6 +109,10 @@ void           nopoll_ctx_set_on_msg    (noPollCtx              * ctx,
 					 noPollOnMessageHandler   on_msg,
 					 noPollPtr                user_data);
 
+void           nopoll_ctx_set_on_msg_chunk (noPollCtx                   * ctx,
+					    noPollOnMessageChunkHandler   on_msg_chunk,
+					    noPollPtr                     user_data);
+
 void           nopoll_ctx_set_ssl_context_creator (noPollCtx                * ctx,
 						   noPollSslContextCreator    context_creator,
 						   noPollPtr                  user_data);
@@ -105,6 +129,104 @@ void           nopoll_ctx_set_max_frame_size (noPollCtx * ctx, long int max_fram
 
 long int       nopoll_ctx_get_max_frame_size (noPollCtx * ctx);
 
+void           nopoll_ctx_set_resolver (noPollCtx      * ctx,
+					noPollResolver   resolver,
+					noPollPtr        user_data);
+
+void           nopoll_ctx_set_resolver_mode (noPollCtx * ctx, noPollResolverMode mode);
+
+void           nopoll_ctx_set_resolver_cache_ttl (noPollCtx * ctx, int ttl);
+
+void           nopoll_ctx_set_resolver_cache_max_entries (noPollCtx * ctx, int max_entries);
+
+void           nopoll_ctx_set_keepalive (noPollCtx * ctx, long ping_interval, long pong_timeout, long idle_threshold);
+
+void           nopoll_ctx_set_deflate_threshold (noPollCtx * ctx, long min_size);
+
+void           nopoll_ctx_set_deflate_max_windows (noPollCtx * ctx, int max_windows);
+
+int            nopoll_ctx_get_deflate_windows (noPollCtx * ctx);
+
+void           nopoll_ctx_set_utf8_validation (noPollCtx * ctx, nopoll_bool on_receive, nopoll_bool on_send);
+
+void           nopoll_ctx_set_reassemble_messages (noPollCtx * ctx, nopoll_bool enable);
+
+void           nopoll_ctx_flush_resolver_cache (noPollCtx * ctx);
+
+struct addrinfo * __nopoll_ctx_resolve (noPollCtx        * ctx,
+					noPollTransport    transport,
+					const char       * host,
+					const char       * port);
+
+void           __nopoll_ctx_resolve_release (struct addrinfo * list);
+
+struct addrinfo * __nopoll_ctx_resolve_copy (struct addrinfo * list);
+
+void           __nopoll_ctx_resolver_cache_purge (noPollCtx * ctx, nopoll_bool all);
+
+void           __nopoll_ctx_resolver_cache_trim (noPollCtx * ctx);
+
+void           __nopoll_ctx_hosts_release (noPollCtx * ctx);
+
+nopoll_bool    __nopoll_ctx_resolve_may_block (noPollCtx        * ctx,
+					       noPollTransport    transport,
+					       const char       * host,
+					       const char       * port);
+
+void           __nopoll_ctx_stats_add (noPollStats * dest, noPollStats * source);
+
+void           __nopoll_ctx_latency_add (noPollHistogram * dest, noPollHistogram * source);
+
+void           __nopoll_ctx_counters_start (noPollCtx * ctx);
+
+noPollStats     * __nopoll_ctx_thread_stats (noPollCtx * ctx);
+
+noPollHistogram * __nopoll_ctx_thread_latency (noPollCtx * ctx);
+
+void           __nopoll_ctx_counters_collect (noPollCtx       * ctx,
+					      noPollStats     * stats,
+					      noPollLatency     which,
+					      noPollHistogram * hist);
+
+void           __nopoll_ctx_counters_release (noPollCtx * ctx);
+
+unsigned int   __nopoll_ctx_sni_hash (const char * serverName);
+
+nopoll_bool    __nopoll_ctx_sni_equal (const char * name1, const char * name2);
+
+void           __nopoll_ctx_ssl_ctx_ref (noPollPtr ssl_ctx);
+
+int            __nopoll_ctx_cert_generation (noPollCtx * ctx);
+
+void           __nopoll_ctx_sni_publish (noPollCtx * ctx);
+
+void           __nopoll_ctx_sni_install (noPollCtx * ctx, noPollPtr ssl_ctx);
+
+void           __nopoll_ctx_sni_release (noPollCtx * ctx);
+
+noPollPtr      __nopoll_ctx_load_certificate (noPollCtx  * ctx,
+					      const char * certificateFile,
+					      const char * privateKey,
+					      const char * optionalChainFile);
+
+nopoll_bool    __nopoll_ctx_apply_certificate (noPollPtr ssl_ctx, noPollPtr source);
+
+long           __nopoll_ctx_certificate_stamp (const char * certificateFile,
+					       const char * privateKey,
+					       const char * optionalChainFile);
+
+nopoll_bool    __nopoll_ctx_use_certificate (noPollCtx * ctx, noPollPtr ssl_ctx);
+
+nopoll_bool    __nopoll_ctx_watch_certificate (noPollCtx * ctx, int position);
+
+nopoll_bool    __nopoll_ctx_watch_listener (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data);
+
+void           __nopoll_ctx_watch_file (noPollCtx * ctx, const char * file);
+
+void           __nopoll_ctx_watch_run (noPollPtr data, nopoll_bool cancelled);
+
+void           __nopoll_ctx_watch_certificates (noPollCtx * ctx, int timer_id, noPollPtr user_data);
+
 void           nopoll_ctx_free (noPollCtx * ctx);
 
 END_C_DECLS
@@ -321,6 +321,41 @@ typedef struct _noPollConn noPollConn;
  */
 typedef struct _noPollConnOpts noPollConnOpts;
 
+/**
+ * @brief Pool of client connections kept ready to be used (see \ref nopoll_conn_pool_new).
+ */
+typedef struct _noPollConnPool noPollConnPool;
+
+/**
+ * @brief Name resolution and connect running on a worker (only used
+ * internally, see \ref nopoll_conn_new).
+ */
+typedef struct _noPollConnDial noPollConnDial;
+
+/**
+ * @brief Timer installed with \ref nopoll_timer_add (only used
+ * internally, timers are identified by their id).
+ */
+typedef struct _noPollTimer noPollTimer;
+
+/**
+ * @brief Writer used to send a message in pieces produced on demand
+ * (see \ref nopoll_writer_new).
+ */
+typedef struct _noPollWriter noPollWriter;
+
+/**
+ * @brief permessage-deflate state of a connection (only used
+ * internally, see \ref nopoll_conn_opts_set_permessage_deflate).
+ */
+typedef struct _noPollDeflate noPollDeflate;
+
+/**
+ * @brief Compression scratch buffer of a thread (only used
+ * internally).
+ */
+typedef struct _noPollDeflateScratch noPollDeflateScratch;
+
 /** 
  * @brief Abstraction that represents a selected IO wait mechanism.
  */
@@ -587,6 +622,324 @@ typedef enum {
 	NOPOLL_TRANSPORT_IPV6 = 2
 } noPollTransport;
 
+/**
+ * @brief Name resolution strategies available for the built-in
+ * resolver used by client connections (see \ref
+ * nopoll_ctx_set_resolver_mode).
+ */
+typedef enum {
+	/**
+	 * Resolve host names using the system resolver
+	 * (getaddrinfo) on a worker thread, answering numeric
+	 * addresses and names found at /etc/hosts from memory. This
+	 * is the default.
+	 */
+	NOPOLL_RESOLVER_SYSTEM     = 1,
+	/**
+	 * Only resolve numeric addresses and names found at
+	 * /etc/hosts, never querying DNS servers.
+	 */
+	NOPOLL_RESOLVER_HOSTS_ONLY = 2
+} noPollResolverMode;
+
+/**
+ * @brief Default maximum number of entries kept by the resolver cache
+ * of a \ref noPollCtx (see \ref nopoll_ctx_set_resolver_cache_ttl and
+ * \ref nopoll_ctx_set_resolver_cache_max_entries).
+ */
+#define NOPOLL_RESOLVER_CACHE_MAX_ENTRIES (128)
+
+/**
+ * @brief Delay (in microseconds) between connection attempts started
+ * by the dual stack connect (see \ref nopoll_conn_opts_set_happy_eyeballs).
+ * RFC 8305 recommends 250ms.
+ */
+#define NOPOLL_HAPPY_EYEBALLS_DELAY (250000)
+
+/**
+ * @brief Time (in microseconds) the dual stack connect waits for IPv6
+ * addresses when IPv4 ones are resolved first (see \ref
+ * nopoll_conn_opts_set_happy_eyeballs). RFC 8305 recommends 50ms.
+ */
+#define NOPOLL_HAPPY_EYEBALLS_RESOLUTION_DELAY (50000)
+
+/**
+ * @brief Maximum number of addresses (of both families) tried by the
+ * dual stack connect (see \ref nopoll_conn_opts_set_happy_eyeballs).
+ */
+#define NOPOLL_HAPPY_EYEBALLS_MAX_CANDIDATES (16)
+
+/**
+ * @brief Seconds a connection pool waits before dialing again an
+ * endpoint that failed to connect (see \ref nopoll_conn_pool_refill).
+ */
+#define NOPOLL_CONN_POOL_RETRY_PERIOD (1)
+
+/**
+ * @brief Default number of connections a pool dials at the same time
+ * (see \ref nopoll_conn_pool_set_max_dials).
+ */
+#define NOPOLL_CONN_POOL_MAX_DIALS (2)
+
+/**
+ * @internal Number of workers started to run blocking tasks (name
+ * resolution and connects of client connections and connection pool
+ * dials) when the context has no TLS handshake workers configured.
+ */
+#define NOPOLL_WORKER_TASK_THREADS (4)
+
+/**
+ * @brief Maximum time (in microseconds) the I/O engine waits for
+ * network activity before \ref nopoll_loop_wait checks again its
+ * state. The wait is shortened to the nearest timer deadline (see
+ * \ref nopoll_timer_add).
+ */
+#define NOPOLL_IO_WAIT_TIMEOUT (500000)
+
+/**
+ * @brief Maximum number of idle compression streams kept by a context
+ * to be reused by permessage-deflate connections (see \ref
+ * nopoll_conn_opts_set_permessage_deflate). Streams released beyond
+ * this limit are freed.
+ */
+#define NOPOLL_DEFLATE_POOL_SIZE (32)
+
+/**
+ * @brief Biggest compression scratch buffer kept by a thread (or by
+ * a context) between sends (see \ref
+ * nopoll_conn_opts_set_permessage_deflate). Bigger buffers (required
+ * by bigger messages) are released after use.
+ */
+#define NOPOLL_DEFLATE_SCRATCH_MAX_SIZE (262144)
+
+/**
+ * @brief Number of compression scratch buffers kept by a context for
+ * threads that can't keep their own (no thread support, see \ref
+ * nopoll_conn_opts_set_permessage_deflate).
+ */
+#define NOPOLL_DEFLATE_SCRATCH_BUFFERS (8)
+
+/**
+ * @brief Maximum payload read at once (and notified) on connections
+ * streaming messages received (see \ref nopoll_conn_set_on_msg_chunk).
+ */
+#define NOPOLL_MSG_CHUNK_SIZE (65536)
+
+/**
+ * @brief Time (seconds) \ref nopoll_conn_send_file waits for the
+ * connection to accept more content before failing.
+ */
+#define NOPOLL_SEND_FILE_STALL_TIMEOUT (60)
+
+/**
+ * @brief Default time (microseconds) a TLS handshake (accepted or
+ * created) may take before the connection is closed (see \ref
+ * nopoll_ctx_set_tls_handshake_timeout).
+ */
+#define NOPOLL_TLS_HANDSHAKE_TIMEOUT (10000000)
+
+/**
+ * @internal Time (microseconds) after which the handshake timer
+ * checks again a connection whose handshake step was running on a
+ * worker thread when the timeout was reached.
+ */
+#define NOPOLL_TLS_HANDSHAKE_RECHECK (10000)
+
+/**
+ * @brief Size of the buffer used to format log messages delivered to
+ * log handlers. Longer messages are allocated.
+ */
+#define NOPOLL_LOG_BUFFER_SIZE (1024)
+
+/**
+ * @brief Number of records of each per thread ring used by the
+ * asynchronous logger (see \ref nopoll_log_set_async).
+ */
+#define NOPOLL_LOG_RING_SIZE (256)
+
+/**
+ * @brief Room for the message arguments stored by each asynchronous
+ * log record (strings that don't fit are truncated).
+ */
+#define NOPOLL_LOG_RECORD_SIZE (256)
+
+/**
+ * @brief Maximum content queued by TLS write batching (see \ref
+ * nopoll_conn_set_tls_batching), which is the maximum plaintext
+ * carried by a TLS record.
+ */
+#define NOPOLL_TLS_BATCH_SIZE (16384)
+
+/**
+ * @brief Piece of the payload of a message (see \ref
+ * nopoll_msg_get_iovec).
+ */
+typedef struct _noPollIoVec {
+	/**
+	 * Content of the piece (not nul terminated).
+	 */
+	const unsigned char * iov_base;
+	/**
+	 * Size of the piece.
+	 */
+	long int              iov_len;
+} noPollIoVec;
+
+/**
+ * @brief Flags that can be provided to \ref nopoll_conn_send_ext.
+ */
+typedef enum {
+	/**
+	 * Default send operation.
+	 */
+	NOPOLL_SEND_DEFAULT     = 0,
+	/**
+	 * Do not compress the message (even if permessage-deflate
+	 * was negotiated), for example because the content is
+	 * already compressed. When sending fragments, the flag is
+	 * taken from the first frame of the message.
+	 */
+	NOPOLL_SEND_NO_COMPRESS = 1
+} noPollSendFlags;
+
+/**
+ * @brief Kernel TLS offload state of a connection (see \ref
+ * nopoll_conn_get_ktls).
+ */
+typedef enum {
+	/**
+	 * TLS records are handled by OpenSSL in user space.
+	 */
+	NOPOLL_KTLS_NONE = 0,
+	/**
+	 * Encryption of data sent is done by the kernel.
+	 */
+	NOPOLL_KTLS_TX   = 1,
+	/**
+	 * Decryption of data received is done by the kernel.
+	 */
+	NOPOLL_KTLS_RX   = 2
+} noPollKtlsFlags;
+
+/**
+ * @brief Counters collected by connections and contexts (see \ref
+ * nopoll_conn_get_stats and \ref nopoll_ctx_get_stats).
+ *
+ * Frame counters are indexed by the frame opcode (\ref
+ * noPollOpCode, 0-15). Byte counters report payload bytes (frame
+ * headers are not included).
+ */
+typedef struct _noPollStats {
+	/**
+	 * Frames and payload bytes received, by opcode.
+	 */
+	long frames_in[16];
+	long bytes_in[16];
+	/**
+	 * Frames and payload bytes sent, by opcode.
+	 */
+	long frames_out[16];
+	long bytes_out[16];
+	/**
+	 * WebSocket handshakes completed and failed.
+	 */
+	long handshakes_ok;
+	long handshakes_failed;
+	/**
+	 * TLS handshakes completed and failed (including those that
+	 * timed out).
+	 */
+	long tls_handshakes_ok;
+	long tls_handshakes_failed;
+	/**
+	 * Write operations that were not able to send everything
+	 * requested and bytes still pending to be written when the
+	 * stats were taken.
+	 */
+	long partial_writes;
+	long pending_write_bytes;
+	/**
+	 * Keepalive pongs received, round trip time (microseconds)
+	 * measured by the last one and sum of all of them.
+	 */
+	long pongs;
+	long rtt_last;
+	long rtt_total;
+	/**
+	 * Close frames received by status code: close_codes[n]
+	 * counts code 1000 + n (1000-1015), close_other anything
+	 * else.
+	 */
+	long close_codes[16];
+	long close_other;
+	/**
+	 * Frames rejected because they announced a payload bigger
+	 * than the maximum frame size accepted.
+	 */
+	long frame_size_rejections;
+} noPollStats;
+
+/**
+ * @brief Number of buckets kept by a \ref noPollHistogram.
+ */
+#define NOPOLL_HISTOGRAM_BUCKETS (128)
+
+/**
+ * @brief Latency histogram (values in microseconds) as reported by
+ * \ref nopoll_conn_get_latency and \ref nopoll_ctx_get_latency.
+ *
+ * Values below 4 have their own bucket, the rest are grouped in four
+ * linear buckets per power of two (a precision of 25%). Use \ref
+ * nopoll_histogram_percentile to query it and \ref
+ * nopoll_histogram_merge to combine several of them.
+ */
+typedef struct _noPollHistogram {
+	/**
+	 * Values recorded in each bucket.
+	 */
+	long counts[NOPOLL_HISTOGRAM_BUCKETS];
+	/**
+	 * Number of values recorded, their sum and the smallest and
+	 * biggest of them.
+	 */
+	long count;
+	long sum;
+	long min;
+	long max;
+} noPollHistogram;
+
+/**
+ * @brief Latencies measured when enabled with \ref
+ * nopoll_ctx_set_latency_tracking.
+ */
+typedef enum {
+	/**
+	 * Time from the io wait engine reporting the socket readable
+	 * until the message is notified to the on message handler.
+	 */
+	NOPOLL_LATENCY_READ_TO_DISPATCH = 0,
+	/**
+	 * Time spent inside on message handlers.
+	 */
+	NOPOLL_LATENCY_HANDLER          = 1,
+	/**
+	 * Time from a frame send operation until its last byte was
+	 * written (including time waiting as pending write).
+	 */
+	NOPOLL_LATENCY_WRITE_FLUSH      = 2,
+	/**
+	 * Time spent by \ref nopoll_loop_wait processing each
+	 * iteration (from the io wait engine return until timers
+	 * were run). Only reported at context level.
+	 */
+	NOPOLL_LATENCY_LOOP             = 3
+} noPollLatency;
+
+/**
+ * @brief Number of latencies defined by \ref noPollLatency.
+ */
+#define NOPOLL_LATENCY_MAX (4)
+
 BEGIN_C_DECLS
 
 nopoll_bool nopoll_socket_is_valid (NOPOLL_SOCKET socket);
@@ -0,0 +1,1241 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_deflate.h>
+#include <nopoll_private.h>
+
+#if defined(NOPOLL_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(NOPOLL_HAVE_PTHREAD)
+#include <pthread.h>
+#endif
+
+/** 
+ * \defgroup nopoll_deflate noPoll Deflate: permessage-deflate (RFC 7692) support
+ */
+
+/** 
+ * \addtogroup nopoll_deflate
+ * @{
+ */
+
+/**
+ * @brief Allows to check if permessage-deflate was negotiated on the
+ * provided connection (see \ref nopoll_conn_opts_set_permessage_deflate).
+ *
+ * @param conn The connection to check.
+ *
+ * @return nopoll_true if messages are compressed, otherwise nopoll_false.
+ */
+nopoll_bool nopoll_conn_is_permessage_deflate (noPollConn * conn)
+{
+	if (conn == NULL || conn->deflate == NULL)
+		return nopoll_false;
+	return conn->deflate->enabled;
+}
+
+#if defined(NOPOLL_HAVE_ZLIB)
+
+/**
+ * @internal Compression stream kept by the context pool.
+ */
+typedef struct _noPollDeflateStream {
+	z_stream                       zstream;
+	nopoll_bool                    is_deflate;
+	int                            window_bits;
+	struct _noPollDeflateStream  * next;
+} noPollDeflateStream;
+
+/**
+ * @internal permessage-deflate parameters found on an offer or on a
+ * response (0: not present, -1: client_max_window_bits without value).
+ */
+typedef struct _noPollDeflateParams {
+	nopoll_bool   server_no_context_takeover;
+	nopoll_bool   client_no_context_takeover;
+	int           server_max_window_bits;
+	int           client_max_window_bits;
+} noPollDeflateParams;
+
+/**
+ * @internal Trailer removed from each compressed message (and added
+ * back before inflating it), RFC 7692 section 7.2.1.
+ */
+#define NOPOLL_DEFLATE_TAIL "\x00\x00\xff\xff"
+
+#if defined(NOPOLL_HAVE_PTHREAD)
+/**
+ * @internal Called when a thread that compressed content finishes:
+ * the scratch buffer is only used by its thread, so it is released
+ * here (the context releases the rest, see
+ * __nopoll_deflate_pool_release).
+ */
+static void __nopoll_deflate_scratch_thread_end (void * data)
+{
+	noPollDeflateScratch * scratch = (noPollDeflateScratch *) data;
+
+	nopoll_free (scratch->buffer);
+	scratch->buffer = NULL;
+	__sync_synchronize ();
+	scratch->closed = 1;
+	return;
+}
+#endif
+
+/**
+ * @internal Prepares the context so each thread compresses into its
+ * own scratch buffer (see __nopoll_deflate_scratch_thread).
+ */
+void __nopoll_deflate_scratch_start (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	pthread_key_t * key;
+
+	key = nopoll_new (pthread_key_t, 1);
+	if (key == NULL)
+		return;
+	if (pthread_key_create (key, __nopoll_deflate_scratch_thread_end) != 0) {
+		nopoll_free (key);
+		return;
+	} /* end if */
+	ctx->deflate_scratch_key = key;
+#endif
+	return;
+}
+
+/**
+ * @internal Returns the scratch buffer of the calling thread for the
+ * provided context, created on first use (releasing those of threads
+ * already finished). Only the calling thread uses it, so compressing
+ * does not lock. Returns NULL without thread support (or if memory
+ * is exhausted), in which case buffers kept by the context are
+ * borrowed.
+ */
+static noPollDeflateScratch * __nopoll_deflate_scratch_thread (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	pthread_key_t         * key = (pthread_key_t *) ctx->deflate_scratch_key;
+	noPollDeflateScratch  * scratch;
+	noPollDeflateScratch ** cursor;
+	noPollDeflateScratch  * closed;
+
+	if (key == NULL)
+		return NULL;
+	scratch = (noPollDeflateScratch *) pthread_getspecific (*key);
+	if (scratch)
+		return scratch;
+
+	scratch = nopoll_new (noPollDeflateScratch, 1);
+	if (scratch == NULL)
+		return NULL;
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	cursor = &ctx->deflate_scratch_threads;
+	while (*cursor) {
+		if ((*cursor)->closed) {
+			closed  = *cursor;
+			*cursor = closed->next;
+			__sync_synchronize ();
+			nopoll_free (closed);
+			continue;
+		} /* end if */
+		cursor = &(*cursor)->next;
+	} /* end while */
+	scratch->next                = ctx->deflate_scratch_threads;
+	ctx->deflate_scratch_threads = scratch;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+	pthread_setspecific (*key, scratch);
+	return scratch;
+#else
+	return NULL;
+#endif
+}
+
+/**
+ * @internal Takes a stream from the context pool (or creates a new one
+ * if no stream with the same configuration is idle).
+ */
+noPollDeflateStream * __nopoll_deflate_stream_get (noPollCtx * ctx, nopoll_bool is_deflate, int window_bits)
+{
+	noPollDeflateStream * stream;
+	noPollDeflateStream * previous = NULL;
+	int                   rc;
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	stream = (noPollDeflateStream *) ctx->deflate_pool;
+	while (stream) {
+		if (stream->is_deflate == is_deflate && stream->window_bits == window_bits) {
+			/* unlink from the pool */
+			if (previous)
+				previous->next = stream->next;
+			else
+				ctx->deflate_pool = stream->next;
+			ctx->deflate_pool_size--;
+			nopoll_mutex_unlock (ctx->deflate_mutex);
+
+			stream->next = NULL;
+			return stream;
+		} /* end if */
+		previous = stream;
+		stream   = stream->next;
+	} /* end while */
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	/* nothing idle, create a new one */
+	stream = nopoll_new (noPollDeflateStream, 1);
+	if (stream == NULL)
+		return NULL;
+	stream->is_deflate  = is_deflate;
+	stream->window_bits = window_bits;
+
+	/* raw deflate streams (negative window bits) */
+	if (is_deflate)
+		rc = deflateInit2 (&stream->zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, - window_bits, 8, Z_DEFAULT_STRATEGY);
+	else
+		rc = inflateInit2 (&stream->zstream, - window_bits);
+	if (rc != Z_OK) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to create %s stream (window bits %d), zlib error %d",
+			    is_deflate ? "deflate" : "inflate", window_bits, rc);
+		nopoll_free (stream);
+		return NULL;
+	} /* end if */
+
+	return stream;
+}
+
+/**
+ * @internal Releases a stream created by __nopoll_deflate_stream_get.
+ */
+void __nopoll_deflate_stream_free (noPollDeflateStream * stream)
+{
+	if (stream->is_deflate)
+		deflateEnd (&stream->zstream);
+	else
+		inflateEnd (&stream->zstream);
+	nopoll_free (stream);
+	return;
+}
+
+/**
+ * @internal Resets the stream and returns it to the context pool (or
+ * releases it if the pool is full).
+ */
+void __nopoll_deflate_stream_release (noPollCtx * ctx, noPollDeflateStream * stream)
+{
+	if (stream == NULL)
+		return;
+
+	/* reset keeps memory allocated (window and buffers), which is
+	 * what makes reusing streams cheap */
+	if (stream->is_deflate)
+		deflateReset (&stream->zstream);
+	else
+		inflateReset (&stream->zstream);
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	if (ctx->deflate_pool_size < NOPOLL_DEFLATE_POOL_SIZE) {
+		stream->next      = (noPollDeflateStream *) ctx->deflate_pool;
+		ctx->deflate_pool = stream;
+		ctx->deflate_pool_size++;
+		stream            = NULL;
+	} /* end if */
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	if (stream)
+		__nopoll_deflate_stream_free (stream);
+	return;
+}
+
+/**
+ * @internal Unlinks the compressor provided from the context LRU list
+ * (ctx->deflate_mutex must be locked).
+ */
+void __nopoll_deflate_lru_unlink (noPollCtx * ctx, noPollDeflate * state)
+{
+	if (state->lru_prev)
+		state->lru_prev->lru_next = state->lru_next;
+	else
+		ctx->deflate_lru = state->lru_next;
+	if (state->lru_next)
+		state->lru_next->lru_prev = state->lru_prev;
+	else
+		ctx->deflate_lru_tail = state->lru_prev;
+	state->lru_prev = NULL;
+	state->lru_next = NULL;
+	return;
+}
+
+/**
+ * @internal Places the compressor provided at the head of the context
+ * LRU list (ctx->deflate_mutex must be locked).
+ */
+void __nopoll_deflate_lru_push (noPollCtx * ctx, noPollDeflate * state)
+{
+	state->lru_prev = NULL;
+	state->lru_next = ctx->deflate_lru;
+	if (ctx->deflate_lru)
+		ctx->deflate_lru->lru_prev = state;
+	else
+		ctx->deflate_lru_tail = state;
+	ctx->deflate_lru = state;
+	return;
+}
+
+/**
+ * @internal Accounts a window kept by the connection (context
+ * takeover) and, if the context limit is exceeded, evicts the least
+ * recently used compressors that are idle (not in the middle of a
+ * message), switching them to no context takeover.
+ *
+ * @param is_tx nopoll_true to account the compressor, nopoll_false
+ * to account the decompressor (which cannot be evicted since the
+ * peer relies on it).
+ */
+void __nopoll_deflate_window_hold (noPollConn * conn, nopoll_bool is_tx)
+{
+	noPollCtx           * ctx     = conn->ctx;
+	noPollDeflate       * state   = conn->deflate;
+	noPollDeflate       * victim;
+	noPollDeflate       * previous;
+	noPollDeflateStream * evicted = NULL;
+	noPollDeflateStream * stream;
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	if (is_tx) {
+		state->tx_held = nopoll_true;
+		__nopoll_deflate_lru_push (ctx, state);
+	} else
+		state->rx_held = nopoll_true;
+	ctx->deflate_windows++;
+
+	/* evict from the tail (least recently used) */
+	victim = ctx->deflate_lru_tail;
+	while (victim && ctx->deflate_max_windows > 0 && ctx->deflate_windows > ctx->deflate_max_windows) {
+		previous = victim->lru_prev;
+		if (! victim->tx_busy && ! victim->tx_message) {
+			__nopoll_deflate_lru_unlink (ctx, victim);
+			victim->tx_held                = nopoll_false;
+			victim->tx_no_context_takeover = nopoll_true;
+			ctx->deflate_windows--;
+
+			stream            = (noPollDeflateStream *) victim->tx_stream;
+			victim->tx_stream = NULL;
+			if (stream) {
+				stream->next = evicted;
+				evicted      = stream;
+			} /* end if */
+		} /* end if */
+		victim = previous;
+	} /* end while */
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	/* return evicted streams to the pool */
+	while (evicted) {
+		stream  = evicted;
+		evicted = evicted->next;
+		stream->next = NULL;
+		__nopoll_deflate_stream_release (ctx, stream);
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @internal Checks if the windows kept by the context reached the
+ * configured limit, in which case new connections negotiate no
+ * context takeover.
+ */
+nopoll_bool __nopoll_deflate_windows_exhausted (noPollCtx * ctx)
+{
+	nopoll_bool result;
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	result = ctx->deflate_max_windows > 0 && ctx->deflate_windows >= ctx->deflate_max_windows;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Removes leading and trailing blanks from the token
+ * provided (modifying it).
+ */
+char * __nopoll_deflate_trim (char * token)
+{
+	int length;
+
+	while (*token == ' ' || *token == '\t')
+		token++;
+	length = strlen (token);
+	while (length > 0 && (token[length - 1] == ' ' || token[length - 1] == '\t')) {
+		token[length - 1] = 0;
+		length--;
+	} /* end while */
+
+	return token;
+}
+
+/**
+ * @internal Parses a window bits value (8..15, optionally quoted).
+ *
+ * @return The value or -1 if it is not valid.
+ */
+int __nopoll_deflate_parse_bits (char * value)
+{
+	int length = strlen (value);
+
+	/* remove quotes */
+	if (length >= 2 && value[0] == '"' && value[length - 1] == '"') {
+		value[length - 1] = 0;
+		value++;
+		length -= 2;
+	} /* end if */
+
+	if (length == 1 && value[0] >= '8' && value[0] <= '9')
+		return value[0] - '0';
+	if (length == 2 && value[0] == '1' && value[1] >= '0' && value[1] <= '5')
+		return 10 + value[1] - '0';
+	return -1;
+}
+
+/**
+ * @internal Parses the parameters of one permessage-deflate element
+ * (the text after the extension name, modifying it).
+ *
+ * @return nopoll_false if some parameter is unknown, repeated or has
+ * a wrong value (RFC 7692 section 5), otherwise nopoll_true.
+ */
+nopoll_bool __nopoll_deflate_parse_params (char * text, noPollDeflateParams * params)
+{
+	char * param;
+	char * next;
+	char * value;
+
+	memset (params, 0, sizeof (noPollDeflateParams));
+
+	while (text) {
+		/* get next parameter */
+		next = strchr (text, ';');
+		if (next) {
+			*next = 0;
+			next++;
+		} /* end if */
+		param = text;
+		text  = next;
+
+		/* split value */
+		value = strchr (param, '=');
+		if (value) {
+			*value = 0;
+			value  = __nopoll_deflate_trim (value + 1);
+		} /* end if */
+		param = __nopoll_deflate_trim (param);
+
+		if (strcasecmp (param, "server_no_context_takeover") == 0) {
+			if (value || params->server_no_context_takeover)
+				return nopoll_false;
+			params->server_no_context_takeover = nopoll_true;
+		} else if (strcasecmp (param, "client_no_context_takeover") == 0) {
+			if (value || params->client_no_context_takeover)
+				return nopoll_false;
+			params->client_no_context_takeover = nopoll_true;
+		} else if (strcasecmp (param, "server_max_window_bits") == 0) {
+			if (value == NULL || params->server_max_window_bits)
+				return nopoll_false;
+			params->server_max_window_bits = __nopoll_deflate_parse_bits (value);
+			if (params->server_max_window_bits < 0)
+				return nopoll_false;
+		} else if (strcasecmp (param, "client_max_window_bits") == 0) {
+			if (params->client_max_window_bits)
+				return nopoll_false;
+			params->client_max_window_bits = -1;
+			if (value) {
+				params->client_max_window_bits = __nopoll_deflate_parse_bits (value);
+				if (params->client_max_window_bits < 0)
+					return nopoll_false;
+			} /* end if */
+		} else {
+			/* unknown parameter */
+			return nopoll_false;
+		} /* end if */
+	} /* end while */
+
+	return nopoll_true;
+}
+
+/**
+ * @internal Splits the extension element provided into its name and
+ * its parameters (NULL if it has none), modifying it.
+ */
+char * __nopoll_deflate_element_name (char * element, char ** params)
+{
+	char * separator = strchr (element, ';');
+
+	*params = NULL;
+	if (separator) {
+		*separator = 0;
+		*params    = separator + 1;
+	} /* end if */
+
+	return __nopoll_deflate_trim (element);
+}
+
+/**
+ * @internal Builds the extension offer sent by clients with
+ * permessage-deflate enabled.
+ *
+ * @return A newly allocated string with the Sec-WebSocket-Extensions
+ * header line (starting with CRLF) or NULL if nothing is offered.
+ */
+char * __nopoll_deflate_client_offer (noPollConn * conn)
+{
+	noPollDeflate * state = conn->deflate;
+	char            client_bits[40];
+	char            server_bits[40];
+
+	if (state == NULL)
+		return NULL;
+
+	/* too many windows kept: request no context takeover in both
+	 * directions */
+	if (__nopoll_deflate_windows_exhausted (conn->ctx)) {
+		state->server_no_context_takeover = nopoll_true;
+		state->client_no_context_takeover = nopoll_true;
+	} /* end if */
+
+	/* client_max_window_bits is always sent to let the server
+	 * reduce our window */
+	if (state->client_max_window_bits)
+		sprintf (client_bits, "; client_max_window_bits=%d", state->client_max_window_bits);
+	else
+		sprintf (client_bits, "; client_max_window_bits");
+	server_bits[0] = 0;
+	if (state->server_max_window_bits)
+		sprintf (server_bits, "; server_max_window_bits=%d", state->server_max_window_bits);
+
+	return nopoll_strdup_printf ("\r\nSec-WebSocket-Extensions: permessage-deflate%s%s%s%s",
+				     client_bits, server_bits,
+				     state->server_no_context_takeover ? "; server_no_context_takeover" : "",
+				     state->client_no_context_takeover ? "; client_no_context_takeover" : "");
+}
+
+/**
+ * @internal Selects the first valid permessage-deflate offer received
+ * from the client (if the listener has it enabled) and records the
+ * configuration negotiated.
+ *
+ * @return A newly allocated string with the Sec-WebSocket-Extensions
+ * header line to reply (starting with CRLF) or NULL if no extension
+ * was accepted.
+ */
+char * __nopoll_deflate_server_accept (noPollConn * conn)
+{
+	noPollDeflate       * state   = conn->deflate;
+	noPollDeflateParams   params;
+	char                * offers;
+	char                * element;
+	char                * next;
+	char                * name;
+	char                * text;
+	int                   server_bits;
+	int                   client_bits;
+	char                  reply_server_bits[40];
+	char                  reply_client_bits[40];
+	char                * reply = NULL;
+
+	if (state == NULL || conn->handshake == NULL || conn->handshake->extensions == NULL)
+		return NULL;
+
+	/* too many windows kept: reply no context takeover in both
+	 * directions (the server can always request it) */
+	if (__nopoll_deflate_windows_exhausted (conn->ctx)) {
+		state->server_no_context_takeover = nopoll_true;
+		state->client_no_context_takeover = nopoll_true;
+	} /* end if */
+
+	offers  = nopoll_strdup (conn->handshake->extensions);
+	element = offers;
+	while (element) {
+		/* get next offer */
+		next = strchr (element, ',');
+		if (next) {
+			*next = 0;
+			next++;
+		} /* end if */
+
+		name    = __nopoll_deflate_element_name (element, &text);
+		element = next;
+		if (strcasecmp (name, "permessage-deflate") != 0)
+			continue;
+		if (! __nopoll_deflate_parse_params (text, &params)) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Skipping invalid permessage-deflate offer from %s:%s", conn->host, conn->port);
+			continue;
+		} /* end if */
+
+		/* window used by our compressor: the smallest between
+		 * our configuration and the limit requested by the
+		 * client (zlib does not support 8 bits windows) */
+		server_bits = state->server_max_window_bits ? state->server_max_window_bits : 15;
+		if (params.server_max_window_bits > 0 && params.server_max_window_bits < server_bits)
+			server_bits = params.server_max_window_bits;
+		if (server_bits < 9) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_WARNING, "Skipping permessage-deflate offer requesting server_max_window_bits=%d (not supported)", server_bits);
+			continue;
+		} /* end if */
+		reply_server_bits[0] = 0;
+		if (params.server_max_window_bits > 0 || server_bits < 15)
+			sprintf (reply_server_bits, "; server_max_window_bits=%d", server_bits);
+
+		/* window used by the client compressor: it can only be
+		 * limited if the client announced it supports it */
+		client_bits          = params.client_max_window_bits > 0 ? params.client_max_window_bits : 15;
+		reply_client_bits[0] = 0;
+		if (params.client_max_window_bits != 0 && state->client_max_window_bits && state->client_max_window_bits < client_bits) {
+			client_bits = state->client_max_window_bits;
+			sprintf (reply_client_bits, "; client_max_window_bits=%d", client_bits);
+		} /* end if */
+
+		/* record configuration negotiated */
+		state->enabled                = nopoll_true;
+		state->tx_no_context_takeover = params.server_no_context_takeover || state->server_no_context_takeover;
+		state->rx_no_context_takeover = params.client_no_context_takeover || state->client_no_context_takeover;
+		state->tx_window_bits         = server_bits;
+		state->rx_window_bits         = client_bits;
+
+		reply = nopoll_strdup_printf ("\r\nSec-WebSocket-Extensions: permessage-deflate%s%s%s%s",
+					      state->tx_no_context_takeover ? "; server_no_context_takeover" : "",
+					      state->rx_no_context_takeover ? "; client_no_context_takeover" : "",
+					      reply_server_bits, reply_client_bits);
+		break;
+	} /* end while */
+	nopoll_free (offers);
+
+	if (reply == NULL)
+		return NULL;
+
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Accepted permessage-deflate on conn-id=%d (tx bits %d, rx bits %d)",
+		    conn->id, state->tx_window_bits, state->rx_window_bits);
+	return reply;
+}
+
+/**
+ * @internal Checks the Sec-WebSocket-Extensions reply received by a
+ * client, recording the permessage-deflate configuration negotiated.
+ *
+ * @return nopoll_false if the server accepted something that was not
+ * offered or something that cannot be honoured (the handshake must
+ * fail, RFC 6455 section 4.1), otherwise nopoll_true.
+ */
+nopoll_bool __nopoll_deflate_client_check (noPollConn * conn)
+{
+	noPollDeflate       * state   = conn->deflate;
+	noPollDeflateParams   params;
+	char                * reply;
+	char                * name;
+	char                * text;
+	nopoll_bool           result  = nopoll_false;
+
+	/* nothing accepted */
+	if (conn->handshake->extensions == NULL)
+		return nopoll_true;
+
+	if (state == NULL) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Server accepted extensions that were not offered (%s)", conn->handshake->extensions);
+		return nopoll_false;
+	} /* end if */
+
+	/* only one permessage-deflate element is expected */
+	reply = nopoll_strdup (conn->handshake->extensions);
+	name  = __nopoll_deflate_element_name (reply, &text);
+	if (strchr (conn->handshake->extensions, ',') || strcasecmp (name, "permessage-deflate") != 0) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Server accepted extensions that were not offered (%s)", conn->handshake->extensions);
+		goto finish;
+	} /* end if */
+
+	if (! __nopoll_deflate_parse_params (text, &params)) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received invalid permessage-deflate reply (%s)", conn->handshake->extensions);
+		goto finish;
+	} /* end if */
+
+	/* server window can only be smaller than the one requested */
+	if (state->server_max_window_bits && params.server_max_window_bits > state->server_max_window_bits) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Server replied server_max_window_bits=%d but %d was requested",
+			    params.server_max_window_bits, state->server_max_window_bits);
+		goto finish;
+	} /* end if */
+
+	/* client window requires a value, within the limit offered
+	 * and supported by zlib */
+	state->tx_window_bits = state->client_max_window_bits ? state->client_max_window_bits : 15;
+	if (params.client_max_window_bits) {
+		if (params.client_max_window_bits < 9 || params.client_max_window_bits > state->tx_window_bits) {
+			nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Server replied an unsupported client_max_window_bits value (%s)", conn->handshake->extensions);
+			goto finish;
+		} /* end if */
+		state->tx_window_bits = params.client_max_window_bits;
+	} /* end if */
+
+	/* record configuration negotiated */
+	state->enabled                = nopoll_true;
+	state->rx_window_bits         = params.server_max_window_bits ? params.server_max_window_bits : 15;
+	state->rx_no_context_takeover = params.server_no_context_takeover;
+	state->tx_no_context_takeover = params.client_no_context_takeover || state->client_no_context_takeover;
+	result                          = nopoll_true;
+
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_DEBUG, "Negotiated permessage-deflate on conn-id=%d (tx bits %d, rx bits %d)",
+		    conn->id, state->tx_window_bits, state->rx_window_bits);
+ finish:
+	nopoll_free (reply);
+	return result;
+}
+
+/**
+ * @internal Checks the RSV1 bit of a frame header received, tracking
+ * if the message that starts is compressed.
+ *
+ * @return nopoll_false if RSV1 is not allowed on that frame (the
+ * connection must be closed), otherwise nopoll_true.
+ */
+nopoll_bool __nopoll_deflate_rx_frame (noPollConn * conn, nopoll_bool rsv1, noPollOpCode op_code)
+{
+	noPollDeflate * state = conn->deflate;
+
+	/* RSV1 is only allowed on the first frame of a message and
+	 * only if permessage-deflate was negotiated */
+	if (op_code == NOPOLL_TEXT_FRAME || op_code == NOPOLL_BINARY_FRAME) {
+		if (state == NULL || ! state->enabled)
+			return ! rsv1;
+		state->rx_message = rsv1;
+		return nopoll_true;
+	} /* end if */
+
+	return ! rsv1;
+}
+
+/**
+ * @internal Inflates the input provided into the buffer, growing it
+ * as required, failing when the output is bigger than max_size bytes
+ * (the buffer must have room for size + 1 bytes).
+ */
+nopoll_bool __nopoll_deflate_run_inflate (z_stream * zstream, const char * input, long input_size,
+					  char ** buffer, long * size, long * used, long max_size)
+{
+	char * aux;
+	int    rc;
+
+	zstream->next_in  = (Bytef *) input;
+	zstream->avail_in = input_size;
+	while (nopoll_true) {
+		/* grow output if needed */
+		if (*used == *size) {
+			/* the buffer grows up to one byte beyond
+			 * max_size: output filling it is bigger than
+			 * allowed while exactly max_size bytes fit */
+			if (*size > max_size)
+				return nopoll_false;
+			aux = nopoll_realloc (*buffer, (*size * 2 > max_size ? max_size + 1 : *size * 2) + 1);
+			if (aux == NULL)
+				return nopoll_false;
+			*buffer = aux;
+			*size   = *size * 2 > max_size ? max_size + 1 : *size * 2;
+		} /* end if */
+
+		zstream->next_out  = (Bytef *) (*buffer + *used);
+		zstream->avail_out = *size - *used;
+		rc = inflate (zstream, Z_SYNC_FLUSH);
+		*used = *size - zstream->avail_out;
+
+		/* the peer finished the deflate stream (BFINAL): start
+		 * again for next messages */
+		if (rc == Z_STREAM_END) {
+			inflateReset (zstream);
+			return *used <= max_size;
+		} /* end if */
+		if (rc != Z_OK && rc != Z_BUF_ERROR)
+			return nopoll_false;
+
+		/* finished when all input was consumed and output was
+		 * not exhausted (so nothing is pending) */
+		if (zstream->avail_in == 0 && zstream->avail_out > 0)
+			return *used <= max_size;
+		if (rc == Z_BUF_ERROR && zstream->avail_out > 0)
+			return nopoll_false;
+	} /* end while */
+
+	return nopoll_false;
+}
+
+/**
+ * @internal Inflates the payload of the message received (when it
+ * belongs to a compressed message), replacing it. The message
+ * received can be a frame or part of a frame (see
+ * nopoll_conn_get_msg): the stream is fed as content arrives.
+ *
+ * @return -1 if the content cannot be inflated or it is bigger than
+ * max_size (the connection must be closed), 0 if nothing was done and
+ * 1 if the payload was inflated.
+ */
+int __nopoll_deflate_inflate_msg (noPollConn * conn, noPollMsg * msg, long int max_size)
+{
+	noPollDeflate       * state   = conn->deflate;
+	noPollDeflateStream * stream;
+	nopoll_bool           final;
+	char                * buffer;
+	long                  size;
+	long                  used    = 0;
+
+	if (state == NULL || ! state->rx_message || msg->op_code > NOPOLL_BINARY_FRAME)
+		return 0;
+
+	/* last piece of the message */
+	final = msg->has_fin && msg->remain_bytes == 0;
+
+	if (state->rx_stream == NULL) {
+		state->rx_stream = __nopoll_deflate_stream_get (conn->ctx, nopoll_false, state->rx_window_bits);
+		if (state->rx_stream == NULL)
+			return -1;
+	} /* end if */
+	stream = (noPollDeflateStream *) state->rx_stream;
+
+	size = msg->payload_size * 4 + 64;
+	if (size > max_size)
+		size = max_size;
+	buffer = nopoll_new (char, size + 1);
+	if (buffer == NULL)
+		return -1;
+
+	if (! __nopoll_deflate_run_inflate (&stream->zstream, msg->payload, msg->payload_size, &buffer, &size, &used, max_size) ||
+	    (final && ! __nopoll_deflate_run_inflate (&stream->zstream, NOPOLL_DEFLATE_TAIL, 4, &buffer, &size, &used, max_size))) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Failed to inflate message received on conn-id=%d (wrong content or bigger than %ld bytes)",
+			    conn->id, max_size);
+		nopoll_free (buffer);
+		return -1;
+	} /* end if */
+
+	/* replace payload */
+	buffer[used] = 0;
+	nopoll_free (msg->payload);
+	msg->payload      = buffer;
+	msg->payload_size = used;
+
+	if (final) {
+		state->rx_message = nopoll_false;
+
+		/* without context takeover the stream is only held
+		 * while the message is received */
+		if (state->rx_no_context_takeover) {
+			__nopoll_deflate_stream_release (conn->ctx, stream);
+			state->rx_stream = NULL;
+		} else if (! state->rx_held)
+			__nopoll_deflate_window_hold (conn, nopoll_false);
+	} /* end if */
+
+	return 1;
+}
+
+/**
+ * @internal Compresses the content of a data frame about to be sent
+ * (if permessage-deflate was negotiated). The first frame of each
+ * message decides if the message is compressed (see
+ * nopoll_ctx_set_deflate_threshold and NOPOLL_SEND_NO_COMPRESS).
+ *
+ * @param flags Send flags (see \ref noPollSendFlags).
+ *
+ * @param result Where the compressed content is placed. It is a
+ * scratch buffer borrowed from the context that must be returned
+ * with __nopoll_deflate_scratch_release once sent.
+ *
+ * @param result_size Where the size of the compressed content is
+ * placed.
+ *
+ * @return -1 on failure, 0 if the content must be sent as is and 1 if
+ * it was compressed (the first frame of the message must flag RSV1).
+ */
+int __nopoll_deflate_compress (noPollConn   * conn,
+			       nopoll_bool    fin,
+			       noPollOpCode   op_code,
+			       const char   * content,
+			       long           length,
+			       int            flags,
+			       char        ** result,
+			       long         * result_size)
+{
+	noPollDeflate       * state   = conn->deflate;
+	noPollCtx           * ctx     = conn->ctx;
+	noPollDeflateStream * stream;
+	noPollDeflateStream * released = NULL;
+	noPollDeflateScratch * scratch;
+	char                * buffer;
+	char                * aux;
+	long                  size;
+	long                  used    = 0;
+	int                   rc;
+	nopoll_bool           hold;
+
+	*result      = NULL;
+	*result_size = 0;
+
+	if (state == NULL || ! state->enabled)
+		return 0;
+
+	/* control frames are never compressed */
+	if (op_code != NOPOLL_TEXT_FRAME && op_code != NOPOLL_BINARY_FRAME && op_code != NOPOLL_CONTINUATION_FRAME)
+		return 0;
+
+	/* uncompressed message in progress */
+	if (state->tx_skip) {
+		if (fin)
+			state->tx_skip = nopoll_false;
+		return 0;
+	} /* end if */
+
+	/* first frame of a message: decide if it is compressed */
+	if (! state->tx_message) {
+		if (op_code == NOPOLL_CONTINUATION_FRAME)
+			return 0;
+		if ((flags & NOPOLL_SEND_NO_COMPRESS) || length < state->threshold) {
+			state->tx_skip = ! fin;
+			return 0;
+		} /* end if */
+	} /* end if */
+
+	/* borrow the scratch buffer of this thread (or one kept by
+	 * the context if the thread has none or is already using
+	 * it) */
+	buffer  = NULL;
+	size    = 0;
+	scratch = __nopoll_deflate_scratch_thread (ctx);
+	if (scratch && scratch->busy)
+		scratch = NULL;
+	if (scratch) {
+		scratch->busy   = nopoll_true;
+		buffer          = scratch->buffer;
+		size            = scratch->size;
+		scratch->buffer = NULL;
+		scratch->size   = 0;
+	} /* end if */
+
+	/* flag the compressor as busy (so it is not evicted) and
+	 * refresh its LRU position */
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	state->tx_busy    = nopoll_true;
+	state->tx_message = nopoll_true;
+	if (state->tx_held) {
+		__nopoll_deflate_lru_unlink (ctx, state);
+		__nopoll_deflate_lru_push (ctx, state);
+	} /* end if */
+	if (scratch == NULL && ctx->deflate_scratch_count > 0) {
+		ctx->deflate_scratch_count--;
+		buffer = ctx->deflate_scratch[ctx->deflate_scratch_count];
+		size   = ctx->deflate_scratch_size[ctx->deflate_scratch_count];
+	} /* end if */
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	if (state->tx_stream == NULL) {
+		state->tx_stream = __nopoll_deflate_stream_get (ctx, nopoll_true, state->tx_window_bits);
+		if (state->tx_stream == NULL)
+			goto failure;
+	} /* end if */
+	stream = (noPollDeflateStream *) state->tx_stream;
+
+	if (size < deflateBound (&stream->zstream, length) + 8) {
+		nopoll_free (buffer);
+		size   = deflateBound (&stream->zstream, length) + 8;
+		buffer = nopoll_new (char, size);
+		if (buffer == NULL)
+			goto failure;
+	} /* end if */
+
+	stream->zstream.next_in  = (Bytef *) content;
+	stream->zstream.avail_in = length;
+	do {
+		/* grow output if needed */
+		if (used == size) {
+			aux = nopoll_realloc (buffer, size * 2);
+			if (aux == NULL)
+				goto failure;
+			buffer = aux;
+			size   = size * 2;
+		} /* end if */
+
+		stream->zstream.next_out  = (Bytef *) (buffer + used);
+		stream->zstream.avail_out = size - used;
+		rc   = deflate (&stream->zstream, Z_SYNC_FLUSH);
+		used = size - stream->zstream.avail_out;
+		if (rc != Z_OK && rc != Z_BUF_ERROR) {
+			nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Failed to compress content on conn-id=%d, zlib error %d", conn->id, rc);
+			goto failure;
+		} /* end if */
+	} while (stream->zstream.avail_out == 0);
+
+	if (fin) {
+		/* remove the trailer of the sync flush, keeping at
+		 * least one byte (an empty block) */
+		if (used >= 4 && memcmp (buffer + used - 4, NOPOLL_DEFLATE_TAIL, 4) == 0)
+			used -= 4;
+		if (used == 0)
+			buffer[used++] = 0;
+
+		/* without context takeover the stream is only held
+		 * while the message is sent */
+		if (state->tx_no_context_takeover) {
+			released         = stream;
+			state->tx_stream = NULL;
+		} /* end if */
+	} /* end if */
+
+	/* check if the window kept starts to be accounted (while
+	 * still busy, so it cannot be evicted meanwhile) */
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	hold           = fin && released == NULL && ! state->tx_held;
+	state->tx_busy = nopoll_false;
+	if (fin)
+		state->tx_message = nopoll_false;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	if (released)
+		__nopoll_deflate_stream_release (ctx, released);
+	else if (hold)
+		__nopoll_deflate_window_hold (conn, nopoll_true);
+
+	state->scratch        = buffer;
+	state->scratch_size   = size;
+	state->scratch_thread = scratch;
+	*result               = buffer;
+	*result_size          = used;
+	return 1;
+
+ failure:
+	nopoll_free (buffer);
+	if (scratch)
+		scratch->busy = nopoll_false;
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	state->tx_busy = nopoll_false;
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+	return -1;
+}
+
+/**
+ * @internal Returns the scratch buffer borrowed by the last
+ * __nopoll_deflate_compress call (on the same thread) to the thread
+ * it was borrowed from, so next compression done by that thread (on
+ * any connection) reuses it without locking. Buffers borrowed from
+ * the context are returned to it, which keeps up to
+ * NOPOLL_DEFLATE_SCRATCH_BUFFERS. Only buffers of up to
+ * NOPOLL_DEFLATE_SCRATCH_MAX_SIZE bytes are kept, bigger ones are
+ * released.
+ */
+void __nopoll_deflate_scratch_release (noPollConn * conn)
+{
+	noPollCtx            * ctx     = conn->ctx;
+	noPollDeflateScratch * thread;
+	char                 * scratch;
+
+	if (conn->deflate == NULL || conn->deflate->scratch == NULL)
+		return;
+
+	scratch = conn->deflate->scratch;
+	thread  = conn->deflate->scratch_thread;
+	conn->deflate->scratch        = NULL;
+	conn->deflate->scratch_thread = NULL;
+
+	/* borrowed from this thread */
+	if (thread) {
+		if (conn->deflate->scratch_size <= NOPOLL_DEFLATE_SCRATCH_MAX_SIZE) {
+			thread->buffer = scratch;
+			thread->size   = conn->deflate->scratch_size;
+			scratch        = NULL;
+		} /* end if */
+		thread->busy = nopoll_false;
+		nopoll_free (scratch);
+		return;
+	} /* end if */
+
+	nopoll_mutex_lock (ctx->deflate_mutex);
+	if (ctx->deflate_scratch_count < NOPOLL_DEFLATE_SCRATCH_BUFFERS && conn->deflate->scratch_size <= NOPOLL_DEFLATE_SCRATCH_MAX_SIZE) {
+		ctx->deflate_scratch[ctx->deflate_scratch_count]      = scratch;
+		ctx->deflate_scratch_size[ctx->deflate_scratch_count] = conn->deflate->scratch_size;
+		ctx->deflate_scratch_count++;
+		scratch = NULL;
+	} /* end if */
+	nopoll_mutex_unlock (ctx->deflate_mutex);
+
+	nopoll_free (scratch);
+	return;
+}
+
+/**
+ * @internal Releases permessage-deflate state of the connection,
+ * returning its streams to the context pool.
+ */
+void __nopoll_deflate_release (noPollConn * conn)
+{
+	if (conn == NULL || conn->deflate == NULL)
+		return;
+
+	/* stop accounting windows kept */
+	nopoll_mutex_lock (conn->ctx->deflate_mutex);
+	if (conn->deflate->tx_held) {
+		__nopoll_deflate_lru_unlink (conn->ctx, conn->deflate);
+		conn->ctx->deflate_windows--;
+	} /* end if */
+	if (conn->deflate->rx_held)
+		conn->ctx->deflate_windows--;
+	nopoll_mutex_unlock (conn->ctx->deflate_mutex);
+
+	__nopoll_deflate_scratch_release (conn);
+	__nopoll_deflate_stream_release (conn->ctx, (noPollDeflateStream *) conn->deflate->tx_stream);
+	__nopoll_deflate_stream_release (conn->ctx, (noPollDeflateStream *) conn->deflate->rx_stream);
+	nopoll_free (conn->deflate);
+	conn->deflate = NULL;
+
+	return;
+}
+
+/**
+ * @internal Releases all idle streams kept by the context.
+ */
+void __nopoll_deflate_pool_release (noPollCtx * ctx)
+{
+	noPollDeflateStream  * stream;
+	noPollDeflateScratch * scratch;
+
+	while (ctx->deflate_pool) {
+		stream            = (noPollDeflateStream *) ctx->deflate_pool;
+		ctx->deflate_pool = stream->next;
+		__nopoll_deflate_stream_free (stream);
+	} /* end while */
+	ctx->deflate_pool_size = 0;
+
+	while (ctx->deflate_scratch_count > 0) {
+		ctx->deflate_scratch_count--;
+		nopoll_free (ctx->deflate_scratch[ctx->deflate_scratch_count]);
+	} /* end while */
+
+	/* release scratch buffers of threads (see
+	 * __nopoll_deflate_scratch_thread) */
+#if defined(NOPOLL_HAVE_PTHREAD)
+	if (ctx->deflate_scratch_key) {
+		pthread_key_delete (*((pthread_key_t *) ctx->deflate_scratch_key));
+		nopoll_free (ctx->deflate_scratch_key);
+		ctx->deflate_scratch_key = NULL;
+	} /* end if */
+#endif
+	while (ctx->deflate_scratch_threads) {
+		scratch                      = ctx->deflate_scratch_threads;
+		ctx->deflate_scratch_threads = scratch->next;
+		nopoll_free (scratch->buffer);
+		nopoll_free (scratch);
+	} /* end while */
+
+	return;
+}
+
+#else
+
+/* noPoll built without zlib: permessage-deflate is never offered nor
+ * accepted */
+
+char * __nopoll_deflate_client_offer (noPollConn * conn)
+{
+	return NULL;
+}
+
+char * __nopoll_deflate_server_accept (noPollConn * conn)
+{
+	return NULL;
+}
+
+nopoll_bool __nopoll_deflate_client_check (noPollConn * conn)
+{
+	if (conn->handshake->extensions == NULL)
+		return nopoll_true;
+
+	nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Server accepted extensions that were not offered (%s)", conn->handshake->extensions);
+	return nopoll_false;
+}
+
+nopoll_bool __nopoll_deflate_rx_frame (noPollConn * conn, nopoll_bool rsv1, noPollOpCode op_code)
+{
+	return ! rsv1;
+}
+
+int __nopoll_deflate_inflate_msg (noPollConn * conn, noPollMsg * msg, long int max_size)
+{
+	return 0;
+}
+
+int __nopoll_deflate_compress (noPollConn   * conn,
+			       nopoll_bool    fin,
+			       noPollOpCode   op_code,
+			       const char   * content,
+			       long           length,
+			       int            flags,
+			       char        ** result,
+			       long         * result_size)
+{
+	*result      = NULL;
+	*result_size = 0;
+	return 0;
+}
+
+void __nopoll_deflate_scratch_release (noPollConn * conn)
+{
+	return;
+}
+
+void __nopoll_deflate_release (noPollConn * conn)
+{
+	return;
+}
+
+void __nopoll_deflate_scratch_start (noPollCtx * ctx)
+{
+	return;
+}
+
+void __nopoll_deflate_pool_release (noPollCtx * ctx)
+{
+	return;
+}
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,77 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#ifndef __NOPOLL_DEFLATE_H__
+#define __NOPOLL_DEFLATE_H__
+
+#include <nopoll.h>
+
+BEGIN_C_DECLS
+
+nopoll_bool nopoll_conn_is_permessage_deflate (noPollConn * conn);
+
+/** internal API **/
+char      * __nopoll_deflate_client_offer (noPollConn * conn);
+
+char      * __nopoll_deflate_server_accept (noPollConn * conn);
+
+nopoll_bool __nopoll_deflate_client_check (noPollConn * conn);
+
+nopoll_bool __nopoll_deflate_rx_frame (noPollConn * conn, nopoll_bool rsv1, noPollOpCode op_code);
+
+int         __nopoll_deflate_inflate_msg (noPollConn * conn, noPollMsg * msg, long int max_size);
+
+int         __nopoll_deflate_compress (noPollConn   * conn,
+				       nopoll_bool    fin,
+				       noPollOpCode   op_code,
+				       const char   * content,
+				       long           length,
+				       int            flags,
+				       char        ** result,
+				       long         * result_size);
+
+void        __nopoll_deflate_scratch_release (noPollConn * conn);
+
+void        __nopoll_deflate_release (noPollConn * conn);
+
+void        __nopoll_deflate_scratch_start (noPollCtx * ctx);
+
+void        __nopoll_deflate_pool_release (noPollCtx * ctx);
+
+END_C_DECLS
+
+#endif
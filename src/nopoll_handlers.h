@@ -198,6 +198,40 @@ typedef void (*noPollOnMessageHandler) (noPollCtx  * ctx,
 					noPollMsg  * msg,
 					noPollPtr    user_data);
 
+/**
+ * @brief Handler definition used to stream websocket messages
+ * received (see \ref nopoll_conn_set_on_msg_chunk).
+ *
+ * This handler is called for each piece of payload read (no bigger
+ * than \ref NOPOLL_MSG_CHUNK_SIZE), as it arrives, so messages of any
+ * size can be processed with bounded memory. The data provided is
+ * only valid during the handler execution.
+ *
+ * @param ctx The context where the message was received.
+ *
+ * @param conn The connection where the message was received.
+ *
+ * @param op_code The message type (\ref NOPOLL_TEXT_FRAME or \ref NOPOLL_BINARY_FRAME).
+ *
+ * @param data The piece of payload received.
+ *
+ * @param length The size of the piece received (it can be 0 for empty messages).
+ *
+ * @param is_first nopoll_true if this is the first piece of a message.
+ *
+ * @param is_last nopoll_true if this is the last piece of a message.
+ *
+ * @param user_data An optional user defined pointer.
+ */
+typedef void (*noPollOnMessageChunkHandler) (noPollCtx    * ctx,
+					     noPollConn   * conn,
+					     noPollOpCode   op_code,
+					     const char   * data,
+					     long           length,
+					     nopoll_bool    is_first,
+					     nopoll_bool    is_last,
+					     noPollPtr      user_data);
+
 /** 
  * @brief Handler definition used by \ref nopoll_conn_set_on_close.
  *
@@ -258,6 +292,25 @@ typedef void (*noPollMutexUnlock) (noPollPtr mutex);
  */
 typedef void (*noPollLogHandler) (noPollCtx * ctx, noPollDebugLevel level, const char * log_msg, noPollPtr user_data);
 
+/**
+ * @brief Handler used by nopoll_log_set_handler_ext to receive all
+ * log notifications produced by the library, with the source location
+ * as separate fields.
+ *
+ * @param ctx The context where the operation is happening.
+ *
+ * @param level The log level 
+ *
+ * @param file The source file that produced the log.
+ *
+ * @param line The source line that produced the log.
+ *
+ * @param log_msg The actual log message reported (without location).
+ *
+ * @param user_data A reference to user defined pointer passed in into  the function.
+ */
+typedef void (*noPollLogHandlerExt) (noPollCtx * ctx, noPollDebugLevel level, const char * file, int line, const char * log_msg, noPollPtr user_data);
+
 /** 
  * @brief An optional handler that allows user land code to define how
  * is SSL_CTX (SSL context) created and which are the settings it
@@ -324,6 +377,85 @@ typedef nopoll_bool (*noPollSslPostCheck) (noPollCtx      * ctx,
 					   noPollPtr        SSL,
 					   noPollPtr        user_data);
 
+/**
+ * @brief Optional user defined handler used to resolve host names
+ * into addresses for client connections, replacing the built-in
+ * resolver. See \ref nopoll_ctx_set_resolver.
+ *
+ * The handler must work like getaddrinfo (3): on success it must
+ * return 0 and place into \p result an address list that will be
+ * released by the library by calling freeaddrinfo (3), so it must be
+ * a list obtained from getaddrinfo (for example, by resolving
+ * numerically the addresses found through a custom lookup).
+ *
+ * @param ctx The context where the operation happens.
+ *
+ * @param transport The transport requested (\ref NOPOLL_TRANSPORT_IPV4 or \ref NOPOLL_TRANSPORT_IPV6).
+ *
+ * @param host The host name to resolve.
+ *
+ * @param port The port (or service) to resolve.
+ *
+ * @param result Reference where the address list must be placed.
+ *
+ * @param user_data User defined pointer configured at \ref nopoll_ctx_set_resolver.
+ *
+ * @return 0 if the name was resolved, otherwise any other value.
+ */
+typedef int (*noPollResolver) (noPollCtx        * ctx,
+			       noPollTransport    transport,
+			       const char       * host,
+			       const char       * port,
+			       struct addrinfo ** result,
+			       noPollPtr          user_data);
+
+/**
+ * @brief Handler called when a timer installed with \ref
+ * nopoll_timer_add expires.
+ *
+ * @param ctx The context where the timer was installed.
+ *
+ * @param timer_id The id of the timer expired (as returned by \ref nopoll_timer_add).
+ *
+ * @param user_data User defined pointer configured at \ref nopoll_timer_add.
+ */
+typedef void (*noPollTimerHandler) (noPollCtx * ctx,
+				    int         timer_id,
+				    noPollPtr   user_data);
+
+/**
+ * @brief Handler called by a writer (see \ref nopoll_writer_new) to
+ * get the next piece of the message being sent.
+ *
+ * @param writer The writer asking for content.
+ *
+ * @param buffer The buffer where content must be placed.
+ *
+ * @param size Maximum number of bytes that can be placed.
+ *
+ * @param user_data User defined pointer configured at \ref nopoll_writer_new.
+ *
+ * @return Number of bytes placed (up to size), 0 when the message
+ * has no more content, -2 when no content is available right now
+ * (the writer will ask again later) or -1 to report a failure.
+ */
+typedef long (*noPollWriterProducer) (noPollWriter * writer,
+				      char         * buffer,
+				      long           size,
+				      noPollPtr      user_data);
+
+/**
+ * @internal Task run on a worker thread (see
+ * __nopoll_worker_run_task).
+ *
+ * @param data Pointer provided when the task was queued.
+ *
+ * @param cancelled nopoll_true when the worker pool was stopped
+ * before running the task: only its resources must be released.
+ */
+typedef void (*noPollWorkerTask) (noPollPtr   data,
+				  nopoll_bool cancelled);
+
 
 #endif
 
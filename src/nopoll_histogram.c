@@ -0,0 +1,252 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_histogram.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_histogram noPoll Histogram: latency histograms
+ */
+
+/** 
+ * \addtogroup nopoll_histogram
+ * @{
+ */
+
+/**
+ * @internal Returns the bucket where the provided value is recorded:
+ * values below 4 have their own bucket, the rest use the position of
+ * their most significant bit plus the two bits that follow it.
+ */
+int         __nopoll_histogram_index    (long value)
+{
+	int msb;
+	int index;
+
+	if (value < 4)
+		return value < 0 ? 0 : (int) value;
+
+	msb = 2;
+	while ((value >> (msb + 1)) > 0)
+		msb++;
+
+	index = (msb - 1) * 4 + (int) ((value >> (msb - 2)) & 3);
+	if (index >= NOPOLL_HISTOGRAM_BUCKETS)
+		return NOPOLL_HISTOGRAM_BUCKETS - 1;
+	return index;
+}
+
+/**
+ * @internal Returns the highest value recorded by the provided
+ * bucket.
+ */
+long        __nopoll_histogram_value    (int index)
+{
+	int msb;
+
+	if (index < 4)
+		return index;
+
+	msb = index / 4 + 1;
+	return ((long) (4 + index % 4) << (msb - 2)) + ((long) 1 << (msb - 2)) - 1;
+}
+
+/**
+ * @brief Clears all values recorded by the provided histogram.
+ *
+ * @param hist The histogram to clear.
+ */
+void        nopoll_histogram_reset      (noPollHistogram * hist)
+{
+	if (hist == NULL)
+		return;
+
+	memset (hist, 0, sizeof (noPollHistogram));
+	return;
+}
+
+/**
+ * @brief Records a value into the provided histogram.
+ *
+ * No lock is used: each histogram is expected to be updated by a
+ * single thread (noPoll keeps one per connection, updated by the
+ * thread doing I/O on it). Use \ref nopoll_histogram_merge to combine
+ * histograms recorded by different threads.
+ *
+ * @param hist The histogram to update.
+ *
+ * @param value The value to record (negative values are recorded as
+ * 0).
+ */
+void        nopoll_histogram_record     (noPollHistogram * hist,
+					 long              value)
+{
+	if (hist == NULL)
+		return;
+	if (value < 0)
+		value = 0;
+
+	hist->counts[__nopoll_histogram_index (value)]++;
+	if (hist->count == 0 || value < hist->min)
+		hist->min = value;
+	if (value > hist->max)
+		hist->max = value;
+	hist->count++;
+	hist->sum += value;
+	return;
+}
+
+/**
+ * @brief Adds all values recorded by source into dest.
+ *
+ * @param dest The histogram updated.
+ *
+ * @param source The histogram to add.
+ */
+void        nopoll_histogram_merge      (noPollHistogram * dest,
+					 noPollHistogram * source)
+{
+	int iterator;
+
+	if (dest == NULL || source == NULL || source->count == 0)
+		return;
+
+	for (iterator = 0; iterator < NOPOLL_HISTOGRAM_BUCKETS; iterator++)
+		dest->counts[iterator] += source->counts[iterator];
+
+	if (dest->count == 0 || source->min < dest->min)
+		dest->min = source->min;
+	if (source->max > dest->max)
+		dest->max = source->max;
+	dest->count += source->count;
+	dest->sum   += source->sum;
+	return;
+}
+
+/**
+ * @brief Returns the value below which the provided percentage of
+ * the values recorded falls (for example 99 to get the p99).
+ *
+ * The value reported is the upper bound of the bucket where the
+ * percentile is found (never above the maximum recorded), so it is
+ * at most 25% above the real value.
+ *
+ * @param hist The histogram to check.
+ *
+ * @param percentile Percentage requested (0 - 100).
+ *
+ * @return The value found or -1 if nothing was recorded.
+ */
+long        nopoll_histogram_percentile (noPollHistogram * hist,
+					 double            percentile)
+{
+	long target;
+	long seen = 0;
+	long value;
+	int  iterator;
+
+	if (hist == NULL || hist->count == 0)
+		return -1;
+	if (percentile <= 0)
+		return hist->min;
+	if (percentile >= 100)
+		return hist->max;
+
+	/* number of values that have to be at or below the result */
+	target = (long) ((percentile * hist->count) / 100);
+	if (target * 100 < percentile * hist->count)
+		target++;
+
+	for (iterator = 0; iterator < NOPOLL_HISTOGRAM_BUCKETS; iterator++) {
+		seen += hist->counts[iterator];
+		if (seen >= target) {
+			value = __nopoll_histogram_value (iterator);
+			return value > hist->max ? hist->max : value;
+		} /* end if */
+	} /* end for */
+
+	return hist->max;
+}
+
+/**
+ * @internal Gets current time.
+ */
+void        __nopoll_latency_now        (struct timeval * now)
+{
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (now, NULL);
+#else
+	gettimeofday (now, NULL);
+#endif
+	return;
+}
+
+/**
+ * @internal Records the value provided into the context histogram
+ * selected. Each thread records into its own histograms, merged when
+ * they are read (see __nopoll_ctx_counters_collect), so recording
+ * takes no lock.
+ */
+void        __nopoll_latency_add        (noPollCtx     * ctx,
+					 noPollLatency   which,
+					 long            value)
+{
+	nopoll_histogram_record (&__nopoll_ctx_thread_latency (ctx)[which], value);
+	return;
+}
+
+/**
+ * @internal Records the time elapsed since start into the context
+ * histogram selected and, when the connection tracks its own
+ * latencies (see nopoll_conn_set_latency_tracking), into the
+ * connection one.
+ */
+void        __nopoll_latency_record     (noPollConn      * conn,
+					 noPollLatency     which,
+					 struct timeval  * start)
+{
+	long value = __nopoll_conn_elapsed_since (start);
+
+	__nopoll_latency_add (conn->ctx, which, value);
+	if (conn->latency)
+		nopoll_histogram_record (&conn->latency[which], value);
+	return;
+}
+
+/**
+ * @}
+ */
@@ -41,6 +41,7 @@
 typedef struct _noPollSelect {
 	noPollCtx          * ctx;
 	fd_set               set;
+	fd_set               wset;
 	int                  length;
 	int                  max_fds;
 } noPollSelect;
@@ -68,6 +69,7 @@ noPollPtr nopoll_io_wait_select_create (noPollCtx * ctx)
 	
 	/* clear the set */
 	FD_ZERO (&(select->set));
+	FD_ZERO (&(select->wset));
 
 	return select;
 }
@@ -111,6 +113,7 @@ void    nopoll_io_wait_select_clear (noPollCtx * ctx, noPollPtr __fd_group)
 	select->length  = 0;
 	select->max_fds = 0;
 	FD_ZERO (&(select->set));
+	FD_ZERO (&(select->wset));
 
 	/* nothing more to do */
 	return;
@@ -142,10 +145,11 @@ int nopoll_io_wait_select_wait (noPollCtx * ctx, noPollPtr __fd_group)
 	struct timeval      tv;
 	noPollSelect     * _select = (noPollSelect *) __fd_group;
 
-	/* init wait */
-	tv.tv_sec    = 0;
-	tv.tv_usec   = 500000;
-	result       = select (_select->max_fds + 1, &(_select->set), NULL,   NULL, &tv);
+	/* init wait (configured by nopoll_loop_wait according to
+	 * pending timers) */
+	tv.tv_sec    = ctx->io_wait_timeout / 1000000;
+	tv.tv_usec   = ctx->io_wait_timeout % 1000000;
+	result       = select (_select->max_fds + 1, &(_select->set), &(_select->wset), NULL, &tv);
 
 	/* check result: an interrupted wait is not a failure, just
 	 * report that nothing changed so the caller keeps waiting
@@ -189,8 +193,13 @@ nopoll_bool  nopoll_io_wait_select_add_to (int               fds,
 		return nopoll_false;
 	} /* end if */
 
-	/* set the value */
-	FD_SET (fds, &(select->set));
+	/* set the value: connections whose TLS handshake is blocked
+	 * writing (or with a client init or metrics reply pending)
+	 * are watched for writing instead */
+	if (conn && (conn->ssl_want_write || conn->client_init_pending || conn->metrics_reply))
+		FD_SET (fds, &(select->wset));
+	else
+		FD_SET (fds, &(select->set));
 
 	/* update length */
 	select->length++;
@@ -230,7 +239,7 @@ nopoll_bool      nopoll_io_wait_select_is_set (noPollCtx   * ctx,
 		return nopoll_false;
 	}
 
-	return FD_ISSET (fds, &(select->set));
+	return FD_ISSET (fds, &(select->set)) || FD_ISSET (fds, &(select->wset));
 }
 
 
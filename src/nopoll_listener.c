@@ -636,7 +636,8 @@ nopoll_bool           nopoll_listener_set_certificate (noPollConn * listener,
 						       const char * private_key,
 						       const char * chain_file)
 {
-	FILE * handle;
+	FILE      * handle;
+	noPollPtr   ssl_ctx;
 
 	if (! listener || ! certificate || ! private_key)
 		return nopoll_false;
@@ -667,26 +668,227 @@ nopoll_bool           nopoll_listener_set_certificate (noPollConn * listener,
 		fclose (handle);
 	} /* end if */
 
+	/* preload key material (a previous chain is kept when no
+	 * chain is provided) so TLS handshakes don't read files. When
+	 * it can't be loaded, handshakes read the files */
+	if (chain_file == NULL)
+		chain_file = listener->chain_certificate;
+	ssl_ctx = __nopoll_ctx_load_certificate (listener->ctx, certificate, private_key, chain_file);
+
 	/* copy certificates to be used
 	 *
 	 * NOTE: release any value configured by a previous call:
 	 * assigning over the previous pointers leaked them */
-	nopoll_free (listener->certificate);
-	nopoll_free (listener->private_key);
-	listener->certificate   = nopoll_strdup (certificate);
-	listener->private_key   = nopoll_strdup (private_key);
-	if (chain_file) {
-		nopoll_free (listener->chain_certificate);
-		listener->chain_certificate = nopoll_strdup (chain_file);
-	} /* end if */
+	__nopoll_listener_swap_certificate (listener, certificate, private_key, chain_file, ssl_ctx,
+					    __nopoll_ctx_certificate_stamp (certificate, private_key, chain_file));
 	    
 	nopoll_log (listener->ctx, NOPOLL_LEVEL_DEBUG, "Configured certificate: %s, key: %s, for conn id: %d",
-		    listener->certificate, listener->private_key, listener->id);
+		    certificate, private_key, listener->id);
 
 	/* certificates configured */
 	return nopoll_true;
 }
 
+/**
+ * @brief Replaces the TLS certificate and key used by the provided
+ * listener (see \ref nopoll_listener_set_certificate), for example
+ * after renewing them.
+ *
+ * The new certificate is loaded first and then swapped in
+ * atomically: handshakes already running keep using the previous
+ * one, while connections accepted after this call get the new
+ * one. When the files can't be loaded the current certificate is
+ * kept and the function fails. The function can be called from any
+ * thread. See also \ref nopoll_ctx_watch_certificates.
+ *
+ * @param listener The listener to update.
+ *
+ * @param certificate The path to the public certificate file (PEM
+ * format).
+ *
+ * @param private_key The path to the key file (PEM format).
+ *
+ * @param chain_file The path to additional chain certificates (PEM
+ * format) or NULL if there is no chain.
+ *
+ * @return nopoll_true if the certificate was replaced, otherwise
+ * nopoll_false is returned.
+ */
+nopoll_bool           nopoll_listener_reload_certificate (noPollConn * listener,
+							  const char * certificate,
+							  const char * private_key,
+							  const char * chain_file)
+{
+	noPollPtr ssl_ctx;
+	long      stamp;
+
+	if (! listener || ! certificate || ! private_key)
+		return nopoll_false;
+
+	/* load new key material without holding any lock */
+	stamp   = __nopoll_ctx_certificate_stamp (certificate, private_key, chain_file);
+	ssl_ctx = __nopoll_ctx_load_certificate (listener->ctx, certificate, private_key, chain_file);
+	if (ssl_ctx == NULL) {
+		nopoll_log (listener->ctx, NOPOLL_LEVEL_CRITICAL, "Unable to reload certificate %s for listener id: %d, keeping current one",
+			    certificate, listener->id);
+		return nopoll_false;
+	} /* end if */
+
+	__nopoll_listener_swap_certificate (listener, certificate, private_key, chain_file, ssl_ctx, stamp);
+
+	nopoll_log (listener->ctx, NOPOLL_LEVEL_DEBUG, "Reloaded certificate: %s, key: %s, for conn id: %d",
+		    certificate, private_key, listener->id);
+	return nopoll_true;
+}
+
+/**
+ * @internal Replaces the certificate configuration of the listener
+ * (taking the reference to ssl_ctx, a SSL_CTX * that can be NULL)
+ * under its mutex.
+ */
+void __nopoll_listener_swap_certificate (noPollConn * listener,
+					 const char * certificate,
+					 const char * private_key,
+					 const char * chain_file,
+					 noPollPtr    ssl_ctx,
+					 long         stamp)
+{
+	char    * files[3];
+	SSL_CTX * previous;
+	SSL_CTX * accept_ctx;
+
+	/* copy before releasing: chain_file may be the current value */
+	nopoll_mutex_lock (listener->ref_mutex);
+	files[0]                    = listener->certificate;
+	files[1]                    = listener->private_key;
+	files[2]                    = listener->chain_certificate;
+	previous                    = listener->cert_ctx;
+	accept_ctx                  = listener->accept_ctx;
+	listener->accept_ctx        = NULL;
+	listener->certificate       = nopoll_strdup (certificate);
+	listener->private_key       = nopoll_strdup (private_key);
+	listener->chain_certificate = chain_file ? nopoll_strdup (chain_file) : NULL;
+	listener->cert_ctx          = (SSL_CTX *) ssl_ctx;
+	listener->cert_stamp        = stamp;
+	nopoll_mutex_unlock (listener->ref_mutex);
+
+	/* let the certificate watcher know there are new files */
+	nopoll_mutex_lock (listener->ctx->ref_mutex);
+	listener->ctx->cert_generation++;
+	nopoll_mutex_unlock (listener->ctx->ref_mutex);
+
+	/* sessions using the previous key material hold their own
+	 * references */
+	if (previous)
+		SSL_CTX_free (previous);
+	if (accept_ctx)
+		SSL_CTX_free (accept_ctx);
+	nopoll_free (files[0]);
+	nopoll_free (files[1]);
+	nopoll_free (files[2]);
+	return;
+}
+
+/**
+ * @internal Configures on the ssl_ctx provided (an SSL_CTX * being
+ * prepared for a connection accepted by the listener) the key material
+ * preloaded for the listener.
+ *
+ * @return nopoll_true if the key material was configured, nopoll_false
+ * when it is not preloaded.
+ */
+nopoll_bool __nopoll_listener_use_certificate (noPollConn * listener, noPollPtr ssl_ctx)
+{
+	nopoll_bool result = nopoll_false;
+
+	nopoll_mutex_lock (listener->ref_mutex);
+	if (listener->cert_ctx)
+		result = __nopoll_ctx_apply_certificate (ssl_ctx, listener->cert_ctx);
+	nopoll_mutex_unlock (listener->ref_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Returns the SSL_CTX shared by the TLS connections
+ * accepted by the listener (with a reference acquired for the
+ * caller), so accepting does not build and configure a new one each
+ * time. NULL is returned when there is none or it was built for a
+ * previous generation of the context certificates (see
+ * __nopoll_ctx_sni_publish).
+ */
+noPollPtr __nopoll_listener_get_accept_ctx (noPollConn * listener, int generation)
+{
+	SSL_CTX * ssl_ctx = NULL;
+
+	nopoll_mutex_lock (listener->ref_mutex);
+	if (listener->accept_ctx && listener->accept_ctx_generation == generation) {
+		ssl_ctx = listener->accept_ctx;
+		__nopoll_ctx_ssl_ctx_ref (ssl_ctx);
+	} /* end if */
+	nopoll_mutex_unlock (listener->ref_mutex);
+
+	return ssl_ctx;
+}
+
+/**
+ * @internal Records the SSL_CTX provided (acquiring a reference) to
+ * be shared by next TLS connections accepted by the listener (see
+ * __nopoll_listener_get_accept_ctx).
+ */
+void __nopoll_listener_set_accept_ctx (noPollConn * listener, noPollPtr ssl_ctx, int generation)
+{
+	SSL_CTX * previous;
+
+	__nopoll_ctx_ssl_ctx_ref (ssl_ctx);
+
+	nopoll_mutex_lock (listener->ref_mutex);
+	previous                        = listener->accept_ctx;
+	listener->accept_ctx            = (SSL_CTX *) ssl_ctx;
+	listener->accept_ctx_generation = generation;
+	nopoll_mutex_unlock (listener->ref_mutex);
+
+	if (previous)
+		SSL_CTX_free (previous);
+	return;
+}
+
+/**
+ * @internal Checks the certificate files of the listener, reloading
+ * them when they changed (see nopoll_ctx_watch_certificates).
+ */
+void __nopoll_listener_watch_certificate (noPollConn * listener)
+{
+	char * files[3];
+	long   stamp;
+	long   current;
+
+	nopoll_mutex_lock (listener->ref_mutex);
+	if (listener->certificate == NULL || listener->private_key == NULL) {
+		nopoll_mutex_unlock (listener->ref_mutex);
+		return;
+	} /* end if */
+	files[0] = nopoll_strdup (listener->certificate);
+	files[1] = nopoll_strdup (listener->private_key);
+	files[2] = listener->chain_certificate ? nopoll_strdup (listener->chain_certificate) : NULL;
+	stamp    = listener->cert_stamp;
+	nopoll_mutex_unlock (listener->ref_mutex);
+
+	__nopoll_ctx_watch_file (listener->ctx, files[0]);
+	__nopoll_ctx_watch_file (listener->ctx, files[1]);
+	__nopoll_ctx_watch_file (listener->ctx, files[2]);
+
+	/* reload on changes (a failure is retried on next check) */
+	current = __nopoll_ctx_certificate_stamp (files[0], files[1], files[2]);
+	if (current != -1 && current != stamp)
+		nopoll_listener_reload_certificate (listener, files[0], files[1], files[2]);
+
+	nopoll_free (files[0]);
+	nopoll_free (files[1]);
+	nopoll_free (files[2]);
+	return;
+}
+
 /**
  * @brief Creates a websocket connection object from the socket
  * provided, representing a connection already accepted by a listener:
@@ -87,11 +87,32 @@ nopoll_bool       nopoll_listener_set_certificate (noPollConn * listener,
 						   const char * private_key,
 						   const char * chain_file);
 
+nopoll_bool       nopoll_listener_reload_certificate (noPollConn * listener,
+						      const char * certificate,
+						      const char * private_key,
+						      const char * chain_file);
+
 noPollConn      * nopoll_listener_from_socket (noPollCtx      * ctx,
 					       NOPOLL_SOCKET    session);
 
 NOPOLL_SOCKET     nopoll_listener_accept (NOPOLL_SOCKET server_socket);
 
+/** internal API **/
+void              __nopoll_listener_swap_certificate (noPollConn * listener,
+						      const char * certificate,
+						      const char * private_key,
+						      const char * chain_file,
+						      noPollPtr    ssl_ctx,
+						      long         stamp);
+
+nopoll_bool       __nopoll_listener_use_certificate (noPollConn * listener, noPollPtr ssl_ctx);
+
+noPollPtr         __nopoll_listener_get_accept_ctx (noPollConn * listener, int generation);
+
+void              __nopoll_listener_set_accept_ctx (noPollConn * listener, noPollPtr ssl_ctx, int generation);
+
+void              __nopoll_listener_watch_certificate (noPollConn * listener);
+
 END_C_DECLS
 
 #endif
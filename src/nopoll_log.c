@@ -38,6 +38,76 @@
 #include <nopoll.h>
 #include <nopoll_private.h>
 
+#if defined(NOPOLL_OS_WIN32) && ! defined(__GNUC__)
+# define __nopoll_log_vsnprintf _vsnprintf
+#else
+# define __nopoll_log_vsnprintf vsnprintf
+#endif
+
+#if defined(NOPOLL_HAVE_PTHREAD)
+#include <pthread.h>
+
+/* asynchronous logger: each thread writes records into its own ring
+ * (single producer, single consumer) drained by the logger thread,
+ * which is the one formatting them */
+typedef struct _noPollLogRecord {
+	noPollDebugLevel   level;
+	struct timeval     stamp;
+	const char       * file;
+	int                line;
+	int                conn_id;
+	/* message format (NULL when args holds the message already
+	 * formatted) and its arguments (see __nopoll_log_encode) */
+	const char       * format;
+	char               args[NOPOLL_LOG_RECORD_SIZE];
+} noPollLogRecord;
+
+/* arguments encoded into log records */
+#define NOPOLL_LOG_ARG_NONE     (0)
+#define NOPOLL_LOG_ARG_INT      (1)
+#define NOPOLL_LOG_ARG_LONG     (2)
+#define NOPOLL_LOG_ARG_DOUBLE   (3)
+#define NOPOLL_LOG_ARG_LDOUBLE  (4)
+#define NOPOLL_LOG_ARG_STRING   (5)
+#define NOPOLL_LOG_ARG_POINTER  (6)
+
+/* longest conversion specification handled */
+#define NOPOLL_LOG_SPEC_SIZE    (32)
+
+typedef struct _noPollLogRing noPollLogRing;
+
+struct _noPollLogRing {
+	noPollLogRecord         records[NOPOLL_LOG_RING_SIZE];
+	/* written by the producer thread and by the logger thread */
+	volatile unsigned long  head;
+	volatile unsigned long  tail;
+	volatile long           overruns;
+	/* the producer thread finished */
+	volatile int            closed;
+	/* connection the producer thread is handling (see
+	 * __nopoll_log_set_conn) */
+	int                     conn_id;
+	noPollLogRing         * next;
+};
+
+typedef struct _noPollLogAsync {
+	noPollCtx       * ctx;
+	int               fd;
+	pthread_key_t     key;
+	pthread_mutex_t   mutex;
+	/* the logger thread waits here while all rings are empty */
+	pthread_cond_t    cond;
+	pthread_t         thread;
+	noPollLogRing   * rings;
+	/* rings taken by the logger thread while it drains them */
+	noPollLogRing   * detached;
+	/* overruns of rings already released */
+	long              overruns;
+	volatile int      sleeping;
+	volatile int      stop;
+} noPollLogAsync;
+#endif
+
 /** 
  * \defgroup nopoll_log noPoll Log: Console log reporting for noPoll library
  */
@@ -94,6 +164,7 @@ void     nopoll_log_enable (noPollCtx * ctx, nopoll_bool value)
 
 	/* activate debuging according to the variable */
 	ctx->debug_enabled = value;
+	__nopoll_log_update (ctx);
 	return;
 }
 
@@ -133,12 +204,790 @@ void            nopoll_log_set_handler (noPollCtx * ctx, noPollLogHandler handle
 {
 	nopoll_return_if_fail (ctx, ctx);
 
-	ctx->log_handler   = handler;
-	ctx->log_user_data = user_data;
+	ctx->log_handler     = handler;
+	ctx->log_handler_ext = NULL;
+	ctx->log_user_data   = user_data;
+	__nopoll_log_update (ctx);
+
+	return;
+}
+
+/**
+ * @brief Allows to define a log handler that will receive all logs
+ * produced under the provided context, with the source file and line
+ * as separate fields (\ref nopoll_log_set_handler handlers receive
+ * them as a prefix of the message).
+ *
+ * Only one handler is used: this replaces any handler configured
+ * with \ref nopoll_log_set_handler.
+ *
+ * @param ctx The context that is going to be configured.
+ *
+ * @param handler The handler to be called for each log to be
+ * notified. Passing in NULL is allowed to remove any previously
+ * configured handler.
+ *
+ * @param user_data User defined pointer to be passed in into the
+ * handler configured along with the log notified.
+ */
+void            nopoll_log_set_handler_ext (noPollCtx * ctx, noPollLogHandlerExt handler, noPollPtr user_data)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->log_handler     = NULL;
+	ctx->log_handler_ext = handler;
+	ctx->log_user_data   = user_data;
+	__nopoll_log_update (ctx);
+
+	return;
+}
+
+/**
+ * @brief Allows to configure the minimum level of the logs reported
+ * (to the console or to the log handler configured). Logs below it
+ * are skipped without formatting (or evaluating) their arguments.
+ *
+ * @param ctx The context that is going to be configured.
+ *
+ * @param level The minimum level reported (\ref NOPOLL_LEVEL_DEBUG by
+ * default, which reports all logs).
+ */
+void            nopoll_log_set_level (noPollCtx * ctx, noPollDebugLevel level)
+{
+	nopoll_return_if_fail (ctx, ctx);
+
+	ctx->log_level = level;
+	__nopoll_log_update (ctx);
+	return;
+}
 
+/**
+ * @internal Allows to check if a log of the provided level is
+ * reported on the provided context (the check done by nopoll_log
+ * before evaluating its arguments).
+ */
+nopoll_bool     __nopoll_log_is_active (noPollCtx * ctx, noPollDebugLevel level)
+{
+	return ctx && (int) level >= ctx->log_threshold;
+}
+
+/**
+ * @internal Updates the log threshold cached on the context after its
+ * log configuration changes: logs are reported from the minimum level
+ * configured when the console log or a handler is enabled, otherwise
+ * none is.
+ */
+void            __nopoll_log_update (noPollCtx * ctx)
+{
+	if (ctx->debug_enabled || ctx->log_handler || ctx->log_handler_ext)
+		ctx->log_threshold = ctx->log_level;
+	else
+		ctx->log_threshold = NOPOLL_LEVEL_CRITICAL + 1;
 	return;
 }
 
+#if defined(SHOW_DEBUG_LOG) || defined(NOPOLL_HAVE_PTHREAD)
+/**
+ * @internal Formats into the buffer provided.
+ *
+ * @return Bytes written or -1 if the result doesn't fit.
+ */
+static int __nopoll_log_format (char * buffer, int size, const char * format, ...)
+{
+	va_list args;
+	int     result;
+
+	va_start (args, format);
+	result = __nopoll_log_vsnprintf (buffer, size, format, args);
+	va_end (args);
+	if (result < 0 || result >= size)
+		return -1;
+	return result;
+}
+#endif
+
+#if defined(NOPOLL_HAVE_PTHREAD)
+/**
+ * @internal Called when a thread that logged finishes: its ring is
+ * released by the logger thread once drained.
+ */
+static void __nopoll_log_async_thread_end (void * data)
+{
+	noPollLogRing * ring = (noPollLogRing *) data;
+
+	__sync_synchronize ();
+	ring->closed = 1;
+	return;
+}
+
+/**
+ * @internal Parses the conversion specification found after a '%' of
+ * a log format, placing at type the argument it consumes
+ * (NOPOLL_LOG_ARG_*). Only C89 conversions without '*' are handled.
+ *
+ * @return Length of the specification (conversion included) or -1 if
+ * it isn't handled.
+ */
+static int __nopoll_log_spec (const char * spec, int * type)
+{
+	int length   = 0;
+	int modifier = 0;
+
+	while (spec[length] == '-' || spec[length] == '+' || spec[length] == ' ' || spec[length] == '#' || spec[length] == '0')
+		length++;
+	while (spec[length] >= '0' && spec[length] <= '9')
+		length++;
+	if (spec[length] == '.') {
+		length++;
+		while (spec[length] >= '0' && spec[length] <= '9')
+			length++;
+	} /* end if */
+	if (spec[length] == 'h' || spec[length] == 'l' || spec[length] == 'L') {
+		modifier = spec[length];
+		length++;
+	} /* end if */
+
+	switch (spec[length]) {
+	case '%':
+		*type = NOPOLL_LOG_ARG_NONE;
+		break;
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+	case 'c':
+		if (modifier == 'L' || (modifier == 'l' && spec[length] == 'c'))
+			return -1;
+		*type = modifier == 'l' ? NOPOLL_LOG_ARG_LONG : NOPOLL_LOG_ARG_INT;
+		break;
+	case 'e':
+	case 'E':
+	case 'f':
+	case 'g':
+	case 'G':
+		if (modifier == 'h')
+			return -1;
+		*type = modifier == 'L' ? NOPOLL_LOG_ARG_LDOUBLE : NOPOLL_LOG_ARG_DOUBLE;
+		break;
+	case 's':
+	case 'p':
+		if (modifier)
+			return -1;
+		*type = spec[length] == 's' ? NOPOLL_LOG_ARG_STRING : NOPOLL_LOG_ARG_POINTER;
+		break;
+	default:
+		return -1;
+	} /* end switch */
+
+	/* '%' and the terminator are added when it is formatted */
+	if (*type != NOPOLL_LOG_ARG_NONE && length + 3 > NOPOLL_LOG_SPEC_SIZE)
+		return -1;
+	return length + 1;
+}
+
+/**
+ * @internal Bytes taken by an encoded argument (strings take their
+ * content plus a terminator).
+ */
+static int __nopoll_log_arg_size (int type)
+{
+	switch (type) {
+	case NOPOLL_LOG_ARG_INT:
+		return sizeof (int);
+	case NOPOLL_LOG_ARG_LONG:
+		return sizeof (long);
+	case NOPOLL_LOG_ARG_DOUBLE:
+		return sizeof (double);
+	case NOPOLL_LOG_ARG_LDOUBLE:
+		return sizeof (long double);
+	case NOPOLL_LOG_ARG_POINTER:
+		return sizeof (void *);
+	default:
+		return 0;
+	} /* end switch */
+}
+
+/**
+ * @internal Formats the message of the provided record (see
+ * __nopoll_log_encode) into the buffer provided, truncating it if it
+ * doesn't fit. Called by the logger thread.
+ */
+static void __nopoll_log_decode (noPollLogRecord * record, char * buffer, int size)
+{
+	const char  * format = record->format;
+	const char  * args   = record->args;
+	char          spec[NOPOLL_LOG_SPEC_SIZE];
+	int           used   = 0;
+	int           length;
+	int           type;
+	int           written;
+	int           int_value;
+	long          long_value;
+	double        double_value;
+	long double   ldouble_value;
+	void        * pointer_value;
+
+	/* formatted by the producer */
+	if (format == NULL) {
+		__nopoll_log_format (buffer, size, "%s", record->args);
+		return;
+	} /* end if */
+
+	while (*format && used < size - 1) {
+		if (*format != '%') {
+			buffer[used++] = *format++;
+			continue;
+		} /* end if */
+
+		length = __nopoll_log_spec (format + 1, &type);
+		if (length < 0)
+			break;
+		if (type == NOPOLL_LOG_ARG_NONE) {
+			buffer[used++] = '%';
+			format        += length + 1;
+			continue;
+		} /* end if */
+		memcpy (spec, format, length + 1);
+		spec[length + 1] = 0;
+		format += length + 1;
+
+		switch (type) {
+		case NOPOLL_LOG_ARG_INT:
+			memcpy (&int_value, args, sizeof (int));
+			written = __nopoll_log_format (buffer + used, size - used, spec, int_value);
+			break;
+		case NOPOLL_LOG_ARG_LONG:
+			memcpy (&long_value, args, sizeof (long));
+			written = __nopoll_log_format (buffer + used, size - used, spec, long_value);
+			break;
+		case NOPOLL_LOG_ARG_DOUBLE:
+			memcpy (&double_value, args, sizeof (double));
+			written = __nopoll_log_format (buffer + used, size - used, spec, double_value);
+			break;
+		case NOPOLL_LOG_ARG_LDOUBLE:
+			memcpy (&ldouble_value, args, sizeof (long double));
+			written = __nopoll_log_format (buffer + used, size - used, spec, ldouble_value);
+			break;
+		case NOPOLL_LOG_ARG_POINTER:
+			memcpy (&pointer_value, args, sizeof (void *));
+			written = __nopoll_log_format (buffer + used, size - used, spec, pointer_value);
+			break;
+		default:
+			written = __nopoll_log_format (buffer + used, size - used, spec, args);
+			args   += strlen (args) + 1;
+			break;
+		} /* end switch */
+		args += __nopoll_log_arg_size (type);
+
+		/* doesn't fit: keep what was written */
+		if (written < 0) {
+			used = size - 1;
+			break;
+		} /* end if */
+		used += written;
+	} /* end while */
+
+	buffer[used] = 0;
+	return;
+}
+
+/**
+ * @internal Writes the batch provided to the logger descriptor
+ * (errors are ignored: there is nowhere to report them).
+ */
+static void __nopoll_log_async_write (int fd, const char * buffer, int size)
+{
+	int written;
+
+	while (size > 0) {
+		written = write (fd, buffer, size);
+		if (written <= 0)
+			return;
+		buffer += written;
+		size   -= written;
+	} /* end while */
+	return;
+}
+
+/**
+ * @internal Writes the records pending on the provided ring to the
+ * logger descriptor (one write per batch).
+ *
+ * @return Number of records written.
+ */
+static int __nopoll_log_async_drain_ring (noPollLogAsync * async, noPollLogRing * ring)
+{
+	char              buffer[8192];
+	char              message[NOPOLL_LOG_BUFFER_SIZE];
+	int               size  = 0;
+	int               count = 0;
+	int               written;
+	unsigned long     head;
+	noPollLogRecord * record;
+	const char      * label;
+	nopoll_bool       color = nopoll_log_color_is_enabled (async->ctx);
+
+	head = ring->head;
+	__sync_synchronize ();
+	while (ring->tail != head) {
+		record = &ring->records[ring->tail % NOPOLL_LOG_RING_SIZE];
+		__nopoll_log_decode (record, message, sizeof (message));
+		switch (record->level) {
+		case NOPOLL_LEVEL_DEBUG:
+			label = color ? "(\e[1;32mdebug\e[0m)" : "(debug)";
+			break;
+		case NOPOLL_LEVEL_WARNING:
+			label = color ? "(\e[1;33mwarning\e[0m)" : "(warning)";
+			break;
+		default:
+			label = color ? "(\e[1;31mcritical\e[0m)" : "(critical)";
+			break;
+		} /* end switch */
+
+		if (record->conn_id > 0)
+			written = __nopoll_log_format (buffer + size, sizeof (buffer) - size, "(proc %d) [%ld.%06ld]: %s %s:%d conn-id=%d %s\n",
+						       getpid (), (long) record->stamp.tv_sec, (long) record->stamp.tv_usec,
+						       label, record->file, record->line, record->conn_id, message);
+		else
+			written = __nopoll_log_format (buffer + size, sizeof (buffer) - size, "(proc %d) [%ld.%06ld]: %s %s:%d %s\n",
+						       getpid (), (long) record->stamp.tv_sec, (long) record->stamp.tv_usec,
+						       label, record->file, record->line, message);
+		if (written < 0 && size > 0) {
+			/* batch full: write it and retry */
+			__nopoll_log_async_write (async->fd, buffer, size);
+			size = 0;
+			continue;
+		} /* end if */
+		if (written > 0)
+			size += written;
+
+		/* release the slot */
+		__sync_synchronize ();
+		ring->tail++;
+		count++;
+	} /* end while */
+
+	__nopoll_log_async_write (async->fd, buffer, size);
+	return count;
+}
+
+/**
+ * @internal Checks if some ring has records pending. The caller must
+ * hold async->mutex.
+ */
+static nopoll_bool __nopoll_log_async_pending (noPollLogAsync * async)
+{
+	noPollLogRing * ring;
+
+	for (ring = async->rings; ring; ring = ring->next) {
+		if (ring->tail != ring->head)
+			return nopoll_true;
+	} /* end for */
+	return nopoll_false;
+}
+
+/**
+ * @internal Logger thread: drains rings until the logger is stopped,
+ * releasing rings of threads that finished. Rings are detached while
+ * they are drained, so writes are done without holding async->mutex,
+ * and the thread waits on async->cond while there is nothing to
+ * write (producers wake it up, see __nopoll_log_async_push).
+ */
+static void * __nopoll_log_async_run (void * data)
+{
+	noPollLogAsync  * async = (noPollLogAsync *) data;
+	noPollLogRing   * rings;
+	noPollLogRing  ** ring;
+	noPollLogRing   * closed;
+	int               count;
+	int               stop;
+
+	while (nopoll_true) {
+		pthread_mutex_lock (&async->mutex);
+		stop            = async->stop;
+		rings           = async->rings;
+		async->rings    = NULL;
+		async->detached = rings;
+		pthread_mutex_unlock (&async->mutex);
+
+		count = 0;
+		for (closed = rings; closed; closed = closed->next)
+			count += __nopoll_log_async_drain_ring (async, closed);
+
+		/* release rings of threads that finished and put the
+		 * rest back, ahead of rings registered meanwhile */
+		pthread_mutex_lock (&async->mutex);
+		ring = &rings;
+		while (*ring) {
+			if ((*ring)->closed && (*ring)->tail == (*ring)->head) {
+				closed           = *ring;
+				*ring            = closed->next;
+				async->overruns += closed->overruns;
+				nopoll_free (closed);
+				continue;
+			} /* end if */
+			ring = &(*ring)->next;
+		} /* end while */
+		*ring           = async->rings;
+		async->rings    = rings;
+		async->detached = NULL;
+
+		/* last pass done after the stop request */
+		if (stop) {
+			pthread_mutex_unlock (&async->mutex);
+			break;
+		} /* end if */
+
+		/* wait for records: sleeping is published before
+		 * rings are checked, so a producer either finds it set
+		 * or its record is seen here */
+		if (count == 0) {
+			async->sleeping = 1;
+			__sync_synchronize ();
+			if (! async->stop && ! __nopoll_log_async_pending (async))
+				pthread_cond_wait (&async->cond, &async->mutex);
+			async->sleeping = 0;
+		} /* end if */
+		pthread_mutex_unlock (&async->mutex);
+	} /* end while */
+
+	return NULL;
+}
+
+/**
+ * @internal Returns the ring of the calling thread, created on first
+ * use (NULL if memory is exhausted).
+ */
+static noPollLogRing * __nopoll_log_async_ring (noPollLogAsync * async)
+{
+	noPollLogRing * ring = (noPollLogRing *) pthread_getspecific (async->key);
+
+	if (ring)
+		return ring;
+
+	ring = nopoll_new (noPollLogRing, 1);
+	if (ring == NULL)
+		return NULL;
+	pthread_mutex_lock (&async->mutex);
+	ring->next   = async->rings;
+	async->rings = ring;
+	pthread_mutex_unlock (&async->mutex);
+	pthread_setspecific (async->key, ring);
+	return ring;
+}
+
+#if defined(SHOW_DEBUG_LOG)
+/**
+ * @internal Stores into the record the format provided and its
+ * arguments without formatting them (that is done by the logger
+ * thread, see __nopoll_log_decode): values are copied as they are and
+ * strings are copied (truncated so the rest of arguments fit into
+ * NOPOLL_LOG_RECORD_SIZE). Formats with conversions not handled (see
+ * __nopoll_log_spec) are formatted here.
+ */
+static void __nopoll_log_encode (noPollLogRecord * record, const char * format, va_list args)
+{
+	const char  * cursor;
+	const char  * string;
+	int           fixed  = 0;
+	int           used   = 0;
+	int           length;
+	int           type;
+	int           room;
+	int           int_value;
+	long          long_value;
+	double        double_value;
+	long double   ldouble_value;
+	void        * pointer_value;
+
+	/* first pass (without taking arguments): check every
+	 * conversion is handled and find the room taken by values */
+	for (cursor = format; *cursor; cursor++) {
+		if (*cursor != '%')
+			continue;
+		length = __nopoll_log_spec (cursor + 1, &type);
+		if (length < 0)
+			break;
+		fixed  += __nopoll_log_arg_size (type) + (type == NOPOLL_LOG_ARG_STRING ? 1 : 0);
+		cursor += length;
+	} /* end for */
+	if (*cursor || fixed > NOPOLL_LOG_RECORD_SIZE) {
+		record->format = NULL;
+		if (__nopoll_log_vsnprintf (record->args, NOPOLL_LOG_RECORD_SIZE, format, args) < 0)
+			record->args[0] = 0;
+		record->args[NOPOLL_LOG_RECORD_SIZE - 1] = 0;
+		return;
+	} /* end if */
+
+	/* second pass: take arguments */
+	record->format = format;
+	for (cursor = format; *cursor; cursor++) {
+		if (*cursor != '%')
+			continue;
+		length  = __nopoll_log_spec (cursor + 1, &type);
+		cursor += length;
+
+		switch (type) {
+		case NOPOLL_LOG_ARG_NONE:
+			continue;
+		case NOPOLL_LOG_ARG_INT:
+			int_value = va_arg (args, int);
+			memcpy (record->args + used, &int_value, sizeof (int));
+			break;
+		case NOPOLL_LOG_ARG_LONG:
+			long_value = va_arg (args, long);
+			memcpy (record->args + used, &long_value, sizeof (long));
+			break;
+		case NOPOLL_LOG_ARG_DOUBLE:
+			double_value = va_arg (args, double);
+			memcpy (record->args + used, &double_value, sizeof (double));
+			break;
+		case NOPOLL_LOG_ARG_LDOUBLE:
+			ldouble_value = va_arg (args, long double);
+			memcpy (record->args + used, &ldouble_value, sizeof (long double));
+			break;
+		case NOPOLL_LOG_ARG_POINTER:
+			pointer_value = va_arg (args, void *);
+			memcpy (record->args + used, &pointer_value, sizeof (void *));
+			break;
+		default:
+			string = va_arg (args, const char *);
+			if (string == NULL)
+				string = "(null)";
+
+			/* copy what fits, leaving room for the rest */
+			fixed--;
+			room = NOPOLL_LOG_RECORD_SIZE - used - fixed - 1;
+			while (room > 0 && *string) {
+				record->args[used++] = *string++;
+				room--;
+			} /* end while */
+			record->args[used++] = 0;
+			continue;
+		} /* end switch */
+
+		length  = __nopoll_log_arg_size (type);
+		used   += length;
+		fixed  -= length;
+	} /* end for */
+
+	return;
+}
+
+/**
+ * @internal Stores a log record on the calling thread ring.
+ *
+ * @return nopoll_true if the record was handled (stored or counted as
+ * an overrun), nopoll_false if the ring couldn't be created.
+ */
+static nopoll_bool __nopoll_log_async_push (noPollLogAsync * async, noPollDebugLevel level, const char * file, int line, const char * message, va_list args)
+{
+	noPollLogRing   * ring = __nopoll_log_async_ring (async);
+	noPollLogRecord * record;
+
+	if (ring == NULL)
+		return nopoll_false;
+
+	/* never block: count records that don't fit */
+	if (ring->head - ring->tail >= NOPOLL_LOG_RING_SIZE) {
+		ring->overruns++;
+		return nopoll_true;
+	} /* end if */
+
+	record          = &ring->records[ring->head % NOPOLL_LOG_RING_SIZE];
+	record->level   = level;
+	record->file    = file;
+	record->line    = line;
+	record->conn_id = ring->conn_id;
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&record->stamp, NULL);
+#else
+	gettimeofday (&record->stamp, NULL);
+#endif
+	__nopoll_log_encode (record, message, args);
+
+	/* publish the record */
+	__sync_synchronize ();
+	ring->head++;
+
+	/* wake the logger thread up when it is waiting */
+	__sync_synchronize ();
+	if (async->sleeping) {
+		pthread_mutex_lock (&async->mutex);
+		async->sleeping = 0;
+		pthread_cond_signal (&async->cond);
+		pthread_mutex_unlock (&async->mutex);
+	} /* end if */
+	return nopoll_true;
+}
+#endif
+#endif
+
+/**
+ * @brief Allows to write console logs from a background thread
+ * instead of the thread producing them.
+ *
+ * Each thread logging stores its records (level, time, source
+ * location, the message format and its arguments) into its own
+ * lock-free ring, which is drained by a logger thread formatting them
+ * and writing batches to the descriptor provided, so the thread
+ * logging does not format messages. When a ring is full, records are
+ * dropped and counted (see \ref nopoll_log_async_overruns) rather
+ * than blocking the caller. Records logged while the loop handles a
+ * connection (see \ref nopoll_loop_wait) carry its id (conn-id=).
+ *
+ * Only console logs are affected (see \ref nopoll_log_enable): logs
+ * delivered to a log handler are not. Configure it before other
+ * threads use the context. Formats are kept until the record is
+ * written, so they must be string literals (as nopoll_log calls use),
+ * and string arguments longer than \ref NOPOLL_LOG_RECORD_SIZE (for
+ * all the arguments of a record) are truncated.
+ *
+ * @param ctx The context that is going to be configured.
+ *
+ * @param fd The descriptor where logs are written (for example 1 for
+ * the standard output). Use -1 to flush and stop the logger.
+ *
+ * @return nopoll_true if the logger was configured, otherwise
+ * nopoll_false (for example, when noPoll was built without POSIX
+ * threads support).
+ */
+nopoll_bool     nopoll_log_set_async (noPollCtx * ctx, int fd)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	noPollLogAsync * async;
+
+	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+
+	/* replace the current logger (if any) */
+	__nopoll_log_async_release (ctx);
+	if (fd < 0)
+		return nopoll_true;
+
+	async = nopoll_new (noPollLogAsync, 1);
+	if (async == NULL)
+		return nopoll_false;
+	async->ctx = ctx;
+	async->fd  = fd;
+	if (pthread_key_create (&async->key, __nopoll_log_async_thread_end) != 0) {
+		nopoll_free (async);
+		return nopoll_false;
+	} /* end if */
+	pthread_mutex_init (&async->mutex, NULL);
+	pthread_cond_init (&async->cond, NULL);
+	if (pthread_create (&async->thread, NULL, __nopoll_log_async_run, async) != 0) {
+		pthread_cond_destroy (&async->cond);
+		pthread_mutex_destroy (&async->mutex);
+		pthread_key_delete (async->key);
+		nopoll_free (async);
+		return nopoll_false;
+	} /* end if */
+
+	ctx->log_async = async;
+	return nopoll_true;
+#else
+	nopoll_return_val_if_fail (ctx, ctx, nopoll_false);
+	return fd < 0;
+#endif
+}
+
+/**
+ * @brief Allows to get how many log records were dropped by the
+ * asynchronous logger because the ring of the thread producing them
+ * was full (see \ref nopoll_log_set_async).
+ *
+ * @param ctx The context where the logger is configured.
+ *
+ * @return Number of records dropped (0 when the logger isn't
+ * configured).
+ */
+long            nopoll_log_async_overruns (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	noPollLogAsync * async;
+	noPollLogRing  * ring;
+	long             result;
+
+	if (ctx == NULL || ctx->log_async == NULL)
+		return 0;
+	async = (noPollLogAsync *) ctx->log_async;
+
+	pthread_mutex_lock (&async->mutex);
+	result = async->overruns;
+	for (ring = async->rings; ring; ring = ring->next)
+		result += ring->overruns;
+	for (ring = async->detached; ring; ring = ring->next)
+		result += ring->overruns;
+	pthread_mutex_unlock (&async->mutex);
+	return result;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * @internal Sets the connection the calling thread is handling (NULL
+ * once done), so records it hands to the asynchronous logger carry
+ * its id (see nopoll_loop_process). Does nothing when the logger
+ * isn't configured.
+ */
+void            __nopoll_log_set_conn (noPollCtx * ctx, noPollConn * conn)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	noPollLogAsync * async;
+	noPollLogRing  * ring;
+
+	if (ctx == NULL || ctx->log_async == NULL)
+		return;
+	async = (noPollLogAsync *) ctx->log_async;
+
+	if (conn)
+		ring = __nopoll_log_async_ring (async);
+	else
+		ring = (noPollLogRing *) pthread_getspecific (async->key);
+	if (ring)
+		ring->conn_id = conn ? conn->id : 0;
+#endif
+	return;
+}
+
+/**
+ * @internal Stops the asynchronous logger of the provided context
+ * (if any), writing the records still pending.
+ */
+void            __nopoll_log_async_release (noPollCtx * ctx)
+{
+#if defined(NOPOLL_HAVE_PTHREAD)
+	noPollLogAsync * async = (noPollLogAsync *) ctx->log_async;
+	noPollLogRing  * ring;
+
+	if (async == NULL)
+		return;
+	ctx->log_async = NULL;
+
+	/* the logger thread drains everything before finishing */
+	pthread_mutex_lock (&async->mutex);
+	async->stop = 1;
+	pthread_cond_signal (&async->cond);
+	pthread_mutex_unlock (&async->mutex);
+	pthread_join (async->thread, NULL);
+
+	pthread_key_delete (async->key);
+	while (async->rings) {
+		ring         = async->rings;
+		async->rings = ring->next;
+		nopoll_free (ring);
+	} /* end while */
+	pthread_cond_destroy (&async->cond);
+	pthread_mutex_destroy (&async->mutex);
+	nopoll_free (async);
+#endif
+	return;
+}
+
+
 /** 
  * @internal Allows to drop a log to the console.
  *
@@ -168,21 +1017,55 @@ void __nopoll_log (noPollCtx * ctx, const char * function_name, const char * fil
 
 #ifdef SHOW_DEBUG_LOG
 	va_list      args;
+	char         buffer[NOPOLL_LOG_BUFFER_SIZE];
 	char       * log_msg;
 	char       * log_msg2;
+	int          size = 0;
+	int          written;
 
-	if (ctx && ctx->log_handler) {
-		/* print the message */
-		va_start (args, message);
-		log_msg = nopoll_strdup_printfv (message, args);
-		va_end (args);
+	/* check if the log is enabled for this level (already done by
+	 * nopoll_log, but this function can be called directly) */
+	if (! __NOPOLL_LOG_ACTIVE (ctx, level))
+		return;
 
-		log_msg2 = log_msg;
-		log_msg = nopoll_strdup_printf ("%s:%d %s ", file, line, log_msg);
-		nopoll_free (log_msg2);
+	if (ctx->log_handler || ctx->log_handler_ext) {
+		/* format into the stack buffer (handlers without
+		 * location fields get it as a prefix): only messages
+		 * that don't fit are allocated */
+		if (ctx->log_handler)
+			size = __nopoll_log_format (buffer, sizeof (buffer), "%s:%d ", file, line);
+		written = -1;
+		if (size >= 0) {
+			va_start (args, message);
+			written = __nopoll_log_vsnprintf (buffer + size, sizeof (buffer) - size - 1, message, args);
+			va_end (args);
+			if (written >= (int) sizeof (buffer) - size - 1)
+				written = -1;
+		} /* end if */
 
-		ctx->log_handler (ctx, level, log_msg, ctx->log_user_data);
-		nopoll_free (log_msg);
+		log_msg = buffer;
+		if (written < 0) {
+			va_start (args, message);
+			log_msg = nopoll_strdup_printfv (message, args);
+			va_end (args);
+			if (ctx->log_handler) {
+				log_msg2 = log_msg;
+				log_msg  = nopoll_strdup_printf ("%s:%d %s ", file, line, log_msg2);
+				nopoll_free (log_msg2);
+			} /* end if */
+		} else if (ctx->log_handler) {
+			buffer[size + written]     = ' ';
+			buffer[size + written + 1] = 0;
+		} /* end if */
+		if (log_msg == NULL)
+			return;
+
+		if (ctx->log_handler_ext)
+			ctx->log_handler_ext (ctx, level, file, line, log_msg, ctx->log_user_data);
+		else
+			ctx->log_handler (ctx, level, log_msg, ctx->log_user_data);
+		if (log_msg != buffer)
+			nopoll_free (log_msg);
 		return;
 	}
 
@@ -190,6 +1073,17 @@ void __nopoll_log (noPollCtx * ctx, const char * function_name, const char * fil
 	if (! nopoll_log_is_enabled (ctx))
 		return;
 
+#if defined(NOPOLL_HAVE_PTHREAD)
+	/* hand the record to the asynchronous logger */
+	if (ctx->log_async) {
+		va_start (args, message);
+		written = __nopoll_log_async_push ((noPollLogAsync *) ctx->log_async, level, file, line, message, args);
+		va_end (args);
+		if (written)
+			return;
+	} /* end if */
+#endif
+
 	/* printout the process pid */
 	if (nopoll_log_color_is_enabled (ctx)) 
 		printf ("\e[1;36m(proc %d)\e[0m: ", getpid ());
@@ -58,6 +58,22 @@ void            nopoll_log_color_enable (noPollCtx * ctx, nopoll_bool value);
 
 void            nopoll_log_set_handler (noPollCtx * ctx, noPollLogHandler handler, noPollPtr user_data);
 
+void            nopoll_log_set_handler_ext (noPollCtx * ctx, noPollLogHandlerExt handler, noPollPtr user_data);
+
+void            nopoll_log_set_level (noPollCtx * ctx, noPollDebugLevel level);
+
+nopoll_bool     nopoll_log_set_async (noPollCtx * ctx, int fd);
+
+long            nopoll_log_async_overruns (noPollCtx * ctx);
+
+nopoll_bool     __nopoll_log_is_active (noPollCtx * ctx, noPollDebugLevel level);
+
+void            __nopoll_log_update (noPollCtx * ctx);
+
+void            __nopoll_log_set_conn (noPollCtx * ctx, noPollConn * conn);
+
+void            __nopoll_log_async_release (noPollCtx * ctx);
+
 /* include this at this place to load GNU extensions */
 #if defined(__GNUC__)
 #  ifndef _GNU_SOURCE
@@ -78,8 +94,17 @@ void            nopoll_log_set_handler (noPollCtx * ctx, noPollLogHandler handle
 #endif
 
 
+/**
+ * @internal Check done by nopoll_log before evaluating its
+ * arguments. The library replaces it with a check of the threshold
+ * cached on the context (see nopoll_private.h).
+ */
+#if !defined(__NOPOLL_LOG_ACTIVE)
+# define __NOPOLL_LOG_ACTIVE(ctx,level) __nopoll_log_is_active (ctx, level)
+#endif
+
 #if defined(SHOW_DEBUG_LOG)
-# define nopoll_log(ctx,level,message, ...) do{__nopoll_log(ctx, __function_name__, __file__, __line__, level, message, ##__VA_ARGS__);}while(0)
+# define nopoll_log(ctx,level,message, ...) do{if (__NOPOLL_LOG_ACTIVE (ctx, level)) __nopoll_log(ctx, __function_name__, __file__, __line__, level, message, ##__VA_ARGS__);}while(0)
 #else
 # if defined(NOPOLL_OS_WIN32) && !( defined (__GNUC__) || _MSC_VER >= 1400)
 /* default case where '...' is not supported but log is still
@@ -57,6 +57,11 @@
  */
 nopoll_bool nopoll_loop_register (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
 {
+	/* connections dialed by a worker are watched once connecting
+	 * (the worker wakes up the loop when it finishes) */
+	if (! __nopoll_conn_dial_check (conn))
+		return nopoll_false; /* keep foreach, don't stop */
+
 	/* do not add connections that aren't working */
 	if (! nopoll_conn_is_ok (conn)) {
 		
@@ -66,9 +71,22 @@ nopoll_bool nopoll_loop_register (noPollCtx * ctx, noPollConn * conn, noPollPtr
 		return nopoll_false; /* keep foreach, don't stop */
 	}
 
-	/* Do not listen on sockets that are doing SSL/TLS handshake */
-	if (conn->pending_ssl_connect)
+	/* connections whose TLS handshake step runs on a worker are
+	 * watched again once it finishes */
+	if (__nopoll_worker_is_busy (ctx, conn))
+		return nopoll_false; /* keep foreach, don't stop */
+
+	/* close here connections whose TLS handshake failed on a
+	 * worker (see __nopoll_conn_tls_handshake_failed) */
+	if (conn->tls_failed) {
+		nopoll_conn_shutdown (conn);
+		nopoll_ctx_unregister_conn (ctx, conn);
 		return nopoll_false; /* keep foreach, don't stop */
+	} /* end if */
+
+	/* write content batched before waiting */
+	if (conn->tls_batch_size > 0)
+		__nopoll_conn_tls_batch_flush (conn);
 
 	/* register the connection socket */
 	/* nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Adding socket id: %d", conn->session);*/
@@ -90,7 +108,11 @@ nopoll_bool nopoll_loop_register (noPollCtx * ctx, noPollConn * conn, noPollPtr
  */
 void nopoll_loop_process_data (noPollCtx * ctx, noPollConn * conn)
 {
-	noPollMsg * msg;
+	noPollMsg      * msg;
+	nopoll_bool      is_first;
+	nopoll_bool      is_last;
+	nopoll_bool      timed;
+	struct timeval   start;
 
 	while (nopoll_true) {
 
@@ -99,12 +121,38 @@ void nopoll_loop_process_data (noPollCtx * ctx, noPollConn * conn)
 		if (msg == NULL)
 			return;
 
-		/* found message, notify it */
-		if (conn->on_msg)
+		/* record time since the socket was reported readable */
+		timed = ctx->latency_tracking && ctx->loop_wakeup.tv_sec > 0;
+		if (timed) {
+			__nopoll_latency_record (conn, NOPOLL_LATENCY_READ_TO_DISPATCH, &ctx->loop_wakeup);
+			__nopoll_latency_now (&start);
+		} /* end if */
+		NOPOLL_PROBE3 (msg_dispatch, conn->id, msg->op_code, msg->payload_size);
+
+		/* found message, notify it (streaming data messages
+		 * when configured) */
+		if ((conn->on_msg_chunk || ctx->on_msg_chunk) && msg->op_code <= NOPOLL_BINARY_FRAME) {
+			is_first = ! conn->chunk_message;
+			is_last  = msg->has_fin && msg->remain_bytes == 0;
+			if (is_first)
+				conn->chunk_op_code = msg->op_code;
+			conn->chunk_message = ! is_last;
+
+			if (conn->on_msg_chunk)
+				conn->on_msg_chunk (ctx, conn, conn->chunk_op_code, (const char *) msg->payload, msg->payload_size,
+						    is_first, is_last, conn->on_msg_chunk_data);
+			else
+				ctx->on_msg_chunk (ctx, conn, conn->chunk_op_code, (const char *) msg->payload, msg->payload_size,
+						   is_first, is_last, ctx->on_msg_chunk_data);
+		} else if (conn->on_msg)
 			conn->on_msg (ctx, conn, msg, conn->on_msg_data);
 		else if (ctx->on_msg)
 			ctx->on_msg (ctx, conn, msg, ctx->on_msg_data);
 
+		/* record time spent by the handler */
+		if (timed)
+			__nopoll_latency_record (conn, NOPOLL_LATENCY_HANDLER, &start);
+
 		/* release message */
 		nopoll_msg_unref (msg);
 
@@ -140,17 +188,33 @@ nopoll_bool nopoll_loop_process (noPollCtx * ctx, noPollConn * conn, noPollPtr u
 	 * handler notified for a previous connection is allowed to
 	 * close this one, leaving conn->session as
 	 * NOPOLL_INVALID_SOCKET, and reporting that descriptor to the
-	 * io engine just makes it complain about a non valid socket */
-	if (! nopoll_conn_is_ok (conn))
+	 * io engine just makes it complain about a non valid socket
+	 * (connections still dialing have no socket either) */
+	if (conn->session == NOPOLL_INVALID_SOCKET)
 		return nopoll_false; /* keep foreach, don't stop */
 
 	/* check if the connection have something to notify */
 	if (ctx->io_engine->is_set (ctx, conn->session, ctx->io_engine->io_object)) {
 
+		/* records logged meanwhile carry the connection id */
+		__nopoll_log_set_conn (ctx, conn);
+
 		/* call to notify action according to role */
 		switch (conn->role) {
 		case NOPOLL_ROLE_CLIENT:
 		case NOPOLL_ROLE_LISTENER:
+			/* keep on writing metrics replies (see
+			 * nopoll_ctx_set_metrics_path) */
+			if (conn->metrics_reply) {
+				__nopoll_metrics_flush (conn);
+				break;
+			} /* end if */
+
+			/* run the TLS handshake of accepted connections
+			 * on the workers (if configured) */
+			if (conn->pending_ssl_accept && __nopoll_worker_push (ctx, conn))
+				break;
+
 			/* received data, notify */
 			nopoll_loop_process_data (ctx, conn);
 			break;
@@ -163,6 +227,7 @@ nopoll_bool nopoll_loop_process (noPollCtx * ctx, noPollConn * conn, noPollPtr u
 			nopoll_conn_shutdown (conn);
 			break;
 		}
+		__nopoll_log_set_conn (ctx, NULL);
 		
 		/* reduce connection changed */
 		(*conn_changed)--;
@@ -235,11 +300,11 @@ void nopoll_loop_stop (noPollCtx * ctx)
  * the caller until a call to \ref nopoll_loop_stop is done in the case
  * timeout passed is 0. To wait 1 second, pass 1000000
  *
- * NOTE: the timeout is checked after every internal wait operation, so
- * it is not an exact deadline: the io wait engine may keep the caller
- * blocked up to its own internal wait period (500ms for the select(2)
- * based engine) before the timeout is noticed. Timeouts smaller than
- * that period will still block the caller for that period.
+ * Each internal wait operation is limited to \ref
+ * NOPOLL_IO_WAIT_TIMEOUT, to the time remaining to reach the
+ * timeout and to the nearest timer deadline, so the function returns
+ * close to the timeout requested and timers installed with \ref
+ * nopoll_timer_add are run on time (they are run by this function).
  *
  * @return The function returns 0 when finished without error or -2 in
  * the case ctx is NULL or timeout is negative. Function returns -3 if
@@ -281,6 +346,7 @@ int nopoll_loop_wait (noPollCtx * ctx, long timeout)
 	struct timeval stop;
 	struct timeval diff;
 	long           ellapsed;
+	long           wait_timeout;
 	int            wait_status;
 	int            result = 0;
 
@@ -308,12 +374,33 @@ int nopoll_loop_wait (noPollCtx * ctx, long timeout)
 	ctx->keep_looping = nopoll_true;
 
 	while (ctx->keep_looping) {
+		/* replace connections used or closed on pools */
+		if (ctx->conn_pools)
+			__nopoll_conn_pool_refill_all (ctx);
+
 		/* ok, now implement wait operation */
 		ctx->io_engine->clear (ctx, ctx->io_engine->io_object);
 		
 		/* add all connections */
 		/* nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Adding connections to watch: %d", ctx->conn_num);  */
 		nopoll_ctx_foreach_conn (ctx, nopoll_loop_register, NULL);
+		__nopoll_worker_register (ctx);
+
+		/* do not wait beyond the timeout or the nearest timer
+		 * deadline */
+		wait_timeout = NOPOLL_IO_WAIT_TIMEOUT;
+		if (timeout > 0) {
+#if defined(NOPOLL_OS_WIN32)
+			nopoll_win32_gettimeofday (&stop, NULL);
+#else
+			gettimeofday (&stop, NULL);
+#endif
+			nopoll_timeval_substract (&stop, &start, &diff);
+			ellapsed = (diff.tv_sec * 1000000) + diff.tv_usec;
+			if (timeout - ellapsed < wait_timeout)
+				wait_timeout = (timeout - ellapsed) < 0 ? 0 : (timeout - ellapsed) + 1;
+		} /* end if */
+		ctx->io_wait_timeout = __nopoll_timer_next_timeout (ctx, wait_timeout);
 
 		/* implement wait operation */
 		/* nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Waiting for changes into %d connections", ctx->conn_num); */
@@ -325,13 +412,28 @@ int nopoll_loop_wait (noPollCtx * ctx, long timeout)
 			break;
 		} /* end if */
 
+		NOPOLL_PROBE2 (loop_wakeup, wait_status, ctx->conn_num);
+
+		/* time this iteration when latency tracking is
+		 * enabled (see nopoll_ctx_set_latency_tracking) */
+		if (ctx->latency_tracking)
+			__nopoll_latency_now (&ctx->loop_wakeup);
+
 		/* check how many connections changed and restart */
+		if (wait_status > 0)
+			wait_status -= __nopoll_worker_process (ctx);
 		if (wait_status > 0) {
 			/* check and call for connections with something
 			 * interesting */
 			nopoll_ctx_foreach_conn (ctx, nopoll_loop_process, &wait_status);
 		}
 
+		/* run expired timers */
+		__nopoll_timer_process (ctx);
+
+		if (ctx->latency_tracking && ctx->loop_wakeup.tv_sec > 0)
+			__nopoll_latency_add (ctx, NOPOLL_LATENCY_LOOP, __nopoll_conn_elapsed_since (&ctx->loop_wakeup));
+
 		/* check to stop wait operation */
 		if (timeout > 0) {
 #if defined(NOPOLL_OS_WIN32)
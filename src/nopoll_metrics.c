@@ -0,0 +1,323 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_metrics.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_metrics noPoll Metrics: OpenMetrics exporter
+ */
+
+/** 
+ * \addtogroup nopoll_metrics
+ * @{
+ */
+
+typedef struct _noPollMetricsText {
+	char * data;
+	int    used;
+	int    size;
+	/* memory allocation failed */
+	nopoll_bool failed;
+} noPollMetricsText;
+
+static const char * __nopoll_metrics_opcodes[16] = {
+	"continuation", "text", "binary", "3", "4", "5", "6", "7",
+	"close", "ping", "pong", "11", "12", "13", "14", "15"
+};
+
+static const char * __nopoll_metrics_latencies[NOPOLL_LATENCY_MAX] = {
+	"read_to_dispatch", "handler", "write_flush", "loop"
+};
+
+static void __nopoll_metrics_printf (noPollMetricsText * text, const char * format, ...)
+{
+	va_list   args;
+	char    * line;
+	int       length;
+	char    * data;
+
+	if (text->failed)
+		return;
+
+	va_start (args, format);
+	line = nopoll_strdup_printfv (format, args);
+	va_end (args);
+	if (line == NULL) {
+		text->failed = nopoll_true;
+		return;
+	} /* end if */
+
+	/* grow the buffer when required */
+	length = strlen (line);
+	if (text->used + length + 1 > text->size) {
+		data = nopoll_realloc (text->data, text->size * 2 + length + 1);
+		if (data == NULL) {
+			nopoll_free (line);
+			text->failed = nopoll_true;
+			return;
+		} /* end if */
+		text->data  = data;
+		text->size  = text->size * 2 + length + 1;
+	} /* end if */
+
+	memcpy (text->data + text->used, line, length + 1);
+	text->used += length;
+	nopoll_free (line);
+	return;
+}
+
+static void __nopoll_metrics_by_opcode (noPollMetricsText * text, const char * name, const char * help, long * values)
+{
+	int iterator;
+
+	__nopoll_metrics_printf (text, "# TYPE nopoll_%s counter\n# HELP nopoll_%s %s\n", name, name, help);
+	for (iterator = 0; iterator < 16; iterator++) {
+		/* unknown opcodes are only reported if used */
+		if (values[iterator] == 0 && iterator != NOPOLL_TEXT_FRAME && iterator != NOPOLL_BINARY_FRAME)
+			continue;
+		__nopoll_metrics_printf (text, "nopoll_%s_total{opcode=\"%s\"} %ld\n",
+					 name, __nopoll_metrics_opcodes[iterator], values[iterator]);
+	} /* end for */
+	return;
+}
+
+static void __nopoll_metrics_histogram (noPollMetricsText * text, noPollCtx * ctx, noPollLatency which)
+{
+	noPollHistogram   hist;
+	const char      * name = __nopoll_metrics_latencies[which];
+	long              cumulative = 0;
+	int               iterator;
+
+	if (! nopoll_ctx_get_latency (ctx, which, &hist))
+		return;
+
+	__nopoll_metrics_printf (text, "# TYPE nopoll_latency_%s_microseconds histogram\n", name);
+	for (iterator = 0; iterator < NOPOLL_HISTOGRAM_BUCKETS; iterator++) {
+		cumulative += hist.counts[iterator];
+		/* report the same bounds on every scrape (2^n - 1, the
+		 * last bucket of each power of two) even when empty,
+		 * as expected by rate () and histogram_quantile ();
+		 * the last bucket also keeps bigger values so it is
+		 * only reported as +Inf */
+		if (iterator % 4 != 3 || iterator == NOPOLL_HISTOGRAM_BUCKETS - 1)
+			continue;
+		__nopoll_metrics_printf (text, "nopoll_latency_%s_microseconds_bucket{le=\"%ld.0\"} %ld\n",
+					 name, __nopoll_histogram_value (iterator), cumulative);
+	} /* end for */
+	__nopoll_metrics_printf (text, "nopoll_latency_%s_microseconds_bucket{le=\"+Inf\"} %ld\n", name, hist.count);
+	__nopoll_metrics_printf (text, "nopoll_latency_%s_microseconds_count %ld\n", name, hist.count);
+	__nopoll_metrics_printf (text, "nopoll_latency_%s_microseconds_sum %ld\n", name, hist.sum);
+	return;
+}
+
+/**
+ * @brief Renders the counters of the provided context (see \ref
+ * nopoll_ctx_get_stats) and, when latency tracking is enabled, its
+ * histograms (see \ref nopoll_ctx_get_latency) in OpenMetrics text
+ * format.
+ *
+ * This is the content served by listeners of the context at the
+ * path configured with \ref nopoll_ctx_set_metrics_path. It is
+ * available to export the metrics by other means.
+ *
+ * @param ctx The context to render.
+ *
+ * @return A newly allocated string (release it with \ref
+ * nopoll_free) or NULL if it fails.
+ */
+char      * nopoll_metrics_render      (noPollCtx * ctx)
+{
+	noPollMetricsText   text;
+	noPollStats         stats;
+	int                 iterator;
+
+	nopoll_return_val_if_fail (ctx, ctx, NULL);
+
+	if (! nopoll_ctx_get_stats (ctx, &stats))
+		return NULL;
+
+	memset (&text, 0, sizeof (noPollMetricsText));
+	text.size = 4096;
+	text.data = nopoll_new (char, text.size);
+	if (text.data == NULL)
+		return NULL;
+
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_connections gauge\n# HELP nopoll_connections Connections registered.\n");
+	__nopoll_metrics_printf (&text, "nopoll_connections %d\n", nopoll_ctx_conns (ctx));
+
+	__nopoll_metrics_by_opcode (&text, "frames_received", "Frames received by opcode.", stats.frames_in);
+	__nopoll_metrics_by_opcode (&text, "bytes_received", "Payload bytes received by opcode.", stats.bytes_in);
+	__nopoll_metrics_by_opcode (&text, "frames_sent", "Frames sent by opcode.", stats.frames_out);
+	__nopoll_metrics_by_opcode (&text, "bytes_sent", "Payload bytes sent by opcode.", stats.bytes_out);
+
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_handshakes counter\n# HELP nopoll_handshakes WebSocket handshakes.\n");
+	__nopoll_metrics_printf (&text, "nopoll_handshakes_total{result=\"ok\"} %ld\n", stats.handshakes_ok);
+	__nopoll_metrics_printf (&text, "nopoll_handshakes_total{result=\"failed\"} %ld\n", stats.handshakes_failed);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_tls_handshakes counter\n# HELP nopoll_tls_handshakes TLS handshakes.\n");
+	__nopoll_metrics_printf (&text, "nopoll_tls_handshakes_total{result=\"ok\"} %ld\n", stats.tls_handshakes_ok);
+	__nopoll_metrics_printf (&text, "nopoll_tls_handshakes_total{result=\"failed\"} %ld\n", stats.tls_handshakes_failed);
+
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_partial_writes counter\nnopoll_partial_writes_total %ld\n", stats.partial_writes);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_pending_write_bytes gauge\nnopoll_pending_write_bytes %ld\n", stats.pending_write_bytes);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_pongs counter\nnopoll_pongs_total %ld\n", stats.pongs);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_rtt_last_microseconds gauge\nnopoll_rtt_last_microseconds %ld\n", stats.rtt_last);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_rtt_microseconds counter\nnopoll_rtt_microseconds_total %ld\n", stats.rtt_total);
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_frame_size_rejections counter\nnopoll_frame_size_rejections_total %ld\n", stats.frame_size_rejections);
+
+	__nopoll_metrics_printf (&text, "# TYPE nopoll_close_codes counter\n# HELP nopoll_close_codes Close frames received by status code.\n");
+	for (iterator = 0; iterator < 16; iterator++) {
+		if (stats.close_codes[iterator] > 0)
+			__nopoll_metrics_printf (&text, "nopoll_close_codes_total{code=\"%d\"} %ld\n", 1000 + iterator, stats.close_codes[iterator]);
+	} /* end for */
+	__nopoll_metrics_printf (&text, "nopoll_close_codes_total{code=\"other\"} %ld\n", stats.close_other);
+
+	/* histograms (only when recorded) */
+	if (ctx->latency_tracking) {
+		for (iterator = 0; iterator < NOPOLL_LATENCY_MAX; iterator++)
+			__nopoll_metrics_histogram (&text, ctx, iterator);
+	} /* end if */
+
+	__nopoll_metrics_printf (&text, "# EOF\n");
+	if (text.failed) {
+		nopoll_free (text.data);
+		return NULL;
+	} /* end if */
+
+	return text.data;
+}
+
+/**
+ * @internal Checks if the url requested (ignoring its query string)
+ * is the metrics path configured on the provided context.
+ */
+nopoll_bool __nopoll_metrics_is_path   (noPollCtx * ctx, const char * url)
+{
+	nopoll_bool result = nopoll_false;
+	int         length;
+
+	if (url == NULL || ctx->metrics_path == NULL)
+		return nopoll_false;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	if (ctx->metrics_path) {
+		length = strlen (ctx->metrics_path);
+		result = strncmp (url, ctx->metrics_path, length) == 0 && (url[length] == 0 || url[length] == '?');
+	} /* end if */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Replies the metrics to the provided listener connection
+ * (instead of upgrading it). What can't be written right now is kept
+ * at pending_write and written by nopoll_loop_wait as the socket
+ * becomes writable (see __nopoll_metrics_flush), so a slow scraper
+ * never blocks the loop. The connection is closed once the reply is
+ * written.
+ */
+void        __nopoll_metrics_serve     (noPollConn * conn)
+{
+	noPollCtx * ctx = conn->ctx;
+	char      * body;
+	char      * reply;
+
+	body = nopoll_metrics_render (ctx);
+	if (body == NULL) {
+		reply = nopoll_strdup ("HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+	} else {
+		reply = nopoll_strdup_printf ("HTTP/1.1 200 OK\r\nContent-Type: application/openmetrics-text; version=1.0.0; charset=utf-8\r\nContent-Length: %d\r\nConnection: close\r\n\r\n%s",
+					      (int) strlen (body), body);
+		nopoll_free (body);
+	} /* end if */
+
+	if (reply == NULL) {
+		nopoll_conn_shutdown (conn);
+		return;
+	} /* end if */
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Serving metrics to %s:%s (conn-id=%d)", conn->host, conn->port, conn->id);
+
+	/* keep the reply as pending write */
+	nopoll_free (conn->pending_write);
+	conn->pending_write              = reply;
+	conn->pending_write_desp         = 0;
+	conn->pending_write_bytes        = strlen (reply);
+	conn->pending_write_added_header = 0;
+	conn->metrics_reply              = nopoll_true;
+	__nopoll_conn_pending_sync (conn);
+
+	__nopoll_metrics_flush (conn);
+	return;
+}
+
+/**
+ * @internal Writes as much of the metrics reply as possible without
+ * blocking, closing the connection when finished or if it fails.
+ */
+void        __nopoll_metrics_flush     (noPollConn * conn)
+{
+	int written;
+
+	while (conn->pending_write_bytes > 0) {
+		written = conn->send (conn, conn->pending_write + conn->pending_write_desp, conn->pending_write_bytes);
+		if (written <= 0) {
+			/* retry once the socket is writable */
+			if (written == -2 || errno == NOPOLL_EWOULDBLOCK || errno == NOPOLL_EINPROGRESS) {
+				__nopoll_conn_pending_sync (conn);
+				return;
+			} /* end if */
+			break;
+		} /* end if */
+		conn->pending_write_desp  += written;
+		conn->pending_write_bytes -= written;
+	} /* end while */
+
+	/* reply written (or failed): close */
+	nopoll_free (conn->pending_write);
+	conn->pending_write       = NULL;
+	conn->pending_write_bytes = 0;
+	conn->metrics_reply       = nopoll_false;
+	__nopoll_conn_pending_sync (conn);
+	nopoll_conn_shutdown (conn);
+	return;
+}
+
+/**
+ * @}
+ */
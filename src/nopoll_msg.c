@@ -65,12 +65,55 @@ noPollMsg  * nopoll_msg_new (void)
 	return msg;
 }
 
+/**
+ * @internal Builds the payload of a chained message (see
+ * nopoll_msg_chain) copying its pieces, which are released after
+ * that.
+ */
+void __nopoll_msg_flatten (noPollMsg * msg)
+{
+	char      * payload;
+	long int    desp = 0;
+	int         iterator;
+
+	nopoll_mutex_lock (msg->ref_mutex);
+	if (msg->pieces == NULL) {
+		/* already built by another thread */
+		nopoll_mutex_unlock (msg->ref_mutex);
+		return;
+	} /* end if */
+
+	payload = nopoll_new (char, (size_t) (msg->payload_size + 1));
+	if (payload == NULL) {
+		nopoll_mutex_unlock (msg->ref_mutex);
+		return;
+	} /* end if */
+
+	for (iterator = 0; iterator < msg->pieces_count; iterator++) {
+		if (msg->pieces[iterator]->payload_size > 0)
+			memcpy (payload + desp, msg->pieces[iterator]->payload, (size_t) msg->pieces[iterator]->payload_size);
+		desp += msg->pieces[iterator]->payload_size;
+		nopoll_msg_unref (msg->pieces[iterator]);
+	} /* end for */
+	nopoll_free (msg->pieces);
+	msg->pieces       = NULL;
+	msg->pieces_count = 0;
+	msg->payload      = payload;
+	nopoll_mutex_unlock (msg->ref_mutex);
+
+	return;
+}
+
 /** 
  * @brief Allows to get a reference to the payload content inside the
  * provided websocket message.
  *
  * @param msg The websocket message to get the payload from.
  *
+ * For messages built with \ref nopoll_msg_chain, the payload is
+ * assembled (copied once) on the first call. Use \ref
+ * nopoll_msg_get_iovec to read it without copying.
+ *
  * @return A reference to the payload or NULL if it fails. See \ref
  * nopoll_msg_get_payload_size to get payload size.
  */
@@ -78,6 +121,10 @@ const unsigned char * nopoll_msg_get_payload (noPollMsg * msg)
 {
 	if (msg == NULL)
 		return NULL;
+
+	/* chained message: build payload now */
+	if (msg->pieces)
+		__nopoll_msg_flatten (msg);
 	return msg->payload;
 }
 
@@ -340,6 +387,164 @@ noPollMsg  * nopoll_msg_join (noPollMsg * msg, noPollMsg * msg2)
 	return result;
 }
 
+/**
+ * @brief Allows to join the provided messages without copying their
+ * content: the message returned chains references to the pieces of
+ * both messages, so joining N fragments one after another costs no
+ * payload copy (unlike \ref nopoll_msg_join, which copies both
+ * payloads each time).
+ *
+ * The content can be read without copying with \ref
+ * nopoll_msg_get_iovec. \ref nopoll_msg_get_payload also works: it
+ * assembles the payload (only once) on its first call.
+ *
+ * \code
+ * // reassembling fragments as they are received
+ * aux          = previous_msg;
+ * previous_msg = nopoll_msg_chain (previous_msg, msg);
+ * nopoll_msg_unref (aux);
+ * \endcode
+ *
+ * The message returned takes its headers from the first argument,
+ * but the FIN flag (\ref nopoll_msg_is_final) is taken from the
+ * second one. It holds a reference to each piece (the caller still
+ * owns the references received). See also \ref
+ * nopoll_ctx_set_reassemble_messages to let the library deliver
+ * complete messages.
+ *
+ * @param msg The first part of the message. When NULL, the second
+ * argument is returned with its reference counting increased.
+ *
+ * @param msg2 The second part of the message. When NULL, the first
+ * argument is returned with its reference counting increased.
+ *
+ * @return A newly created message (with one reference), the
+ * reference received (see above) or NULL if it fails (both arguments
+ * are NULL, a message reports an inconsistent payload size, the
+ * resulting size cannot be represented or memory is exhausted).
+ */
+noPollMsg  * nopoll_msg_chain (noPollMsg * msg, noPollMsg * msg2)
+{
+	noPollMsg  * result;
+	noPollMsg  * parts[2];
+	int          count = 0;
+	int          iterator;
+	int          piece;
+
+	/* check for basic cases */
+	if (msg == NULL && msg2 == NULL)
+		return NULL;
+	if (msg == NULL || msg2 == NULL) {
+		result = msg ? msg : msg2;
+		nopoll_msg_ref (result);
+		return result;
+	} /* end if */
+
+	/* check sizes (see nopoll_msg_join) */
+	if (msg->payload_size < 0 || msg2->payload_size < 0)
+		return NULL;
+	if ((msg->payload == NULL && msg->pieces == NULL && msg->payload_size > 0) ||
+	    (msg2->payload == NULL && msg2->pieces == NULL && msg2->payload_size > 0))
+		return NULL;
+	if (msg->payload_size > (LONG_MAX - 1) - msg2->payload_size)
+		return NULL;
+
+	result = nopoll_msg_new ();
+	if (result == NULL)
+		return NULL;
+	result->has_fin      = msg2->has_fin;
+	result->remain_bytes = msg2->remain_bytes;
+	result->op_code      = msg->op_code;
+	result->is_fragment  = msg->is_fragment;
+	result->payload_size = msg->payload_size + msg2->payload_size;
+
+	/* collect pieces: chained messages contribute their pieces
+	 * (so chains never nest) */
+	parts[0] = msg;
+	parts[1] = msg2;
+	for (iterator = 0; iterator < 2; iterator++) {
+		nopoll_mutex_lock (parts[iterator]->ref_mutex);
+		count += parts[iterator]->pieces ? parts[iterator]->pieces_count : 1;
+		nopoll_mutex_unlock (parts[iterator]->ref_mutex);
+	} /* end for */
+
+	result->pieces = nopoll_new (noPollMsg *, count);
+	if (result->pieces == NULL) {
+		nopoll_msg_unref (result);
+		return NULL;
+	} /* end if */
+
+	for (iterator = 0; iterator < 2; iterator++) {
+		nopoll_mutex_lock (parts[iterator]->ref_mutex);
+		if (parts[iterator]->pieces) {
+			for (piece = 0; piece < parts[iterator]->pieces_count && result->pieces_count < count; piece++) {
+				nopoll_msg_ref (parts[iterator]->pieces[piece]);
+				result->pieces[result->pieces_count++] = parts[iterator]->pieces[piece];
+			} /* end for */
+			nopoll_mutex_unlock (parts[iterator]->ref_mutex);
+			continue;
+		} /* end if */
+		nopoll_mutex_unlock (parts[iterator]->ref_mutex);
+
+		/* plain message (or chain already assembled) */
+		if (result->pieces_count < count) {
+			nopoll_msg_ref (parts[iterator]);
+			result->pieces[result->pieces_count++] = parts[iterator];
+		} /* end if */
+	} /* end for */
+
+	return result;
+}
+
+/**
+ * @brief Allows to get the pieces holding the payload of the message
+ * provided without copying them (see \ref nopoll_msg_chain).
+ *
+ * \code
+ * noPollIoVec iov[16];
+ * int         count = nopoll_msg_get_iovec (msg, iov, 16);
+ * \endcode
+ *
+ * @param msg The message to inspect.
+ *
+ * @param iov Array where pieces are placed (it can be NULL to just
+ * get the number of pieces).
+ *
+ * @param iov_count Capacity of the array provided.
+ *
+ * @return The number of pieces the message has (which can be
+ * bigger than iov_count: only iov_count pieces are placed) or -1 if
+ * msg is NULL. Plain messages have one piece. The pieces are valid
+ * while the message reference is held.
+ */
+int          nopoll_msg_get_iovec (noPollMsg * msg, noPollIoVec * iov, int iov_count)
+{
+	int result;
+	int iterator;
+
+	if (msg == NULL)
+		return -1;
+
+	nopoll_mutex_lock (msg->ref_mutex);
+	if (msg->pieces == NULL) {
+		if (iov && iov_count > 0) {
+			iov[0].iov_base = (const unsigned char *) msg->payload;
+			iov[0].iov_len  = msg->payload_size;
+		} /* end if */
+		nopoll_mutex_unlock (msg->ref_mutex);
+		return 1;
+	} /* end if */
+
+	result = msg->pieces_count;
+	for (iterator = 0; iov && iterator < iov_count && iterator < result; iterator++) {
+		iov[iterator].iov_base = (const unsigned char *) msg->pieces[iterator]->payload;
+		iov[iterator].iov_len  = msg->pieces[iterator]->payload_size;
+	} /* end for */
+	nopoll_mutex_unlock (msg->ref_mutex);
+
+	return result;
+}
+
 /** 
  * @brief Allows to release the reference acquired, finished the
  * object if all references are terminated.
@@ -364,6 +569,13 @@ void         nopoll_msg_unref (noPollMsg * msg)
 	nopoll_mutex_unlock (msg->ref_mutex);
 	nopoll_mutex_destroy (msg->ref_mutex);
 
+	/* release chained pieces */
+	while (msg->pieces_count > 0) {
+		msg->pieces_count--;
+		nopoll_msg_unref (msg->pieces[msg->pieces_count]);
+	} /* end while */
+	nopoll_free (msg->pieces);
+
 	/* free websocket message */
 	nopoll_free (msg->payload);
 	nopoll_free (msg);
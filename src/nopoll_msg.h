@@ -60,8 +60,15 @@ noPollOpCode nopoll_msg_opcode (noPollMsg * msg);
 
 noPollMsg  * nopoll_msg_join (noPollMsg * msg, noPollMsg * msg2);
 
+noPollMsg  * nopoll_msg_chain (noPollMsg * msg, noPollMsg * msg2);
+
+int          nopoll_msg_get_iovec (noPollMsg * msg, noPollIoVec * iov, int iov_count);
+
 void         nopoll_msg_unref (noPollMsg * msg);
 
+/** internal API **/
+void         __nopoll_msg_flatten (noPollMsg * msg);
+
 END_C_DECLS
 
 #endif
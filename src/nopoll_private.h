@@ -55,8 +55,108 @@ typedef struct _noPollCertificate {
 	char * privateKey;
 	char * optionalChainFile;
 
+	/* SSL_CTX preloaded with the key material (NULL when it could
+	 * not be loaded) and stamp of the files it was loaded from
+	 * (see nopoll_ctx_reload_certificate) */
+	SSL_CTX * ssl_ctx;
+	long      stamp;
+
 } noPollCertificate;
 
+/**
+ * @internal SNI index entry: server name (possibly a wildcard like
+ * *.example.com) associated to the certificate stored at cert_index.
+ */
+typedef struct _noPollSniEntry {
+	char                    * serverName;
+	int                       cert_index;
+	/* preloaded key material (only set, and referenced, on
+	 * entries of a noPollSniIndex snapshot) */
+	SSL_CTX                 * ssl_ctx;
+
+	struct _noPollSniEntry  * next;
+} noPollSniEntry;
+
+/**
+ * @internal Read only snapshot of the SNI index used by TLS
+ * handshakes (see __nopoll_ctx_sni_select). It is rebuilt and
+ * published by pointer swap each time certificates change, so
+ * handshakes don't take the context mutex. Replaced snapshots are
+ * kept at the retired list until no handshake is reading them.
+ */
+typedef struct _noPollSniIndex {
+	noPollSniEntry          ** hash;
+	int                        hash_size;
+
+	struct _noPollSniIndex   * next;
+} noPollSniIndex;
+
+/**
+ * @internal Context counters and latency histograms updated by one
+ * thread (see __nopoll_ctx_counters), so connections running on
+ * different threads update them without locking. They are added when
+ * read (see nopoll_ctx_get_stats and nopoll_ctx_get_latency).
+ */
+typedef struct _noPollCtxCounters {
+	noPollStats                    stats;
+	noPollHistogram                latency[NOPOLL_LATENCY_MAX];
+
+	/* the thread finished: the block is folded into the context
+	 * on next read */
+	volatile int                   closed;
+
+	struct _noPollCtxCounters    * next;
+} noPollCtxCounters;
+
+/**
+ * @internal Hosts file entry: one for each name (or alias) declared
+ * (see __nopoll_ctx_hosts_refresh).
+ */
+typedef struct _noPollHostsEntry {
+	char                         * name;
+	char                         * address;
+
+	struct _noPollHostsEntry     * next;
+} noPollHostsEntry;
+
+/**
+ * @internal Dual stack connect state shared by the thread running the
+ * race and the workers resolving each family (see
+ * __nopoll_conn_sock_connect_happy_eyeballs). Protected by
+ * ctx->ref_mutex.
+ */
+typedef struct _noPollHappyEyeballs {
+	noPollCtx                    * ctx;
+	int                            refs;
+	char                         * host;
+	char                         * port;
+
+	/* addresses and resolution state of each family (0 for IPv6,
+	 * 1 for IPv4): 0 queued, 1 resolving, 2 resolved */
+	struct addrinfo              * res[2];
+	int                            state[2];
+} noPollHappyEyeballs;
+
+/**
+ * @internal Resolver cache entry: addresses resolved for a host, port
+ * and transport, valid until the expiration time recorded.
+ */
+typedef struct _noPollResolverEntry {
+	char                         * host;
+	char                         * port;
+	noPollTransport                transport;
+
+	/* time (in seconds, as reported by time ()) when this entry
+	 * stops being valid */
+	long                           expires;
+
+	/* address list (a copy owned by the library, released with
+	 * __nopoll_ctx_resolve_release) */
+	struct addrinfo              * addresses;
+
+	struct _noPollResolverEntry  * next;
+} noPollResolverEntry;
+
 struct _noPollCtx {
 	/**
 	 * @internal Controls logs output..
@@ -124,6 +224,13 @@ struct _noPollCtx {
 	noPollOnMessageHandler on_msg;
 	noPollPtr              on_msg_data;
 
+	/**
+	 * @internal Streaming on message handler (see
+	 * nopoll_ctx_set_on_msg_chunk).
+	 */
+	noPollOnMessageChunkHandler on_msg_chunk;
+	noPollPtr                   on_msg_chunk_data;
+
 	/** 
 	 * @internal Basic fake support for protocol version, by
 	 * default: 13, due to RFC6455 standard
@@ -136,12 +243,84 @@ struct _noPollCtx {
 	noPollCertificate *  certificates;
 	int                  certificates_length;
 
+	/**
+	 * @internal Hash from server name to certificate (and its
+	 * preloaded SSL_CTX) used to route TLS connections by SNI
+	 * (see nopoll_ctx_set_certificate). Protected by ref_mutex.
+	 */
+	noPollSniEntry    ** sni_hash;
+	int                  sni_hash_size;
+	int                  sni_count;
+	int                  sni_loaded;
+
+	/**
+	 * @internal SNI index snapshot read by handshakes without
+	 * locking, snapshots replaced and handshakes reading one (see
+	 * __nopoll_ctx_sni_publish).
+	 */
+	noPollSniIndex     * sni_index;
+	noPollSniIndex     * sni_retired;
+	int                  sni_readers;
+
+	/**
+	 * @internal Changed each time the certificates stored (on the
+	 * context or on listeners) are updated, so listeners know when
+	 * the SSL_CTX they reuse for accepted connections must be
+	 * rebuilt and the certificate watcher which files to watch.
+	 */
+	int                  cert_generation;
+
+	/**
+	 * @internal Certificate watcher (see
+	 * nopoll_ctx_watch_certificates): check interval and timer.
+	 */
+	long                 cert_watch_interval;
+	/* time (microseconds) TLS handshakes may take */
+	long                 tls_handshake_timeout;
+	/* TLS handshake worker pool (see nopoll_worker.c) */
+	noPollPtr            tls_workers;
+	int                  cert_watch_timer;
+	/* certificate check queued or running on the worker pool,
+	 * another check requested meanwhile, certificate generation
+	 * checked and inotify descriptor (-1 when not available) */
+	nopoll_bool          cert_watch_running;
+	nopoll_bool          cert_watch_pending;
+	int                  cert_watch_generation;
+	int                  cert_watch_fd;
+
 	/* mutex */
 	noPollPtr            ref_mutex;
 
 	/* log handling */
 	noPollLogHandler     log_handler;
+	noPollLogHandlerExt  log_handler_ext;
 	noPollPtr            log_user_data;
+	/* minimum level reported and cached threshold checked by
+	 * nopoll_log (see __nopoll_log_update) */
+	noPollDebugLevel     log_level;
+	int                  log_threshold;
+	/* asynchronous console logger (see nopoll_log_set_async) */
+	noPollPtr            log_async;
+
+	/* counters and latency histograms of all connections (see
+	 * nopoll_ctx_get_stats): those of threads already finished
+	 * (protected by ref_mutex, also updated directly when there
+	 * is no thread support), key to find the block of the
+	 * current thread and blocks of each thread updating them,
+	 * protected by ref_mutex (see __nopoll_ctx_counters) */
+	noPollCtxCounters    counters;
+	noPollPtr            counters_key;
+	noPollCtxCounters  * counters_threads;
+
+	/* latency tracking (see nopoll_ctx_set_latency_tracking) and
+	 * time the io wait engine returned in the current loop
+	 * iteration */
+	nopoll_bool          latency_tracking;
+	struct timeval       loop_wakeup;
+
+	/* path served with the metrics exporter (see
+	 * nopoll_ctx_set_metrics_path), protected by ref_mutex */
+	char               * metrics_path;
 
 	/* context creator */
 	noPollSslContextCreator context_creator;
@@ -157,6 +336,117 @@ struct _noPollCtx {
 	 * NOPOLL_MAX_FRAME_SIZE_DEFAULT.
 	 */
 	long int                max_frame_size;
+
+	/**
+	 * @internal User defined resolver (if any) and the strategy
+	 * used by the built-in one (see \ref noPollResolverMode).
+	 */
+	noPollResolver          resolver;
+	noPollPtr               resolver_data;
+	noPollResolverMode      resolver_mode;
+
+	/**
+	 * @internal Resolver cache: entries are kept resolver_cache_ttl
+	 * seconds (0 disables the cache), up to resolver_cache_max
+	 * entries. Protected by ref_mutex.
+	 */
+	int                     resolver_cache_ttl;
+	int                     resolver_cache_max;
+	noPollResolverEntry   * resolver_cache;
+	int                     resolver_cache_length;
+
+	/**
+	 * @internal Hosts file entries (used under
+	 * NOPOLL_RESOLVER_HOSTS_ONLY), modification time of the file
+	 * loaded and last time (seconds) it was checked for changes.
+	 * Protected by ref_mutex.
+	 */
+	noPollHostsEntry      * hosts;
+	long                    hosts_mtime;
+	long                    hosts_checked;
+
+	/**
+	 * @internal Connection pools created on this context (see
+	 * nopoll_conn_pool_new). Protected by ref_mutex.
+	 */
+	noPollConnPool        * conn_pools;
+
+	/**
+	 * @internal Timing wheel (levels x slots lists), current
+	 * tick (milliseconds since timer_base seconds) and hash to
+	 * find timers by id (see nopoll_timer_add). Protected by
+	 * ref_mutex.
+	 */
+	noPollTimer          ** timer_wheel;
+	long                    timer_base;
+	long                    timer_tick;
+	int                     timer_id;
+	int                     timer_count;
+	noPollTimer          ** timer_hash;
+	int                     timer_hash_size;
+
+	/**
+	 * @internal Time (microseconds) the io engine waits for
+	 * activity on the next wait call.
+	 */
+	long                    io_wait_timeout;
+
+	/**
+	 * @internal Keepalive settings (microseconds) applied to
+	 * connections that do not configure them through options
+	 * (see nopoll_ctx_set_keepalive).
+	 */
+	long                    keepalive_interval;
+	long                    keepalive_pong_timeout;
+	long                    keepalive_idle;
+
+	/**
+	 * @internal Idle compression streams reused by
+	 * permessage-deflate connections (see nopoll_deflate.c).
+	 * Protected by deflate_mutex, which also protects the
+	 * deflate state below (so compressing does not contend
+	 * with ref_mutex users).
+	 */
+	noPollPtr               deflate_mutex;
+	noPollPtr               deflate_pool;
+	int                     deflate_pool_size;
+
+	/**
+	 * @internal permessage-deflate policy (see
+	 * nopoll_ctx_set_deflate_threshold and
+	 * nopoll_ctx_set_deflate_max_windows). Windows held by
+	 * connections using context takeover are accounted and
+	 * compressors are kept on a LRU list (most recently used
+	 * first) to evict them when deflate_max_windows is
+	 * exceeded. Each thread compresses into its own scratch
+	 * buffer (deflate_scratch_key, see
+	 * __nopoll_deflate_scratch_thread), the ones kept here are
+	 * only borrowed when a thread has none. Protected by
+	 * deflate_mutex.
+	 */
+	long                    deflate_threshold;
+	int                     deflate_max_windows;
+	int                     deflate_windows;
+	noPollDeflate         * deflate_lru;
+	noPollDeflate         * deflate_lru_tail;
+	char                  * deflate_scratch[NOPOLL_DEFLATE_SCRATCH_BUFFERS];
+	long                    deflate_scratch_size[NOPOLL_DEFLATE_SCRATCH_BUFFERS];
+	int                     deflate_scratch_count;
+	noPollPtr               deflate_scratch_key;
+	noPollDeflateScratch  * deflate_scratch_threads;
+
+	/**
+	 * @internal UTF-8 validation of text messages received and
+	 * sent (see nopoll_ctx_set_utf8_validation).
+	 */
+	nopoll_bool             utf8_rx;
+	nopoll_bool             utf8_tx;
+
+	/**
+	 * @internal Deliver complete messages only (see
+	 * nopoll_ctx_set_reassemble_messages).
+	 */
+	nopoll_bool             reassemble;
 };
 
 struct _noPollConn {
@@ -175,6 +465,14 @@ struct _noPollConn {
 	 * the noPollConn object.
 	 */
 	NOPOLL_SOCKET    session;
+	/**
+	 * @internal Name resolution and connect running on a worker
+	 * (session is NOPOLL_INVALID_SOCKET while dialing is set, see
+	 * __nopoll_conn_dial_check). The dial reference is protected
+	 * by ctx->ref_mutex.
+	 */
+	noPollConnDial * dial;
+	nopoll_bool      dialing;
 	/** 
 	 * @internal Flag to signal this connection has finished its
 	 * handshake.
@@ -240,6 +538,15 @@ struct _noPollConn {
 	noPollOnMessageHandler on_msg;
 	noPollPtr              on_msg_data;
 
+	/**
+	 * @internal Streaming on message handler (see
+	 * nopoll_conn_set_on_msg_chunk) and message being streamed.
+	 */
+	noPollOnMessageChunkHandler on_msg_chunk;
+	noPollPtr                   on_msg_chunk_data;
+	nopoll_bool                 chunk_message;
+	noPollOpCode                chunk_op_code;
+
 	/** 
 	 * @internal Reference to defined on ready handling.
 	 */
@@ -283,6 +590,19 @@ struct _noPollConn {
 	 * reception.
 	 */
 	nopoll_bool   tls_on;
+	/**
+	 * @internal Kernel TLS offload requested and active
+	 * direction (see noPollKtlsFlags).
+	 */
+	nopoll_bool   ktls_requested;
+	int           ktls;
+	/**
+	 * @internal TLS write batching (see
+	 * nopoll_conn_set_tls_batching): content queued.
+	 */
+	nopoll_bool   tls_batching;
+	char        * tls_batch;
+	int           tls_batch_size;
 	/** 
 	 * @internal Flag that indicates that the provided session
 	 * must call to accept the TLS session before proceeding.
@@ -296,6 +616,25 @@ struct _noPollConn {
          */
         nopoll_bool   pending_ssl_connect;
 
+	/**
+	 * @internal TLS handshake state (see
+	 * __nopoll_conn_tls_handshake): the handshake is blocked
+	 * until the socket is writable, when it was started, the
+	 * timer enforcing its timeout and the client init to send
+	 * once it finishes (client role).
+	 */
+	nopoll_bool      ssl_want_write;
+	struct timeval   tls_handshake_start;
+	int              tls_handshake_timer;
+	char           * client_init;
+	/* client init still held at pending_write (see
+	 * __nopoll_conn_send_client_init) */
+	nopoll_bool      client_init_pending;
+	/* handshake step queued or running on the worker pool and
+	 * failure found by it (the loop closes the connection) */
+	nopoll_bool      tls_offloaded;
+	nopoll_bool      tls_failed;
+
 	/* SSL support */
 	SSL_CTX        * ssl_ctx;
 	SSL            * ssl;
@@ -304,6 +643,17 @@ struct _noPollConn {
 	char           * certificate;
 	char           * private_key;
 	char           * chain_certificate;
+	/* listener key material preloaded and stamp of the files it
+	 * was loaded from (see nopoll_listener_reload_certificate),
+	 * protected by ref_mutex */
+	SSL_CTX        * cert_ctx;
+	long             cert_stamp;
+	/* SSL_CTX shared by the TLS connections accepted by the
+	 * listener and context certificate generation it was built
+	 * for (see __nopoll_listener_get_accept_ctx), protected by
+	 * ref_mutex */
+	SSL_CTX        * accept_ctx;
+	int              accept_ctx_generation;
 
 	/* pending buffer */
 	char             pending_buf[100];
@@ -331,6 +681,9 @@ struct _noPollConn {
 
 	char                * pending_write;
 	int                   pending_write_bytes;
+	/* pending bytes accounted at the context counters (see
+	 * __nopoll_conn_pending_sync) */
+	int                   pending_write_counted;
 	int                   pending_write_desp;
         int                   pending_write_added_header;
 
@@ -350,6 +703,67 @@ struct _noPollConn {
 	 */
 	nopoll_bool           read_pending_header;
 
+	/**
+	 * @internal Keepalive settings (microseconds, configured
+	 * through options when keepalive_set), timer running the
+	 * keepalive checks, last time a frame was received, last
+	 * keepalive ping sent and round trip time measured with it.
+	 */
+	nopoll_bool           keepalive_set;
+	long                  keepalive_interval;
+	long                  keepalive_pong_timeout;
+	long                  keepalive_idle;
+	int                   keepalive_timer;
+	struct timeval        last_activity;
+	struct timeval        ping_sent;
+	nopoll_bool           pong_pending;
+	long                  rtt;
+
+	/**
+	 * @internal Counters reported by nopoll_conn_get_stats, only
+	 * updated by the thread doing I/O on this connection.
+	 */
+	noPollStats           stats;
+
+	/**
+	 * @internal Latency histograms (NOPOLL_LATENCY_MAX, only
+	 * allocated when the connection tracks its own latencies, see
+	 * nopoll_conn_set_latency_tracking) and time when the frame
+	 * kept as pending write was sent.
+	 */
+	noPollHistogram     * latency;
+	struct timeval        pending_write_start;
+
+	/**
+	 * @internal The connection is serving the metrics reply kept
+	 * at pending_write and it is closed once written (see
+	 * nopoll_metrics.c).
+	 */
+	nopoll_bool           metrics_reply;
+
+	/**
+	 * @internal UTF-8 validation of text messages (see
+	 * nopoll_ctx_set_utf8_validation) and validator state kept
+	 * across fragments and partial reads.
+	 */
+	nopoll_bool           utf8_rx;
+	nopoll_bool           utf8_tx;
+	int                   utf8_rx_state;
+	nopoll_bool           utf8_rx_text;
+	nopoll_bool           utf8_rx_message;
+	int                   utf8_tx_state;
+
+	/**
+	 * @internal Reassembly of fragmented messages (see
+	 * nopoll_ctx_set_reassemble_messages): buffer holding the
+	 * content received so far and its capacity.
+	 */
+	nopoll_bool           reassemble;
+	char                * reassembly;
+	long                  reassembly_size;
+	long                  reassembly_capacity;
+	noPollOpCode          reassembly_op_code;
+
 	
 	/**** debug values ****/
 	/* force stop after header: do not use this, it is just for
@@ -369,6 +783,12 @@ struct _noPollConn {
 	 * configured at the context.
 	 */
 	long int               max_frame_size;
+
+	/**
+	 * @internal permessage-deflate configuration and state (NULL
+	 * when it was not requested through options).
+	 */
+	noPollDeflate        * deflate;
 };
 
 struct _noPollIoEngine {
@@ -398,6 +818,11 @@ struct _noPollMsg {
 
 	nopoll_bool    is_fragment;
 	int            unmask_desp;
+
+	/* pieces chained by nopoll_msg_chain (payload is built from
+	 * them on demand), protected by ref_mutex */
+	noPollMsg   ** pieces;
+	int            pieces_count;
 };
 
 struct _noPollHandshake {
@@ -415,6 +840,14 @@ struct _noPollHandshake {
 
 	/* reference to cookie header */
 	char          * cookie;
+
+	/* Sec-WebSocket-Extensions received (repeated headers are
+	 * joined with ", ") */
+	char          * extensions;
+
+	/* GET received for the metrics path (see
+	 * nopoll_ctx_set_metrics_path) */
+	nopoll_bool     metrics_request;
 };
 
 struct _noPollConnOpts {
@@ -436,6 +869,9 @@ struct _noPollConnOpts {
 
 	nopoll_bool  disable_ssl_verify;
 
+	/* kernel TLS offload requested (see nopoll_conn_opts_set_ktls) */
+	nopoll_bool  ktls;
+
 	/* cookie support */
 	char * cookie;
 
@@ -457,6 +893,225 @@ struct _noPollConnOpts {
 	 * the value configured at the context (see
 	 * nopoll_conn_opts_set_max_frame_size) */
 	long int max_frame_size;
+
+	/* race IPv6 and IPv4 candidates when connecting (see
+	 * nopoll_conn_opts_set_happy_eyeballs) */
+	nopoll_bool happy_eyeballs;
+
+	/* keepalive settings (see nopoll_conn_opts_set_keepalive) */
+	nopoll_bool keepalive_set;
+	long        keepalive_interval;
+	long        keepalive_pong_timeout;
+	long        keepalive_idle;
+
+	/* permessage-deflate settings (see
+	 * nopoll_conn_opts_set_permessage_deflate) */
+	nopoll_bool deflate_enabled;
+	nopoll_bool deflate_server_no_context_takeover;
+	nopoll_bool deflate_client_no_context_takeover;
+	int         deflate_server_max_window_bits;
+	int         deflate_client_max_window_bits;
+	nopoll_bool deflate_threshold_set;
+	long        deflate_threshold;
+
+	/* UTF-8 validation (see
+	 * nopoll_conn_opts_set_utf8_validation) */
+	nopoll_bool utf8_set;
+	nopoll_bool utf8_rx;
+	nopoll_bool utf8_tx;
+
+	/* message reassembly (see
+	 * nopoll_conn_opts_set_reassemble_messages) */
+	nopoll_bool reassemble_set;
+	nopoll_bool reassemble;
+};
+
+/* socket being dialed by a worker, for a connection pool or a client
+ * connection (see __nopoll_conn_dial_start) */
+struct _noPollConnDial {
+	noPollCtx             * ctx;
+	noPollConnOpts        * opts;
+	noPollTransport         transport;
+	char                  * host;
+	char                  * port;
+	struct timeval          start;
+
+	/* result, protected by ctx->ref_mutex (orphaned dials are
+	 * released by the worker once finished) */
+	NOPOLL_SOCKET           session;
+	nopoll_bool             done;
+	nopoll_bool             orphaned;
+
+	noPollConnDial        * next;
+};
+
+struct _noPollConnPool {
+	noPollCtx             * ctx;
+	/* protected by ctx->ref_mutex */
+	int                     refs;
+	noPollPtr               mutex;
+
+	/* endpoint */
+	noPollConnOpts        * opts;
+	noPollTransport         transport;
+	nopoll_bool             enable_tls;
+	char                  * host_ip;
+	char                  * host_port;
+	char                  * host_name;
+	char                  * get_url;
+	char                  * protocols;
+	char                  * origin;
+
+	/* connections kept (NULL for empty slots) */
+	noPollConn           ** conns;
+	int                     size;
+
+	/* sockets being dialed and how many connections may be
+	 * dialing (or doing their handshakes) at the same time */
+	noPollConnDial        * dials;
+	int                     max_dials;
+
+	/* do not dial before this time (after a failure) */
+	long                    next_retry;
+
+	/* next pool registered on the context */
+	struct _noPollConnPool * next;
+};
+
+/* file range sent by nopoll_conn_send_file */
+typedef struct _noPollFileRange {
+	int                     fd;
+	long                    offset;
+	long                    remaining;
+} noPollFileRange;
+
+struct _noPollWriter {
+	noPollConn            * conn;
+	noPollOpCode            op_code;
+	int                     flags;
+
+	/* content source (fd is used by the fd producer) */
+	noPollWriterProducer    producer;
+	noPollPtr               user_data;
+	int                     fd;
+
+	/* piece being sent */
+	char                  * buffer;
+	long                    chunk_size;
+	long                    used;
+
+	/* progress */
+	int                     frames;
+	long                    sent;
+	nopoll_bool             eof;
+	nopoll_bool             done;
+	nopoll_bool             failed;
+};
+
+struct _noPollDeflate {
+	/* settings requested (taken from connection options) */
+	nopoll_bool   server_no_context_takeover;
+	nopoll_bool   client_no_context_takeover;
+	int           server_max_window_bits;
+	int           client_max_window_bits;
+
+	/* negotiation result: tx is our compressor, rx the peer's */
+	nopoll_bool   enabled;
+	nopoll_bool   tx_no_context_takeover;
+	nopoll_bool   rx_no_context_takeover;
+	int           tx_window_bits;
+	int           rx_window_bits;
+
+	/* streams borrowed from the context pool: kept while a
+	 * message is in progress or, when context takeover is in
+	 * place, for the whole connection life */
+	noPollPtr     tx_stream;
+	noPollPtr     rx_stream;
+
+	/* compressed message being sent / received */
+	nopoll_bool   tx_message;
+	nopoll_bool   rx_message;
+
+	/* uncompressed message being sent (threshold or
+	 * NOPOLL_SEND_NO_COMPRESS) */
+	nopoll_bool   tx_skip;
+
+	/* minimum message size to compress */
+	long          threshold;
+
+	/* window accounting (see noPollCtx deflate_windows):
+	 * protected by ctx->deflate_mutex, tx_busy flags the
+	 * compressor is in use so it cannot be evicted */
+	nopoll_bool   tx_held;
+	nopoll_bool   rx_held;
+	nopoll_bool   tx_busy;
+	noPollDeflate * lru_prev;
+	noPollDeflate * lru_next;
+
+	/* scratch buffer borrowed while a compressed frame is sent,
+	 * from the sending thread (scratch_thread) or from the
+	 * context */
+	char        * scratch;
+	long          scratch_size;
+	noPollDeflateScratch * scratch_thread;
+};
+
+/**
+ * @internal Compression scratch buffer of a thread (see
+ * __nopoll_deflate_scratch_thread): only used by its thread, linked
+ * into noPollCtx deflate_scratch_threads (under deflate_mutex) so it
+ * is released with the context.
+ */
+struct _noPollDeflateScratch {
+	char                 * buffer;
+	long                   size;
+	nopoll_bool            busy;
+	int                    closed;
+	noPollDeflateScratch * next;
 };
 
+struct _noPollTimer {
+	int                     id;
+	/* expiration tick */
+	long                    expires;
+	noPollTimerHandler      handler;
+	noPollPtr               user_data;
+
+	/* wheel slot list where the timer is placed */
+	noPollTimer          ** slot;
+	noPollTimer           * next;
+	noPollTimer           * prev;
+
+	/* id hash bucket list */
+	noPollTimer           * hash_next;
+};
+
+/* inside the library, nopoll_log checks the threshold cached on the
+ * context without calling into nopoll_log.c */
+#undef  __NOPOLL_LOG_ACTIVE
+#define __NOPOLL_LOG_ACTIVE(ctx,level) ((ctx) && (int) (level) >= (ctx)->log_threshold)
+
+/* USDT probes (provider nopoll), compiled out unless configured
+ * with --enable-usdt. Probes and their arguments:
+ *
+ *   frame_header (conn-id, opcode, payload size, fin)
+ *   msg_dispatch (conn-id, opcode, payload size)
+ *   frame_sent (conn-id, opcode, payload size, bytes written)
+ *   partial_write (conn-id, bytes written, bytes pending)
+ *   handshake_complete (conn-id, role, ok)
+ *   tls_handshake_complete (conn-id, role, ok)
+ *   conn_closed (conn-id, role, peer close status)
+ *   loop_wakeup (connections changed, connections registered)
+ */
+#if defined(NOPOLL_HAVE_USDT)
+#include <sys/sdt.h>
+#define NOPOLL_PROBE2(name,a,b)     DTRACE_PROBE2 (nopoll, name, a, b)
+#define NOPOLL_PROBE3(name,a,b,c)   DTRACE_PROBE3 (nopoll, name, a, b, c)
+#define NOPOLL_PROBE4(name,a,b,c,d) DTRACE_PROBE4 (nopoll, name, a, b, c, d)
+#else
+#define NOPOLL_PROBE2(name,a,b)     do { } while (0)
+#define NOPOLL_PROBE3(name,a,b,c)   do { } while (0)
+#define NOPOLL_PROBE4(name,a,b,c,d) do { } while (0)
+#endif
+
 #endif
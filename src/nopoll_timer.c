@@ -0,0 +1,556 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_timer.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_timer noPoll Timer: timers run by the noPoll loop
+ */
+
+/** 
+ * \addtogroup nopoll_timer
+ * @{
+ */
+
+/**
+ * @internal Bits used to index slots on each wheel level.
+ */
+#define NOPOLL_TIMER_SLOT_BITS (6)
+
+/**
+ * @internal Slots per wheel level.
+ */
+#define NOPOLL_TIMER_SLOTS (1 << NOPOLL_TIMER_SLOT_BITS)
+
+/**
+ * @internal Number of wheel levels: with 1ms ticks, level 0 covers
+ * 64ms, level 1 4s, level 2 4m and level 3 4h (timers beyond that are
+ * cascaded again until they expire).
+ */
+#define NOPOLL_TIMER_LEVELS (4)
+
+/**
+ * @internal Initial size of the hash used to find timers by id.
+ */
+#define NOPOLL_TIMER_HASH_SIZE (64)
+
+/**
+ * @internal Ticks are counted from ctx->timer_base so they fit on
+ * 32bit longs. Once they reach this value (a multiple of the wheel
+ * span, so slots do not change, and of 1000) the base is moved
+ * forward.
+ */
+#define NOPOLL_TIMER_REBASE (2097152000L)
+
+/**
+ * @internal Returns current time in ticks (milliseconds). The caller
+ * must hold ctx->ref_mutex.
+ */
+long __nopoll_timer_now (noPollCtx * ctx)
+{
+	struct timeval now;
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&now, NULL);
+#else
+	gettimeofday (&now, NULL);
+#endif
+	return ((now.tv_sec - ctx->timer_base) * 1000) + (now.tv_usec / 1000);
+}
+
+/**
+ * @internal Moves the tick base forward before ticks overflow. The
+ * caller must hold ctx->ref_mutex.
+ */
+void __nopoll_timer_rebase (noPollCtx * ctx)
+{
+	noPollTimer * timer;
+	int           iterator;
+
+	for (iterator = 0; iterator < NOPOLL_TIMER_LEVELS * NOPOLL_TIMER_SLOTS; iterator++) {
+		for (timer = ctx->timer_wheel[iterator]; timer; timer = timer->next)
+			timer->expires -= NOPOLL_TIMER_REBASE;
+	} /* end for */
+
+	ctx->timer_tick -= NOPOLL_TIMER_REBASE;
+	ctx->timer_base += NOPOLL_TIMER_REBASE / 1000;
+	return;
+}
+
+/**
+ * @internal Places the timer on the wheel slot matching its
+ * expiration. The caller must hold ctx->ref_mutex.
+ */
+void __nopoll_timer_link (noPollCtx * ctx, noPollTimer * timer)
+{
+	long           expires = timer->expires;
+	long           delta;
+	int            level;
+	noPollTimer ** slot;
+
+	if (expires < ctx->timer_tick)
+		expires = ctx->timer_tick;
+	delta = expires - ctx->timer_tick;
+
+	/* find the level covering the delta */
+	for (level = 0; level < NOPOLL_TIMER_LEVELS - 1; level++) {
+		if (delta < (1L << (NOPOLL_TIMER_SLOT_BITS * (level + 1))))
+			break;
+	} /* end for */
+
+	/* timers beyond the last level are placed on the farthest
+	 * slot and cascaded again from there */
+	if (level == NOPOLL_TIMER_LEVELS - 1 && delta >= (1L << (NOPOLL_TIMER_SLOT_BITS * NOPOLL_TIMER_LEVELS)))
+		expires = ctx->timer_tick + (1L << (NOPOLL_TIMER_SLOT_BITS * NOPOLL_TIMER_LEVELS)) - 1;
+
+	slot = &(ctx->timer_wheel[(level * NOPOLL_TIMER_SLOTS) + ((expires >> (NOPOLL_TIMER_SLOT_BITS * level)) & (NOPOLL_TIMER_SLOTS - 1))]);
+
+	/* push into the slot list */
+	timer->slot = slot;
+	timer->prev = NULL;
+	timer->next = *slot;
+	if (*slot)
+		(*slot)->prev = timer;
+	*slot = timer;
+
+	return;
+}
+
+/**
+ * @internal Removes the timer from its wheel slot. The caller must
+ * hold ctx->ref_mutex.
+ */
+void __nopoll_timer_unlink (noPollTimer * timer)
+{
+	if (timer->prev)
+		timer->prev->next = timer->next;
+	else
+		*(timer->slot) = timer->next;
+	if (timer->next)
+		timer->next->prev = timer->prev;
+
+	timer->slot = NULL;
+	timer->next = NULL;
+	timer->prev = NULL;
+	return;
+}
+
+/**
+ * @internal Removes the timer from the id hash. The caller must hold
+ * ctx->ref_mutex.
+ */
+void __nopoll_timer_hash_remove (noPollCtx * ctx, noPollTimer * timer)
+{
+	noPollTimer ** bucket = &(ctx->timer_hash[timer->id & (ctx->timer_hash_size - 1)]);
+
+	while (*bucket) {
+		if (*bucket == timer) {
+			*bucket = timer->hash_next;
+			break;
+		} /* end if */
+		bucket = &((*bucket)->hash_next);
+	} /* end while */
+
+	timer->hash_next = NULL;
+	return;
+}
+
+/**
+ * @internal Doubles the id hash size so buckets are kept short. The
+ * caller must hold ctx->ref_mutex.
+ */
+void __nopoll_timer_hash_grow (noPollCtx * ctx)
+{
+	noPollTimer ** hash;
+	noPollTimer  * timer;
+	noPollTimer  * next;
+	int            size = ctx->timer_hash_size * 2;
+	int            iterator;
+
+	hash = nopoll_new (noPollTimer *, size);
+	if (hash == NULL)
+		return;
+
+	for (iterator = 0; iterator < ctx->timer_hash_size; iterator++) {
+		timer = ctx->timer_hash[iterator];
+		while (timer) {
+			next                         = timer->hash_next;
+			timer->hash_next             = hash[timer->id & (size - 1)];
+			hash[timer->id & (size - 1)] = timer;
+			timer                        = next;
+		} /* end while */
+	} /* end for */
+
+	nopoll_free (ctx->timer_hash);
+	ctx->timer_hash      = hash;
+	ctx->timer_hash_size = size;
+	return;
+}
+
+/**
+ * @brief Installs a timer on the provided context that calls the
+ * handler once \p microseconds have elapsed.
+ *
+ * Timers are run by \ref nopoll_loop_wait, which also adjusts how long
+ * it waits for network activity to the nearest timer deadline, so
+ * timers fire on time (with millisecond resolution) without any
+ * additional thread. Timers are kept on a hierarchical timing wheel:
+ * adding, cancelling and expiring a timer has a constant cost no
+ * matter how many timers are installed.
+ *
+ * The handler is called once (from the thread running \ref
+ * nopoll_loop_wait). To get a periodic timer, install a new one from
+ * the handler. Timers (and \ref nopoll_timer_cancel) can be used from
+ * any thread when the library has thread support (see \ref
+ * nopoll_thread_handlers).
+ *
+ * \code
+ * void my_timeout (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+ * {
+ *       // timeout reached
+ * }
+ *
+ * // call my_timeout in 5 seconds
+ * timer_id = nopoll_timer_add (ctx, 5000000, my_timeout, NULL);
+ * \endcode
+ *
+ * @param ctx The context where the timer is installed.
+ *
+ * @param microseconds Time to wait before calling the handler.
+ *
+ * @param handler The handler to call.
+ *
+ * @param user_data Optional user defined pointer passed to the handler.
+ *
+ * @return The timer id (bigger than 0) that can be used with \ref
+ * nopoll_timer_cancel or -1 if it fails.
+ */
+int         nopoll_timer_add (noPollCtx          * ctx,
+			      long                 microseconds,
+			      noPollTimerHandler   handler,
+			      noPollPtr            user_data)
+{
+	noPollTimer * timer;
+	long          now;
+	int           id;
+
+	nopoll_return_val_if_fail (ctx, ctx && handler && microseconds >= 0, -1);
+
+	timer = nopoll_new (noPollTimer, 1);
+	if (timer == NULL)
+		return -1;
+	timer->handler   = handler;
+	timer->user_data = user_data;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+
+	/* create wheel and hash on first use */
+	if (ctx->timer_wheel == NULL) {
+		ctx->timer_base      = (long) time (NULL);
+		ctx->timer_wheel     = nopoll_new (noPollTimer *, NOPOLL_TIMER_LEVELS * NOPOLL_TIMER_SLOTS);
+		ctx->timer_hash      = nopoll_new (noPollTimer *, NOPOLL_TIMER_HASH_SIZE);
+		ctx->timer_hash_size = NOPOLL_TIMER_HASH_SIZE;
+		ctx->timer_tick      = __nopoll_timer_now (ctx);
+		if (ctx->timer_wheel == NULL || ctx->timer_hash == NULL) {
+			nopoll_free (ctx->timer_wheel);
+			nopoll_free (ctx->timer_hash);
+			ctx->timer_wheel = NULL;
+			ctx->timer_hash  = NULL;
+			nopoll_mutex_unlock (ctx->ref_mutex);
+			nopoll_free (timer);
+			return -1;
+		} /* end if */
+	} /* end if */
+
+	/* the wheel does not move while it is empty */
+	now = __nopoll_timer_now (ctx);
+	if (ctx->timer_count == 0 && now > ctx->timer_tick)
+		ctx->timer_tick = now;
+
+	/* next id (skipping values not valid) */
+	ctx->timer_id++;
+	if (ctx->timer_id <= 0)
+		ctx->timer_id = 1;
+	timer->id      = ctx->timer_id;
+	/* round up to the next millisecond (at least one tick, so
+	 * a timer installed from a handler is not run on the same
+	 * pass) */
+	timer->expires = now + ((microseconds + 999) / 1000);
+	if (timer->expires <= now)
+		timer->expires = now + 1;
+	id             = timer->id;
+
+	__nopoll_timer_link (ctx, timer);
+
+	if (ctx->timer_count >= ctx->timer_hash_size)
+		__nopoll_timer_hash_grow (ctx);
+	timer->hash_next = ctx->timer_hash[id & (ctx->timer_hash_size - 1)];
+	ctx->timer_hash[id & (ctx->timer_hash_size - 1)] = timer;
+	ctx->timer_count++;
+
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return id;
+}
+
+/**
+ * @brief Cancels a timer installed with \ref nopoll_timer_add.
+ *
+ * @param ctx The context where the timer was installed.
+ *
+ * @param timer_id The timer id to cancel.
+ *
+ * @return nopoll_true if the timer was cancelled, nopoll_false if it
+ * was not found (already expired or cancelled).
+ */
+nopoll_bool nopoll_timer_cancel (noPollCtx * ctx, int timer_id)
+{
+	noPollTimer * timer;
+
+	nopoll_return_val_if_fail (ctx, ctx && timer_id > 0, nopoll_false);
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	if (ctx->timer_hash == NULL) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return nopoll_false;
+	} /* end if */
+
+	timer = ctx->timer_hash[timer_id & (ctx->timer_hash_size - 1)];
+	while (timer && timer->id != timer_id)
+		timer = timer->hash_next;
+
+	if (timer == NULL) {
+		nopoll_mutex_unlock (ctx->ref_mutex);
+		return nopoll_false;
+	} /* end if */
+
+	__nopoll_timer_hash_remove (ctx, timer);
+	__nopoll_timer_unlink (timer);
+	ctx->timer_count--;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	nopoll_free (timer);
+	return nopoll_true;
+}
+
+/**
+ * @brief Returns the number of timers installed (pending) on the
+ * provided context.
+ *
+ * @param ctx The context to check.
+ *
+ * @return Number of timers or -1 if it fails.
+ */
+int         nopoll_timer_count (noPollCtx * ctx)
+{
+	int result;
+
+	nopoll_return_val_if_fail (ctx, ctx, -1);
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	result = ctx->timer_count;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return result;
+}
+
+/**
+ * @internal Returns how long (microseconds) the loop can wait before
+ * the next timer must be processed, limited to max_timeout.
+ *
+ * The wheel is not scanned timer by timer: the first busy slot of
+ * every level bounds the deadline (timers on upper levels are
+ * reported at the time they are cascaded).
+ */
+long        __nopoll_timer_next_timeout (noPollCtx * ctx, long max_timeout)
+{
+	long  now;
+	long  next = -1;
+	long  candidate;
+	long  position;
+	int   level;
+	int   iterator;
+	int   first;
+	int   shift;
+
+	if (ctx == NULL || ctx->timer_count == 0)
+		return max_timeout;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	now = __nopoll_timer_now (ctx);
+	for (level = 0; level < NOPOLL_TIMER_LEVELS; level++) {
+		shift    = NOPOLL_TIMER_SLOT_BITS * level;
+		position = ctx->timer_tick >> shift;
+
+		/* level 0 slots starting from the current tick, upper
+		 * levels starting from the next cascade (which is the
+		 * current slot when the tick is on a boundary not yet
+		 * processed) */
+		first = (level == 0 || (ctx->timer_tick & ((1L << shift) - 1)) == 0) ? 0 : 1;
+		for (iterator = first; iterator < first + NOPOLL_TIMER_SLOTS; iterator++) {
+			if (ctx->timer_wheel[(level * NOPOLL_TIMER_SLOTS) + ((position + iterator) & (NOPOLL_TIMER_SLOTS - 1))] == NULL)
+				continue;
+
+			candidate = (position + iterator) << shift;
+			if (next == -1 || candidate < next)
+				next = candidate;
+			break;
+		} /* end for */
+	} /* end for */
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	if (next == -1)
+		return max_timeout;
+	if (next <= now)
+		return 0;
+	if ((next - now) * 1000 < max_timeout)
+		return (next - now) * 1000;
+	return max_timeout;
+}
+
+/**
+ * @internal Moves upper level slot timers into lower levels. The
+ * caller must hold ctx->ref_mutex.
+ */
+void __nopoll_timer_cascade (noPollCtx * ctx, int level)
+{
+	noPollTimer ** slot;
+	noPollTimer  * timer;
+	noPollTimer  * next;
+
+	slot  = &(ctx->timer_wheel[(level * NOPOLL_TIMER_SLOTS) + ((ctx->timer_tick >> (NOPOLL_TIMER_SLOT_BITS * level)) & (NOPOLL_TIMER_SLOTS - 1))]);
+	timer = *slot;
+	*slot = NULL;
+
+	while (timer) {
+		next = timer->next;
+		__nopoll_timer_link (ctx, timer);
+		timer = next;
+	} /* end while */
+
+	return;
+}
+
+/**
+ * @internal Advances the wheel up to the current time, calling
+ * handlers of expired timers (without holding any lock).
+ */
+void        __nopoll_timer_process (noPollCtx * ctx)
+{
+	long           now;
+	noPollTimer  * timer;
+	noPollTimer ** slot;
+	int            level;
+
+	if (ctx == NULL || ctx->timer_wheel == NULL)
+		return;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	now = __nopoll_timer_now (ctx);
+	while (ctx->timer_count > 0 && ctx->timer_tick <= now) {
+		/* cascade upper levels when lower ones wrap */
+		for (level = 1; level < NOPOLL_TIMER_LEVELS; level++) {
+			if ((ctx->timer_tick & ((1L << (NOPOLL_TIMER_SLOT_BITS * level)) - 1)) != 0)
+				break;
+			__nopoll_timer_cascade (ctx, level);
+		} /* end for */
+
+		/* expire timers on current slot */
+		slot = &(ctx->timer_wheel[ctx->timer_tick & (NOPOLL_TIMER_SLOTS - 1)]);
+		while (*slot) {
+			timer = *slot;
+			__nopoll_timer_unlink (timer);
+			__nopoll_timer_hash_remove (ctx, timer);
+			ctx->timer_count--;
+
+			/* call handler without the lock: it may install
+			 * or cancel timers */
+			nopoll_mutex_unlock (ctx->ref_mutex);
+			timer->handler (ctx, timer->id, timer->user_data);
+			nopoll_free (timer);
+			nopoll_mutex_lock (ctx->ref_mutex);
+		} /* end while */
+
+		ctx->timer_tick++;
+	} /* end while */
+
+	/* the wheel does not move while it is empty */
+	if (ctx->timer_count == 0 && now > ctx->timer_tick)
+		ctx->timer_tick = now;
+
+	/* keep ticks far from overflowing */
+	if (ctx->timer_tick >= NOPOLL_TIMER_REBASE)
+		__nopoll_timer_rebase (ctx);
+
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	return;
+}
+
+/**
+ * @internal Releases every timer installed (without calling handlers).
+ */
+void        __nopoll_timer_release_all (noPollCtx * ctx)
+{
+	noPollTimer * timer;
+	int           iterator;
+
+	if (ctx == NULL || ctx->timer_wheel == NULL)
+		return;
+
+	for (iterator = 0; iterator < NOPOLL_TIMER_LEVELS * NOPOLL_TIMER_SLOTS; iterator++) {
+		while (ctx->timer_wheel[iterator]) {
+			timer                       = ctx->timer_wheel[iterator];
+			ctx->timer_wheel[iterator]  = timer->next;
+			nopoll_free (timer);
+		} /* end while */
+	} /* end for */
+
+	nopoll_free (ctx->timer_wheel);
+	nopoll_free (ctx->timer_hash);
+	ctx->timer_wheel     = NULL;
+	ctx->timer_hash      = NULL;
+	ctx->timer_hash_size = 0;
+	ctx->timer_count     = 0;
+
+	return;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,63 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#ifndef __NOPOLL_TIMER_H__
+#define __NOPOLL_TIMER_H__
+
+#include <nopoll.h>
+
+BEGIN_C_DECLS
+
+int         nopoll_timer_add (noPollCtx          * ctx,
+			      long                 microseconds,
+			      noPollTimerHandler   handler,
+			      noPollPtr            user_data);
+
+nopoll_bool nopoll_timer_cancel (noPollCtx * ctx, int timer_id);
+
+int         nopoll_timer_count (noPollCtx * ctx);
+
+/** internal API **/
+long        __nopoll_timer_next_timeout (noPollCtx * ctx, long max_timeout);
+
+void        __nopoll_timer_process (noPollCtx * ctx);
+
+void        __nopoll_timer_release_all (noPollCtx * ctx);
+
+END_C_DECLS
+
+#endif
@@ -0,0 +1,242 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_utf8.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_utf8 noPoll UTF-8: UTF-8 validation of text messages
+ */
+
+/** 
+ * \addtogroup nopoll_utf8
+ * @{
+ */
+
+/**
+ * @internal Validator states: NOPOLL_UTF8_ACCEPT is the only state
+ * where a text message can end. States 1..3 expect that amount of
+ * continuation bytes (0x80..0xBF) while states 4..7 restrict the
+ * range of the next continuation byte to reject overlong forms,
+ * surrogates and code points beyond U+10FFFF (RFC 3629 section 4).
+ */
+#define NOPOLL_UTF8_ACCEPT  (0)
+#define NOPOLL_UTF8_REJECT  (-1)
+#define NOPOLL_UTF8_AFTER_E0 (4)
+#define NOPOLL_UTF8_AFTER_ED (5)
+#define NOPOLL_UTF8_AFTER_F0 (6)
+#define NOPOLL_UTF8_AFTER_F4 (7)
+
+/**
+ * @internal Mask with the high bit of each byte of a word set: a word
+ * holds only ASCII if (word & mask) == 0.
+ */
+#define NOPOLL_UTF8_ASCII_MASK ((unsigned long) -1 / 0xff * 0x80)
+
+/**
+ * @brief Allows to check if the content provided is valid UTF-8 (as
+ * required for text messages, RFC 6455 section 8.1).
+ *
+ * See \ref nopoll_ctx_set_utf8_validation to have text messages sent
+ * and received validated by the library.
+ *
+ * @param content The content to check.
+ *
+ * @param length Amount of bytes to check.
+ *
+ * @return nopoll_true if the content is valid UTF-8, otherwise nopoll_false.
+ */
+nopoll_bool nopoll_utf8_validate (const char * content, long length)
+{
+	if (content == NULL || length < 0)
+		return nopoll_false;
+
+	return __nopoll_utf8_check (NOPOLL_UTF8_ACCEPT, content, length) == NOPOLL_UTF8_ACCEPT;
+}
+
+/**
+ * @internal Feeds the validator with the content provided, starting
+ * from the state reported by a previous call (NOPOLL_UTF8_ACCEPT
+ * for the first piece), so a code point can be split across frames
+ * and partial reads.
+ *
+ * While the validator is between code points, ASCII runs are skipped
+ * a word at a time, which is what makes the check cheap on regular
+ * text.
+ *
+ * @return The validator state after the content, NOPOLL_UTF8_REJECT
+ * if it is not valid UTF-8.
+ */
+int __nopoll_utf8_check (int state, const char * content, long length)
+{
+	const unsigned char * iterator = (const unsigned char *) content;
+	const unsigned char * end      = iterator + length;
+	unsigned long         word;
+	unsigned char         byte;
+
+	while (iterator < end) {
+		if (state == NOPOLL_UTF8_ACCEPT) {
+			/* ASCII fast path, a word at a time */
+			while ((end - iterator) >= (long) sizeof (word)) {
+				memcpy (&word, iterator, sizeof (word));
+				if (word & NOPOLL_UTF8_ASCII_MASK)
+					break;
+				iterator += sizeof (word);
+			} /* end while */
+			while (iterator < end && *iterator < 0x80)
+				iterator++;
+			if (iterator == end)
+				break;
+
+			/* lead byte */
+			byte = *iterator++;
+			if (byte >= 0xc2 && byte <= 0xdf)
+				state = 1;
+			else if (byte == 0xe0)
+				state = NOPOLL_UTF8_AFTER_E0;
+			else if (byte == 0xed)
+				state = NOPOLL_UTF8_AFTER_ED;
+			else if (byte >= 0xe1 && byte <= 0xef)
+				state = 2;
+			else if (byte == 0xf0)
+				state = NOPOLL_UTF8_AFTER_F0;
+			else if (byte >= 0xf1 && byte <= 0xf3)
+				state = 3;
+			else if (byte == 0xf4)
+				state = NOPOLL_UTF8_AFTER_F4;
+			else
+				return NOPOLL_UTF8_REJECT;
+			continue;
+		} /* end if */
+
+		/* continuation byte */
+		byte = *iterator++;
+		switch (state) {
+		case NOPOLL_UTF8_AFTER_E0:
+			if (byte < 0xa0 || byte > 0xbf)
+				return NOPOLL_UTF8_REJECT;
+			state = 1;
+			break;
+		case NOPOLL_UTF8_AFTER_ED:
+			if (byte < 0x80 || byte > 0x9f)
+				return NOPOLL_UTF8_REJECT;
+			state = 1;
+			break;
+		case NOPOLL_UTF8_AFTER_F0:
+			if (byte < 0x90 || byte > 0xbf)
+				return NOPOLL_UTF8_REJECT;
+			state = 2;
+			break;
+		case NOPOLL_UTF8_AFTER_F4:
+			if (byte < 0x80 || byte > 0x8f)
+				return NOPOLL_UTF8_REJECT;
+			state = 2;
+			break;
+		default:
+			if (byte < 0x80 || byte > 0xbf)
+				return NOPOLL_UTF8_REJECT;
+			state--;
+			break;
+		} /* end switch */
+	} /* end while */
+
+	return state;
+}
+
+/**
+ * @internal Validates the content of the message received (a frame
+ * or part of a frame, see nopoll_conn_get_msg) when it belongs to a
+ * text message, keeping validator state on the connection across
+ * fragments and partial reads.
+ *
+ * @return nopoll_false if the content is not valid UTF-8 or the
+ * message ends in the middle of a code point (the connection must be
+ * failed with status 1007), otherwise nopoll_true.
+ */
+nopoll_bool __nopoll_utf8_rx_msg (noPollConn * conn, noPollMsg * msg)
+{
+	nopoll_bool final;
+
+	/* control frames are not part of messages */
+	if (msg->op_code > NOPOLL_BINARY_FRAME)
+		return nopoll_true;
+
+	/* first frame of a message (noPoll peers flag every fragment
+	 * with the message op code) */
+	if (msg->op_code != NOPOLL_CONTINUATION_FRAME && ! conn->utf8_rx_message) {
+		conn->utf8_rx_text  = msg->op_code == NOPOLL_TEXT_FRAME;
+		conn->utf8_rx_state = NOPOLL_UTF8_ACCEPT;
+	} /* end if */
+
+	final                 = msg->has_fin && msg->remain_bytes == 0;
+	conn->utf8_rx_message = ! final;
+	if (! conn->utf8_rx_text)
+		return nopoll_true;
+
+	conn->utf8_rx_state = __nopoll_utf8_check (conn->utf8_rx_state, (const char *) msg->payload, msg->payload_size);
+	if (conn->utf8_rx_state == NOPOLL_UTF8_REJECT || (final && conn->utf8_rx_state != NOPOLL_UTF8_ACCEPT)) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Received invalid UTF-8 content in a text message over conn-id=%d", conn->id);
+		return nopoll_false;
+	} /* end if */
+
+	return nopoll_true;
+}
+
+/**
+ * @internal Validates the content of a text frame about to be sent.
+ *
+ * @param state Where the validator state after the content is
+ * placed: the caller records it on the connection
+ * (conn->utf8_tx_state) once the frame is sent.
+ *
+ * @return nopoll_false if the content is not valid UTF-8 or the
+ * message ends in the middle of a code point, otherwise nopoll_true.
+ */
+nopoll_bool __nopoll_utf8_tx_check (noPollConn * conn, const char * content, long length, nopoll_bool has_fin, int * state)
+{
+	*state = __nopoll_utf8_check (conn->utf8_tx_state, content, length);
+	if (*state == NOPOLL_UTF8_REJECT || (has_fin && *state != NOPOLL_UTF8_ACCEPT)) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Refusing to send invalid UTF-8 content in a text message over conn-id=%d", conn->id);
+		return nopoll_false;
+	} /* end if */
+
+	return nopoll_true;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,397 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_worker.h>
+#include <nopoll_private.h>
+
+/* the pool is woken up through a pipe (see __nopoll_worker_register) */
+#if defined(NOPOLL_HAVE_PTHREAD) && defined(NOPOLL_OS_UNIX)
+#include <pthread.h>
+#define NOPOLL_WORKER_SUPPORT (1)
+#endif
+
+/** 
+ * \defgroup nopoll_worker noPoll Worker: TLS handshakes and blocking tasks run on a thread pool
+ */
+
+/** 
+ * \addtogroup nopoll_worker
+ * @{
+ */
+
+#if defined(NOPOLL_WORKER_SUPPORT)
+
+typedef struct _noPollWorkerJob noPollWorkerJob;
+
+struct _noPollWorkerJob {
+	/* connection waiting for a handshake step or task to run */
+	noPollConn      * conn;
+	noPollWorkerTask  task;
+	noPollPtr         data;
+	noPollWorkerJob * next;
+};
+
+typedef struct _noPollWorkerPool {
+	pthread_mutex_t   mutex;
+	pthread_cond_t    cond;
+	pthread_t       * threads;
+	int               workers;
+	/* run handshakes of accepted connections (otherwise the pool
+	 * was started to run tasks, see __nopoll_worker_run_task) */
+	nopoll_bool       handshakes;
+	noPollWorkerJob * first;
+	noPollWorkerJob * last;
+	nopoll_bool       stop;
+	/* wakes up nopoll_loop_wait when a step finishes */
+	int               wakeup[2];
+} noPollWorkerPool;
+
+/**
+ * @internal Worker thread: runs the handshake step of the connections
+ * (and the tasks) queued until the pool is stopped.
+ */
+static void * __nopoll_worker_run (void * data)
+{
+	noPollWorkerPool * pool   = (noPollWorkerPool *) data;
+	noPollWorkerJob  * job;
+	noPollConn       * conn;
+	char               signal = 1;
+
+	while (nopoll_true) {
+		pthread_mutex_lock (&pool->mutex);
+		while (pool->first == NULL && ! pool->stop)
+			pthread_cond_wait (&pool->cond, &pool->mutex);
+		if (pool->stop) {
+			pthread_mutex_unlock (&pool->mutex);
+			return NULL;
+		} /* end if */
+
+		job         = pool->first;
+		pool->first = job->next;
+		if (pool->first == NULL)
+			pool->last = NULL;
+		pthread_mutex_unlock (&pool->mutex);
+
+		if (job->task) {
+			job->task (job->data, nopoll_false);
+			nopoll_free (job);
+			if (write (pool->wakeup[1], &signal, 1) < 0)
+				continue;
+			continue;
+		} /* end if */
+
+		/* the loop doesn't watch the connection meanwhile (see
+		 * __nopoll_worker_is_busy) and failures are only
+		 * flagged: the loop closes the connection (see
+		 * __nopoll_conn_tls_handshake_failed) */
+		conn = job->conn;
+		nopoll_free (job);
+		__nopoll_conn_tls_handshake (conn);
+
+		pthread_mutex_lock (&pool->mutex);
+		conn->tls_offloaded = nopoll_false;
+		pthread_mutex_unlock (&pool->mutex);
+		nopoll_conn_unref (conn);
+
+		/* return the connection to the loop: a full pipe means
+		 * the loop is already awake */
+		if (write (pool->wakeup[1], &signal, 1) < 0)
+			continue;
+	} /* end while */
+
+	return NULL;
+}
+
+/**
+ * @internal Stops the worker pool of the provided context (if any),
+ * waiting for the handshake steps and tasks running to finish. Tasks
+ * still queued are cancelled.
+ */
+void __nopoll_worker_release (noPollCtx * ctx)
+{
+	noPollWorkerPool * pool = (noPollWorkerPool *) ctx->tls_workers;
+	noPollWorkerJob  * job;
+	int                iterator;
+
+	if (pool == NULL)
+		return;
+	ctx->tls_workers = NULL;
+
+	pthread_mutex_lock (&pool->mutex);
+	pool->stop = nopoll_true;
+	pthread_cond_broadcast (&pool->cond);
+	pthread_mutex_unlock (&pool->mutex);
+
+	iterator = 0;
+	while (iterator < pool->workers) {
+		pthread_join (pool->threads[iterator], NULL);
+		iterator++;
+	} /* end while */
+
+	/* connections still queued go back to the loop */
+	while (pool->first) {
+		job         = pool->first;
+		pool->first = job->next;
+		if (job->task)
+			job->task (job->data, nopoll_true);
+		else {
+			job->conn->tls_offloaded = nopoll_false;
+			nopoll_conn_unref (job->conn);
+		} /* end if */
+		nopoll_free (job);
+	} /* end while */
+
+	nopoll_close_socket (pool->wakeup[0]);
+	nopoll_close_socket (pool->wakeup[1]);
+	pthread_cond_destroy (&pool->cond);
+	pthread_mutex_destroy (&pool->mutex);
+	nopoll_free (pool->threads);
+	nopoll_free (pool);
+	return;
+}
+
+/**
+ * @internal Starts a pool with the provided number of workers to run
+ * the TLS handshake of connections accepted on the context (when
+ * handshakes is nopoll_true) and the tasks queued.
+ *
+ * @return nopoll_true if at least one worker was started.
+ */
+nopoll_bool __nopoll_worker_start (noPollCtx * ctx, int workers, nopoll_bool handshakes)
+{
+	noPollWorkerPool * pool;
+
+	pool = nopoll_new (noPollWorkerPool, 1);
+	if (pool == NULL)
+		return nopoll_false;
+	if (pipe (pool->wakeup) != 0) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "Unable to create TLS handshake workers wakeup pipe, errno=%d", errno);
+		nopoll_free (pool);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_set_sock_block (pool->wakeup[0], nopoll_false);
+	nopoll_conn_set_sock_block (pool->wakeup[1], nopoll_false);
+	pthread_mutex_init (&pool->mutex, NULL);
+	pthread_cond_init (&pool->cond, NULL);
+	pool->threads    = nopoll_new (pthread_t, workers);
+	pool->handshakes = handshakes;
+
+	ctx->tls_workers = pool;
+	while (pool->threads && pool->workers < workers) {
+		if (pthread_create (&pool->threads[pool->workers], NULL, __nopoll_worker_run, pool) != 0) {
+			nopoll_log (ctx, NOPOLL_LEVEL_WARNING, "Unable to start TLS handshake worker %d of %d, errno=%d",
+				    pool->workers + 1, workers, errno);
+			break;
+		} /* end if */
+		pool->workers++;
+	} /* end while */
+
+	if (pool->workers == 0) {
+		__nopoll_worker_release (ctx);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_log (ctx, NOPOLL_LEVEL_DEBUG, "Started %d workers (TLS handshakes: %d)", pool->workers, handshakes);
+	return nopoll_true;
+}
+
+/**
+ * @internal Queues the TLS handshake step of the provided accepted
+ * connection on the worker pool (if configured). The connection is
+ * not watched by the loop until the step finishes.
+ *
+ * @return nopoll_true if the connection was queued.
+ */
+nopoll_bool __nopoll_worker_push (noPollCtx * ctx, noPollConn * conn)
+{
+	noPollWorkerPool * pool = (noPollWorkerPool *) ctx->tls_workers;
+	noPollWorkerJob  * job;
+
+	if (pool == NULL || ! pool->handshakes || ! nopoll_conn_ref (conn))
+		return nopoll_false;
+	job = nopoll_new (noPollWorkerJob, 1);
+	if (job == NULL) {
+		nopoll_conn_unref (conn);
+		return nopoll_false;
+	} /* end if */
+	job->conn = conn;
+
+	pthread_mutex_lock (&pool->mutex);
+	conn->tls_offloaded = nopoll_true;
+	if (pool->last)
+		pool->last->next = job;
+	else
+		pool->first = job;
+	pool->last = job;
+	pthread_cond_signal (&pool->cond);
+	pthread_mutex_unlock (&pool->mutex);
+	return nopoll_true;
+}
+
+/**
+ * @internal Runs the provided task on the worker pool, starting a
+ * pool with \ref NOPOLL_WORKER_TASK_THREADS workers (which do not take
+ * TLS handshakes) if none is configured. The loop is woken up once
+ * the task finishes. The task is called with cancelled set when the
+ * pool is stopped before running it.
+ *
+ * @return nopoll_true if the task was queued.
+ */
+nopoll_bool __nopoll_worker_run_task (noPollCtx * ctx, noPollWorkerTask task, noPollPtr data)
+{
+	noPollWorkerPool * pool;
+	noPollWorkerJob  * job;
+
+	nopoll_mutex_lock (ctx->ref_mutex);
+	if (ctx->tls_workers == NULL)
+		__nopoll_worker_start (ctx, NOPOLL_WORKER_TASK_THREADS, nopoll_false);
+	pool = (noPollWorkerPool *) ctx->tls_workers;
+	nopoll_mutex_unlock (ctx->ref_mutex);
+
+	if (pool == NULL)
+		return nopoll_false;
+	job = nopoll_new (noPollWorkerJob, 1);
+	if (job == NULL)
+		return nopoll_false;
+	job->task = task;
+	job->data = data;
+
+	pthread_mutex_lock (&pool->mutex);
+	if (pool->last)
+		pool->last->next = job;
+	else
+		pool->first = job;
+	pool->last = job;
+	pthread_cond_signal (&pool->cond);
+	pthread_mutex_unlock (&pool->mutex);
+	return nopoll_true;
+}
+
+/**
+ * @internal Allows to check if the TLS handshake of the provided
+ * connection is queued or running on the worker pool.
+ */
+nopoll_bool __nopoll_worker_is_busy (noPollCtx * ctx, noPollConn * conn)
+{
+	noPollWorkerPool * pool = (noPollWorkerPool *) ctx->tls_workers;
+	nopoll_bool        result;
+
+	if (pool == NULL)
+		return nopoll_false;
+	pthread_mutex_lock (&pool->mutex);
+	result = conn->tls_offloaded;
+	pthread_mutex_unlock (&pool->mutex);
+	return result;
+}
+
+/**
+ * @internal Adds the worker pool wakeup descriptor to the io wait
+ * engine so nopoll_loop_wait returns as soon as a handshake step
+ * finishes.
+ */
+void __nopoll_worker_register (noPollCtx * ctx)
+{
+	noPollWorkerPool * pool = (noPollWorkerPool *) ctx->tls_workers;
+
+	if (pool == NULL)
+		return;
+	ctx->io_engine->add_to (pool->wakeup[0], ctx, NULL, ctx->io_engine->io_object);
+	return;
+}
+
+/**
+ * @internal Consumes worker pool wakeups after the io wait.
+ *
+ * @return 1 if the wakeup descriptor was reported by the io wait
+ * engine, otherwise 0.
+ */
+int __nopoll_worker_process (noPollCtx * ctx)
+{
+	noPollWorkerPool * pool = (noPollWorkerPool *) ctx->tls_workers;
+	char               buffer[64];
+
+	if (pool == NULL || ! ctx->io_engine->is_set (ctx, pool->wakeup[0], ctx->io_engine->io_object))
+		return 0;
+	while (read (pool->wakeup[0], buffer, sizeof (buffer)) > 0)
+		;
+	return 1;
+}
+
+#else /* ! NOPOLL_WORKER_SUPPORT */
+
+void __nopoll_worker_release (noPollCtx * ctx)
+{
+	return;
+}
+
+nopoll_bool __nopoll_worker_start (noPollCtx * ctx, int workers, nopoll_bool handshakes)
+{
+	nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "noPoll was built without POSIX threads support (or for a platform without pipes), TLS handshake workers are not available");
+	return nopoll_false;
+}
+
+nopoll_bool __nopoll_worker_push (noPollCtx * ctx, noPollConn * conn)
+{
+	return nopoll_false;
+}
+
+nopoll_bool __nopoll_worker_run_task (noPollCtx * ctx, noPollWorkerTask task, noPollPtr data)
+{
+	/* no workers: the caller runs the task */
+	return nopoll_false;
+}
+
+nopoll_bool __nopoll_worker_is_busy (noPollCtx * ctx, noPollConn * conn)
+{
+	return nopoll_false;
+}
+
+void __nopoll_worker_register (noPollCtx * ctx)
+{
+	return;
+}
+
+int __nopoll_worker_process (noPollCtx * ctx)
+{
+	return 0;
+}
+
+#endif
+
+/**
+ * @}
+ */
@@ -0,0 +1,433 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll_writer.h>
+#include <nopoll_private.h>
+
+/** 
+ * \defgroup nopoll_writer noPoll Writer: send big messages in pieces produced on demand
+ */
+
+/** 
+ * \addtogroup nopoll_writer
+ * @{
+ */
+
+/**
+ * @brief Creates a writer that sends a single message over the
+ * provided connection, taking its content from the producer
+ * provided, piece by piece, as the connection accepts more data.
+ *
+ * This allows sending messages of any size (for example, a big file)
+ * without building the whole content in memory: the writer only
+ * holds one piece (chunk_size bytes) at a time. Each piece is sent in
+ * its own frame (first frame with the op code provided, the rest as
+ * continuation frames).
+ *
+ * \code
+ * writer = nopoll_writer_new (conn, NOPOLL_BINARY_FRAME, 0, my_producer, my_data);
+ * // blocking operation
+ * if (nopoll_writer_send (writer, 30000000) != 1)
+ *       printf ("Failed to send message\n");
+ * nopoll_writer_free (writer);
+ * \endcode
+ *
+ * Applications driving non blocking connections can call \ref
+ * nopoll_writer_write each time the connection is ready to write
+ * instead of \ref nopoll_writer_send.
+ *
+ * No other message can be sent over the connection until the writer
+ * has finished (control frames like ping or close are not affected).
+ *
+ * @param conn The connection where the message is sent (the writer
+ * holds a reference to it).
+ *
+ * @param op_code The message type: \ref NOPOLL_TEXT_FRAME or \ref NOPOLL_BINARY_FRAME.
+ *
+ * @param chunk_size Size of each piece (bytes). Use 0 or a negative
+ * value to use the default (\ref NOPOLL_MSG_CHUNK_SIZE).
+ *
+ * @param producer The handler called to get content (see \ref noPollWriterProducer).
+ *
+ * @param user_data User defined pointer passed in to the producer.
+ *
+ * @return A newly created writer or NULL if it fails (wrong
+ * parameters or memory exhausted). Release it with \ref nopoll_writer_free.
+ */
+noPollWriter * nopoll_writer_new (noPollConn           * conn,
+				  noPollOpCode           op_code,
+				  long                   chunk_size,
+				  noPollWriterProducer   producer,
+				  noPollPtr              user_data)
+{
+	noPollWriter * writer;
+
+	if (conn == NULL || producer == NULL)
+		return NULL;
+
+	if (op_code != NOPOLL_TEXT_FRAME && op_code != NOPOLL_BINARY_FRAME) {
+		nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Writer can only send text or binary messages (op code %d received)", op_code);
+		return NULL;
+	} /* end if */
+
+	/* at least two bytes: one byte is held back until next piece
+	 * is produced (see nopoll_writer_write) */
+	if (chunk_size <= 0)
+		chunk_size = NOPOLL_MSG_CHUNK_SIZE;
+	if (chunk_size < 2)
+		chunk_size = 2;
+
+	writer = nopoll_new (noPollWriter, 1);
+	if (writer == NULL)
+		return NULL;
+	writer->buffer = nopoll_new (char, chunk_size);
+	if (writer->buffer == NULL || ! nopoll_conn_ref (conn)) {
+		nopoll_free (writer->buffer);
+		nopoll_free (writer);
+		return NULL;
+	} /* end if */
+
+	writer->conn       = conn;
+	writer->op_code    = op_code;
+	writer->chunk_size = chunk_size;
+	writer->producer   = producer;
+	writer->user_data  = user_data;
+
+	return writer;
+}
+
+/**
+ * @internal Producer used by writers created with
+ * nopoll_writer_new_fd.
+ */
+long __nopoll_writer_fd_producer (noPollWriter * writer, char * buffer, long size, noPollPtr user_data)
+{
+	int result;
+
+	do {
+#if defined(NOPOLL_OS_WIN32)
+		result = _read (writer->fd, buffer, (unsigned int) size);
+#else
+		result = read (writer->fd, buffer, (size_t) size);
+#endif
+	} while (result < 0 && errno == NOPOLL_EINTR);
+
+	if (result < 0 && (errno == EAGAIN || errno == NOPOLL_EWOULDBLOCK))
+		return -2;
+	return result;
+}
+
+/**
+ * @brief Creates a writer that sends as a single message the content
+ * read from the provided file descriptor (until end of file is
+ * reached). See \ref nopoll_writer_new.
+ *
+ * The descriptor can be non blocking (the writer retries later when
+ * no data is available). It is not closed by the writer.
+ *
+ * @param conn The connection where the message is sent.
+ *
+ * @param op_code The message type: \ref NOPOLL_TEXT_FRAME or \ref NOPOLL_BINARY_FRAME.
+ *
+ * @param chunk_size Size of each piece (bytes), 0 to use the default.
+ *
+ * @param fd The file descriptor to read.
+ *
+ * @return A newly created writer or NULL if it fails.
+ */
+noPollWriter * nopoll_writer_new_fd (noPollConn   * conn,
+				     noPollOpCode   op_code,
+				     long           chunk_size,
+				     int            fd)
+{
+	noPollWriter * writer;
+
+	if (fd < 0)
+		return NULL;
+
+	writer = nopoll_writer_new (conn, op_code, chunk_size, __nopoll_writer_fd_producer, NULL);
+	if (writer)
+		writer->fd = fd;
+	return writer;
+}
+
+/**
+ * @brief Allows to configure send flags applied to the frames sent
+ * by the writer (see \ref noPollSendFlags). It must be called before
+ * the first write.
+ *
+ * @param writer The writer to configure.
+ *
+ * @param flags The send flags.
+ */
+void           nopoll_writer_set_flags (noPollWriter * writer, int flags)
+{
+	if (writer == NULL)
+		return;
+
+	writer->flags = flags;
+	return;
+}
+
+/**
+ * @brief Sends as many pieces of the message as the connection
+ * accepts without blocking.
+ *
+ * The writer only produces a new piece once the previous one was
+ * completely written (see \ref nopoll_conn_pending_write_bytes), so
+ * memory used is bounded by one piece no matter how fast the
+ * producer is.
+ *
+ * @param writer The writer to run.
+ *
+ * @return 1 when the message was completely sent, 0 when the
+ * connection (or the producer) can't accept more work right now
+ * (call again later, for example when the socket is ready to write),
+ * or -1 if a failure was found. When a failure is found after part
+ * of the message was sent, the connection is closed with status
+ * 1011 because the message cannot be completed.
+ */
+int            nopoll_writer_write (noPollWriter * writer)
+{
+	noPollConn  * conn;
+	long          produced;
+	long          length;
+	nopoll_bool   fin;
+	int           result;
+	int           utf8_state = 0;
+
+	if (writer == NULL || writer->failed)
+		return -1;
+
+	conn = writer->conn;
+	while (! writer->done) {
+		if (! nopoll_conn_is_ok (conn)) {
+			writer->failed = nopoll_true;
+			return -1;
+		} /* end if */
+
+		/* backpressure: wait until the previous frame is
+		 * completely written */
+		if (nopoll_conn_pending_write_bytes (conn) > 0) {
+			if (nopoll_conn_complete_pending_write (conn) < 0 && errno != NOPOLL_EWOULDBLOCK) {
+				writer->failed = nopoll_true;
+				return -1;
+			} /* end if */
+			if (nopoll_conn_pending_write_bytes (conn) > 0)
+				return 0;
+		} /* end if */
+
+		/* fill the piece */
+		while (! writer->eof && writer->used < writer->chunk_size) {
+			produced = writer->producer (writer, writer->buffer + writer->used, writer->chunk_size - writer->used, writer->user_data);
+			if (produced == -2)
+				return 0;
+			if (produced < 0 || produced > writer->chunk_size - writer->used) {
+				nopoll_log (conn->ctx, NOPOLL_LEVEL_CRITICAL, "Writer producer failed (result %ld) on conn-id=%d", produced, conn->id);
+				writer->failed = nopoll_true;
+				if (writer->frames > 0)
+					__nopoll_conn_fail (conn, 1011, "Unable to complete message");
+				return -1;
+			} /* end if */
+			if (produced == 0)
+				writer->eof = nopoll_true;
+			writer->used += produced;
+		} /* end while */
+
+		/* the last byte is held back until the producer
+		 * reports more content or the end of the message, so
+		 * the final frame is never empty */
+		fin    = writer->eof;
+		length = fin ? writer->used : writer->used - 1;
+
+		if (conn->utf8_tx && writer->op_code == NOPOLL_TEXT_FRAME &&
+		    ! __nopoll_utf8_tx_check (conn, writer->buffer, length, fin, &utf8_state)) {
+			writer->failed = nopoll_true;
+			if (writer->frames > 0)
+				__nopoll_conn_fail (conn, 1007, "Invalid UTF-8 content");
+			return -1;
+		} /* end if */
+
+		result = __nopoll_conn_send_frame_flags (conn, fin, conn->role == NOPOLL_ROLE_CLIENT,
+							 writer->frames == 0 ? writer->op_code : NOPOLL_CONTINUATION_FRAME,
+							 length, writer->buffer, 0, writer->flags);
+		if (result == -1) {
+			writer->failed = nopoll_true;
+			return -1;
+		} /* end if */
+
+		/* frame accepted (completely written or held as
+		 * pending write) */
+		if (conn->utf8_tx && writer->op_code == NOPOLL_TEXT_FRAME)
+			conn->utf8_tx_state = utf8_state;
+		writer->frames++;
+		writer->sent += length;
+
+		if (fin) {
+			writer->done = nopoll_true;
+			break;
+		} /* end if */
+		writer->buffer[0] = writer->buffer[length];
+		writer->used      = 1;
+	} /* end while */
+
+	return 1;
+}
+
+/**
+ * @brief Sends the message blocking the caller until it is
+ * completely written (including pending bytes) or the timeout is
+ * reached. See \ref nopoll_writer_write.
+ *
+ * @param writer The writer to run.
+ *
+ * @param timeout Timeout in microseconds. Use 0 to wait without limit.
+ *
+ * @return 1 when the message was completely written, 0 when the
+ * timeout was reached (the operation can be continued later) or -1
+ * if a failure was found.
+ */
+int            nopoll_writer_send (noPollWriter * writer, long timeout)
+{
+	noPollConn     * conn;
+	int              result;
+	long             wait;
+	struct timeval   start;
+	struct timeval   now;
+
+	if (writer == NULL)
+		return -1;
+
+	conn = writer->conn;
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&start, NULL);
+#else
+	gettimeofday (&start, NULL);
+#endif
+	while (nopoll_true) {
+		result = nopoll_writer_write (writer);
+		if (result < 0)
+			return -1;
+		if (result == 1 && nopoll_conn_pending_write_bytes (conn) == 0)
+			return 1;
+
+		/* flush what is left of the last frame */
+		if (result == 1 && nopoll_conn_complete_pending_write (conn) < 0 && errno != NOPOLL_EWOULDBLOCK)
+			return -1;
+
+		/* check timeout */
+		wait = 10000;
+		if (timeout > 0) {
+#if defined(NOPOLL_OS_WIN32)
+			nopoll_win32_gettimeofday (&now, NULL);
+#else
+			gettimeofday (&now, NULL);
+#endif
+			wait = timeout - ((now.tv_sec - start.tv_sec) * 1000000 + (now.tv_usec - start.tv_usec));
+			if (wait <= 0)
+				return 0;
+			if (wait > 10000)
+				wait = 10000;
+		} /* end if */
+
+		/* wait until the socket accepts more data (the
+		 * producer may also be the one not ready) */
+		if (nopoll_conn_socket (conn) == NOPOLL_INVALID_SOCKET)
+			return -1;
+		if (nopoll_conn_pending_write_bytes (conn) > 0)
+			__nopoll_conn_wait_writable (conn, wait);
+		else
+			nopoll_sleep (1000);
+	} /* end while */
+
+	return -1;
+}
+
+/**
+ * @brief Allows to check if the writer has sent the whole message
+ * (the last frame may still have pending bytes, see \ref
+ * nopoll_conn_pending_write_bytes).
+ *
+ * @param writer The writer to check.
+ *
+ * @return nopoll_true when the message was sent, otherwise nopoll_false.
+ */
+nopoll_bool    nopoll_writer_is_done (noPollWriter * writer)
+{
+	if (writer == NULL)
+		return nopoll_false;
+	return writer->done;
+}
+
+/**
+ * @brief Allows to get the number of message bytes sent (or queued
+ * as pending write) by the writer.
+ *
+ * @param writer The writer to check.
+ *
+ * @return Bytes sent or -1 if writer is NULL.
+ */
+long           nopoll_writer_get_sent (noPollWriter * writer)
+{
+	if (writer == NULL)
+		return -1;
+	return writer->sent;
+}
+
+/**
+ * @brief Releases the writer provided (and its connection reference).
+ *
+ * Releasing a writer that didn't finish leaves the connection in the
+ * middle of a message: close the connection in such case.
+ *
+ * @param writer The writer to release.
+ */
+void           nopoll_writer_free (noPollWriter * writer)
+{
+	if (writer == NULL)
+		return;
+
+	nopoll_conn_unref (writer->conn);
+	nopoll_free (writer->buffer);
+	nopoll_free (writer);
+
+	return;
+}
+
+/**
+ * @}
+ */
@@ -0,0 +1,73 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#ifndef __NOPOLL_WRITER_H__
+#define __NOPOLL_WRITER_H__
+
+#include <nopoll.h>
+
+BEGIN_C_DECLS
+
+noPollWriter * nopoll_writer_new (noPollConn           * conn,
+				  noPollOpCode           op_code,
+				  long                   chunk_size,
+				  noPollWriterProducer   producer,
+				  noPollPtr              user_data);
+
+noPollWriter * nopoll_writer_new_fd (noPollConn   * conn,
+				     noPollOpCode   op_code,
+				     long           chunk_size,
+				     int            fd);
+
+void           nopoll_writer_set_flags (noPollWriter * writer, int flags);
+
+int            nopoll_writer_write (noPollWriter * writer);
+
+int            nopoll_writer_send (noPollWriter * writer, long timeout);
+
+nopoll_bool    nopoll_writer_is_done (noPollWriter * writer);
+
+long           nopoll_writer_get_sent (noPollWriter * writer);
+
+void           nopoll_writer_free (noPollWriter * writer);
+
+/** internal API **/
+long           __nopoll_writer_fd_producer (noPollWriter * writer, char * buffer, long size, noPollPtr user_data);
+
+END_C_DECLS
+
+#endif
@@ -0,0 +1,561 @@
+/*
+ *  LibNoPoll: A websocket library
+ *  Copyright (C) 2025 Advanced Software Production Line, S.L.
+ *
+ *  This program is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public License
+ *  as published by the Free Software Foundation; either version 2.1
+ *  of the License, or (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this program; if not, write to the Free
+ *  Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307 USA
+ *  
+ *  You may find a copy of the license under this software is released
+ *  at COPYING file. This is LGPL software: you are welcome to develop
+ *  proprietary applications using this library without any royalty or
+ *  fee but returning back any change, improvement or addition in the
+ *  form of source code, project image, documentation patches, etc.
+ *
+ *  For commercial support on build Websocket enabled solutions
+ *  contact us:
+ *          
+ *      Postal address:
+ *         Advanced Software Production Line, S.L.
+ *         Av. Juan Carlos I, Nº13, 2ºC
+ *         Alcalá de Henares 28806 Madrid
+ *         Spain
+ *
+ *      Email address:
+ *         info@aspl.es - http://www.aspl.es/nopoll
+ */
+#include <nopoll-regression-common.h>
+#include <nopoll.h>
+
+#include <pthread.h>
+#include <signal.h>
+
+/*
+ * noPoll benchmark: runs a set of reproducible scenarios over the
+ * loopback interface (listener on a thread with its own context and
+ * loop, clients on the main thread) and reports one JSON object per
+ * result line on stdout, so it can be stored and compared to track
+ * regressions. Progress is reported on stderr.
+ *
+ *   >> ./nopoll-bench [--quick] [--scenario <name>] [--offset-port <value>]
+ *
+ * Scenarios: echo, throughput, fanout and handshake.
+ */
+
+#define BENCH_PLAIN_PORT  1270
+#define BENCH_TLS_PORT    1271
+#define BENCH_MAX_SIZE    (16 * 1024 * 1024)
+#define BENCH_MAX_CONNS   64
+
+/* benchmark settings */
+nopoll_bool   bench_quick     = nopoll_false;
+const char  * bench_scenario  = NULL;
+char        * bench_payload   = NULL;
+
+/* listener side state (only used by the listener thread) */
+noPollCtx   * bench_server    = NULL;
+long          bench_expected  = 0;
+long          bench_received  = 0;
+
+/* client side context */
+noPollCtx   * bench_ctx       = NULL;
+
+double bench_now (void)
+{
+	struct timeval now;
+
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&now, NULL);
+#else
+	gettimeofday (&now, NULL);
+#endif
+	return now.tv_sec + (now.tv_usec / 1000000.0);
+}
+
+/* waits until the socket provided is ready to read (or write) */
+void bench_wait_socket (noPollConn * conn, nopoll_bool for_write)
+{
+	fd_set         set;
+	struct timeval tv;
+	NOPOLL_SOCKET  session = nopoll_conn_socket (conn);
+
+	FD_ZERO (&set);
+	FD_SET (session, &set);
+	tv.tv_sec  = 0;
+	tv.tv_usec = 10000;
+	if (for_write)
+		select (session + 1, NULL, &set, NULL, &tv);
+	else
+		select (session + 1, &set, NULL, NULL, &tv);
+	return;
+}
+
+/* sends the provided content completely (waiting while it is kept
+ * as pending write) */
+nopoll_bool bench_send (noPollConn * conn, noPollOpCode op_code, const char * content, long size)
+{
+	int result;
+
+	result = nopoll_conn_send_frame (conn, nopoll_true, nopoll_conn_role (conn) == NOPOLL_ROLE_CLIENT, op_code, size, (noPollPtr) content, 0);
+	while (nopoll_conn_is_ok (conn) && nopoll_conn_pending_write_bytes (conn) > 0) {
+		bench_wait_socket (conn, nopoll_true);
+		if (nopoll_conn_complete_pending_write (conn) < 0 && errno != NOPOLL_EWOULDBLOCK) {
+			/* peer is gone */
+			nopoll_conn_shutdown (conn);
+			return nopoll_false;
+		} /* end if */
+	} /* end while */
+
+	return nopoll_conn_is_ok (conn) && (result >= 0 || result == -2);
+}
+
+/* waits for the next message (or piece of message) received */
+noPollMsg * bench_get_msg (noPollConn * conn, long timeout)
+{
+	noPollMsg * msg;
+	double      limit = bench_now () + (timeout / 1000000.0);
+
+	while (nopoll_conn_is_ok (conn)) {
+		msg = nopoll_conn_get_msg (conn);
+		if (msg)
+			return msg;
+		if (bench_now () > limit)
+			break;
+		if (nopoll_conn_read_pending (conn) <= 0)
+			bench_wait_socket (conn, nopoll_false);
+	} /* end while */
+
+	return NULL;
+}
+
+/* listener side: sends count messages of size bytes to conn */
+void bench_server_send (noPollConn * conn, long size, long count)
+{
+	while (count > 0) {
+		if (! bench_send (conn, NOPOLL_BINARY_FRAME, bench_payload, size))
+			return;
+		count--;
+	} /* end while */
+	return;
+}
+
+nopoll_bool bench_server_fanout (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	long * request = (long *) user_data;
+
+	if (nopoll_conn_role (conn) == NOPOLL_ROLE_LISTENER && nopoll_conn_is_ready (conn))
+		bench_server_send (conn, request[0], request[1]);
+	return nopoll_false; /* keep foreach, don't stop */
+}
+
+/* listener side: handles requests received */
+void bench_server_on_msg (noPollCtx * ctx, noPollConn * conn, noPollMsg * msg, noPollPtr user_data)
+{
+	const char * content = (const char *) nopoll_msg_get_payload (msg);
+	int          size    = nopoll_msg_get_payload_size (msg);
+	long         request[2];
+
+	if (nopoll_msg_opcode (msg) == NOPOLL_BINARY_FRAME || nopoll_msg_opcode (msg) == NOPOLL_CONTINUATION_FRAME) {
+		/* one way throughput: report when everything arrived */
+		bench_received += size;
+		if (bench_expected > 0 && bench_received >= bench_expected) {
+			bench_expected = 0;
+			bench_send (conn, NOPOLL_TEXT_FRAME, "done", 4);
+		} /* end if */
+		return;
+	} /* end if */
+
+	if (nopoll_ncmp (content, "echo", 4)) {
+		bench_send (conn, NOPOLL_TEXT_FRAME, content, size);
+	} else if (nopoll_ncmp (content, "expect ", 7)) {
+		bench_received = 0;
+		bench_expected = atol (content + 7);
+	} else if (nopoll_ncmp (content, "send ", 5)) {
+		request[0] = atol (content + 5);
+		request[1] = atol (strchr (content + 5, ' ') + 1);
+		bench_server_send (conn, request[0], request[1]);
+	} else if (nopoll_ncmp (content, "fanout ", 7)) {
+		request[0] = atol (content + 7);
+		request[1] = atol (strchr (content + 7, ' ') + 1);
+		nopoll_ctx_foreach_conn (ctx, bench_server_fanout, request);
+	} /* end if */
+	return;
+}
+
+nopoll_bool bench_server_on_open (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	/* never let a single connection block the listener loop */
+	return nopoll_conn_set_sock_block (nopoll_conn_socket (conn), nopoll_false);
+}
+
+void * bench_server_run (void * data)
+{
+	nopoll_loop_wait (bench_server, 0);
+	return NULL;
+}
+
+nopoll_bool bench_server_start (pthread_t * thread)
+{
+	noPollConn * listener;
+
+	bench_server = nopoll_ctx_new ();
+	nopoll_ctx_set_max_frame_size (bench_server, BENCH_MAX_SIZE + 1024);
+	nopoll_ctx_set_on_msg (bench_server, bench_server_on_msg, NULL);
+	nopoll_ctx_set_on_open (bench_server, bench_server_on_open, NULL);
+
+	listener = nopoll_listener_new (bench_server, "127.0.0.1", regtest_port (BENCH_PLAIN_PORT));
+	if (! nopoll_conn_is_ok (listener)) {
+		fprintf (stderr, "ERROR: unable to start listener at %s\n", regtest_port (BENCH_PLAIN_PORT));
+		return nopoll_false;
+	} /* end if */
+	listener = nopoll_listener_tls_new (bench_server, "127.0.0.1", regtest_port (BENCH_TLS_PORT));
+	if (! nopoll_conn_is_ok (listener) || ! nopoll_listener_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		fprintf (stderr, "ERROR: unable to start TLS listener at %s (run from the test directory)\n", regtest_port (BENCH_TLS_PORT));
+		return nopoll_false;
+	} /* end if */
+
+	return pthread_create (thread, NULL, bench_server_run, NULL) == 0;
+}
+
+/* client side: creates a connection ready to be used */
+noPollConn * bench_connect (nopoll_bool tls)
+{
+	noPollConn     * conn;
+	noPollConnOpts * opts;
+
+	if (tls) {
+		opts = nopoll_conn_opts_new ();
+		nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+		conn = nopoll_conn_tls_new (bench_ctx, opts, "127.0.0.1", regtest_port (BENCH_TLS_PORT), NULL, NULL, NULL, NULL);
+	} else {
+		conn = nopoll_conn_new (bench_ctx, "127.0.0.1", regtest_port (BENCH_PLAIN_PORT), NULL, NULL, NULL, NULL);
+	} /* end if */
+
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		fprintf (stderr, "ERROR: unable to connect (tls=%d)\n", tls);
+		nopoll_conn_close (conn);
+		return NULL;
+	} /* end if */
+	return conn;
+}
+
+const char * bench_transport (nopoll_bool tls)
+{
+	return tls ? "tls" : "plain";
+}
+
+nopoll_bool bench_enabled (const char * scenario)
+{
+	return bench_scenario == NULL || nopoll_cmp (bench_scenario, scenario);
+}
+
+/* echo round trip latency percentiles */
+nopoll_bool bench_echo (nopoll_bool tls, int size)
+{
+	noPollConn      * conn;
+	noPollMsg       * msg;
+	noPollHistogram   hist;
+	char              content[4096];
+	double            start;
+	int               iterations = bench_quick ? 500 : 5000;
+	int               iterator;
+	int               received;
+
+	conn = bench_connect (tls);
+	if (conn == NULL)
+		return nopoll_false;
+
+	memcpy (content, "echo", 4);
+	memcpy (content + 4, bench_payload, size - 4);
+	nopoll_histogram_reset (&hist);
+
+	/* first 10% are warm up round trips */
+	for (iterator = 0; iterator < iterations + iterations / 10; iterator++) {
+		start = bench_now ();
+		if (! bench_send (conn, NOPOLL_TEXT_FRAME, content, size))
+			return nopoll_false;
+		received = 0;
+		while (received < size) {
+			msg = bench_get_msg (conn, 5000000);
+			if (msg == NULL) {
+				fprintf (stderr, "ERROR: echo reply not received\n");
+				return nopoll_false;
+			} /* end if */
+			received += nopoll_msg_get_payload_size (msg);
+			nopoll_msg_unref (msg);
+		} /* end while */
+		if (iterator >= iterations / 10)
+			nopoll_histogram_record (&hist, (long) ((bench_now () - start) * 1000000));
+	} /* end for */
+
+	printf ("{\"scenario\":\"echo\",\"transport\":\"%s\",\"size\":%d,\"iterations\":%ld,\"mean_us\":%.1f,"
+		"\"p50_us\":%ld,\"p90_us\":%ld,\"p99_us\":%ld,\"p999_us\":%ld,\"max_us\":%ld}\n",
+		bench_transport (tls), size, hist.count, (double) hist.sum / hist.count,
+		nopoll_histogram_percentile (&hist, 50), nopoll_histogram_percentile (&hist, 90),
+		nopoll_histogram_percentile (&hist, 99), nopoll_histogram_percentile (&hist, 99.9),
+		hist.max);
+	fflush (stdout);
+
+	nopoll_conn_close (conn);
+	return nopoll_true;
+}
+
+/* one way throughput: client to server frames are masked, server to
+ * client frames are not */
+nopoll_bool bench_throughput (nopoll_bool tls, long size, nopoll_bool masked)
+{
+	noPollConn * conn;
+	noPollMsg  * msg;
+	char         request[100];
+	long         count;
+	long         total;
+	long         received = 0;
+	long         iterator;
+	double       start;
+	double       elapsed;
+
+	/* same amount of bytes for every size */
+	count = (bench_quick ? 4 * 1024 * 1024 : 64 * 1024 * 1024) / size;
+	if (count < 4)
+		count = 4;
+	if (count > (bench_quick ? 5000 : 100000))
+		count = bench_quick ? 5000 : 100000;
+	total = count * size;
+
+	conn = bench_connect (tls);
+	if (conn == NULL)
+		return nopoll_false;
+
+	start = bench_now ();
+	if (masked) {
+		sprintf (request, "expect %ld", total);
+		if (! bench_send (conn, NOPOLL_TEXT_FRAME, request, strlen (request)))
+			return nopoll_false;
+		for (iterator = 0; iterator < count; iterator++) {
+			if (! bench_send (conn, NOPOLL_BINARY_FRAME, bench_payload, size))
+				return nopoll_false;
+		} /* end for */
+
+		/* wait for the listener to confirm */
+		msg = bench_get_msg (conn, 60000000);
+		if (msg == NULL) {
+			fprintf (stderr, "ERROR: throughput confirmation not received\n");
+			return nopoll_false;
+		} /* end if */
+		nopoll_msg_unref (msg);
+	} else {
+		sprintf (request, "send %ld %ld", size, count);
+		if (! bench_send (conn, NOPOLL_TEXT_FRAME, request, strlen (request)))
+			return nopoll_false;
+		while (received < total) {
+			msg = bench_get_msg (conn, 60000000);
+			if (msg == NULL) {
+				fprintf (stderr, "ERROR: throughput content not received (%ld of %ld)\n", received, total);
+				return nopoll_false;
+			} /* end if */
+			received += nopoll_msg_get_payload_size (msg);
+			nopoll_msg_unref (msg);
+		} /* end while */
+	} /* end if */
+	elapsed = bench_now () - start;
+
+	printf ("{\"scenario\":\"throughput\",\"transport\":\"%s\",\"direction\":\"%s\",\"masked\":%s,\"size\":%ld,"
+		"\"messages\":%ld,\"seconds\":%.6f,\"msgs_per_sec\":%.1f,\"mbytes_per_sec\":%.2f}\n",
+		bench_transport (tls), masked ? "client_to_server" : "server_to_client", masked ? "true" : "false", size,
+		count, elapsed, count / elapsed, (total / elapsed) / (1024 * 1024));
+	fflush (stdout);
+
+	nopoll_conn_close (conn);
+	return nopoll_true;
+}
+
+/* one message sent by the listener to N connections */
+nopoll_bool bench_fanout (nopoll_bool tls, int conns_count, long size)
+{
+	noPollConn * conns[BENCH_MAX_CONNS];
+	long         received[BENCH_MAX_CONNS];
+	noPollMsg  * msg;
+	char         request[100];
+	long         count = bench_quick ? 100 : 1000;
+	long         total = count * size;
+	int          iterator;
+	int          pending;
+	double       start;
+	double       elapsed;
+	fd_set       set;
+	struct timeval tv;
+	NOPOLL_SOCKET  max_fd;
+
+	for (iterator = 0; iterator < conns_count; iterator++) {
+		conns[iterator] = bench_connect (tls);
+		if (conns[iterator] == NULL)
+			return nopoll_false;
+		received[iterator] = 0;
+	} /* end for */
+
+	start = bench_now ();
+	sprintf (request, "fanout %ld %ld", size, count);
+	if (! bench_send (conns[0], NOPOLL_TEXT_FRAME, request, strlen (request)))
+		return nopoll_false;
+
+	pending = conns_count;
+	while (pending > 0) {
+		/* wait for any of the connections */
+		FD_ZERO (&set);
+		max_fd = 0;
+		for (iterator = 0; iterator < conns_count; iterator++) {
+			FD_SET (nopoll_conn_socket (conns[iterator]), &set);
+			if (nopoll_conn_socket (conns[iterator]) > max_fd)
+				max_fd = nopoll_conn_socket (conns[iterator]);
+		} /* end for */
+		tv.tv_sec  = 0;
+		tv.tv_usec = 10000;
+		select (max_fd + 1, &set, NULL, NULL, &tv);
+
+		for (iterator = 0; iterator < conns_count; iterator++) {
+			while (received[iterator] < total && (msg = nopoll_conn_get_msg (conns[iterator])) != NULL) {
+				received[iterator] += nopoll_msg_get_payload_size (msg);
+				nopoll_msg_unref (msg);
+				if (received[iterator] >= total)
+					pending--;
+			} /* end while */
+		} /* end for */
+
+		if (bench_now () - start > 60) {
+			fprintf (stderr, "ERROR: fan-out content not received\n");
+			return nopoll_false;
+		} /* end if */
+	} /* end while */
+	elapsed = bench_now () - start;
+
+	printf ("{\"scenario\":\"fanout\",\"transport\":\"%s\",\"connections\":%d,\"size\":%ld,\"messages\":%ld,"
+		"\"seconds\":%.6f,\"msgs_per_sec\":%.1f,\"mbytes_per_sec\":%.2f}\n",
+		bench_transport (tls), conns_count, size, count * conns_count, elapsed,
+		(count * conns_count) / elapsed, ((double) total * conns_count / elapsed) / (1024 * 1024));
+	fflush (stdout);
+
+	for (iterator = 0; iterator < conns_count; iterator++)
+		nopoll_conn_close (conns[iterator]);
+	return nopoll_true;
+}
+
+/* connections opened (handshake completed) and closed one after
+ * another */
+nopoll_bool bench_handshake (nopoll_bool tls)
+{
+	noPollConn      * conn;
+	noPollHistogram   hist;
+	int               count = tls ? (bench_quick ? 20 : 200) : (bench_quick ? 100 : 1000);
+	int               iterator;
+	double            start;
+	double            conn_start;
+	double            elapsed;
+
+	nopoll_histogram_reset (&hist);
+	start = bench_now ();
+	for (iterator = 0; iterator < count; iterator++) {
+		conn_start = bench_now ();
+		conn = bench_connect (tls);
+		if (conn == NULL)
+			return nopoll_false;
+		nopoll_histogram_record (&hist, (long) ((bench_now () - conn_start) * 1000000));
+		nopoll_conn_close (conn);
+	} /* end for */
+	elapsed = bench_now () - start;
+
+	printf ("{\"scenario\":\"handshake\",\"transport\":\"%s\",\"connections\":%d,\"seconds\":%.6f,"
+		"\"per_sec\":%.1f,\"p50_us\":%ld,\"p99_us\":%ld,\"max_us\":%ld}\n",
+		bench_transport (tls), count, elapsed, count / elapsed,
+		nopoll_histogram_percentile (&hist, 50), nopoll_histogram_percentile (&hist, 99), hist.max);
+	fflush (stdout);
+	return nopoll_true;
+}
+
+int main (int argc, char ** argv)
+{
+	pthread_t   thread;
+	int         iterator;
+	int         tls;
+	long        size;
+	int         fanout[3] = {1, 16, 64};
+	nopoll_bool result = nopoll_true;
+
+	if (! regtest_configure_port_offset (argc, argv))
+		return -1;
+	iterator = 1;
+	while (iterator < argc) {
+		if (nopoll_cmp (argv[iterator], "--quick"))
+			bench_quick = nopoll_true;
+		else if (nopoll_cmp (argv[iterator], "--scenario") && (iterator + 1) < argc)
+			bench_scenario = argv[++iterator];
+		iterator++;
+	} /* end while */
+
+	/* peers closing while content is written must not kill the
+	 * benchmark */
+	signal (SIGPIPE, SIG_IGN);
+
+	nopoll_thread_handlers (__nopoll_regtest_mutex_create,
+				__nopoll_regtest_mutex_destroy,
+				__nopoll_regtest_mutex_lock,
+				__nopoll_regtest_mutex_unlock);
+
+	/* same content on every run */
+	bench_payload = nopoll_new (char, BENCH_MAX_SIZE);
+	if (bench_payload == NULL)
+		return -1;
+	for (iterator = 0; iterator < BENCH_MAX_SIZE; iterator++)
+		bench_payload[iterator] = 'a' + (iterator % 26);
+
+	if (! bench_server_start (&thread))
+		return -1;
+	bench_ctx = nopoll_ctx_new ();
+	nopoll_ctx_set_max_frame_size (bench_ctx, BENCH_MAX_SIZE + 1024);
+
+	printf ("{\"benchmark\":\"nopoll\",\"version\":\"%s\",\"quick\":%s}\n", VERSION, bench_quick ? "true" : "false");
+	fflush (stdout);
+
+	for (tls = 0; tls < 2 && result; tls++) {
+		fprintf (stderr, "Running %s scenarios..\n", bench_transport (tls));
+		if (bench_enabled ("echo")) {
+			result = result && bench_echo (tls, 64);
+			result = result && bench_echo (tls, 1024);
+		} /* end if */
+		if (bench_enabled ("throughput")) {
+			for (size = 16; size <= BENCH_MAX_SIZE && result; size *= 16) {
+				result = result && bench_throughput (tls, size, nopoll_true);
+				result = result && bench_throughput (tls, size, nopoll_false);
+			} /* end for */
+		} /* end if */
+		if (bench_enabled ("fanout")) {
+			for (iterator = 0; iterator < 3 && result; iterator++)
+				result = bench_fanout (tls, fanout[iterator], 1024);
+		} /* end if */
+		if (bench_enabled ("handshake"))
+			result = result && bench_handshake (tls);
+	} /* end for */
+
+	nopoll_loop_stop (bench_server);
+	pthread_join (thread, NULL);
+	nopoll_ctx_unref (bench_ctx);
+	nopoll_ctx_unref (bench_server);
+	nopoll_free (bench_payload);
+	nopoll_cleanup_library ();
+
+	if (! result) {
+		fprintf (stderr, "ERROR: benchmark failed\n");
+		return -1;
+	} /* end if */
+	return 0;
+}
@@ -2258,6 +2258,9 @@ nopoll_bool test_21 (void) {
 	/* call to create a connection */
 	printf ("Test 21: check ssl connection (with auth certificate)..\n");
 	conn = nopoll_conn_tls_new (ctx, NULL, "localhost", regtest_port (1239), NULL, NULL, NULL, NULL);
+
+	/* the TLS handshake doesn't block: it fails while waiting */
+	nopoll_conn_wait_until_connection_ready (conn, 5);
 	if (nopoll_conn_is_ok (conn)) {
 		printf ("ERROR: Expected to FAILURE client connection status, but ok..\n");
 		return nopoll_false;
@@ -4225,240 +4228,2761 @@ nopoll_bool test_48 (void) {
 	return nopoll_true;
 }
 
-int main (int argc, char ** argv)
+int test_49_resolver (noPollCtx * ctx, noPollTransport transport, const char * host, const char * port, struct addrinfo ** result, noPollPtr user_data)
 {
-	int iterator;
-
-	printf ("** NoPoll: Websocket toolkit (regression test).\n");
-	printf ("** Copyright (C) 2025 Advanced Software Production Line, S.L.\n**\n");
-	printf ("** NoPoll regression tests: version=%s\n**\n",
-		VERSION);
-	printf ("** To gather information about time performance you can use:\n**\n");
-	printf ("**     >> time ./nopoll-regression-client [--debug,--show-critical-only,--offset-port <value>]\n**\n");
-	printf ("** Use --offset-port to add the value provided to every port used by the test,\n");
-	printf ("** so a complete run (listener and client) can be started without colliding with\n");
-	printf ("** another run already in progress. The same value must be provided to\n");
-	printf ("** ./nopoll-regression-listener\n**\n");
-	printf ("** To gather information about memory consumed (and leaks) use:\n**\n");
-	printf ("**     >> libtool --mode=execute valgrind --leak-check=yes --error-limit=no ./nopoll-regression-client\n**\n");
-	printf ("**\n");
-	printf ("** Report bugs to:\n**\n");
-	printf ("**     <nopoll@lists.aspl.es> noPoll mailing list\n**\n");
-	printf ("**     <info@aspl.es> ASPL's contact \n**\n");
+	struct addrinfo hints;
+	int           * calls = (int *) user_data;
 
-	/* configure port offset before anything else: every port used
-	 * by the tests is derived from it */
-	if (! regtest_configure_port_offset (argc, argv))
-		return -1;
+	(*calls)++;
 
-	iterator = 1;
-	while (iterator < argc) {
-		/* check for debug */
-		printf ("Checking agument: %s\n", argv[iterator]);
-		if (nopoll_cmp (argv[iterator], "--debug")) {
-			printf ("Activating debug..\n");
-			debug = nopoll_true;
-		} /* end if */
-		if (nopoll_cmp (argv[iterator], "--show-critical-only")) {
-			printf ("Activating reporting of critical messages..\n");
-			show_critical_only = nopoll_true;
-		} /* end if */
+	memset (&hints, 0, sizeof (struct addrinfo));
+	hints.ai_family   = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	return getaddrinfo (host, port, &hints, result);
+}
 
-		/* next position */
-		iterator++;
-	}
+int test_49_slow_resolver (noPollCtx * ctx, noPollTransport transport, const char * host, const char * port, struct addrinfo ** result, noPollPtr user_data)
+{
+	/* a slow DNS server */
+	nopoll_sleep (300000);
+	return test_49_resolver (ctx, transport, host, port, result, user_data);
+}
 
-#if defined(__NOPOLL_PTHREAD_SUPPORT__)	
-	printf ("INFO: install default threading functions to check noPoll locking code..\n");
-	nopoll_thread_handlers (__nopoll_regtest_mutex_create,
-				__nopoll_regtest_mutex_destroy,
-				__nopoll_regtest_mutex_lock,
-				__nopoll_regtest_mutex_unlock);
-#endif
+nopoll_bool test_49_connect (noPollCtx * ctx, const char * host)
+{
+	noPollConn * conn;
+	nopoll_bool  result;
 
-	printf ("INFO: starting tests with pid: %d\n", getpid ());
-	if (test_01_strings ()) {
-		printf ("Test 01-strings: Library strings support [   OK   ]\n");
-	}else {
-		printf ("Test 01-strings: Library strings support [ FAILED ]\n");
-		return -1;
-	}
+	conn   = nopoll_conn_new (ctx, host, regtest_port (1234), NULL, NULL, NULL, NULL);
+	result = nopoll_conn_wait_until_connection_ready (conn, 5);
+	nopoll_conn_close (conn);
 
-	if (test_01_base64 ()) {
-		printf ("Test 01-base64: Library base64 support [   OK   ]\n");
-	}else {
-		printf ("Test 01-base64: Library base64 support [ FAILED ]\n");
-		return -1;
-	}
+	return result;
+}
 
-	if (test_01_support ()) {
-		printf ("Test 01-support: library support functions [   OK   ]\n");
-	}else {
-		printf ("Test 01-support: library support functions [ FAILED ]\n");
-		return -1;
-	}
+nopoll_bool test_49 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	struct addrinfo * res;
+	int               calls = 0;
 
-	if (test_01_masking ()) {
-		printf ("Test 01-masking: Library websocket content masking support [   OK   ]\n");
-	}else {
-		printf ("Test 01-masking: Library websocket content masking support [ FAILED ]\n");
-		return -1;
-	}
+	printf ("Test 49: checking pluggable resolver and resolver cache..\n");
 
-	if (test_01 ()) {	
-		printf ("Test 01: Simple connect and disconnect [   OK   ]\n");
-	}else {
-		printf ("Test 01: Simple connect and disconnect [ FAILED ]\n");
-		return -1;
-	}
+	ctx = create_ctx ();
 
-	if (test_02 ()) {	
-		printf ("Test 02: Simple request/reply [   OK   ]\n");
-	}else {
-		printf ("Test 02: Simple request/reply [ FAILED ]\n");
-		return -1;
-	}
+	/* install a resolver that counts how many times it is called */
+	nopoll_ctx_set_resolver (ctx, test_49_resolver, &calls);
 
-	if (test_02a ()) {	
-		printf ("Test 02a: Simple request/reply (IPv6) [   OK   ]\n");
-	}else {
-		printf ("Test 02a: Simple request/reply (IPv6) [ FAILED ]\n");
-		return -1;
-	}
+	/* without cache, every connection resolves */
+	if (! test_49_connect (ctx, "localhost") || ! test_49_connect (ctx, "localhost")) {
+		printf ("ERROR: expected to connect through the custom resolver..\n");
+		return nopoll_false;
+	} /* end if */
+	if (calls != 2) {
+		printf ("ERROR: expected 2 calls to the resolver without cache, but found %d..\n", calls);
+		return nopoll_false;
+	} /* end if */
 
-	/* test sending ping */
-	if (test_02b ()) {	
-		printf ("Test 02b: test sending ping [   OK   ]\n");
-	}else {
-		printf ("Test 02a: test sending ping [ FAILED ]\n");
-		return -1;
-	}
+	/* enable cache: only the first connection resolves */
+	calls = 0;
+	nopoll_ctx_set_resolver_cache_ttl (ctx, 60);
+	if (! test_49_connect (ctx, "localhost") || ! test_49_connect (ctx, "localhost")) {
+		printf ("ERROR: expected to connect through the resolver cache..\n");
+		return nopoll_false;
+	} /* end if */
+	if (calls != 1 || ctx->resolver_cache_length != 1) {
+		printf ("ERROR: expected 1 call to the resolver with cache (and 1 entry), but found %d (entries %d)..\n",
+			calls, ctx->resolver_cache_length);
+		return nopoll_false;
+	} /* end if */
 
-	/* test sending pong (without ping) */
+	/* flush: next connection resolves again */
+	nopoll_ctx_flush_resolver_cache (ctx);
+	if (ctx->resolver_cache_length != 0 || ! test_49_connect (ctx, "localhost") || calls != 2) {
+		printf ("ERROR: expected to resolve again after flushing the cache (calls %d)..\n", calls);
+		return nopoll_false;
+	} /* end if */
 
-	/* test streaming api */
-	if (test_03 ()) {	
-		printf ("Test 03: test streaming api [   OK   ]\n");
-	}else {
-		printf ("Test 03: test streaming api [ FAILED ]\n");
-		return -1;
-	}
+	/* bounded cache: only the newest entry is kept */
+	nopoll_ctx_set_resolver_cache_max_entries (ctx, 1);
+	res = __nopoll_ctx_resolve (ctx, NOPOLL_TRANSPORT_IPV4, "127.0.0.1", "80");
+	__nopoll_ctx_resolve_release (res);
+	if (ctx->resolver_cache_length != 1 || ! nopoll_cmp (ctx->resolver_cache->host, "127.0.0.1")) {
+		printf ("ERROR: expected resolver cache limited to 1 entry, but found %d..\n", ctx->resolver_cache_length);
+		return nopoll_false;
+	} /* end if */
+	nopoll_ctx_set_resolver_cache_max_entries (ctx, NOPOLL_RESOLVER_CACHE_MAX_ENTRIES);
 
-	if (test_04 (1024)) {	
-		printf ("Test 04: test streaming api (II) [   OK   ]\n");
-	}else {
-		printf ("Test 04: test streaming api (II) [ FAILED ]\n");
-		return -1;
-	}
+	/* built-in resolver restricted to the hosts file */
+	nopoll_ctx_set_resolver (ctx, NULL, NULL);
+	nopoll_ctx_set_resolver_mode (ctx, NOPOLL_RESOLVER_HOSTS_ONLY);
+	res = __nopoll_ctx_resolve (ctx, NOPOLL_TRANSPORT_IPV4, "127.0.0.1", "80");
+	if (res == NULL || res->ai_family != AF_INET) {
+		printf ("ERROR: expected to resolve numeric address without lookup..\n");
+		return nopoll_false;
+	} /* end if */
+	__nopoll_ctx_resolve_release (res);
 
-	if (test_04 (512)) {	
-		printf ("Test 04-a: test streaming api (III) [   OK   ]\n");
-	}else {
-		printf ("Test 04-a: test streaming api (III) [ FAILED ]\n");
-		return -1;
-	}
+	res = __nopoll_ctx_resolve (ctx, NOPOLL_TRANSPORT_IPV4, "this-name-does-not-exist.nopoll.invalid", "80");
+	if (res != NULL) {
+		printf ("ERROR: expected to fail resolving a name not declared in the hosts file..\n");
+		return nopoll_false;
+	} /* end if */
 
-	if (test_04 (137)) {	
-		printf ("Test 04-b: test streaming api (IV) [   OK   ]\n");
-	}else {
-		printf ("Test 04-b: test streaming api (IV) [ FAILED ]\n");
-		return -1;
-	}
+	if (! test_49_connect (ctx, "localhost")) {
+		printf ("ERROR: expected to connect to localhost using the hosts file..\n");
+		return nopoll_false;
+	} /* end if */
 
-	if (test_04 (17)) {	
-		printf ("Test 04-c: test streaming api (V) [   OK   ]\n");
-	}else {
-		printf ("Test 04-c: test streaming api (V) [ FAILED ]\n");
-		return -1;
-	}
+	/* the hosts file is loaded once (and answered from memory) */
+	if (ctx->hosts == NULL || ctx->hosts_mtime <= 0) {
+		printf ("ERROR: expected hosts file entries to be kept by the context..\n");
+		return nopoll_false;
+	} /* end if */
 
-	if (test_04a ()) {
-		printf ("Test 04-a: check non-blocking streaming and message based API  [   OK   ]\n");
-	} else {
-		printf ("Test 04-a: check non-blocking streaming and message based API [ FAILED ]\n");
-		return -1;
-	}
+	/* slow resolvers run on a worker: the connection is reported
+	 * while it is dialing */
+	calls = 0;
+	nopoll_ctx_set_resolver_mode (ctx, NOPOLL_RESOLVER_SYSTEM);
+	nopoll_ctx_set_resolver_cache_ttl (ctx, 0);
+	nopoll_ctx_set_resolver (ctx, test_49_slow_resolver, &calls);
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_is_ok (conn) || ! conn->dialing) {
+		printf ("ERROR: expected connection to be dialing while the resolver runs..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || calls != 1) {
+		printf ("ERROR: expected to connect once the resolver finished (calls %d)..\n", calls);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
 
-	if (test_04b ()) {
-		printf ("Test 04-b: try to overflow write access and recover from it  [   OK   ]\n");
-	} else {
-		printf ("Test 04-b: try to overflow write access and recover from it [ FAILED ]\n");
-		return -1;
-	}
+	/* names that can't be resolved close the connection */
+	conn = nopoll_conn_new (ctx, "this-name-does-not-exist.nopoll.invalid", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected connection to fail when its name can't be resolved..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
 
-	if (test_04c ()) {
-		printf ("Test 04-c: send a file and try to overflow (but retry)  [   OK   ]\n");
-	} else {
-		printf ("Test 04-c: send a file and try to overflow (but retry) [ FAILED ]\n");
-		return -1;
-	}
+	nopoll_ctx_unref (ctx);
 
-	if (test_05 ()) {
-		printf ("Test 05: sending utf-8 content [   OK   ]\n");
-	} else {
-		printf ("Test 05: sending utf-8 content [ FAILED ]\n");
-		return -1;
-	}
+	return nopoll_true;
+}
 
-	if (test_06 ()) {
-		printf ("Test 06: testing basic TLS connect [   OK   ]\n");
-	} else {
-		printf ("Test 06: testing basic TLS connect [ FAILED ]\n");
-		return -1;
-	}
+int test_50_resolver (noPollCtx * ctx, noPollTransport transport, const char * host, const char * port, struct addrinfo ** result, noPollPtr user_data)
+{
+	struct addrinfo   hints;
+	int             * families = (int *) user_data;
 
-	if (test_06a ()) {
-		printf ("Test 06a: testing basic TLS connect (IPv6) [   OK   ]\n");
-	} else {
-		printf ("Test 06a: testing basic TLS connect (IPv6) [ FAILED ]\n");
-		return -1;
-	}
+	memset (&hints, 0, sizeof (struct addrinfo));
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags    = AI_NUMERICHOST;
 
-	if (test_07 ()) {
-		printf ("Test 07: testing TLS request/reply [   OK   ]\n");
-	} else {
-		printf ("Test 07: testing TLS request/reply [ FAILED ]\n");
-		return -1;
-	}
+	if (transport == NOPOLL_TRANSPORT_IPV6) {
+		/* broken family: nothing listens there */
+		families[0]++;
+		hints.ai_family = AF_INET6;
+		return getaddrinfo ("::1", "1", &hints, result);
+	} /* end if */
 
-	if (test_08 ()) {
-		printf ("Test 08: test normal connect to TLS port [   OK   ]\n");
-	} else {
-		printf ("Test 08: test normal connect to TLS port [ FAILED ]\n");
-		return -1;
-	}
+	families[1]++;
+	hints.ai_family = AF_INET;
+	return getaddrinfo ("127.0.0.1", families[2] ? "1" : port, &hints, result);
+}
 
-	if (test_09 ()) {
-		printf ("Test 09: ensure we only support Sec-WebSocket-Version: 13 [   OK   ]\n");
-	} else {
-		printf ("Test 09: ensure we only support Sec-WebSocket-Version: 13 [ FAILED ]\n");
-		return -1;
-	}
+int test_50_slow_resolver (noPollCtx * ctx, noPollTransport transport, const char * host, const char * port, struct addrinfo ** result, noPollPtr user_data)
+{
+	/* a broken AAAA lookup that takes its time */
+	if (transport == NOPOLL_TRANSPORT_IPV6)
+		nopoll_sleep (2000000);
+	return test_50_resolver (ctx, transport, host, port, result, user_data);
+}
 
-	if (test_10 ()) {
-		printf ("Test 10: test checking origing in on open and denying it [   OK   ]\n");
-	} else {
-		printf ("Test 10: test checking origing in on open and denying it [ FAILED ]\n");
-		return -1;
-	}
+nopoll_bool test_50 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	int               families[3] = {0, 0, 0};
+	struct timeval    start;
+	struct timeval    stop;
+	struct timeval    diff;
 
-	if (test_11 ()) {
-		printf ("Test 11: release context after connection [   OK   ]\n");
-	} else {
-		printf ("Test 11: release context after connection [ FAILED ]\n");
-		return -1;
-	}
+	printf ("Test 50: checking dual stack (happy eyeballs) connect..\n");
 
-	if (test_12 ()) {
-		printf ("Test 12: create huge amount of connections in a short time [   OK   ]\n");
-	} else {
-		printf ("Test 12: create huge amount of connections in a short time [ FAILED ]\n");
-		return -1;
-	}
+	ctx = create_ctx ();
+	nopoll_ctx_set_resolver (ctx, test_50_resolver, families);
 
-	if (test_13 ()) {
-		printf ("Test 13: testing certificate storage [   OK    ]\n");
-	} else {
+	/* IPv6 candidate is tried first and fails, IPv4 one must
+	 * win */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_happy_eyeballs (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect using the IPv4 candidate..\n");
+		return nopoll_false;
+	} /* end if */
+	if (families[0] != 1 || families[1] != 1) {
+		printf ("ERROR: expected both families to be resolved once, but found IPv6=%d, IPv4=%d..\n", families[0], families[1]);
+		return nopoll_false;
+	} /* end if */
+
+	/* check the connection works */
+	if (nopoll_conn_send_text (conn, "happy eyeballs", 14) != 14) {
+		printf ("ERROR: expected to send content over the connection..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	/* every candidate broken: the connection must fail */
+	families[2] = 1;
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_happy_eyeballs (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (conn == NULL) {
+		printf ("ERROR: expected to get the connection being dialed..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected to fail connecting when every candidate is broken..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+
+	/* a slow AAAA lookup must not delay the IPv4 candidate (nor
+	 * the caller creating the connection) */
+	families[2] = 0;
+	ctx  = create_ctx ();
+	nopoll_ctx_set_resolver (ctx, test_50_slow_resolver, families);
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_happy_eyeballs (opts, nopoll_true);
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&start, NULL);
+#else
+	gettimeofday (&start, NULL);
+#endif
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect using the IPv4 candidate while the AAAA lookup runs..\n");
+		return nopoll_false;
+	} /* end if */
+#if defined(NOPOLL_OS_WIN32)
+	nopoll_win32_gettimeofday (&stop, NULL);
+#else
+	gettimeofday (&stop, NULL);
+#endif
+	nopoll_timeval_substract (&stop, &start, &diff);
+	if (diff.tv_sec >= 1) {
+		printf ("ERROR: expected the slow AAAA lookup not to delay the connection, but it took %ld.%06ld..\n",
+			(long) diff.tv_sec, (long) diff.tv_usec);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	nopoll_ctx_unref (ctx);
+
+	return nopoll_true;
+}
+
+nopoll_bool test_51 (void) {
+	noPollCtx       * ctx;
+	noPollConnPool  * pool;
+	noPollConnPool  * pool2;
+	noPollConn      * conn;
+	noPollMsg       * msg;
+	int               iterator;
+
+	printf ("Test 51: checking client connection pool..\n");
+
+	ctx = create_ctx ();
+
+	/* create a pool with two connections */
+	pool = nopoll_conn_pool_new (ctx, NULL, nopoll_false, 2, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (pool == NULL) {
+		printf ("ERROR: expected to create the connection pool..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* asking again for the same endpoint must return the same pool */
+	pool2 = nopoll_conn_pool_new (ctx, NULL, nopoll_false, 2, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (pool2 != pool) {
+		printf ("ERROR: expected to get the same pool for the same endpoint, but found %p != %p..\n", pool, pool2);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_pool_unref (pool2);
+
+	/* wait connections to be ready */
+	iterator = 0;
+	while (nopoll_conn_pool_ready (pool) < 2 && iterator < 100) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (nopoll_conn_pool_ready (pool) != 2) {
+		printf ("ERROR: expected to find 2 connections ready, but found %d..\n", nopoll_conn_pool_ready (pool));
+		return nopoll_false;
+	} /* end if */
+
+	/* get a connection and use it */
+	conn = nopoll_conn_pool_get (pool);
+	if (! nopoll_conn_is_ready (conn)) {
+		printf ("ERROR: expected to get a ready connection from the pool..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text (conn, "pooled message", 14) != 14) {
+		printf ("ERROR: expected to send content over the pooled connection..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && iterator < 100) {
+		if (! nopoll_conn_is_ok (conn)) {
+			printf ("ERROR: received websocket connection close during wait reply..\n");
+			return nopoll_false;
+		} /* end if */
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (msg == NULL || ! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "pooled message")) {
+		printf ("ERROR: expected to receive the echo over the pooled connection..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+
+	/* the pool must have dialed a replacement */
+	iterator = 0;
+	while (nopoll_conn_pool_ready (pool) < 2 && iterator < 100) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (nopoll_conn_pool_ready (pool) != 2 || nopoll_ctx_conns (ctx) != 3) {
+		printf ("ERROR: expected the pool to be refilled, but found %d connections ready (%d registered)..\n",
+			nopoll_conn_pool_ready (pool), nopoll_ctx_conns (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* there is no room to keep the connection */
+	if (nopoll_conn_pool_release (pool, conn)) {
+		printf ("ERROR: expected the connection to be closed (pool is full)..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* release the pool (closes its connections) */
+	nopoll_conn_pool_unref (pool);
+	if (nopoll_ctx_conns (ctx) != 0) {
+		printf ("ERROR: expected to find no connections after releasing the pool, but found %d..\n", nopoll_ctx_conns (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* IPv6 pool refilled one dial at a time */
+	pool = nopoll_conn_pool_new6 (ctx, NULL, nopoll_false, 3, "::1", regtest_port (2234), NULL, NULL, NULL, NULL);
+	if (pool == NULL) {
+		printf ("ERROR: expected to create the IPv6 connection pool..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_pool_set_max_dials (pool, 1);
+	iterator = 0;
+	while (nopoll_conn_pool_ready (pool) < 3 && iterator < 300) {
+		nopoll_conn_pool_refill (pool);
+		if (nopoll_ctx_conns (ctx) - nopoll_conn_pool_ready (pool) > 2) {
+			printf ("ERROR: expected at most 2 connections dialing, but found %d..\n",
+				nopoll_ctx_conns (ctx) - nopoll_conn_pool_ready (pool));
+			return nopoll_false;
+		} /* end if */
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (nopoll_conn_pool_ready (pool) != 3) {
+		printf ("ERROR: expected to find 3 IPv6 connections ready, but found %d..\n", nopoll_conn_pool_ready (pool));
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_pool_unref (pool);
+
+	nopoll_ctx_unref (ctx);
+
+	return nopoll_true;
+}
+
+void test_52_timer (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+{
+	int * fired = (int *) user_data;
+
+	/* record order */
+	fired[fired[0] + 1] = timer_id;
+	fired[0]++;
+
+	return;
+}
+
+void test_52_stop (noPollCtx * ctx, int timer_id, noPollPtr user_data)
+{
+	nopoll_loop_stop (ctx);
+	return;
+}
+
+nopoll_bool test_52 (void) {
+	noPollCtx       * ctx;
+	int               fired[10];
+	int               first, second, third;
+	int               iterator;
+	struct timeval    start;
+	struct timeval    stop;
+	struct timeval    diff;
+
+	printf ("Test 52: checking timers..\n");
+
+	ctx = create_ctx ();
+	memset (fired, 0, sizeof (fired));
+
+	/* install timers (not in expiration order) */
+	second = nopoll_timer_add (ctx, 60000, test_52_timer, fired);
+	first  = nopoll_timer_add (ctx, 10000, test_52_timer, fired);
+	third  = nopoll_timer_add (ctx, 100000, test_52_timer, fired);
+	if (first <= 0 || second <= 0 || third <= 0 || nopoll_timer_count (ctx) != 3) {
+		printf ("ERROR: expected to install 3 timers..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* cancel one */
+	if (! nopoll_timer_cancel (ctx, third) || nopoll_timer_cancel (ctx, third)) {
+		printf ("ERROR: expected to cancel the timer just once..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* stop the loop with a timer: the loop must not wait more than required */
+	nopoll_timer_add (ctx, 150000, test_52_stop, NULL);
+	gettimeofday (&start, NULL);
+	nopoll_loop_wait (ctx, 0);
+	gettimeofday (&stop, NULL);
+	nopoll_timeval_substract (&stop, &start, &diff);
+
+	if (fired[0] != 2 || fired[1] != first || fired[2] != second) {
+		printf ("ERROR: expected timers %d and %d to fire in order, but found %d fired (%d, %d)..\n",
+			first, second, fired[0], fired[1], fired[2]);
+		return nopoll_false;
+	} /* end if */
+	if (diff.tv_sec != 0 || diff.tv_usec < 140000 || diff.tv_usec > 400000) {
+		printf ("ERROR: expected the loop to be stopped by the timer after 150ms, but it took %ld.%06ld..\n",
+			(long) diff.tv_sec, (long) diff.tv_usec);
+		return nopoll_false;
+	} /* end if */
+
+	/* install and cancel lots of timers spread over the wheel
+	 * levels */
+	for (iterator = 0; iterator < 100000; iterator++) {
+		if (nopoll_timer_add (ctx, (long) iterator * 100000, test_52_timer, fired) <= 0) {
+			printf ("ERROR: failed to install timer %d..\n", iterator);
+			return nopoll_false;
+		} /* end if */
+	} /* end for */
+	first = nopoll_timer_add (ctx, 5000, test_52_timer, fired);
+	for (iterator = first - 100000; iterator < first; iterator++) {
+		if (! nopoll_timer_cancel (ctx, iterator)) {
+			printf ("ERROR: failed to cancel timer %d..\n", iterator);
+			return nopoll_false;
+		} /* end if */
+	} /* end for */
+	if (nopoll_timer_count (ctx) != 1) {
+		printf ("ERROR: expected to find 1 timer, but found %d..\n", nopoll_timer_count (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* the loop must return close to its timeout running the timer */
+	gettimeofday (&start, NULL);
+	if (nopoll_loop_wait (ctx, 50000) != -3) {
+		printf ("ERROR: expected loop timeout..\n");
+		return nopoll_false;
+	} /* end if */
+	gettimeofday (&stop, NULL);
+	nopoll_timeval_substract (&stop, &start, &diff);
+	if (fired[0] != 3 || fired[3] != first || nopoll_timer_count (ctx) != 0) {
+		printf ("ERROR: expected timer %d to fire, but found %d fired..\n", first, fired[0]);
+		return nopoll_false;
+	} /* end if */
+	if (diff.tv_sec != 0 || diff.tv_usec > 300000) {
+		printf ("ERROR: expected the loop to return after 50ms, but it took %ld.%06ld..\n",
+			(long) diff.tv_sec, (long) diff.tv_usec);
+		return nopoll_false;
+	} /* end if */
+
+	/* pending timers are released with the context */
+	nopoll_timer_add (ctx, 1000000, test_52_timer, fired);
+	nopoll_ctx_unref (ctx);
+
+	return nopoll_true;
+}
+
+nopoll_bool test_53_closed = nopoll_false;
+
+void test_53_on_close (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	test_53_closed = nopoll_true;
+	return;
+}
+
+nopoll_bool test_53 (void) {
+	noPollCtx       * ctx;
+	noPollCtx       * ctx2;
+	noPollConn      * conn;
+	noPollConn      * master;
+	noPollConn      * listener;
+	int               iterator;
+
+	printf ("Test 53: checking keepalive pings..\n");
+
+	ctx = create_ctx ();
+	nopoll_ctx_set_keepalive (ctx, 100000, 200000, 0);
+
+	/* connect to the echo listener (replies PONG) */
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_get_rtt (conn) != -1) {
+		printf ("ERROR: expected no round trip time before the first keepalive..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* idle connection is pinged and PONG measured */
+	nopoll_loop_wait (ctx, 400000);
+	if (! nopoll_conn_is_ok (conn) || nopoll_conn_get_rtt (conn) <= 0) {
+		printf ("ERROR: expected connection to be working with rtt measured, but found ok=%d, rtt=%ld..\n",
+			nopoll_conn_is_ok (conn), nopoll_conn_get_rtt (conn));
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 53: keepalive rtt=%ld microseconds\n", nopoll_conn_get_rtt (conn));
+	nopoll_conn_close (conn);
+
+	/* a peer that does not reply PONG (its context is not
+	 * looped) must be closed */
+	ctx2   = create_ctx ();
+	master = nopoll_listener_new (ctx2, "0.0.0.0", regtest_port (22353));
+	if (! nopoll_conn_is_ok (master)) {
+		printf ("ERROR: expected to create the listener..\n");
+		return nopoll_false;
+	} /* end if */
+
+	conn     = nopoll_conn_new (ctx, "localhost", regtest_port (22353), NULL, NULL, NULL, NULL);
+	listener = nopoll_conn_accept (ctx2, master);
+
+	/* complete handshake on both sides */
+	iterator = 0;
+	while (! nopoll_conn_is_ready (conn) && iterator < 500) {
+		/* accepted socket is blocking: only read the
+		 * handshake */
+		if (! nopoll_conn_is_ready (listener))
+			nopoll_conn_get_msg (listener);
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (! nopoll_conn_is_ok (listener) || ! nopoll_conn_is_ready (conn)) {
+		printf ("ERROR: expected to connect to the test listener..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_set_on_close (conn, test_53_on_close, NULL);
+
+	nopoll_loop_wait (ctx, 600000);
+	if (nopoll_conn_is_ok (conn) || ! test_53_closed) {
+		printf ("ERROR: expected connection to be closed after missing PONG..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+	if (nopoll_timer_count (ctx) != 0) {
+		printf ("ERROR: expected no keepalive timers pending, but found %d..\n", nopoll_timer_count (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_conn_close (listener);
+	nopoll_conn_close (master);
+	nopoll_ctx_unref (ctx2);
+	nopoll_ctx_unref (ctx);
+
+	return nopoll_true;
+}
+
+/* checks the content provided is echoed back (replies
+ * can be received in several pieces) */
+nopoll_bool test_54_receive (noPollConn * conn, const char * content, long size)
+{
+	noPollMsg  * msg;
+	long         received = 0;
+	int          iterator = 0;
+
+	while (received < size && iterator < 500) {
+		msg = nopoll_conn_get_msg (conn);
+		if (msg == NULL) {
+			if (! nopoll_conn_is_ok (conn)) {
+				printf ("ERROR: connection closed while waiting for the reply..\n");
+				return nopoll_false;
+			} /* end if */
+			nopoll_sleep (10000);
+			iterator++;
+			continue;
+		} /* end if */
+
+		if (received + nopoll_msg_get_payload_size (msg) > size ||
+		    memcmp (content + received, nopoll_msg_get_payload (msg), nopoll_msg_get_payload_size (msg)) != 0) {
+			printf ("ERROR: received content differs from what was sent (at %ld, %ld bytes)..\n",
+				received, nopoll_msg_get_payload_size (msg));
+			return nopoll_false;
+		} /* end if */
+		received += nopoll_msg_get_payload_size (msg);
+		nopoll_msg_unref (msg);
+	} /* end while */
+
+	if (received != size) {
+		printf ("ERROR: expected to receive %ld bytes but received %ld..\n", size, received);
+		return nopoll_false;
+	} /* end if */
+
+	return nopoll_true;
+}
+
+/* sends the content provided and checks it is echoed back */
+nopoll_bool test_54_echo (noPollConn * conn, const char * content, long size)
+{
+	if (nopoll_conn_send_text (conn, content, size) != size) {
+		printf ("ERROR: expected to send %ld bytes..\n", size);
+		return nopoll_false;
+	} /* end if */
+
+	return test_54_receive (conn, content, size);
+}
+
+nopoll_bool test_54 (void) {
+#if defined(NOPOLL_HAVE_ZLIB)
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	noPollMsg       * msg;
+	char            * content;
+	int               iterator;
+	long              size = 0;
+
+	printf ("Test 54: checking permessage-deflate..\n");
+
+	/* compressible content */
+	content = nopoll_new (char, 60000);
+	iterator = 0;
+	while (size < 50000) {
+		size += sprintf (content + size, "line %d of the content echoed through permessage-deflate\n", iterator);
+		iterator++;
+	} /* end while */
+
+	ctx = create_ctx ();
+
+	/* negotiate with defaults (context takeover) */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect with permessage-deflate negotiated..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* several messages share the compression context */
+	for (iterator = 0; iterator < 3; iterator++) {
+		if (! test_54_echo (conn, content, size))
+			return nopoll_false;
+	} /* end for */
+	if (! test_54_echo (conn, "short message", 13))
+		return nopoll_false;
+
+	/* fragments belong to the same compressed message */
+	if (nopoll_conn_send_text_fragment (conn, "Hel", 3) != 3 || nopoll_conn_send_text (conn, "lo", 2) != 2) {
+		printf ("ERROR: expected to send fragments..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && iterator < 500) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (msg == NULL || ! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "Hello")) {
+		printf ("ERROR: expected to receive Hello..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+	nopoll_conn_close (conn);
+
+	/* messages inflated to exactly the frame size limit are accepted */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	nopoll_conn_opts_set_max_frame_size (opts, 1000);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect with permessage-deflate negotiated (frame size limit)..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, content, 1000))
+		return nopoll_false;
+	nopoll_conn_close (conn);
+
+	/* no context takeover and reduced windows */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate_params (opts, nopoll_true, nopoll_true, 10, 11);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect with permessage-deflate negotiated (no context takeover)..\n");
+		return nopoll_false;
+	} /* end if */
+	for (iterator = 0; iterator < 3; iterator++) {
+		if (! test_54_echo (conn, content, size))
+			return nopoll_false;
+	} /* end for */
+	nopoll_conn_close (conn);
+
+	/* servers without permessage-deflate ignore the offer */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect without permessage-deflate..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, content, 1000))
+		return nopoll_false;
+	nopoll_conn_close (conn);
+
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+#else
+	printf ("Test 54: skipped, noPoll was built without zlib..\n");
+#endif
+	return nopoll_true;
+}
+
+nopoll_bool test_55 (void) {
+#if defined(NOPOLL_HAVE_ZLIB)
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConn      * conn2;
+	noPollConn      * conn3;
+	noPollConnOpts  * opts;
+	char            * content;
+	int               iterator = 0;
+	long              size = 0;
+
+	printf ("Test 55: checking permessage-deflate compression policy..\n");
+
+	/* compressible content */
+	content = nopoll_new (char, 60000);
+	while (size < 50000) {
+		size += sprintf (content + size, "line %d of the content echoed through permessage-deflate\n", iterator);
+		iterator++;
+	} /* end while */
+
+	ctx = create_ctx ();
+
+	/* messages below the threshold are not compressed */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	nopoll_conn_opts_set_permessage_deflate_threshold (opts, 1024);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect with permessage-deflate negotiated..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, "short message", 13))
+		return nopoll_false;
+	if (conn->deflate->tx_stream != NULL) {
+		printf ("ERROR: expected short message to be sent without compression..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, content, size))
+		return nopoll_false;
+#if defined(NOPOLL_HAVE_PTHREAD)
+	/* the scratch buffer is kept by the sending thread */
+	if (conn->deflate->tx_stream == NULL || ctx->deflate_scratch_count != 0 || ctx->deflate_scratch_threads == NULL ||
+	    ctx->deflate_scratch_threads->buffer == NULL || ctx->deflate_scratch_threads->busy) {
+#else
+	if (conn->deflate->tx_stream == NULL || ctx->deflate_scratch_count != 1) {
+#endif
+		printf ("ERROR: expected big message to be compressed (and scratch buffer to be kept)..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	/* per message opt-out */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_permessage_deflate (conn)) {
+		printf ("ERROR: expected to connect with permessage-deflate negotiated..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_ext (conn, NOPOLL_TEXT_FRAME, content, size, nopoll_true, NOPOLL_SEND_NO_COMPRESS) != size) {
+		printf ("ERROR: expected to send %ld bytes..\n", size);
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_receive (conn, content, size))
+		return nopoll_false;
+	if (conn->deflate->tx_stream != NULL) {
+		printf ("ERROR: expected message to be sent without compression (NOPOLL_SEND_NO_COMPRESS)..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+
+	/* windows limit: each connection keeps two windows (tx and
+	 * rx) with context takeover */
+	ctx = create_ctx ();
+	nopoll_ctx_set_deflate_max_windows (ctx, 3);
+
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! test_54_echo (conn, content, size))
+		return nopoll_false;
+	if (nopoll_ctx_get_deflate_windows (ctx) != 2) {
+		printf ("ERROR: expected 2 windows but found %d..\n", nopoll_ctx_get_deflate_windows (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* second connection evicts first connection compressor */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn2 = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn2, 5) || conn2->deflate->tx_no_context_takeover) {
+		printf ("ERROR: expected second connection to negotiate context takeover..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn2, content, size))
+		return nopoll_false;
+	if (nopoll_ctx_get_deflate_windows (ctx) != 3 || conn->deflate->tx_stream != NULL || ! conn->deflate->tx_no_context_takeover) {
+		printf ("ERROR: expected first connection compressor to be evicted (windows: %d)..\n", nopoll_ctx_get_deflate_windows (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* evicted connection keeps working */
+	for (iterator = 0; iterator < 2; iterator++) {
+		if (! test_54_echo (conn, content, size))
+			return nopoll_false;
+	} /* end for */
+
+	/* limit reached: third connection negotiates no context
+	 * takeover */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	conn3 = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1241), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn3, 5) || ! nopoll_conn_is_permessage_deflate (conn3) ||
+	    ! conn3->deflate->tx_no_context_takeover || ! conn3->deflate->rx_no_context_takeover) {
+		printf ("ERROR: expected third connection to negotiate no context takeover..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn3, content, size))
+		return nopoll_false;
+	if (nopoll_ctx_get_deflate_windows (ctx) != 3) {
+		printf ("ERROR: expected 3 windows but found %d..\n", nopoll_ctx_get_deflate_windows (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_conn_close (conn3);
+	nopoll_conn_close (conn2);
+	nopoll_conn_close (conn);
+	if (nopoll_ctx_get_deflate_windows (ctx) != 0) {
+		printf ("ERROR: expected no windows after closing connections but found %d..\n", nopoll_ctx_get_deflate_windows (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+#else
+	printf ("Test 55: skipped, noPoll was built without zlib..\n");
+#endif
+	return nopoll_true;
+}
+
+nopoll_bool test_56 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	noPollMsg       * msg;
+	char            * content;
+	const char      * chars = "\x61\xc3\xb1\xe2\x82\xac\xf0\x9f\x98\x80 ";
+	int               iterator;
+	long              size = 0;
+
+	printf ("Test 56: checking UTF-8 validation..\n");
+
+	/* validator */
+	if (! nopoll_utf8_validate ("h\xc3\xa9llo \xe2\x82\xac \xf0\x9f\x98\x80", 15) || ! nopoll_utf8_validate ("", 0) ||
+	    nopoll_utf8_validate ("\xc0\xaf", 2) || nopoll_utf8_validate ("\xed\xa0\x80", 3) ||
+	    nopoll_utf8_validate ("\xf4\x90\x80\x80", 4) || nopoll_utf8_validate ("ascii text\xe2\x82", 12) ||
+	    nopoll_utf8_validate ("long ascii text before \xff", 24)) {
+		printf ("ERROR: nopoll_utf8_validate reported wrong results..\n");
+		return nopoll_false;
+	} /* end if */
+	if (__nopoll_utf8_check (__nopoll_utf8_check (0, "\xe2", 1), "\x82\xac", 2) != 0) {
+		printf ("ERROR: expected code point split in two pieces to be accepted..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* multi byte content, big enough to be received in several
+	 * reads */
+	content = nopoll_new (char, 60000);
+	while (size < 50000) {
+		memcpy (content + size, chars, 11);
+		size += 11;
+	} /* end while */
+
+	ctx = create_ctx ();
+	nopoll_ctx_set_utf8_validation (ctx, nopoll_true, nopoll_true);
+
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, content, size))
+		return nopoll_false;
+
+	/* invalid content is not sent */
+	if (nopoll_conn_send_text (conn, "\xc3\x28", 2) != -1 || nopoll_conn_send_text (conn, "caf\xc3", 4) != -1) {
+		printf ("ERROR: expected to fail sending invalid UTF-8 content..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* code point split across fragments */
+	if (nopoll_conn_send_text_fragment (conn, "caf\xc3", 4) != 4 || nopoll_conn_send_text (conn, "\xa9", 1) != 1) {
+		printf ("ERROR: expected to send fragments..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && iterator < 500) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (msg == NULL || ! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "caf\xc3\xa9")) {
+		printf ("ERROR: expected to receive caf\xc3\xa9..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+	nopoll_conn_close (conn);
+
+	/* invalid content received fails the connection (the echo
+	 * server replies what this connection sends unchecked) */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_utf8_validation (opts, nopoll_true, nopoll_false);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text (conn, "bad \xc3\x28", 6) != 6) {
+		printf ("ERROR: expected to send invalid content without validation..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while (nopoll_conn_is_ok (conn) && iterator < 500) {
+		msg = nopoll_conn_get_msg (conn);
+		if (msg) {
+			printf ("ERROR: expected invalid content not to be delivered..\n");
+			return nopoll_false;
+		} /* end if */
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected connection to be failed after receiving invalid UTF-8..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+typedef struct _Test57State {
+	const char  * content;
+	long          received;
+	long          max_chunk;
+	int           chunks;
+	int           messages;
+	nopoll_bool   in_message;
+	nopoll_bool   failed;
+} Test57State;
+
+void test_57_on_chunk (noPollCtx    * ctx,
+		       noPollConn   * conn,
+		       noPollOpCode   op_code,
+		       const char   * data,
+		       long           length,
+		       nopoll_bool    is_first,
+		       nopoll_bool    is_last,
+		       noPollPtr      user_data)
+{
+	Test57State * state = (Test57State *) user_data;
+
+	/* first piece only after the last one of the previous
+	 * message (the echo server replies with text messages) */
+	if (is_first == state->in_message || (op_code != NOPOLL_TEXT_FRAME && op_code != NOPOLL_BINARY_FRAME) ||
+	    memcmp (state->content + state->received, data, length) != 0) {
+		printf ("ERROR: unexpected piece received (first: %d, last: %d, length: %ld, op code: %d)..\n",
+			is_first, is_last, length, op_code);
+		state->failed = nopoll_true;
+	} /* end if */
+
+	state->chunks++;
+	state->received  += length;
+	state->in_message = ! is_last;
+	if (is_last)
+		state->messages++;
+	if (length > state->max_chunk)
+		state->max_chunk = length;
+	return;
+}
+
+nopoll_bool test_57 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	char            * content;
+	long              size = 4 * 1024 * 1024;
+	long              iterator;
+	Test57State       state;
+
+	printf ("Test 57: checking streaming receive..\n");
+
+	content = nopoll_new (char, size);
+	for (iterator = 0; iterator < size; iterator++)
+		content[iterator] = (char) (iterator % 251);
+
+	ctx = create_ctx ();
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+
+	memset (&state, 0, sizeof (state));
+	state.content = content;
+	nopoll_conn_set_on_msg_chunk (conn, test_57_on_chunk, &state);
+
+	if (nopoll_conn_send_binary (conn, content, size) < 0) {
+		printf ("ERROR: expected to send %ld bytes..\n", size);
+		return nopoll_false;
+	} /* end if */
+
+	/* echo is streamed as it arrives (while the rest of the
+	 * message is sent) */
+	iterator = 0;
+	while (state.received < size && ! state.failed && iterator < 1000) {
+		if (nopoll_conn_pending_write_bytes (conn) > 0)
+			nopoll_conn_complete_pending_write (conn);
+		nopoll_loop_wait (ctx, 10000);
+		iterator++;
+	} /* end while */
+
+	if (state.failed || state.received != size || state.in_message || state.messages < 1) {
+		printf ("ERROR: expected to receive %ld bytes streamed (received %ld, messages %d)..\n",
+			size, state.received, state.messages);
+		return nopoll_false;
+	} /* end if */
+	if (state.chunks < 2 || state.max_chunk > NOPOLL_MSG_CHUNK_SIZE) {
+		printf ("ERROR: expected content in pieces no bigger than %d bytes (pieces: %d, biggest: %ld)..\n",
+			NOPOLL_MSG_CHUNK_SIZE, state.chunks, state.max_chunk);
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 57: received %ld bytes in %d pieces (biggest %ld bytes)..\n", state.received, state.chunks, state.max_chunk);
+
+	nopoll_conn_close (conn);
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_58 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	noPollMsg       * pieces[3];
+	noPollMsg       * msg;
+	noPollMsg       * aux;
+	noPollIoVec       iov[4];
+	int               iterator;
+
+	printf ("Test 58: checking zero copy message chaining..\n");
+
+	/* build three pieces */
+	for (iterator = 0; iterator < 3; iterator++) {
+		pieces[iterator] = nopoll_msg_new ();
+		pieces[iterator]->payload      = nopoll_strdup (iterator == 0 ? "Hel" : (iterator == 1 ? "l" : "o"));
+		pieces[iterator]->payload_size = iterator == 0 ? 3 : 1;
+		pieces[iterator]->op_code      = NOPOLL_TEXT_FRAME;
+	} /* end for */
+	pieces[2]->has_fin = nopoll_true;
+
+	/* chain them as fragments are received */
+	msg = NULL;
+	for (iterator = 0; iterator < 3; iterator++) {
+		aux = msg;
+		msg = nopoll_msg_chain (msg, pieces[iterator]);
+		nopoll_msg_unref (aux);
+		if (msg == NULL) {
+			printf ("ERROR: expected to chain piece %d..\n", iterator);
+			return nopoll_false;
+		} /* end if */
+	} /* end for */
+
+	/* pieces are shared, not copied */
+	if (nopoll_msg_get_iovec (msg, iov, 4) != 3 || iov[0].iov_base != pieces[0]->payload ||
+	    iov[2].iov_len != 1 || nopoll_msg_ref_count (pieces[1]) != 2) {
+		printf ("ERROR: expected three pieces shared with the chained message..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_msg_get_payload_size (msg) != 5 || ! nopoll_msg_is_final (msg) || nopoll_msg_opcode (msg) != NOPOLL_TEXT_FRAME) {
+		printf ("ERROR: expected 5 bytes final text message, found size=%ld..\n", nopoll_msg_get_payload_size (msg));
+		return nopoll_false;
+	} /* end if */
+
+	/* payload is built on request (releasing pieces) */
+	if (! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "Hello") ||
+	    nopoll_msg_get_iovec (msg, iov, 4) != 1 || nopoll_msg_ref_count (pieces[1]) != 1) {
+		printf ("ERROR: expected to find Hello payload..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+	for (iterator = 0; iterator < 3; iterator++)
+		nopoll_msg_unref (pieces[iterator]);
+
+	printf ("Test 58: checking message reassembly..\n");
+	ctx = create_ctx ();
+
+	/* without reassembly, fragments are reported */
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text (conn, "send-fragments", 14) != 14) {
+		printf ("ERROR: expected to send request..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && iterator < 500) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (msg == NULL || nopoll_msg_get_payload_size (msg) != 3 || nopoll_msg_is_final (msg)) {
+		printf ("ERROR: expected to receive first fragment (3 bytes)..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+	nopoll_conn_close (conn);
+
+	/* with reassembly, one complete message is reported */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_reassemble_messages (opts, nopoll_true);
+	conn = nopoll_conn_new_opts (ctx, opts, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text (conn, "send-fragments", 14) != 14) {
+		printf ("ERROR: expected to send request..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && iterator < 500) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (msg == NULL || ! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "Hello") ||
+	    ! nopoll_msg_is_final (msg) || nopoll_msg_is_fragment (msg) || nopoll_msg_opcode (msg) != NOPOLL_TEXT_FRAME) {
+		printf ("ERROR: expected to receive complete Hello message..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+
+	/* complete messages are delivered as usual */
+	if (! test_54_echo (conn, "This is a test", 14))
+		return nopoll_false;
+
+	/* fragments chained by the listener are echoed complete */
+	if (nopoll_conn_send_text (conn, "chain-fragments", 15) != 15) {
+		printf ("ERROR: expected to send request..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text_fragment (conn, "Hel", 3) != 3 || nopoll_conn_send_text_fragment (conn, "l", 1) != 1 ||
+	    nopoll_conn_send_text (conn, "o", 1) != 1) {
+		printf ("ERROR: expected to send fragments..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_receive (conn, "Hello", 5))
+		return nopoll_false;
+	nopoll_conn_close (conn);
+
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+typedef struct _Test59State {
+	const char * content;
+	long         size;
+	long         produced;
+	long         max_request;
+} Test59State;
+
+long test_59_producer (noPollWriter * writer, char * buffer, long size, noPollPtr user_data)
+{
+	Test59State * state = (Test59State *) user_data;
+
+	if (size > state->max_request)
+		state->max_request = size;
+
+	/* produce small pieces to check they are accumulated */
+	if (size > 10000)
+		size = 10000;
+	if (size > state->size - state->produced)
+		size = state->size - state->produced;
+	memcpy (buffer, state->content + state->produced, size);
+	state->produced += size;
+	return size;
+}
+
+nopoll_bool test_59 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollWriter    * writer;
+	char            * content;
+	long              size = 3 * 1024 * 1024;
+	long              iterator;
+	Test59State       state;
+	FILE            * file;
+
+	printf ("Test 59: checking streaming send..\n");
+
+	content = nopoll_new (char, size);
+	for (iterator = 0; iterator < size; iterator++)
+		content[iterator] = (char) ('a' + (iterator % 26));
+
+	ctx = create_ctx ();
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* message produced on demand */
+	memset (&state, 0, sizeof (state));
+	state.content = content;
+	state.size    = size;
+	writer = nopoll_writer_new (conn, NOPOLL_BINARY_FRAME, 65536, test_59_producer, &state);
+	if (writer == NULL || nopoll_writer_send (writer, 20000000) != 1 || ! nopoll_writer_is_done (writer)) {
+		printf ("ERROR: expected to send message through the writer..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_writer_get_sent (writer) != size || state.max_request > 65536 || writer->frames < 2) {
+		printf ("ERROR: expected to send %ld bytes in pieces no bigger than 65536 (sent %ld, biggest request %ld, frames %d)..\n",
+			size, nopoll_writer_get_sent (writer), state.max_request, writer->frames);
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 59: sent %ld bytes in %d frames..\n", nopoll_writer_get_sent (writer), writer->frames);
+	nopoll_writer_free (writer);
+
+	/* echo is the complete message */
+	if (! test_54_receive (conn, content, size))
+		return nopoll_false;
+
+	/* message read from a file descriptor */
+	file = tmpfile ();
+	if (file == NULL || fwrite (content, 1, 100000, file) != 100000 || fflush (file) != 0 ||
+	    lseek (fileno (file), 0, SEEK_SET) != 0) {
+		printf ("ERROR: unable to prepare temporal file..\n");
+		return nopoll_false;
+	} /* end if */
+	writer = nopoll_writer_new_fd (conn, NOPOLL_TEXT_FRAME, 4096, fileno (file));
+	if (writer == NULL || nopoll_writer_send (writer, 20000000) != 1 || nopoll_writer_get_sent (writer) != 100000) {
+		printf ("ERROR: expected to send file content through the writer..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_writer_free (writer);
+	fclose (file);
+	if (! test_54_receive (conn, content, 100000))
+		return nopoll_false;
+
+	/* regular messages can be sent after that */
+	if (! test_54_echo (conn, "This is a test", 14))
+		return nopoll_false;
+
+	nopoll_conn_close (conn);
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_60 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	FILE            * file;
+	char            * content;
+	long              size;
+
+	printf ("Test 60: checking sending files..\n");
+
+	/* local copy of the file to compare */
+	file = fopen ("nopoll-regression-client.c", "rb");
+	if (file == NULL) {
+		printf ("ERROR: unable to open nopoll-regression-client.c..\n");
+		return nopoll_false;
+	} /* end if */
+	fseek (file, 0, SEEK_END);
+	size = ftell (file);
+	fseek (file, 0, SEEK_SET);
+	content = nopoll_new (char, size + 1);
+	if (fread (content, 1, size, file) != (size_t) size) {
+		printf ("ERROR: unable to read nopoll-regression-client.c..\n");
+		return nopoll_false;
+	} /* end if */
+
+	ctx = create_ctx ();
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* server side (sendfile when available) */
+	if (nopoll_conn_send_text (conn, "send-file: 0 -1 nopoll-regression-client.c", 42) != 42 ||
+	    ! test_54_receive (conn, content, size)) {
+		printf ("ERROR: expected to receive the whole file..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_text (conn, "send-file: 100 5000 nopoll-regression-client.c", 46) != 46 ||
+	    ! test_54_receive (conn, content + 100, 5000)) {
+		printf ("ERROR: expected to receive part of the file..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* client side (masked content is read and sent in pieces) */
+	if (nopoll_conn_send_file (conn, fileno (file), 0, -1) != size || ! test_54_receive (conn, content, size)) {
+		printf ("ERROR: expected to send the whole file..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_send_file (conn, fileno (file), size - 10, 20) != -1 || ! nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected to fail sending beyond the end of file (keeping the connection)..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_echo (conn, "This is a test", 14))
+		return nopoll_false;
+
+	fclose (file);
+	nopoll_free (content);
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_61 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	FILE            * file;
+	char            * content;
+	long              size;
+
+	printf ("Test 61: checking kTLS offload..\n");
+
+	/* local copy of the file to compare */
+	file = fopen ("nopoll-regression-client.c", "rb");
+	if (file == NULL) {
+		printf ("ERROR: unable to open nopoll-regression-client.c..\n");
+		return nopoll_false;
+	} /* end if */
+	fseek (file, 0, SEEK_END);
+	size = ftell (file);
+	fseek (file, 0, SEEK_SET);
+	content = nopoll_new (char, size + 1);
+	if (fread (content, 1, size, file) != (size_t) size) {
+		printf ("ERROR: unable to read nopoll-regression-client.c..\n");
+		return nopoll_false;
+	} /* end if */
+	fclose (file);
+
+	ctx = create_ctx ();
+
+	/* kTLS is not used unless requested */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1235), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_get_ktls (conn) != NOPOLL_KTLS_NONE) {
+		printf ("ERROR: expected to connect without kTLS..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	/* both sides request kTLS: the connection works whether or
+	 * not the kernel accepted the offload */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	nopoll_conn_opts_set_ktls (opts, nopoll_true);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1242), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || ! nopoll_conn_is_tls_on (conn)) {
+		printf ("ERROR: expected to connect with TLS..\n");
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 61: kTLS state tx=%d rx=%d..\n",
+		(nopoll_conn_get_ktls (conn) & NOPOLL_KTLS_TX) != 0, (nopoll_conn_get_ktls (conn) & NOPOLL_KTLS_RX) != 0);
+
+	if (! test_54_echo (conn, "This is a test", 14) || ! test_54_echo (conn, content, size))
+		return nopoll_false;
+
+	/* file sent by the server (sendfile when kTLS is active) */
+	if (nopoll_conn_send_text (conn, "send-file: 0 -1 nopoll-regression-client.c", 42) != 42 ||
+	    ! test_54_receive (conn, content, size)) {
+		printf ("ERROR: expected to receive the whole file..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	nopoll_free (content);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_62 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	char              content[1000];
+	int               iterator;
+
+	printf ("Test 62: checking TLS write batching..\n");
+
+	ctx = create_ctx ();
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1235), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect with TLS..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* idle connections release their TLS buffers */
+	if (! (SSL_get_mode (conn->ssl) & SSL_MODE_RELEASE_BUFFERS) || ! (SSL_get_mode (conn->ssl) & SSL_MODE_ENABLE_PARTIAL_WRITE)) {
+		printf ("ERROR: expected to find SSL modes configured..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* small messages are queued */
+	nopoll_conn_set_tls_batching (conn, nopoll_true);
+	for (iterator = 0; iterator < 100; iterator++) {
+		sprintf (content + (iterator * 10), "message%03d", iterator);
+		if (nopoll_conn_send_text (conn, content + (iterator * 10), 10) != 10) {
+			printf ("ERROR: expected to send message %d..\n", iterator);
+			return nopoll_false;
+		} /* end if */
+	} /* end for */
+	if (conn->tls_batch_size == 0) {
+		printf ("ERROR: expected to find content batched..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* written on flush and echoed in order */
+	if (nopoll_conn_flush_tls_batch (conn) != 1 || conn->tls_batch_size != 0) {
+		printf ("ERROR: expected to flush content batched..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_54_receive (conn, content, 1000))
+		return nopoll_false;
+
+	/* disabling batching writes directly */
+	nopoll_conn_set_tls_batching (conn, nopoll_false);
+	if (! test_54_echo (conn, "This is a test", 14) || conn->tls_batch != NULL)
+		return nopoll_false;
+
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_63_check (const char * host_name, const char * expected_cn)
+{
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	X509            * cert;
+	char              cn[256];
+
+	ctx = create_ctx ();
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1235), host_name, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect with TLS using server name %s..\n", host_name);
+		return nopoll_false;
+	} /* end if */
+
+	/* check the certificate selected by the server */
+	cert = SSL_get_peer_certificate (conn->ssl);
+	if (cert == NULL) {
+		printf ("ERROR: expected to find server certificate for %s..\n", host_name);
+		return nopoll_false;
+	} /* end if */
+	X509_NAME_get_text_by_NID (X509_get_subject_name (cert), NID_commonName, cn, sizeof (cn));
+	X509_free (cert);
+	if (! nopoll_cmp (cn, expected_cn)) {
+		printf ("ERROR: expected certificate %s for server name %s, but found %s..\n", expected_cn, host_name, cn);
+		return nopoll_false;
+	} /* end if */
+
+	/* and the connection works */
+	if (! test_54_echo (conn, "This is a test", 14))
+		return nopoll_false;
+
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_63 (void) {
+	noPollCtx       * ctx;
+	const char      * certificateFile;
+
+	printf ("Test 63: checking certificate selection by SNI..\n");
+
+	/* lookups ignore case and wildcards are only used for SNI */
+	ctx = nopoll_ctx_new ();
+	if (! nopoll_ctx_set_certificate (ctx, "Sni.Nopoll.Test", "server.pem", "server.pem", NULL) ||
+	    ! nopoll_ctx_set_certificate (ctx, "*.wild.nopoll.test", "test.crt", "test.key", NULL)) {
+		printf ("ERROR: expected to install certificates..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! nopoll_ctx_find_certificate (ctx, "sni.nopoll.test", &certificateFile, NULL, NULL) || ! nopoll_cmp (certificateFile, "server.pem")) {
+		printf ("ERROR: expected to find certificate ignoring case..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_ctx_find_certificate (ctx, "a.wild.nopoll.test", NULL, NULL, NULL)) {
+		printf ("ERROR: expected to not find wildcard certificate by name..\n");
+		return nopoll_false;
+	} /* end if */
+	if (ctx->sni_count != 2 || ctx->sni_loaded != 1) {
+		printf ("ERROR: expected 2 certificates indexed with 1 preloaded, but found %d and %d..\n", ctx->sni_count, ctx->sni_loaded);
+		return nopoll_false;
+	} /* end if */
+
+	/* handshakes read a snapshot with the certificates preloaded */
+	if (ctx->sni_index == NULL || ctx->sni_retired != NULL) {
+		printf ("ERROR: expected SNI snapshot to be published..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_ctx_unref (ctx);
+
+	/* exact and wildcard names select the certificate installed
+	 * for them, the rest get the listener certificate */
+	if (! test_63_check ("sni.nopoll.test", "server.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_63_check ("SNI.nopoll.test", "server.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_63_check ("a.wild.nopoll.test", "server.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_63_check ("a.b.wild.nopoll.test", "test.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_63_check ("localhost", "test.nopoll.aspl.es"))
+		return nopoll_false;
+
+	return nopoll_true;
+}
+
+nopoll_bool test_64_cn (SSL_CTX * ssl_ctx, const char * expected_cn)
+{
+	char cn[256];
+
+	if (ssl_ctx == NULL || SSL_CTX_get0_certificate (ssl_ctx) == NULL) {
+		printf ("ERROR: expected to find key material preloaded..\n");
+		return nopoll_false;
+	} /* end if */
+
+	cn[0] = 0;
+	X509_NAME_get_text_by_NID (X509_get_subject_name (SSL_CTX_get0_certificate (ssl_ctx)), NID_commonName, cn, sizeof (cn));
+	if (! nopoll_cmp (cn, expected_cn)) {
+		printf ("ERROR: expected certificate %s preloaded, but found %s..\n", expected_cn, cn);
+		return nopoll_false;
+	} /* end if */
+	return nopoll_true;
+}
+
+nopoll_bool test_64_copy (const char * from, const char * to)
+{
+	FILE * source;
+	FILE * target;
+	char   buffer[4096];
+	size_t bytes;
+
+	source = fopen (from, "rb");
+	target = fopen ("test_64.tmp", "wb");
+	if (source == NULL || target == NULL)
+		return nopoll_false;
+	while ((bytes = fread (buffer, 1, sizeof (buffer), source)) > 0)
+		fwrite (buffer, 1, bytes, target);
+	fclose (source);
+	fclose (target);
+
+	/* replace the file like certificate renewals do */
+	return rename ("test_64.tmp", to) == 0;
+}
+
+nopoll_bool test_64_reload (noPollConn * conn, const char * command)
+{
+	noPollMsg * msg;
+	int         tries = 0;
+
+	if (nopoll_conn_send_text (conn, command, strlen (command)) != (int) strlen (command))
+		return nopoll_false;
+	while ((msg = nopoll_conn_get_msg (conn)) == NULL && tries < 500) {
+		nopoll_sleep (10000);
+		tries++;
+	} /* end while */
+	if (msg == NULL || ! nopoll_cmp ((const char *) nopoll_msg_get_payload (msg), "reloaded")) {
+		printf ("ERROR: expected to reload certificate with: %s..\n", command);
+		return nopoll_false;
+	} /* end if */
+	nopoll_msg_unref (msg);
+	return nopoll_true;
+}
+
+nopoll_bool test_64 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * listener;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	const char      * certificateFile;
+	noPollSniIndex  * index;
+	nopoll_bool       reloaded;
+	int               tries;
+
+	printf ("Test 64: checking certificate reload..\n");
+
+	/* context certificates are swapped */
+	ctx = create_ctx ();
+	if (! nopoll_ctx_set_certificate (ctx, "reload.nopoll.test", "test-certificate.crt", "test-private.key", NULL) ||
+	    ! test_64_cn (ctx->certificates[0].ssl_ctx, "test.nopoll.aspl.es"))
+		return nopoll_false;
+	if (nopoll_ctx_reload_certificate (ctx, "reload.nopoll.test", "missing.crt", "missing.key", NULL) ||
+	    ! test_64_cn (ctx->certificates[0].ssl_ctx, "test.nopoll.aspl.es")) {
+		printf ("ERROR: expected to keep current certificate when reload fails..\n");
+		return nopoll_false;
+	} /* end if */
+	index = ctx->sni_index;
+	if (! nopoll_ctx_reload_certificate (ctx, "reload.nopoll.test", "server.pem", "server.pem", NULL) ||
+	    ! test_64_cn (ctx->certificates[0].ssl_ctx, "server.nopoll.aspl.es")) {
+		printf ("ERROR: expected to reload certificate..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! nopoll_ctx_find_certificate (ctx, "reload.nopoll.test", &certificateFile, NULL, NULL) || ! nopoll_cmp (certificateFile, "server.pem")) {
+		printf ("ERROR: expected to find certificate reloaded..\n");
+		return nopoll_false;
+	} /* end if */
+	if (ctx->sni_index == NULL || ctx->sni_index == index || ctx->sni_retired != NULL) {
+		printf ("ERROR: expected SNI snapshot to be replaced on reload..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* listener certificates are watched */
+	if (! test_64_copy ("test-certificate.crt", "test_64.crt") || ! test_64_copy ("test-private.key", "test_64.key")) {
+		printf ("ERROR: unable to prepare certificate files..\n");
+		return nopoll_false;
+	} /* end if */
+	listener = nopoll_listener_tls_new (ctx, "0.0.0.0", regtest_port (1257));
+	if (! nopoll_conn_is_ok (listener) || ! nopoll_listener_set_certificate (listener, "test_64.crt", "test_64.key", NULL) ||
+	    ! test_64_cn (listener->cert_ctx, "test.nopoll.aspl.es")) {
+		printf ("ERROR: expected to create a TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_ctx_watch_certificates (ctx, 10000);
+#if defined(__linux__)
+	/* changes are reported through inotify */
+	if (ctx->cert_watch_fd < 0) {
+		printf ("ERROR: expected the watcher to use inotify..\n");
+		return nopoll_false;
+	} /* end if */
+#endif
+	if (! test_64_copy ("server.pem", "test_64.crt") || ! test_64_copy ("server.pem", "test_64.key")) {
+		printf ("ERROR: unable to replace certificate files..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* files are reloaded by a worker: check them under the
+	 * listener mutex */
+	tries    = 0;
+	reloaded = nopoll_false;
+	while (tries < 100 && ! reloaded) {
+		nopoll_loop_wait (ctx, 20000);
+		nopoll_mutex_lock (listener->ref_mutex);
+		reloaded = test_64_cn (listener->cert_ctx, "server.nopoll.aspl.es");
+		nopoll_mutex_unlock (listener->ref_mutex);
+		tries++;
+	} /* end while */
+	if (! reloaded) {
+		printf ("ERROR: expected the watcher to reload listener certificate..\n");
+		return nopoll_false;
+	} /* end if */
+#if defined(NOPOLL_HAVE_PTHREAD) && defined(NOPOLL_OS_UNIX)
+	if (ctx->tls_workers == NULL) {
+		printf ("ERROR: expected certificates to be checked on the worker pool..\n");
+		return nopoll_false;
+	} /* end if */
+#endif
+	nopoll_ctx_watch_certificates (ctx, 0);
+	if (nopoll_timer_count (ctx) != 0) {
+		printf ("ERROR: expected watcher to be stopped..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (listener);
+	nopoll_ctx_unref (ctx);
+	unlink ("test_64.crt");
+	unlink ("test_64.key");
+
+	/* connections accepted after a reload get the new
+	 * certificate while current ones keep working */
+	ctx = create_ctx ();
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1235), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected to connect with TLS..\n");
+		return nopoll_false;
+	} /* end if */
+	if (! test_64_reload (conn, "reload-certificate: server.pem server.pem"))
+		return nopoll_false;
+	if (! test_63_check ("localhost", "server.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_64_reload (conn, "reload-certificate: test-certificate.crt test-private.key"))
+		return nopoll_false;
+	if (! test_63_check ("localhost", "test.nopoll.aspl.es"))
+		return nopoll_false;
+	if (! test_54_echo (conn, "This is a test", 14))
+		return nopoll_false;
+
+	nopoll_conn_close (conn);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_65_shared_ctx (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	noPollConn * listener = (noPollConn *) user_data;
+
+	/* report accepted sessions not using the listener SSL_CTX */
+	return nopoll_conn_role (conn) == NOPOLL_ROLE_LISTENER && conn->ssl_ctx != listener->accept_ctx;
+}
+
+nopoll_bool test_65 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * listener;
+	noPollConn      * conn;
+	noPollConnOpts  * opts;
+	NOPOLL_SOCKET     stalled;
+	NOPOLL_SOCKET     silent;
+	struct sockaddr_in addr;
+	struct timeval    start;
+	int               tries;
+
+	printf ("Test 65: checking non-blocking TLS handshakes..\n");
+
+	/* a TLS client that never sends its hello is dropped by the
+	 * listener while other handshakes keep going on the same
+	 * thread */
+	ctx = create_ctx ();
+	nopoll_ctx_set_tls_handshake_timeout (ctx, 1000000);
+	listener = nopoll_listener_tls_new (ctx, "0.0.0.0", regtest_port (1258));
+	if (! nopoll_conn_is_ok (listener) || ! nopoll_listener_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: expected to create a TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+	stalled = socket (AF_INET, SOCK_STREAM, 0);
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+	addr.sin_port        = htons ((unsigned short) regtest_port_int (1258));
+	if (stalled == NOPOLL_INVALID_SOCKET || connect (stalled, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		printf ("ERROR: unable to connect to the TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+	tries = 0;
+	while (tries < 100 && nopoll_ctx_conns (ctx) < 2) {
+		nopoll_loop_wait (ctx, 10000);
+		tries++;
+	} /* end while */
+
+	/* the accepted handshake is bounded by its own timer */
+	if (nopoll_timer_count (ctx) != 1) {
+		printf ("ERROR: expected a timer for the pending TLS handshake but found %d..\n", nopoll_timer_count (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conn = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1258), NULL, NULL, NULL, NULL);
+	tries = 0;
+	while (tries < 100 && ! nopoll_conn_is_ready (conn)) {
+		nopoll_loop_wait (ctx, 10000);
+		tries++;
+	} /* end while */
+	if (! nopoll_conn_is_ready (conn) || ! nopoll_conn_is_tls_on (conn)) {
+		printf ("ERROR: expected TLS connection to be ready while another handshake stalls..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* listener, stalled session and both ends of the TLS
+	 * connection */
+	if (nopoll_ctx_conns (ctx) != 4) {
+		printf ("ERROR: expected 4 connections but found %d..\n", nopoll_ctx_conns (ctx));
+		return nopoll_false;
+	} /* end if */
+
+	/* both accepted sessions share the listener SSL_CTX */
+	if (listener->accept_ctx == NULL || nopoll_ctx_foreach_conn (ctx, test_65_shared_ctx, listener) != NULL) {
+		printf ("ERROR: expected accepted TLS sessions to share the listener SSL context..\n");
+		return nopoll_false;
+	} /* end if */
+	tries = 0;
+	while (tries < 300 && nopoll_ctx_conns (ctx) > 3) {
+		nopoll_loop_wait (ctx, 10000);
+		tries++;
+	} /* end while */
+	if (nopoll_ctx_conns (ctx) != 3 || ! nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected stalled TLS handshake to be closed (%d connections)..\n", nopoll_ctx_conns (ctx));
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_timer_count (ctx) != 0) {
+		printf ("ERROR: expected handshake timers to be released but found %d..\n", nopoll_timer_count (ctx));
+		return nopoll_false;
+	} /* end if */
+	nopoll_close_socket (stalled);
+	nopoll_conn_close (conn);
+	nopoll_conn_close (listener);
+	nopoll_ctx_unref (ctx);
+
+	/* connecting to a server that never answers doesn't block
+	 * and fails once the handshake timeout is reached */
+	ctx = create_ctx ();
+	nopoll_ctx_set_tls_handshake_timeout (ctx, 200000);
+	silent = nopoll_listener_sock_listen (ctx, "127.0.0.1", regtest_port (1259));
+	if (! nopoll_socket_is_valid (silent)) {
+		printf ("ERROR: unable to create listener socket..\n");
+		return nopoll_false;
+	} /* end if */
+	gettimeofday (&start, NULL);
+	conn = nopoll_conn_tls_new (ctx, NULL, "127.0.0.1", regtest_port (1259), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_is_ok (conn) || __nopoll_conn_elapsed_since (&start) > 100000) {
+		printf ("ERROR: expected TLS connect to return without waiting for the server..\n");
+		return nopoll_false;
+	} /* end if */
+	if (nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_is_ok (conn)) {
+		printf ("ERROR: expected TLS handshake to time out..\n");
+		return nopoll_false;
+	} /* end if */
+	if (__nopoll_conn_elapsed_since (&start) > 2000000) {
+		printf ("ERROR: TLS handshake timeout took too long..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+	nopoll_close_socket (silent);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+#if defined(__NOPOLL_PTHREAD_SUPPORT__) && defined(NOPOLL_HAVE_PTHREAD)
+int       test_66_accepted   = 0;
+int       test_66_on_workers = 0;
+pthread_t test_66_loop_thread;
+
+nopoll_bool test_66_post_check (noPollCtx * ctx, noPollConn * conn, noPollPtr ssl_ctx, noPollPtr ssl, noPollPtr user_data)
+{
+	/* record where accepted handshakes finish */
+	if (nopoll_conn_role (conn) == NOPOLL_ROLE_LISTENER) {
+		test_66_accepted++;
+		if (! pthread_equal (pthread_self (), test_66_loop_thread))
+			test_66_on_workers++;
+	} /* end if */
+	return nopoll_true;
+}
+
+int       test_66_closed           = 0;
+int       test_66_closed_on_loop   = 0;
+
+void test_66_on_close (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	test_66_closed++;
+	if (pthread_equal (pthread_self (), test_66_loop_thread))
+		test_66_closed_on_loop++;
+	return;
+}
+
+nopoll_bool test_66_watch_accepted (noPollCtx * ctx, noPollConn * conn, noPollPtr user_data)
+{
+	/* watch the accepted session still doing its handshake */
+	if (nopoll_conn_role (conn) == NOPOLL_ROLE_LISTENER && conn->pending_ssl_accept)
+		nopoll_conn_set_on_close (conn, test_66_on_close, NULL);
+	return nopoll_false;
+}
+
+nopoll_bool test_66 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * listener;
+	noPollConn      * conns[5];
+	noPollConnOpts  * opts;
+	int               iterator;
+	int               ready;
+	int               tries;
+	NOPOLL_SOCKET     broken;
+	struct sockaddr_in addr;
+
+	printf ("Test 66: checking TLS handshakes on worker threads..\n");
+
+	ctx = create_ctx ();
+	test_66_loop_thread = pthread_self ();
+	nopoll_ctx_set_post_ssl_check (ctx, test_66_post_check, NULL);
+	if (! nopoll_ctx_set_tls_handshake_workers (ctx, 2)) {
+		printf ("ERROR: expected to start TLS handshake workers..\n");
+		return nopoll_false;
+	} /* end if */
+	listener = nopoll_listener_tls_new (ctx, "0.0.0.0", regtest_port (1260));
+	if (! nopoll_conn_is_ok (listener) || ! nopoll_listener_set_certificate (listener, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: expected to create a TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* connect several clients at once */
+	iterator = 0;
+	while (iterator < 4) {
+		opts = nopoll_conn_opts_new ();
+		nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+		conns[iterator] = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1260), NULL, NULL, NULL, NULL);
+		iterator++;
+	} /* end while */
+	tries = 0;
+	ready = 0;
+	while (tries < 200 && ready < 4) {
+		nopoll_loop_wait (ctx, 10000);
+		ready    = 0;
+		iterator = 0;
+		while (iterator < 4) {
+			if (nopoll_conn_is_ready (conns[iterator]))
+				ready++;
+			iterator++;
+		} /* end while */
+		tries++;
+	} /* end while */
+	if (ready != 4 || test_66_accepted != 4) {
+		printf ("ERROR: expected 4 TLS connections ready (ready=%d, accepted=%d)..\n", ready, test_66_accepted);
+		return nopoll_false;
+	} /* end if */
+	if (test_66_on_workers != 4) {
+		printf ("ERROR: expected accepted handshakes to run on workers (%d of 4)..\n", test_66_on_workers);
+		return nopoll_false;
+	} /* end if */
+
+	/* a handshake failing on a worker is closed by the loop */
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons ((unsigned short) regtest_port_int (1260));
+	addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+	broken = socket (AF_INET, SOCK_STREAM, 0);
+	if (broken == NOPOLL_INVALID_SOCKET || connect (broken, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		printf ("ERROR: unable to connect to the TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_loop_wait (ctx, 10000);
+	nopoll_ctx_foreach_conn (ctx, test_66_watch_accepted, NULL);
+	if (send (broken, "GET / HTTP/1.1\r\n\r\n", 18, 0) != 18) {
+		printf ("ERROR: unable to send content to the TLS listener..\n");
+		return nopoll_false;
+	} /* end if */
+	tries = 0;
+	while (tries < 200 && test_66_closed == 0) {
+		nopoll_loop_wait (ctx, 10000);
+		tries++;
+	} /* end while */
+	nopoll_close_socket (broken);
+	if (test_66_closed != 1 || test_66_closed_on_loop != 1) {
+		printf ("ERROR: expected failed handshake to be closed on the loop (closed=%d, on loop=%d)..\n",
+			test_66_closed, test_66_closed_on_loop);
+		return nopoll_false;
+	} /* end if */
+
+	/* handshakes go back to the loop when the pool is stopped */
+	if (! nopoll_ctx_set_tls_handshake_workers (ctx, 0) || ctx->tls_workers != NULL) {
+		printf ("ERROR: expected to stop TLS handshake workers..\n");
+		return nopoll_false;
+	} /* end if */
+	opts = nopoll_conn_opts_new ();
+	nopoll_conn_opts_ssl_peer_verify (opts, nopoll_false);
+	conns[4] = nopoll_conn_tls_new (ctx, opts, "localhost", regtest_port (1260), NULL, NULL, NULL, NULL);
+	tries = 0;
+	while (tries < 200 && ! nopoll_conn_is_ready (conns[4])) {
+		nopoll_loop_wait (ctx, 10000);
+		tries++;
+	} /* end while */
+	if (! nopoll_conn_is_ready (conns[4]) || test_66_accepted != 5 || test_66_on_workers != 4) {
+		printf ("ERROR: expected handshake to run on the loop (accepted=%d, on workers=%d)..\n", test_66_accepted, test_66_on_workers);
+		return nopoll_false;
+	} /* end if */
+
+	iterator = 0;
+	while (iterator < 5) {
+		nopoll_conn_close (conns[iterator]);
+		iterator++;
+	} /* end while */
+	nopoll_conn_close (listener);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+#endif
+
+int  test_67_logs[3];
+int  test_67_line;
+char test_67_file[256];
+char test_67_msg[256];
+
+void test_67_handler (noPollCtx * ctx, noPollDebugLevel level, const char * file, int line, const char * log_msg, noPollPtr user_data)
+{
+	test_67_logs[level]++;
+	if (level == NOPOLL_LEVEL_CRITICAL) {
+		test_67_line = line;
+		snprintf (test_67_file, sizeof (test_67_file), "%s", file);
+		snprintf (test_67_msg, sizeof (test_67_msg), "%s", log_msg);
+	} /* end if */
+	return;
+}
+
+void test_67_handler_old (noPollCtx * ctx, noPollDebugLevel level, const char * log_msg, noPollPtr user_data)
+{
+	if (level == NOPOLL_LEVEL_CRITICAL)
+		snprintf (test_67_msg, sizeof (test_67_msg), "%s", log_msg);
+	return;
+}
+
+nopoll_bool test_67 (void) {
+	noPollCtx  * ctx;
+	noPollConn * listener;
+
+	printf ("Test 67: checking log levels and handlers..\n");
+
+	ctx = nopoll_ctx_new ();
+	if (__nopoll_log_is_active (ctx, NOPOLL_LEVEL_CRITICAL)) {
+		printf ("ERROR: expected log to be disabled by default..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* only warnings and critical logs reach the handler, with
+	 * location as separate fields */
+	memset (test_67_logs, 0, sizeof (test_67_logs));
+	nopoll_log_set_handler_ext (ctx, test_67_handler, NULL);
+	nopoll_log_set_level (ctx, NOPOLL_LEVEL_WARNING);
+	if (__nopoll_log_is_active (ctx, NOPOLL_LEVEL_DEBUG) || ! __nopoll_log_is_active (ctx, NOPOLL_LEVEL_WARNING)) {
+		printf ("ERROR: expected log threshold to follow the level configured..\n");
+		return nopoll_false;
+	} /* end if */
+	listener = nopoll_listener_new (ctx, "127.0.0.1", regtest_port (1261));
+	nopoll_ctx_set_tls_handshake_workers (ctx, -1);
+#if defined(SHOW_DEBUG_LOG)
+	if (test_67_logs[NOPOLL_LEVEL_DEBUG] != 0 || test_67_logs[NOPOLL_LEVEL_CRITICAL] != 1) {
+		printf ("ERROR: expected only one critical log (debug=%d, critical=%d)..\n",
+			test_67_logs[NOPOLL_LEVEL_DEBUG], test_67_logs[NOPOLL_LEVEL_CRITICAL]);
+		return nopoll_false;
+	} /* end if */
+	if (strstr (test_67_file, "nopoll_ctx.c") == NULL || test_67_line <= 0 || strncmp (test_67_msg, "Expresion", 9) != 0) {
+		printf ("ERROR: expected location as separate fields (%s:%d '%s')..\n", test_67_file, test_67_line, test_67_msg);
+		return nopoll_false;
+	} /* end if */
+
+	/* debug logs are reported again */
+	nopoll_log_set_level (ctx, NOPOLL_LEVEL_DEBUG);
+	nopoll_conn_close (listener);
+	listener = nopoll_listener_new (ctx, "127.0.0.1", regtest_port (1261));
+	if (test_67_logs[NOPOLL_LEVEL_DEBUG] == 0) {
+		printf ("ERROR: expected debug logs to be reported..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* handlers without location get it as a prefix */
+	nopoll_log_set_handler (ctx, test_67_handler_old, NULL);
+	nopoll_ctx_set_tls_handshake_workers (ctx, -1);
+	if (strstr (test_67_msg, "nopoll_ctx.c:") == NULL || test_67_msg[strlen (test_67_msg) - 1] != ' ') {
+		printf ("ERROR: expected location prefix on log message '%s'..\n", test_67_msg);
+		return nopoll_false;
+	} /* end if */
+#endif
+
+	nopoll_conn_close (listener);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+#if defined(NOPOLL_HAVE_PTHREAD) && defined(SHOW_DEBUG_LOG)
+void * test_68_thread (void * data)
+{
+	noPollCtx * ctx = (noPollCtx *) data;
+	int         iterator = 0;
+
+	while (iterator < 100) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "test_68 record from thread %d", iterator);
+		iterator++;
+	} /* end while */
+	return NULL;
+}
+
+nopoll_bool test_68_find (const char * path, const char * content)
+{
+	FILE        * file;
+	char          line[512];
+	nopoll_bool   found = nopoll_false;
+
+	file = fopen (path, "r");
+	if (file == NULL)
+		return nopoll_false;
+	while (! found && fgets (line, sizeof (line), file))
+		found = (strstr (line, content) != NULL);
+	fclose (file);
+	return found;
+}
+
+nopoll_bool test_68 (void) {
+	noPollCtx * ctx;
+	noPollConn  conn;
+	pthread_t   thread;
+	FILE      * file;
+	char        line[512];
+	int         fd;
+	int         iterator;
+	int         lines = 0;
+	long        overruns;
+
+	printf ("Test 68: checking asynchronous logger..\n");
+
+	ctx = nopoll_ctx_new ();
+	nopoll_log_enable (ctx, nopoll_true);
+	nopoll_log_set_level (ctx, NOPOLL_LEVEL_CRITICAL);
+	fd = open ("test_68.log", O_CREAT | O_TRUNC | O_WRONLY, 0600);
+	if (fd < 0 || ! nopoll_log_set_async (ctx, fd)) {
+		printf ("ERROR: expected to enable asynchronous logger..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* records that don't fit are counted, never blocking */
+	if (pthread_create (&thread, NULL, test_68_thread, ctx) != 0)
+		return nopoll_false;
+	iterator = 0;
+	while (iterator < 5000) {
+		nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "test_68 record %d", iterator);
+		iterator++;
+	} /* end while */
+	pthread_join (thread, NULL);
+	overruns = nopoll_log_async_overruns (ctx);
+
+	/* an idle logger is woken up by new records */
+	nopoll_sleep (100000);
+	nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "test_68 wakeup");
+	iterator = 0;
+	while (iterator < 100 && ! test_68_find ("test_68.log", "test_68 wakeup")) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (iterator == 100) {
+		printf ("ERROR: expected idle logger to write new records..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* arguments are formatted by the logger thread (strings are
+	 * copied, so they can be released right after), and records
+	 * logged while a connection is handled carry its id */
+	memset (&conn, 0, sizeof (noPollConn));
+	conn.id = 4242;
+	memset (line, 0, sizeof (line));
+	strcpy (line, "text");
+	__nopoll_log_set_conn (ctx, &conn);
+	nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "test_68 args %s %ld %d %.2f %c%% %5s|", line, 1234567890L, -5, 3.5, 'z', "ab");
+	__nopoll_log_set_conn (ctx, NULL);
+	memset (line, 0, sizeof (line));
+	nopoll_log (ctx, NOPOLL_LEVEL_CRITICAL, "test_68 without conn");
+	iterator = 0;
+	while (iterator < 100 && ! test_68_find ("test_68.log", "test_68 without conn")) {
+		nopoll_sleep (10000);
+		iterator++;
+	} /* end while */
+	if (! test_68_find ("test_68.log", "conn-id=4242 test_68 args text 1234567890 -5 3.50 z%    ab|")) {
+		printf ("ERROR: expected record formatted by the logger thread with the connection id..\n");
+		return nopoll_false;
+	} /* end if */
+	if (test_68_find ("test_68.log", "conn-id=4242 test_68 without conn")) {
+		printf ("ERROR: expected record without connection id..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* stopping the logger writes the records pending */
+	nopoll_log_set_async (ctx, -1);
+	close (fd);
+	file = fopen ("test_68.log", "r");
+	if (file == NULL)
+		return nopoll_false;
+	while (fgets (line, sizeof (line), file)) {
+		if (strstr (line, "(critical) ") && strstr (line, "test_68 record"))
+			lines++;
+	} /* end while */
+	fclose (file);
+	unlink ("test_68.log");
+
+	if (lines == 0 || lines + overruns != 5100) {
+		printf ("ERROR: expected 5100 records written or dropped (written=%d, overruns=%ld)..\n", lines, overruns);
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 68: %d records written, %ld dropped..\n", lines, overruns);
+
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+#endif
+
+
+nopoll_bool test_69 (void) {
+	noPollCtx   * ctx;
+	noPollConn  * conn;
+	noPollMsg   * msg;
+	noPollStats   stats;
+	int           tries;
+
+	printf ("Test 69: checking connection and context counters..\n");
+
+	ctx  = create_ctx ();
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected connection ready..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* send text (echoed by the listener) and a ping */
+	if (nopoll_conn_send_text (conn, "hello", 5) != 5 || ! nopoll_conn_send_ping (conn)) {
+		printf ("ERROR: failed to send content..\n");
+		return nopoll_false;
+	} /* end if */
+	tries = 0;
+	while (tries < 500 && (conn->stats.frames_in[NOPOLL_TEXT_FRAME] < 1 || conn->stats.frames_in[NOPOLL_PONG_FRAME] < 1)) {
+		msg = nopoll_conn_get_msg (conn);
+		if (msg)
+			nopoll_msg_unref (msg);
+		else
+			nopoll_sleep (10000);
+		tries++;
+	} /* end while */
+
+	if (! nopoll_conn_get_stats (conn, &stats)) {
+		printf ("ERROR: expected to get connection stats..\n");
+		return nopoll_false;
+	} /* end if */
+	if (stats.handshakes_ok != 1 || stats.handshakes_failed != 0 ||
+	    stats.frames_out[NOPOLL_TEXT_FRAME] != 1 || stats.bytes_out[NOPOLL_TEXT_FRAME] != 5 ||
+	    stats.frames_in[NOPOLL_TEXT_FRAME] != 1 || stats.bytes_in[NOPOLL_TEXT_FRAME] != 5 ||
+	    stats.frames_out[NOPOLL_PING_FRAME] != 1 || stats.frames_in[NOPOLL_PONG_FRAME] != 1 ||
+	    stats.pending_write_bytes != 0 || stats.frame_size_rejections != 0) {
+		printf ("ERROR: unexpected connection stats (handshakes=%ld, text out=%ld/%ld, text in=%ld/%ld, ping=%ld, pong=%ld)..\n",
+			stats.handshakes_ok, stats.frames_out[NOPOLL_TEXT_FRAME], stats.bytes_out[NOPOLL_TEXT_FRAME],
+			stats.frames_in[NOPOLL_TEXT_FRAME], stats.bytes_in[NOPOLL_TEXT_FRAME],
+			stats.frames_out[NOPOLL_PING_FRAME], stats.frames_in[NOPOLL_PONG_FRAME]);
+		return nopoll_false;
+	} /* end if */
+
+	/* ask the listener to close with status 1048 */
+	if (nopoll_conn_send_text (conn, "close with message", 18) != 18) {
+		printf ("ERROR: failed to request close..\n");
+		return nopoll_false;
+	} /* end if */
+	tries = 0;
+	while (tries < 500 && nopoll_conn_is_ok (conn)) {
+		msg = nopoll_conn_get_msg (conn);
+		if (msg)
+			nopoll_msg_unref (msg);
+		else
+			nopoll_sleep (10000);
+		tries++;
+	} /* end while */
+	nopoll_conn_close (conn);
+
+	/* context totals keep counters of closed connections */
+	if (! nopoll_ctx_get_stats (ctx, &stats) || nopoll_ctx_conns (ctx) != 0) {
+		printf ("ERROR: expected to get context stats..\n");
+		return nopoll_false;
+	} /* end if */
+	if (stats.close_other != 1 || stats.handshakes_ok != 1 ||
+	    stats.frames_in[NOPOLL_CLOSE_FRAME] != 1 || stats.frames_out[NOPOLL_TEXT_FRAME] != 2 ||
+	    stats.bytes_out[NOPOLL_TEXT_FRAME] != 23 || stats.frames_in[NOPOLL_PONG_FRAME] != 1) {
+		printf ("ERROR: unexpected context stats (close other=%ld, handshakes=%ld, close in=%ld, text out=%ld/%ld)..\n",
+			stats.close_other, stats.handshakes_ok, stats.frames_in[NOPOLL_CLOSE_FRAME],
+			stats.frames_out[NOPOLL_TEXT_FRAME], stats.bytes_out[NOPOLL_TEXT_FRAME]);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+
+int test_70_msgs;
+
+void test_70_on_msg (noPollCtx * ctx, noPollConn * conn, noPollMsg * msg, noPollPtr user_data)
+{
+	test_70_msgs++;
+	if (test_70_msgs == 10)
+		nopoll_loop_stop (ctx);
+	return;
+}
+
+nopoll_bool test_70 (void) {
+	noPollCtx       * ctx;
+	noPollConn      * conn;
+	noPollHistogram   hist;
+	noPollHistogram   other;
+	long              value;
+	int               iterator;
+
+	printf ("Test 70: checking latency histograms..\n");
+
+	/* buckets: exact below 4, 25% precision after that */
+	nopoll_histogram_reset (&hist);
+	value = 0;
+	while (value < 5000) {
+		if (__nopoll_histogram_value (__nopoll_histogram_index (value)) < value ||
+		    (value >= 4 && __nopoll_histogram_value (__nopoll_histogram_index (value)) > value + value / 4)) {
+			printf ("ERROR: wrong bucket for value %ld..\n", value);
+			return nopoll_false;
+		} /* end if */
+		value++;
+	} /* end while */
+	for (iterator = 1; iterator <= 100; iterator++)
+		nopoll_histogram_record (&hist, iterator * 10);
+	if (hist.count != 100 || hist.min != 10 || hist.max != 1000 || hist.sum != 50500 ||
+	    nopoll_histogram_percentile (&hist, 50) < 500 || nopoll_histogram_percentile (&hist, 50) > 625 ||
+	    nopoll_histogram_percentile (&hist, 100) != 1000 || nopoll_histogram_percentile (&hist, 0) != 10) {
+		printf ("ERROR: unexpected histogram (count=%ld, min=%ld, max=%ld, p50=%ld)..\n",
+			hist.count, hist.min, hist.max, nopoll_histogram_percentile (&hist, 50));
+		return nopoll_false;
+	} /* end if */
+	nopoll_histogram_reset (&other);
+	nopoll_histogram_record (&other, 5);
+	nopoll_histogram_record (&other, 100000);
+	nopoll_histogram_merge (&hist, &other);
+	if (hist.count != 102 || hist.min != 5 || hist.max != 100000 || nopoll_histogram_percentile (&hist, 99.5) != 100000) {
+		printf ("ERROR: unexpected merged histogram (count=%ld, min=%ld, max=%ld)..\n", hist.count, hist.min, hist.max);
+		return nopoll_false;
+	} /* end if */
+
+	/* record latencies of messages echoed by the listener */
+	ctx = create_ctx ();
+	if (! nopoll_ctx_set_latency_tracking (ctx, nopoll_true)) {
+		printf ("ERROR: expected to enable latency tracking..\n");
+		return nopoll_false;
+	} /* end if */
+	nopoll_ctx_set_on_msg (ctx, test_70_on_msg, NULL);
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5)) {
+		printf ("ERROR: expected connection ready..\n");
+		return nopoll_false;
+	} /* end if */
+
+	/* connections only keep their own histograms on request */
+	if (conn->latency != NULL || ! nopoll_conn_set_latency_tracking (conn, nopoll_true)) {
+		printf ("ERROR: expected connection histograms to be opt-in..\n");
+		return nopoll_false;
+	} /* end if */
+	for (iterator = 0; iterator < 10; iterator++) {
+		if (nopoll_conn_send_text (conn, "latency", 7) != 7) {
+			printf ("ERROR: failed to send content..\n");
+			return nopoll_false;
+		} /* end if */
+	} /* end for */
+	nopoll_loop_wait (ctx, 5000000);
+	if (test_70_msgs != 10) {
+		printf ("ERROR: expected 10 messages echoed (%d)..\n", test_70_msgs);
+		return nopoll_false;
+	} /* end if */
+
+	nopoll_conn_get_latency (conn, NOPOLL_LATENCY_WRITE_FLUSH, &hist);
+	if (hist.count != 10) {
+		printf ("ERROR: expected 10 writes timed (%ld)..\n", hist.count);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_get_latency (conn, NOPOLL_LATENCY_READ_TO_DISPATCH, &hist);
+	nopoll_conn_get_latency (conn, NOPOLL_LATENCY_HANDLER, &other);
+	if (hist.count != 10 || other.count != 10) {
+		printf ("ERROR: expected 10 messages timed (dispatch=%ld, handler=%ld)..\n", hist.count, other.count);
+		return nopoll_false;
+	} /* end if */
+
+	/* context histograms keep closed connections */
+	nopoll_conn_close (conn);
+	nopoll_ctx_get_latency (ctx, NOPOLL_LATENCY_HANDLER, &hist);
+	nopoll_ctx_get_latency (ctx, NOPOLL_LATENCY_LOOP, &other);
+	if (hist.count != 10 || other.count == 0) {
+		printf ("ERROR: expected context histograms (handler=%ld, loop=%ld)..\n", hist.count, other.count);
+		return nopoll_false;
+	} /* end if */
+	printf ("Test 70: handler p99=%ld us, loop p99=%ld us..\n",
+		nopoll_histogram_percentile (&hist, 99), nopoll_histogram_percentile (&other, 99));
+
+	/* and connections without their own histograms */
+	conn = nopoll_conn_new (ctx, "localhost", regtest_port (1234), NULL, NULL, NULL, NULL);
+	if (! nopoll_conn_wait_until_connection_ready (conn, 5) || nopoll_conn_send_text (conn, "latency", 7) != 7) {
+		printf ("ERROR: expected to send content..\n");
+		return nopoll_false;
+	} /* end if */
+	iterator = 0;
+	while (iterator < 100 && test_70_msgs != 11) {
+		nopoll_loop_wait (ctx, 10000);
+		iterator++;
+	} /* end while */
+	nopoll_conn_get_latency (conn, NOPOLL_LATENCY_HANDLER, &other);
+	nopoll_ctx_get_latency (ctx, NOPOLL_LATENCY_HANDLER, &hist);
+	if (test_70_msgs != 11 || conn->latency != NULL || other.count != 0 || hist.count != 11) {
+		printf ("ERROR: expected message recorded only by the context (msgs=%d, conn=%ld, ctx=%ld)..\n",
+			test_70_msgs, other.count, hist.count);
+		return nopoll_false;
+	} /* end if */
+	nopoll_conn_close (conn);
+
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+nopoll_bool test_71_scrape (noPollCtx * ctx, const char * request, char * reply, int reply_size)
+{
+	NOPOLL_SOCKET      session;
+	struct sockaddr_in addr;
+	int                tries;
+	int                read_bytes;
+	int                total = 0;
+
+	session = socket (AF_INET, SOCK_STREAM, 0);
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family      = AF_INET;
+	addr.sin_addr.s_addr = inet_addr ("127.0.0.1");
+	addr.sin_port        = htons ((unsigned short) regtest_port_int (1263));
+	if (session == NOPOLL_INVALID_SOCKET || connect (session, (struct sockaddr *) &addr, sizeof (addr)) != 0) {
+		printf ("ERROR: unable to connect to the listener..\n");
+		return nopoll_false;
+	} /* end if */
+	if (send (session, request, strlen (request), 0) != (int) strlen (request))
+		return nopoll_false;
+
+	/* let the loop reply and close the scraper connection */
+	tries = 0;
+	while (tries < 100) {
+		nopoll_loop_wait (ctx, 10000);
+		if (nopoll_ctx_conns (ctx) == 1 && tries > 0)
+			break;
+		tries++;
+	} /* end while */
+
+	while (total < reply_size - 1) {
+		read_bytes = recv (session, reply + total, reply_size - 1 - total, 0);
+		if (read_bytes <= 0)
+			break;
+		total += read_bytes;
+	} /* end while */
+	reply[total] = 0;
+	nopoll_close_socket (session);
+	return nopoll_true;
+}
+
+nopoll_bool test_71 (void) {
+	noPollCtx   * ctx;
+	noPollConn  * listener;
+	char        * text;
+	char          reply[32768];
+
+	printf ("Test 71: checking metrics exporter..\n");
+
+	ctx = create_ctx ();
+	nopoll_ctx_set_latency_tracking (ctx, nopoll_true);
+	if (! nopoll_ctx_set_metrics_path (ctx, "/metrics") || nopoll_ctx_set_metrics_path (ctx, "metrics")) {
+		printf ("ERROR: expected to accept only absolute metric paths..\n");
+		return nopoll_false;
+	} /* end if */
+	listener = nopoll_listener_new (ctx, "127.0.0.1", regtest_port (1263));
+	if (! nopoll_conn_is_ok (listener)) {
+		printf ("ERROR: expected to create listener..\n");
+		return nopoll_false;
+	} /* end if */
+
+	text = nopoll_metrics_render (ctx);
+	if (text == NULL || strstr (text, "nopoll_connections 1\n") == NULL || strcmp (text + strlen (text) - 6, "# EOF\n") != 0) {
+		printf ("ERROR: unexpected metrics rendered: %s\n", text ? text : "<null>");
+		return nopoll_false;
+	} /* end if */
+	nopoll_free (text);
+
+	/* plain GET without upgrade headers is replied and closed */
+	if (! test_71_scrape (ctx, "GET /metrics?format=text HTTP/1.1\r\nHost: localhost\r\n\r\n", reply, sizeof (reply)))
+		return nopoll_false;
+	if (strncmp (reply, "HTTP/1.1 200 OK\r\n", 17) != 0 ||
+	    strstr (reply, "Content-Type: application/openmetrics-text") == NULL ||
+	    strstr (reply, "nopoll_handshakes_total{result=\"ok\"} 0\n") == NULL ||
+	    strstr (reply, "nopoll_latency_loop_microseconds_bucket{le=\"+Inf\"}") == NULL ||
+	    strcmp (reply + strlen (reply) - 6, "# EOF\n") != 0) {
+		printf ("ERROR: unexpected metrics reply: %s\n", reply);
+		return nopoll_false;
+	} /* end if */
+
+	/* other paths still require a websocket upgrade */
+	if (! test_71_scrape (ctx, "GET /other HTTP/1.1\r\nHost: localhost\r\n\r\n", reply, sizeof (reply)))
+		return nopoll_false;
+	if (strlen (reply) != 0) {
+		printf ("ERROR: expected no reply for other paths: %s\n", reply);
+		return nopoll_false;
+	} /* end if */
+
+	/* failed upgrade is counted, replies written are no longer
+	 * pending and empty buckets are reported too */
+	text = nopoll_metrics_render (ctx);
+	if (text == NULL || strstr (text, "nopoll_handshakes_total{result=\"failed\"} 1\n") == NULL ||
+	    strstr (text, "nopoll_pending_write_bytes 0\n") == NULL ||
+	    strstr (text, "nopoll_latency_handler_microseconds_bucket{le=\"3.0\"} 0\n") == NULL ||
+	    strstr (text, "nopoll_latency_handler_microseconds_bucket{le=\"4294967295.0\"} 0\n") == NULL) {
+		printf ("ERROR: expected failed handshake reported: %s\n", text ? text : "<null>");
+		return nopoll_false;
+	} /* end if */
+	nopoll_free (text);
+
+	nopoll_conn_close (listener);
+	nopoll_ctx_unref (ctx);
+	return nopoll_true;
+}
+
+int main (int argc, char ** argv)
+{
+	int iterator;
+
+	printf ("** NoPoll: Websocket toolkit (regression test).\n");
+	printf ("** Copyright (C) 2025 Advanced Software Production Line, S.L.\n**\n");
+	printf ("** NoPoll regression tests: version=%s\n**\n",
+		VERSION);
+	printf ("** To gather information about time performance you can use:\n**\n");
+	printf ("**     >> time ./nopoll-regression-client [--debug,--show-critical-only,--offset-port <value>]\n**\n");
+	printf ("** Use --offset-port to add the value provided to every port used by the test,\n");
+	printf ("** so a complete run (listener and client) can be started without colliding with\n");
+	printf ("** another run already in progress. The same value must be provided to\n");
+	printf ("** ./nopoll-regression-listener\n**\n");
+	printf ("** To gather information about memory consumed (and leaks) use:\n**\n");
+	printf ("**     >> libtool --mode=execute valgrind --leak-check=yes --error-limit=no ./nopoll-regression-client\n**\n");
+	printf ("**\n");
+	printf ("** Report bugs to:\n**\n");
+	printf ("**     <nopoll@lists.aspl.es> noPoll mailing list\n**\n");
+	printf ("**     <info@aspl.es> ASPL's contact \n**\n");
+
+	/* configure port offset before anything else: every port used
+	 * by the tests is derived from it */
+	if (! regtest_configure_port_offset (argc, argv))
+		return -1;
+
+	iterator = 1;
+	while (iterator < argc) {
+		/* check for debug */
+		printf ("Checking agument: %s\n", argv[iterator]);
+		if (nopoll_cmp (argv[iterator], "--debug")) {
+			printf ("Activating debug..\n");
+			debug = nopoll_true;
+		} /* end if */
+		if (nopoll_cmp (argv[iterator], "--show-critical-only")) {
+			printf ("Activating reporting of critical messages..\n");
+			show_critical_only = nopoll_true;
+		} /* end if */
+
+		/* next position */
+		iterator++;
+	}
+
+#if defined(__NOPOLL_PTHREAD_SUPPORT__)	
+	printf ("INFO: install default threading functions to check noPoll locking code..\n");
+	nopoll_thread_handlers (__nopoll_regtest_mutex_create,
+				__nopoll_regtest_mutex_destroy,
+				__nopoll_regtest_mutex_lock,
+				__nopoll_regtest_mutex_unlock);
+#endif
+
+	printf ("INFO: starting tests with pid: %d\n", getpid ());
+	if (test_01_strings ()) {
+		printf ("Test 01-strings: Library strings support [   OK   ]\n");
+	}else {
+		printf ("Test 01-strings: Library strings support [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_01_base64 ()) {
+		printf ("Test 01-base64: Library base64 support [   OK   ]\n");
+	}else {
+		printf ("Test 01-base64: Library base64 support [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_01_support ()) {
+		printf ("Test 01-support: library support functions [   OK   ]\n");
+	}else {
+		printf ("Test 01-support: library support functions [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_01_masking ()) {
+		printf ("Test 01-masking: Library websocket content masking support [   OK   ]\n");
+	}else {
+		printf ("Test 01-masking: Library websocket content masking support [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_01 ()) {	
+		printf ("Test 01: Simple connect and disconnect [   OK   ]\n");
+	}else {
+		printf ("Test 01: Simple connect and disconnect [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_02 ()) {	
+		printf ("Test 02: Simple request/reply [   OK   ]\n");
+	}else {
+		printf ("Test 02: Simple request/reply [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_02a ()) {	
+		printf ("Test 02a: Simple request/reply (IPv6) [   OK   ]\n");
+	}else {
+		printf ("Test 02a: Simple request/reply (IPv6) [ FAILED ]\n");
+		return -1;
+	}
+
+	/* test sending ping */
+	if (test_02b ()) {	
+		printf ("Test 02b: test sending ping [   OK   ]\n");
+	}else {
+		printf ("Test 02a: test sending ping [ FAILED ]\n");
+		return -1;
+	}
+
+	/* test sending pong (without ping) */
+
+	/* test streaming api */
+	if (test_03 ()) {	
+		printf ("Test 03: test streaming api [   OK   ]\n");
+	}else {
+		printf ("Test 03: test streaming api [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04 (1024)) {	
+		printf ("Test 04: test streaming api (II) [   OK   ]\n");
+	}else {
+		printf ("Test 04: test streaming api (II) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04 (512)) {	
+		printf ("Test 04-a: test streaming api (III) [   OK   ]\n");
+	}else {
+		printf ("Test 04-a: test streaming api (III) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04 (137)) {	
+		printf ("Test 04-b: test streaming api (IV) [   OK   ]\n");
+	}else {
+		printf ("Test 04-b: test streaming api (IV) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04 (17)) {	
+		printf ("Test 04-c: test streaming api (V) [   OK   ]\n");
+	}else {
+		printf ("Test 04-c: test streaming api (V) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04a ()) {
+		printf ("Test 04-a: check non-blocking streaming and message based API  [   OK   ]\n");
+	} else {
+		printf ("Test 04-a: check non-blocking streaming and message based API [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04b ()) {
+		printf ("Test 04-b: try to overflow write access and recover from it  [   OK   ]\n");
+	} else {
+		printf ("Test 04-b: try to overflow write access and recover from it [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_04c ()) {
+		printf ("Test 04-c: send a file and try to overflow (but retry)  [   OK   ]\n");
+	} else {
+		printf ("Test 04-c: send a file and try to overflow (but retry) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_05 ()) {
+		printf ("Test 05: sending utf-8 content [   OK   ]\n");
+	} else {
+		printf ("Test 05: sending utf-8 content [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_06 ()) {
+		printf ("Test 06: testing basic TLS connect [   OK   ]\n");
+	} else {
+		printf ("Test 06: testing basic TLS connect [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_06a ()) {
+		printf ("Test 06a: testing basic TLS connect (IPv6) [   OK   ]\n");
+	} else {
+		printf ("Test 06a: testing basic TLS connect (IPv6) [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_07 ()) {
+		printf ("Test 07: testing TLS request/reply [   OK   ]\n");
+	} else {
+		printf ("Test 07: testing TLS request/reply [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_08 ()) {
+		printf ("Test 08: test normal connect to TLS port [   OK   ]\n");
+	} else {
+		printf ("Test 08: test normal connect to TLS port [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_09 ()) {
+		printf ("Test 09: ensure we only support Sec-WebSocket-Version: 13 [   OK   ]\n");
+	} else {
+		printf ("Test 09: ensure we only support Sec-WebSocket-Version: 13 [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_10 ()) {
+		printf ("Test 10: test checking origing in on open and denying it [   OK   ]\n");
+	} else {
+		printf ("Test 10: test checking origing in on open and denying it [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_11 ()) {
+		printf ("Test 11: release context after connection [   OK   ]\n");
+	} else {
+		printf ("Test 11: release context after connection [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_12 ()) {
+		printf ("Test 12: create huge amount of connections in a short time [   OK   ]\n");
+	} else {
+		printf ("Test 12: create huge amount of connections in a short time [ FAILED ]\n");
+		return -1;
+	}
+
+	if (test_13 ()) {
+		printf ("Test 13: testing certificate storage [   OK    ]\n");
+	} else {
 		printf ("Test 13: testing certificate storage [ FAILED  ]\n");
 		return -1;
 	}
@@ -4710,6 +7234,171 @@ int main (int argc, char ** argv)
 		return -1;
 	} /* end if */
 
+	if (test_49 ()) {
+		printf ("Test 49: check pluggable resolver and resolver cache         [   OK    ]\n");
+	} else {
+		printf ("Test 49: check pluggable resolver and resolver cache         [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_50 ()) {
+		printf ("Test 50: check dual stack (happy eyeballs) connect           [   OK    ]\n");
+	} else {
+		printf ("Test 50: check dual stack (happy eyeballs) connect           [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_51 ()) {
+		printf ("Test 51: check client connection pool                        [   OK    ]\n");
+	} else {
+		printf ("Test 51: check client connection pool                        [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_52 ()) {
+		printf ("Test 52: check timers                                        [   OK    ]\n");
+	} else {
+		printf ("Test 52: check timers                                        [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_53 ()) {
+		printf ("Test 53: check keepalive pings                               [   OK    ]\n");
+	} else {
+		printf ("Test 53: check keepalive pings                               [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_54 ()) {
+		printf ("Test 54: check permessage-deflate                            [   OK    ]\n");
+	} else {
+		printf ("Test 54: check permessage-deflate                            [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_55 ()) {
+		printf ("Test 55: check permessage-deflate compression policy         [   OK    ]\n");
+	} else {
+		printf ("Test 55: check permessage-deflate compression policy         [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_56 ()) {
+		printf ("Test 56: check UTF-8 validation                              [   OK    ]\n");
+	} else {
+		printf ("Test 56: check UTF-8 validation                              [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_57 ()) {
+		printf ("Test 57: check streaming receive                             [   OK    ]\n");
+	} else {
+		printf ("Test 57: check streaming receive                             [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_58 ()) {
+		printf ("Test 58: check zero copy chaining and message reassembly     [   OK    ]\n");
+	} else {
+		printf ("Test 58: check zero copy chaining and message reassembly     [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_59 ()) {
+		printf ("Test 59: check streaming send                                [   OK    ]\n");
+	} else {
+		printf ("Test 59: check streaming send                                [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_60 ()) {
+		printf ("Test 60: check sending files                                 [   OK    ]\n");
+	} else {
+		printf ("Test 60: check sending files                                 [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_61 ()) {
+		printf ("Test 61: check kTLS offload                                  [   OK    ]\n");
+	} else {
+		printf ("Test 61: check kTLS offload                                  [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_62 ()) {
+		printf ("Test 62: check TLS write batching                            [   OK    ]\n");
+	} else {
+		printf ("Test 62: check TLS write batching                            [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_63 ()) {
+		printf ("Test 63: check certificate selection by SNI                  [   OK    ]\n");
+	} else {
+		printf ("Test 63: check certificate selection by SNI                  [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_64 ()) {
+		printf ("Test 64: check certificate reload                            [   OK    ]\n");
+	} else {
+		printf ("Test 64: check certificate reload                            [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_65 ()) {
+		printf ("Test 65: check non-blocking TLS handshakes                   [   OK    ]\n");
+	} else {
+		printf ("Test 65: check non-blocking TLS handshakes                   [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+#if defined(__NOPOLL_PTHREAD_SUPPORT__) && defined(NOPOLL_HAVE_PTHREAD)
+	if (test_66 ()) {
+		printf ("Test 66: check TLS handshake workers                         [   OK    ]\n");
+	} else {
+		printf ("Test 66: check TLS handshake workers                         [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+#endif
+
+	if (test_67 ()) {
+		printf ("Test 67: check log levels and handlers                       [   OK    ]\n");
+	} else {
+		printf ("Test 67: check log levels and handlers                       [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+#if defined(NOPOLL_HAVE_PTHREAD) && defined(SHOW_DEBUG_LOG)
+	if (test_68 ()) {
+		printf ("Test 68: check asynchronous logger                           [   OK    ]\n");
+	} else {
+		printf ("Test 68: check asynchronous logger                           [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+#endif
+
+	if (test_69 ()) {
+		printf ("Test 69: check connection and context counters               [   OK    ]\n");
+	} else {
+		printf ("Test 69: check connection and context counters               [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_70 ()) {
+		printf ("Test 70: check latency histograms                            [   OK    ]\n");
+	} else {
+		printf ("Test 70: check latency histograms                            [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
+	if (test_71 ()) {
+		printf ("Test 71: check metrics exporter                              [   OK    ]\n");
+	} else {
+		printf ("Test 71: check metrics exporter                              [ FAILED  ]\n");
+		return -1;
+	} /* end if */
+
 	/* add support to reply with redirect 301 to an opening
 	 * request: page 19 and 22 */
 
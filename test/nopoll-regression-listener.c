@@ -129,6 +129,11 @@ void listener_on_message (noPollCtx * ctx, noPollConn * conn, noPollMsg * msg, n
 	FILE       * open_file_cmd = NULL;
 	int          iterator;
 	char       * ref;
+	FILE       * send_file;
+	char         send_file_path[256];
+	long         send_file_offset;
+	long         send_file_length;
+	char         reload_key_path[256];
 
 	/* check for open file commands */
 	if (nopoll_ncmp (content, "open-file: ", 11)) {
@@ -161,6 +166,50 @@ void listener_on_message (noPollCtx * ctx, noPollConn * conn, noPollMsg * msg, n
 		previous_msg = NULL;
 		return;
 	} /* end if */
+	if (nopoll_ncmp (content, "send-file: ", 11)) {
+		/* format: send-file: <offset> <length> <path> */
+		send_file_offset = 0;
+		send_file_length = 0;
+		send_file_path[0] = 0;
+		sscanf (content + 11, "%ld %ld %255s", &send_file_offset, &send_file_length, send_file_path);
+		send_file = fopen (send_file_path, "rb");
+		if (send_file == NULL) {
+			printf ("ERROR: unable to open file: %s\n", send_file_path);
+			return;
+		} /* end if */
+		printf ("Listener: sending file %s (offset %ld, length %ld, sendfile: %d)..\n",
+			send_file_path, send_file_offset, send_file_length, __nopoll_conn_can_sendfile (conn));
+		if (nopoll_conn_send_file (conn, fileno (send_file), send_file_offset, send_file_length) < 0)
+			printf ("ERROR: failed to send file: %s\n", send_file_path);
+		fclose (send_file);
+		return;
+	} /* end if */
+	if (nopoll_ncmp (content, "reload-certificate: ", 20)) {
+		/* format: reload-certificate: <certificate> <key> */
+		send_file_path[0]  = 0;
+		reload_key_path[0] = 0;
+		sscanf (content + 20, "%255s %255s", send_file_path, reload_key_path);
+		printf ("Listener: reloading certificate %s (key %s)..\n", send_file_path, reload_key_path);
+		if (nopoll_listener_reload_certificate (nopoll_conn_get_listener (conn), send_file_path, reload_key_path, NULL))
+			nopoll_conn_send_text (conn, "reloaded", 8);
+		else
+			nopoll_conn_send_text (conn, "failed", 6);
+		return;
+	} /* end if */
+	if (nopoll_ncmp (content, "chain-fragments", 15)) {
+		/* join next fragments of this connection with
+		 * nopoll_msg_chain instead of nopoll_msg_join */
+		printf ("Listener: chaining fragments received..\n");
+		nopoll_conn_set_hook (conn, (noPollPtr) "chain-fragments");
+		return;
+	} /* end if */
+	if (nopoll_ncmp (content, "send-fragments", 14)) {
+		printf ("Listener: replying with a fragmented message..\n");
+		nopoll_conn_send_text_fragment (conn, "Hel", 3);
+		nopoll_conn_send_text_fragment (conn, "l", 1);
+		nopoll_conn_send_text (conn, "o", 1);
+		return;
+	} /* end if */
 	if (nopoll_ncmp (content, "get-cookie", 10)) {
 		printf ("Listener: reporting cookie: %s\n", nopoll_conn_get_cookie (conn));
 		nopoll_conn_send_text (conn, nopoll_conn_get_cookie (conn), strlen (nopoll_conn_get_cookie (conn)));
@@ -267,7 +316,10 @@ void listener_on_message (noPollCtx * ctx, noPollConn * conn, noPollMsg * msg, n
 		printf ("Found fragment, FIN = %d (%p)?..\n", nopoll_msg_is_final (msg), msg);
 		/* call to join this message */
 		aux          = previous_msg;
-		previous_msg = nopoll_msg_join (previous_msg, msg);
+		if (nopoll_conn_get_hook (conn))
+			previous_msg = nopoll_msg_chain (previous_msg, msg);
+		else
+			previous_msg = nopoll_msg_join (previous_msg, msg);
 		nopoll_msg_unref (aux);
 		if (previous_msg == NULL) {
 			printf ("ERROR: failed to join received fragment, unable to reply..\n");
@@ -400,6 +452,10 @@ int main (int argc, char ** argv)
 #if defined(NOPOLL_HAVE_TLSv12_ENABLED)
 	noPollConn     * listener7;
 #endif	
+#if defined(NOPOLL_HAVE_ZLIB)
+	noPollConn     * listener8;
+#endif
+	noPollConn     * listener9;
 	int              iterator;
 	noPollConnOpts * opts;
 
@@ -476,6 +532,13 @@ int main (int argc, char ** argv)
 		return -1;
 	}
 
+	/* certificates selected by SNI (see test_63) */
+	if (! nopoll_ctx_set_certificate (ctx, "sni.nopoll.test", "server.pem", "server.pem", NULL) ||
+	    ! nopoll_ctx_set_certificate (ctx, "*.wild.nopoll.test", "server.pem", "server.pem", NULL)) {
+		printf ("ERROR: unable to setup SNI certificates at context level..\n");
+		return -1;
+	}
+
 	/* now start a TLS version */
 	printf ("Test: starting listener with TLS IPv6 (TLSv1) at :%s\n", regtest_port (2235));
 	listener_62 = nopoll_listener_tls_new6 (ctx, "::1", regtest_port (2235));
@@ -574,6 +637,30 @@ int main (int argc, char ** argv)
 	} /* end if */
 
 
+#if defined(NOPOLL_HAVE_ZLIB)
+	printf ("Test: starting listener with permessage-deflate at :%s\n", regtest_port (1241));
+	opts     = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_permessage_deflate (opts, nopoll_true);
+	listener8 = nopoll_listener_new_opts (ctx, opts, "0.0.0.0", regtest_port (1241));
+	if (! nopoll_conn_is_ok (listener8)) {
+		printf ("ERROR: Expected to find proper listener connection status (:%s, permessage-deflate), but found..\n", regtest_port (1241));
+		return -1;
+	} /* end if */
+#endif
+
+	printf ("Test: starting listener with TLS (kTLS requested) at :%s\n", regtest_port (1242));
+	opts     = nopoll_conn_opts_new ();
+	nopoll_conn_opts_set_ktls (opts, nopoll_true);
+	listener9 = nopoll_listener_tls_new_opts (ctx, opts, "0.0.0.0", regtest_port (1242));
+	if (! nopoll_conn_is_ok (listener9)) {
+		printf ("ERROR: Expected to find proper listener TLS connection status (:%s, kTLS), but found..\n", regtest_port (1242));
+		return -1;
+	} /* end if */
+	if (! nopoll_listener_set_certificate (listener9, "test-certificate.crt", "test-private.key", NULL)) {
+		printf ("ERROR: unable to configure certificates for TLS websocket (kTLS)..\n");
+		return -1;
+	} /* end if */
+
 	/* configure ssl context creator */
 	/* nopoll_ctx_set_ssl_context_creator (ctx, ssl_context_creator, NULL); */
 
@@ -607,6 +694,10 @@ int main (int argc, char ** argv)
 #if defined(NOPOLL_HAVE_TLSv12_ENABLED)
 	nopoll_conn_close (listener7);
 #endif	
+#if defined(NOPOLL_HAVE_ZLIB)
+	nopoll_conn_close (listener8);
+#endif
+	nopoll_conn_close (listener9);
 
 	/* finish */
 	printf ("Listener: finishing references: %d\n", nopoll_ctx_ref_count (ctx));